@@ -56,6 +56,7 @@ struct PushCommandOptions
 {
     std::vector<std::string> pushModules;
     linglong::common::cli::RepoOptions repoOptions;
+    std::string deltaFrom; // Version to generate a static delta from
 };
 
 struct ImportCommandOptions
@@ -319,7 +319,8 @@ int handlePush(linglong::builder::Builder &builder, const PushCommandOptions &op
     for (const auto &module : options.pushModules) {
         LogI("Pushing module: {}", module);
 
-        auto result = builder.push(module, repoOpts.repoUrl, repoOpts.repoName);
+        auto result =
+          builder.push(module, repoOpts.repoUrl, repoOpts.repoName, options.deltaFrom);
         if (!result) {
             LogE("Push failed for module {}: {}", module, result.error());
             return result.error().code();
@@ -663,6 +664,12 @@ You can report bugs to the linyaps team under this project: https://github.com/O
       ->type_name("NAME")
       ->check(validatorString);
     buildPush->add_option("--module", pushModule, _("Push single module"))->check(validatorString);
+    buildPush
+      ->add_option("--delta-from",
+                   pushOpts.deltaFrom,
+                   _("Generate a static delta from this version in the local repo"))
+      ->type_name("VERSION")
+      ->check(validatorString);
 
     // add build import
     auto buildImport =
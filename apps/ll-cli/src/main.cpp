@@ -9,6 +9,7 @@
 #include "linglong/cli/dbus_notifier.h"
 #include "linglong/cli/dummy_notifier.h"
 #include "linglong/cli/json_printer.h"
+#include "linglong/cli/launcher.h"
 #include "linglong/cli/terminal_notifier.h"
 #include "linglong/common/error.h"
 #include "linglong/common/global/initialize.h"
@@ -16,6 +17,7 @@
 #include "linglong/utils/finally/finally.h"
 #include "linglong/utils/gettext.h"
 #include "linglong/utils/log/log.h"
+#include "linglong/utils/log/trace.h"
 #include "ocppi/cli/crun/Crun.hpp"
 
 #include <CLI/CLI.hpp>
@@ -569,6 +571,17 @@ void addInspectCommand(CLI::App &commandParser,
       ->check(validatorString);
 }
 
+// Function to add the launcher subcommand
+void addLauncherCommand(CLI::App &commandParser, const std::string &group)
+{
+    commandParser
+      .add_subcommand("launcher",
+                      _("Keep the repository and namespace of run commands ready to launch "
+                        "applications faster"))
+      ->group(group)
+      ->usage(_("Usage: ll-cli launcher [OPTIONS]"));
+}
+
 } // namespace
 
 int runCliApplication(int argc, char **mainArgv)
@@ -614,6 +627,12 @@ You can report bugs to the linyaps team under this project: https://github.com/O
                            globalOptions.noProgress,
                            _("Don't output progress information"));
 
+    // trace option, the same as LINYAPS_TRACE_FILE
+    std::string traceFile;
+    commandParser.add_option("--trace", traceFile, _("Write a chrome trace of the run to the file"))
+      ->type_name("FILE")
+      ->group(CliHiddenGroup);
+
     // subcommand options
     RunOptions runOptions{};
     EnterOptions enterOptions{};
@@ -657,6 +676,7 @@ You can report bugs to the linyaps team under this project: https://github.com/O
     addContentCommand(commandParser, contentOptions, CliBuildInGroup);
     addPruneCommand(commandParser, CliAppManagingGroup);
     addInspectCommand(commandParser, inspectOptions, CliHiddenGroup);
+    addLauncherCommand(commandParser, CliHiddenGroup);
 
     auto res = transformOldExec(argc, argv);
     CLI11_PARSE(commandParser, std::move(res));
@@ -677,6 +697,16 @@ You can report bugs to the linyaps team under this project: https://github.com/O
     if (globalOptions.verbose > 1) {
         ::setenv("LINYAPS_BACKTRACE", "1", 1);
     }
+    if (!traceFile.empty()) {
+        linglong::utils::log::g_tracer.setTraceFile(traceFile);
+    }
+
+    // hand the run over to the launcher of the user if there is one
+    if (commandParser.got_subcommand("run") && !*jsonFlag) {
+        if (auto launched = launchByLauncher(runOptions, globalOptions); launched) {
+            return *launched;
+        }
+    }
 
     // create printer
     std::unique_ptr<Printer> printer;
@@ -711,8 +741,11 @@ You can report bugs to the linyaps team under this project: https://github.com/O
     // create notifier
     std::unique_ptr<InteractiveNotifier> notifier{ nullptr };
 
+    // the launcher forks for every launch, it must not start the DBus thread of Qt;
     // if ll-cli is running in tty, should use terminalNotifier.
-    if (::isatty(STDIN_FILENO) != 0 && ::isatty(STDOUT_FILENO) != 0) {
+    if (commandParser.got_subcommand("launcher")) {
+        notifier = std::make_unique<linglong::cli::DummyNotifier>();
+    } else if (::isatty(STDIN_FILENO) != 0 && ::isatty(STDOUT_FILENO) != 0) {
         notifier = std::make_unique<TerminalNotifier>();
     } else {
         try {
@@ -809,6 +842,8 @@ You can report bugs to the linyaps team under this project: https://github.com/O
         result = cli->inspect(*ret, inspectOptions);
     } else if (name == "repo") {
         result = cli->repo(*ret, repoOptions);
+    } else if (name == "launcher") {
+        result = cli->launcher();
     } else {
         // if subcommand name is not found, print help
         std::cout << commandParser.help("", CLI::AppFormatMode::All);
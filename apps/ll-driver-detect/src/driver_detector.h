@@ -4,20 +4,13 @@
 
 #pragma once
 
+#include "linglong/driver/detection_cache.h"
 #include "linglong/utils/error/error.h"
 
 #include <string>
 
 namespace linglong::driver::detect {
 
-struct GraphicsDriverInfo
-{
-    std::string identify;
-    std::string packageName;
-    std::string packageVersion;
-    std::string repoName{ "stable" };
-};
-
 class DriverDetector
 {
 public:
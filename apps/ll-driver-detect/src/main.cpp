@@ -9,6 +9,7 @@
 #include "driver_detection_manager.h"
 #include "driver_detector.h"
 #include "linglong/common/global/initialize.h"
+#include "linglong/driver/detection_cache.h"
 #include "linglong/utils/error/error.h"
 #include "linglong/utils/gettext.h"
 #include "tl/expected.hpp"
@@ -20,6 +21,7 @@
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace {
 
@@ -145,25 +147,37 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // don't cache this, the detection cache doesn't know when reminders are enabled again
     auto configManager = *configManagerResult;
     if (!options.force && !configManager.shouldShowNotification()) {
         LogD("User has chosen not to be reminded about driver installation");
         return 0;
     }
 
+    // an empty result stops ll-cli from starting the detection until the drivers are changed
+    auto driverStamp = hostDriverStamp();
+    DetectionCache detectionCache(DetectionCache::defaultPath());
+
     // Create driver detection manager for multi-driver support
     DriverDetectionManager detectionManager;
 
-    // Run driver detection and handling for all available drivers
-    auto result = detectionManager.detectAvailableDrivers();
+    std::vector<GraphicsDriverInfo> detectionResult;
+    if (auto cached = detectionCache.lookup(driverStamp); cached && !options.force) {
+        LogD("Reuse the graphics drivers detected before");
+        detectionResult = std::move(cached).value();
+    } else {
+        // Run driver detection and handling for all available drivers
+        auto result = detectionManager.detectAvailableDrivers();
 
-    if (!result) {
-        LogF("Driver detection failed: {}", result.error().message());
+        if (!result) {
+            LogF("Driver detection failed: {}", result.error().message());
 
-        return 1;
-    }
+            return 1;
+        }
 
-    const auto &detectionResult = *result;
+        detectionResult = std::move(result).value();
+        detectionCache.store(driverStamp, detectionResult);
+    }
 
     if (detectionResult.size() == 0) {
         LogD("No graphics drivers detected that require installation or upgrade");
@@ -194,6 +208,8 @@ int main(int argc, char *argv[])
             LogW("Failed to install driver package {}: {}",
                  options.packageName,
                  installResult.error().message());
+        } else {
+            detectionCache.store(driverStamp, {});
         }
 
         std::cout << "Successfully installed driver package" << std::endl;
@@ -240,6 +256,7 @@ int main(int argc, char *argv[])
         }
 
         LogD("Successfully installed driver package");
+        detectionCache.store(driverStamp, {});
 
         // Send success notification
         DBusNotifier::NotificationRequest successRequest;
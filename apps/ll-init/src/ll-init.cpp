@@ -4,16 +4,24 @@
 #include <fmt/format.h>
 #include <sys/epoll.h>
 #include <sys/fcntl.h>
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
 #include <sys/prctl.h>
 #include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
 
+#include <algorithm>
 #include <array>
 #include <csignal>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <ctime>
 #include <filesystem>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include <sys/wait.h>
@@ -24,6 +32,14 @@ constexpr std::array unblock_signals{ SIGABRT, SIGBUS,  SIGFPE,  SIGILL, SIGSEGV
 
 constexpr auto containerLockPath = "/run/linglong/.lock";
 
+// ll-cli mounts this directory of the bundle to reuse the container without the OCI runtime
+constexpr auto execServerDir = "/run/linglong/init";
+constexpr auto execSocketPath = "/run/linglong/init/exec.sock";
+// the environment is the largest part of a request
+constexpr std::size_t maxExecRequestSize = 256 * 1024;
+// connections whose request is not received yet, the oldest one is dropped beyond this
+constexpr std::size_t maxPendingExecRequests = 16;
+
 namespace {
 
 void print_sys_error(std::string_view msg, int error) noexcept
@@ -44,6 +60,49 @@ void print_info(std::string_view msg) noexcept
     }
 }
 
+// CLOCK_MONOTONIC in nanoseconds, the same clock is used by the trace of ll-cli
+uint64_t monotonic_now() noexcept
+{
+    struct timespec ts{};
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000U + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+const uint64_t init_begin = monotonic_now();
+
+// Append the span from init_begin to now as a chrome trace event to the file named by
+// LINYAPS_TRACE_FILE, see linglong/utils/log/trace.h. It's called right before exec the command.
+void trace_until_now(std::string_view name) noexcept
+{
+    const auto *file = ::getenv("LINYAPS_TRACE_FILE");
+    if (file == nullptr || file[0] == '\0') {
+        return;
+    }
+
+    auto end = monotonic_now();
+    auto fd = ::open(file, O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+
+    auto pid = ::getpid();
+    auto events = fmt::format(
+      R"({{"name":"process_name","ph":"M","pid":{0},"args":{{"name":"ll-init"}}}},)"
+      "\n"
+      R"({{"name":"{1}","cat":"linglong","ph":"X",)"
+      R"("ts":{2:.3f},"dur":{3:.3f},"pid":{0},"tid":{0}}},)"
+      "\n",
+      pid,
+      name,
+      static_cast<double>(init_begin) / 1000,
+      static_cast<double>(end - init_begin) / 1000);
+    // a single write, the events are not interleaved with the ones of other processes
+    if (::write(fd, events.data(), events.size()) == -1) {
+        print_sys_error("failed to write trace");
+    }
+    ::close(fd);
+}
+
 [[nodiscard]] int get_child_status(int status, pid_t pid) noexcept
 {
     if (WIFEXITED(status)) {
@@ -64,6 +123,17 @@ void print_info(std::string_view msg) noexcept
     return -1;
 }
 
+// pidfd_open(2), glibc only wraps it since 2.36
+int pidfd_open(pid_t pid) noexcept
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 class UniqueFd
 {
 public:
@@ -183,6 +253,13 @@ public:
         return true;
     }
 
+    void remove(int fd) noexcept
+    {
+        if (::epoll_ctl(fd_.get(), EPOLL_CTL_DEL, fd, nullptr) == -1) {
+            print_sys_error("failed to remove event from epoll");
+        }
+    }
+
     int wait(int timeout = -1) noexcept
     {
         auto n = ::epoll_wait(fd_.get(), events_.data(), static_cast<int>(events_.size()), timeout);
@@ -220,6 +297,283 @@ private:
     int n_ready_{ 0 };
 };
 
+// ExecServer runs the commands sent by ll-cli to the running container, which saves starting
+// the OCI runtime and entering the namespaces for every reuse. See
+// linglong/runtime/init_exec.cpp for the protocol.
+class ExecServer
+{
+public:
+    static ExecServer listen() noexcept
+    {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(execServerDir, ec)) {
+            print_info("exec server is disabled");
+            return ExecServer{};
+        }
+
+        UniqueFd fd(::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+        if (!fd) {
+            print_sys_error("failed to create exec socket");
+            return ExecServer{};
+        }
+
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, execSocketPath, sizeof(addr.sun_path) - 1);
+        ::unlink(execSocketPath);
+        if (::bind(fd.get(), reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1
+            || ::listen(fd.get(), SOMAXCONN) == -1) {
+            print_sys_error(fmt::format("failed to listen on {}", execSocketPath));
+            return ExecServer{};
+        }
+
+        return ExecServer{ std::move(fd) };
+    }
+
+    // Accept the pending connections. Their requests are received by receive() once they are
+    // readable, a client that sends nothing never blocks the init process.
+    void accept(Epoll &epoll) noexcept
+    {
+        while (true) {
+            UniqueFd connection(
+              ::accept4(fd_.get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+            if (!connection) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    print_sys_error("failed to accept exec request");
+                }
+                return;
+            }
+
+            if (!epoll.add(connection.get(), EPOLLIN)) {
+                continue;
+            }
+
+            if (pending_.size() >= maxPendingExecRequests) {
+                print_info("too many pending exec requests, drop the oldest one");
+                epoll.remove(pending_.front().get());
+                pending_.erase(pending_.begin());
+            }
+            pending_.push_back(std::move(connection));
+        }
+    }
+
+    [[nodiscard]] bool is_pending(int fd) const noexcept
+    {
+        return std::any_of(pending_.begin(), pending_.end(), [fd](const UniqueFd &connection) {
+            return connection.get() == fd;
+        });
+    }
+
+    // receive the request of a pending connection and run its command
+    void receive(Epoll &epoll, int fd, const SignalMask &mask) noexcept
+    {
+        auto it = std::find_if(pending_.begin(), pending_.end(), [fd](const UniqueFd &connection) {
+            return connection.get() == fd;
+        });
+        if (it == pending_.end()) {
+            return;
+        }
+
+        std::string payload(maxExecRequestSize, '\0');
+        struct iovec iov{ .iov_base = payload.data(), .iov_len = payload.size() };
+        alignas(struct cmsghdr) std::array<char, CMSG_SPACE(sizeof(int) * 3)> control{};
+        struct msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+
+        ssize_t n{ -1 };
+        while ((n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR) {
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        // the connection is only readable again once the client quits
+        epoll.remove(fd);
+        auto connection = std::move(*it);
+        pending_.erase(it);
+        if (n == -1) {
+            print_sys_error("failed to receive exec request");
+            return;
+        }
+        if (n == 0) {
+            print_info("exec client closed the connection without a request");
+            return;
+        }
+        payload.resize(static_cast<std::size_t>(n));
+
+        std::vector<UniqueFd> stdio;
+        for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+
+            const auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (std::size_t i = 0; i < count; ++i) {
+                int fd{ -1 };
+                std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                stdio.emplace_back(fd);
+            }
+        }
+
+        std::vector<std::string> fields;
+        std::size_t argc{ 0 };
+        std::size_t envc{ 0 };
+        if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0 || stdio.size() != 3
+            || !parse_request(payload, fields, argc, envc)) {
+            reply(connection.get(), "error invalid request");
+            return;
+        }
+
+        std::vector<char *> args;
+        for (std::size_t i = 3; i < 3 + argc; ++i) {
+            args.push_back(fields[i].data());
+        }
+        args.push_back(nullptr);
+
+        std::vector<char *> env;
+        for (std::size_t i = 3 + argc; i < fields.size(); ++i) {
+            env.push_back(fields[i].data());
+        }
+        env.push_back(nullptr);
+
+        auto pid = ::fork();
+        if (pid == -1) {
+            print_sys_error("failed to fork for exec request");
+            reply(connection.get(), "error failed to fork");
+            return;
+        }
+
+        if (pid == 0) {
+            // like the processes started by the OCI runtime, it's not in the process group of
+            // the container process
+            if (::setpgid(0, 0) == -1 || !mask.restore()) {
+                ::_exit(EXIT_FAILURE);
+            }
+
+            for (int i = 0; i < 3; ++i) {
+                if (::dup2(stdio[i].get(), i) == -1) {
+                    ::_exit(EXIT_FAILURE);
+                }
+            }
+
+            const auto &cwd = fields[2];
+            if (!cwd.empty() && ::chdir(cwd.c_str()) == -1) {
+                print_sys_error(fmt::format("failed to change directory to {}", cwd));
+                ::_exit(EXIT_FAILURE);
+            }
+
+            if (envc == 0) {
+                ::execvp(args[0], args.data());
+            } else {
+                ::execvpe(args[0], args.data(), env.data());
+            }
+            print_sys_error(fmt::format("failed to run {}", args[0]));
+            ::_exit(EXIT_FAILURE);
+        }
+
+        print_info(fmt::format("run exec request {}", pid));
+        clients_.push_back(Client{ pid, std::move(connection) });
+    }
+
+    // Report the exit code to the client if pid is started by the server.
+    void on_child_exit(pid_t pid, int code) noexcept
+    {
+        auto it = std::find_if(clients_.begin(), clients_.end(), [pid](const Client &client) {
+            return client.pid == pid;
+        });
+        if (it == clients_.end()) {
+            return;
+        }
+
+        reply(it->connection.get(), fmt::format("exit {}", code));
+        clients_.erase(it);
+    }
+
+    [[nodiscard]] int fd() const noexcept { return fd_.get(); }
+
+    [[nodiscard]] explicit operator bool() const noexcept { return static_cast<bool>(fd_); }
+
+    ExecServer(ExecServer &&) noexcept = default;
+    ExecServer &operator=(ExecServer &&) noexcept = default;
+    ExecServer(const ExecServer &) = delete;
+    ExecServer &operator=(const ExecServer &) = delete;
+
+    ~ExecServer() noexcept
+    {
+        // the clients fall back to the OCI runtime once the container is quitting
+        if (fd_) {
+            ::unlink(execSocketPath);
+        }
+    }
+
+private:
+    struct Client
+    {
+        pid_t pid;
+        UniqueFd connection;
+    };
+
+    ExecServer() noexcept = default;
+
+    explicit ExecServer(UniqueFd fd) noexcept
+        : fd_(std::move(fd))
+    {
+    }
+
+    static void reply(int connection, std::string_view msg) noexcept
+    {
+        if (::send(connection, msg.data(), msg.size(), MSG_NOSIGNAL) == -1) {
+            print_sys_error("failed to reply exec request");
+        }
+    }
+
+    // The request is NUL terminated fields: the number of arguments, the number of environment
+    // variables, the working directory, the arguments and the environment variables.
+    static bool parse_request(const std::string &payload,
+                              std::vector<std::string> &fields,
+                              std::size_t &argc,
+                              std::size_t &envc) noexcept
+    {
+        if (payload.empty() || payload.back() != '\0') {
+            return false;
+        }
+
+        std::size_t begin = 0;
+        while (begin < payload.size()) {
+            auto end = payload.find('\0', begin);
+            fields.emplace_back(payload, begin, end - begin);
+            begin = end + 1;
+        }
+
+        if (fields.size() < 3) {
+            return false;
+        }
+
+        char *end{ nullptr };
+        argc = std::strtoul(fields[0].c_str(), &end, 10);
+        if (*end != '\0') {
+            return false;
+        }
+        envc = std::strtoul(fields[1].c_str(), &end, 10);
+        if (*end != '\0') {
+            return false;
+        }
+
+        return argc > 0 && fields.size() == 3 + argc + envc;
+    }
+
+    UniqueFd fd_;
+    std::vector<UniqueFd> pending_;
+    std::vector<Client> clients_;
+};
+
 class ChildProcess;
 
 class SignalMonitor
@@ -234,7 +588,7 @@ public:
         return SignalMonitor(UniqueFd(fd));
     }
 
-    bool dispatch(ChildProcess &child) noexcept;
+    bool dispatch(ChildProcess &child, ExecServer &server) noexcept;
 
     [[nodiscard]] int fd() const noexcept { return fd_.get(); }
 
@@ -282,13 +636,21 @@ public:
                 return ChildProcess{};
             }
 
+            trace_until_now("ll-init");
             ::execvp(args[0], const_cast<char *const *>(args.data()));
             print_sys_error("failed to run process");
             ::_exit(EXIT_FAILURE);
         }
 
         print_info(fmt::format("run child {}", pid));
-        return ChildProcess{ pid };
+        // the exit of the child is watched by its pidfd, SIGCHLD is still handled as the
+        // fallback for kernels without pidfd
+        UniqueFd pidfd(pidfd_open(pid));
+        if (!pidfd && errno != ENOSYS) {
+            print_sys_error("failed to open pidfd of child");
+        }
+
+        return ChildProcess{ pid, std::move(pidfd) };
     }
 
     void forward_signal(int signo) const noexcept
@@ -309,7 +671,7 @@ public:
         }
     }
 
-    void reap_pending() noexcept
+    void reap_pending(ExecServer &server) noexcept
     {
         while (true) {
             int status{};
@@ -325,13 +687,15 @@ public:
 
             auto code = get_child_status(status, ret);
             if (ret == pid_) {
-                pid_ = -1;
-                exit_code_ = code;
+                on_exit(code);
+                continue;
             }
+
+            server.on_child_exit(ret, code);
         }
     }
 
-    [[nodiscard]] static bool has_zombies() noexcept
+    [[nodiscard]] static bool has_zombies(ExecServer &server) noexcept
     {
         while (true) {
             int status{};
@@ -350,13 +714,35 @@ public:
             }
 
             if (ret > 0) {
-                std::ignore = get_child_status(status, ret);
+                server.on_child_exit(ret, get_child_status(status, ret));
             }
 
             return true;
         }
     }
 
+    // reap the child once its pidfd is readable
+    void reap() noexcept
+    {
+        if (pid_ <= 0) {
+            return;
+        }
+
+        int status{};
+        auto ret = ::waitpid(pid_, &status, WNOHANG);
+        if (ret == -1 && errno != ECHILD) {
+            print_sys_error("failed to wait for child");
+            return;
+        }
+
+        if (ret == pid_) {
+            on_exit(get_child_status(status, ret));
+        }
+    }
+
+    // -1 if pidfd is not supported or the child has exited
+    [[nodiscard]] int pidfd() const noexcept { return pidfd_.get(); }
+
     [[nodiscard]] int exit_code() const noexcept { return exit_code_; }
 
     [[nodiscard]] bool is_alive() const noexcept { return pid_ > 0; }
@@ -367,6 +753,7 @@ public:
 
     ChildProcess(ChildProcess &&other) noexcept
         : pid_(other.pid_)
+        , pidfd_(std::move(other.pidfd_))
     {
         other.pid_ = 0;
     }
@@ -375,6 +762,7 @@ public:
     {
         if (this != &other) {
             pid_ = other.pid_;
+            pidfd_ = std::move(other.pidfd_);
             other.pid_ = 0;
         }
 
@@ -388,16 +776,26 @@ public:
 private:
     ChildProcess() noexcept = default;
 
-    explicit ChildProcess(pid_t pid) noexcept
+    ChildProcess(pid_t pid, UniqueFd pidfd) noexcept
         : pid_(pid)
+        , pidfd_(std::move(pidfd))
+    {
+    }
+
+    void on_exit(int code) noexcept
     {
+        pid_ = -1;
+        exit_code_ = code;
+        // a pidfd stays readable after the exit, closing it also removes it from epoll
+        pidfd_.reset();
     }
 
     pid_t pid_{ 0 };
+    UniqueFd pidfd_;
     int exit_code_{ 0 };
 };
 
-bool SignalMonitor::dispatch(ChildProcess &child) noexcept
+bool SignalMonitor::dispatch(ChildProcess &child, ExecServer &server) noexcept
 {
     while (true) {
         signalfd_siginfo info{};
@@ -416,7 +814,7 @@ bool SignalMonitor::dispatch(ChildProcess &child) noexcept
             continue;
         }
 
-        child.reap_pending();
+        child.reap_pending(server);
     }
 
     return true;
@@ -556,6 +954,18 @@ public:
             return false;
         }
 
+        // ll-cli holds the read lock while reusing the container and releases it by closing the
+        // file, watch it to retry quitting right then
+        watch_fd_ = UniqueFd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+        if (!watch_fd_
+            || ::inotify_add_watch(watch_fd_.get(),
+                                   containerLockPath,
+                                   IN_CLOSE_WRITE | IN_CLOSE_NOWRITE)
+              == -1) {
+            print_sys_error("failed to watch container lock");
+            watch_fd_.reset();
+        }
+
         if (!file_unlock(fd_.get())) {
             print_sys_error("failed to unlock lock file");
             return false;
@@ -564,6 +974,16 @@ public:
         return true;
     }
 
+    // -1 if the lock can't be watched, the caller has to retry quitting periodically then
+    [[nodiscard]] int watch_fd() const noexcept { return watch_fd_.get(); }
+
+    void drain_watch() const noexcept
+    {
+        alignas(struct inotify_event) std::array<char, 4096> buffer{};
+        while (::read(watch_fd_.get(), buffer.data(), buffer.size()) > 0) {
+        }
+    }
+
     bool transition_to_quitting() noexcept
     {
         if (state_ != State::Active) {
@@ -633,6 +1053,7 @@ private:
     }
 
     UniqueFd fd_;
+    UniqueFd watch_fd_;
     State state_{ State::Error };
 };
 
@@ -687,6 +1108,7 @@ int delegate_run(int argc, char **argv) noexcept
             ::close(tty_fd);
         }
 
+        trace_until_now("ll-init delegate");
         ::execvp(args[0], const_cast<char *const *>(args.data()));
         print_sys_error("failed to exec for delegate run");
         ::_exit(EXIT_FAILURE);
@@ -754,21 +1176,47 @@ int run_init(int argc, char **argv) noexcept
         return -1;
     }
 
+    // listen before running, ll-cli only reuses a running container
+    auto server = ExecServer::listen();
+    if (server && !epoll.add(server.fd(), EPOLLIN)) {
+        return -1;
+    }
+
     if (!lock.transition_to_running()) {
         return -1;
     }
 
+    if (child.pidfd() != -1 && !epoll.add(child.pidfd(), EPOLLIN)) {
+        return -1;
+    }
+
+    if (lock.watch_fd() != -1 && !epoll.add(lock.watch_fd(), EPOLLIN)) {
+        return -1;
+    }
+
+    // The container quits once the child and all the processes left by it exited, unless ll-cli
+    // holds the lock to reuse it. Every state change is an event, the loop only polls if the
+    // lock can't be watched.
     bool waiting_for_quit_lock = false;
+    auto should_quit = [&]() noexcept {
+        if (!child.has_exited() || ChildProcess::has_zombies(server)) {
+            return false;
+        }
+
+        waiting_for_quit_lock = !lock.transition_to_quitting();
+        return !waiting_for_quit_lock;
+    };
+
     while (true) {
-        auto n = epoll.wait(waiting_for_quit_lock ? 1000 : -1);
+        auto poll_quit_lock = waiting_for_quit_lock && lock.watch_fd() == -1;
+        auto n = epoll.wait(poll_quit_lock ? 1000 : -1);
         if (n < 0) {
             return -1;
         }
 
         if (n == 0) {
             // timeout expired; retry the quit transition lock
-            if (waiting_for_quit_lock && child.has_exited() && !ChildProcess::has_zombies()
-                && lock.transition_to_quitting()) {
+            if (poll_quit_lock && should_quit()) {
                 return child.exit_code();
             }
             continue;
@@ -776,19 +1224,36 @@ int run_init(int argc, char **argv) noexcept
 
         for (int i = 0; i < epoll.events_count(); ++i) {
             const auto &ev = epoll.events()[i];
-            if (ev.data.fd != monitor.fd()) {
+            if (server && ev.data.fd == server.fd()) {
+                server.accept(epoll);
                 continue;
             }
 
-            if (!monitor.dispatch(child)) {
-                return -1;
+            if (server && server.is_pending(ev.data.fd)) {
+                server.receive(epoll, ev.data.fd, sigmask);
+                continue;
             }
 
-            if (child.has_exited() && !ChildProcess::has_zombies()) {
-                if (lock.transition_to_quitting()) {
+            if (ev.data.fd == lock.watch_fd()) {
+                lock.drain_watch();
+                if (waiting_for_quit_lock && should_quit()) {
                     return child.exit_code();
                 }
-                waiting_for_quit_lock = true;
+                continue;
+            }
+
+            if (ev.data.fd == child.pidfd()) {
+                child.reap();
+            } else if (ev.data.fd == monitor.fd()) {
+                if (!monitor.dispatch(child, server)) {
+                    return -1;
+                }
+            } else {
+                continue;
+            }
+
+            if (should_quit()) {
+                return child.exit_code();
             }
         }
     }
@@ -14,7 +14,7 @@ namespace linglong::api::types::v1 {
 // I added this size assertion because these structs overload == operator.
 // Adding new fields will make this fail, reminding me to update the == implementation.
 #ifndef __i386__
-static_assert(sizeof(struct Repo) == 120);
+static_assert(sizeof(struct Repo) == 128);
 static_assert(sizeof(struct RepoConfig) == 88);
 static_assert(sizeof(struct RepoConfigV2) == 64);
 static_assert(sizeof(struct UpgradeListResult) == 96);
@@ -23,7 +23,8 @@ static_assert(sizeof(struct UpgradeListResult) == 96);
 inline bool operator==(const Repo &cfg1, const Repo &cfg2) noexcept
 {
     return cfg1.alias == cfg2.alias && cfg1.name == cfg2.name && cfg1.url == cfg2.url
-      && cfg1.priority == cfg2.priority && cfg1.mirrorEnabled == cfg2.mirrorEnabled;
+      && cfg1.priority == cfg2.priority && cfg1.mirrorEnabled == cfg2.mirrorEnabled
+      && cfg1.staticDeltas == cfg2.staticDeltas;
 }
 
 inline bool operator!=(const Repo &cfg1, const Repo &cfg2) noexcept
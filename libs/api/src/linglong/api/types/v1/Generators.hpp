@@ -1177,6 +1177,7 @@ x.alias = get_stack_optional<std::string>(j, "alias");
 x.mirrorEnabled = get_stack_optional<bool>(j, "mirror_enabled");
 x.name = j.at("name").get<std::string>();
 x.priority = j.at("priority").get<int64_t>();
+x.staticDeltas = get_stack_optional<bool>(j, "static_deltas");
 x.url = j.at("url").get<std::string>();
 }
 
@@ -1190,6 +1191,9 @@ j["mirror_enabled"] = x.mirrorEnabled;
 }
 j["name"] = x.name;
 j["priority"] = x.priority;
+if (x.staticDeltas) {
+j["static_deltas"] = x.staticDeltas;
+}
 j["url"] = x.url;
 }
 
@@ -1259,6 +1263,7 @@ j["name"] = x.name;
 
 inline void from_json(const json & j, RepositoryCache& x) {
 x.config = j.at("config").get<RepoConfigV2>();
+x.generation = get_stack_optional<int64_t>(j, "generation");
 x.layers = j.at("layers").get<std::vector<RepositoryCacheLayersItem>>();
 x.llVersion = j.at("ll-version").get<std::string>();
 x.merged = get_stack_optional<std::vector<RepositoryCacheMergedItem>>(j, "merged");
@@ -1268,6 +1273,9 @@ x.version = j.at("version").get<std::string>();
 inline void to_json(json & j, const RepositoryCache & x) {
 j = json::object();
 j["config"] = x.config;
+if (x.generation) {
+j["generation"] = x.generation;
+}
 j["layers"] = x.layers;
 j["ll-version"] = x.llVersion;
 if (x.merged) {
@@ -48,6 +48,10 @@ std::string name;
 */
 int64_t priority;
 /**
+* whether static deltas are preferred when pulling from this repo
+*/
+std::optional<bool> staticDeltas;
+/**
 * repo url
 */
 std::string url;
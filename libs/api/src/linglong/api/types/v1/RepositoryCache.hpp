@@ -36,6 +36,10 @@ using nlohmann::json;
 */
 struct RepositoryCache {
 RepoConfigV2 config;
+/**
+* bumped by every change of the cache
+*/
+std::optional<int64_t> generation;
 std::vector<RepositoryCacheLayersItem> layers;
 /**
 * version of linglong at the time of generating the file
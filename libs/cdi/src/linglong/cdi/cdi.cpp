@@ -8,7 +8,9 @@
 
 #include "linglong/cdi/types/Cdi.hpp"
 #include "linglong/cdi/types/Generators.hpp"
+#include "linglong/common/dir.h"
 #include "linglong/common/strings.h"
+#include "linglong/utils/file.h"
 #include "linglong/utils/log/log.h"
 #include "linglong/utils/sha256.h"
 #include "ytj/ytj.hpp"
@@ -24,6 +26,8 @@
 #include <iostream>
 #include <sstream>
 
+#include <sys/stat.h>
+
 namespace linglong::cdi {
 
 namespace {
@@ -145,6 +149,134 @@ utils::error::Result<std::string> calculateSpecChecksum(const std::filesystem::p
     }
 }
 
+struct LoadedSpec
+{
+    std::string checksum;
+    types::Cdi spec;
+};
+
+// the parsed spec is cached until any of these is changed
+std::optional<std::string> specStamp(const std::filesystem::path &specPath) noexcept
+{
+    struct stat st{};
+    if (::stat(specPath.c_str(), &st) == -1) {
+        return std::nullopt;
+    }
+
+    return fmt::format("{}:{}:{}:{}.{}:{}.{}",
+                       st.st_dev,
+                       st.st_ino,
+                       st.st_size,
+                       st.st_mtim.tv_sec,
+                       st.st_mtim.tv_nsec,
+                       st.st_ctim.tv_sec,
+                       st.st_ctim.tv_nsec);
+}
+
+// one cache file per spec file, it's replaced once the spec is changed
+std::filesystem::path specCacheFile(const std::filesystem::path &specPath) noexcept
+{
+    auto name = digest::sha256Hex(specPath.native()) + ".cbor";
+    return common::dir::getUserCacheDir() / "cdi" / name;
+}
+
+std::optional<LoadedSpec> loadCachedSpec(const std::filesystem::path &cacheFile,
+                                         const std::filesystem::path &specPath,
+                                         const std::string &stamp) noexcept
+{
+    std::ifstream stream(cacheFile, std::ios::binary);
+    if (!stream.is_open()) {
+        return std::nullopt;
+    }
+
+    try {
+        auto json = nlohmann::json::from_cbor(stream);
+        if (json.at("path").get<std::string>() != specPath.string()
+            || json.at("stamp").get<std::string>() != stamp) {
+            return std::nullopt;
+        }
+
+        return LoadedSpec{
+            .checksum = json.at("checksum").get<std::string>(),
+            .spec = json.at("spec").get<types::Cdi>(),
+        };
+    } catch (const std::exception &e) {
+        LogD("ignore invalid CDI spec cache {}: {}", cacheFile, e.what());
+    }
+
+    return std::nullopt;
+}
+
+void storeCachedSpec(const std::filesystem::path &cacheFile,
+                     const std::filesystem::path &specPath,
+                     const std::string &stamp,
+                     const LoadedSpec &loaded) noexcept
+{
+    std::error_code ec;
+    std::filesystem::create_directories(cacheFile.parent_path(), ec);
+    if (ec) {
+        LogD("failed to create CDI spec cache directory {}: {}",
+             cacheFile.parent_path(),
+             ec.message());
+        return;
+    }
+
+    std::vector<std::uint8_t> cbor;
+    try {
+        cbor = nlohmann::json::to_cbor(nlohmann::json{
+          { "path", specPath.string() },
+          { "stamp", stamp },
+          { "checksum", loaded.checksum },
+          { "spec", loaded.spec },
+        });
+    } catch (const std::exception &e) {
+        LogD("failed to serialize CDI spec cache {}: {}", cacheFile, e.what());
+        return;
+    }
+
+    // specs may be cached by several processes
+    auto ret = utils::replaceFile(
+      cacheFile,
+      std::string_view(reinterpret_cast<const char *>(cbor.data()), cbor.size()));
+    if (!ret) {
+        LogD("failed to write CDI spec cache: {}", ret.error());
+    }
+}
+
+// Parse the spec and calculate its checksum. Specs like the ones of NVIDIA are large, the result
+// is cached in the user cache directory until the spec file is changed.
+utils::error::Result<LoadedSpec> loadCDISpec(const std::filesystem::path &specPath)
+{
+    LINGLONG_TRACE(fmt::format("load CDI spec: {}", specPath.string()));
+
+    auto stamp = specStamp(specPath);
+    std::filesystem::path cacheFile;
+    if (stamp) {
+        cacheFile = specCacheFile(specPath);
+        if (auto cached = loadCachedSpec(cacheFile, specPath, *stamp); cached) {
+            return std::move(cached).value();
+        }
+    }
+
+    auto spec = parseCDISpecFile(specPath);
+    if (!spec) {
+        return LINGLONG_ERR(spec);
+    }
+
+    auto checksum = calculateSpecChecksum(specPath);
+    if (!checksum) {
+        return LINGLONG_ERR(checksum);
+    }
+
+    LoadedSpec loaded{ .checksum = std::move(checksum).value(), .spec = std::move(spec).value() };
+    // don't cache the spec if it's changed while parsing
+    if (stamp && specStamp(specPath) == stamp) {
+        storeCachedSpec(cacheFile, specPath, *stamp, loaded);
+    }
+
+    return loaded;
+}
+
 utils::error::Result<types::ContainerEdits> getCDIDeviceEdits(const types::Cdi &spec,
                                                               std::string_view deviceName)
 {
@@ -196,22 +328,16 @@ utils::error::Result<std::vector<api::types::v1::CdiDeviceEntry>> getCDIDevices(
                dir,
                std::filesystem::directory_options::skip_permission_denied,
                ec)) {
-            auto res = parseCDISpecFile(entry.path());
+            auto res = loadCDISpec(entry.path());
             if (!res) {
                 LogW("skip error parsed CDI spec: {}", res.error());
                 continue;
             }
 
-            auto checksum = calculateSpecChecksum(entry.path());
-            if (!checksum) {
-                LogW("skip CDI spec with invalid checksum: {}", checksum.error());
-                continue;
-            }
-
             specs.emplace_back(ParsedSpec{
               .path = entry.path(),
-              .checksum = std::move(*checksum),
-              .spec = std::move(*res),
+              .checksum = std::move(res->checksum),
+              .spec = std::move(res->spec),
             });
         }
     }
@@ -278,26 +404,22 @@ getCDIDeviceEdits(const api::types::v1::CdiDeviceEntry &device)
 {
     LINGLONG_TRACE(fmt::format("get CDI device edits from entry {}={}", device.kind, device.name));
 
-    auto spec = parseCDISpecFile(device.spec.path);
-    if (!spec) {
-        return LINGLONG_ERR(spec);
-    }
-
-    auto checksum = calculateSpecChecksum(device.spec.path);
-    if (!checksum) {
-        return LINGLONG_ERR(checksum);
+    auto loaded = loadCDISpec(device.spec.path);
+    if (!loaded) {
+        return LINGLONG_ERR(loaded);
     }
 
-    if (!device.spec.checksum.empty() && *checksum != device.spec.checksum) {
+    if (!device.spec.checksum.empty() && loaded->checksum != device.spec.checksum) {
         return LINGLONG_ERR(fmt::format("CDI spec checksum mismatch: {}", device.spec.path));
     }
 
-    if (spec->kind != device.kind) {
+    const auto &spec = loaded->spec;
+    if (spec.kind != device.kind) {
         return LINGLONG_ERR(
-          fmt::format("CDI device kind mismatch: expected {}, got {}", device.kind, spec->kind));
+          fmt::format("CDI device kind mismatch: expected {}, got {}", device.kind, spec.kind));
     }
 
-    return getCDIDeviceEdits(*spec, device.name);
+    return getCDIDeviceEdits(spec, device.name);
 }
 
 } // namespace linglong::cdi
@@ -13,6 +13,9 @@ namespace linglong::common::dir {
 // /tmp/linglong-runtime-$UID/linglong
 constexpr auto containerLockPath = "/run/linglong/.lock";
 
+// ll-init listens on the exec socket in this directory if it's mounted
+constexpr auto containerInitExecDir = "/run/linglong/init";
+
 constexpr auto repoLockPath = "/run/linglong/lock";
 
 std::filesystem::path getRuntimeDir() noexcept;
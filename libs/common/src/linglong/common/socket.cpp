@@ -141,6 +141,117 @@ tl::expected<void, std::string> sendFdWithPayload(int socketFd, int fd, const st
     return {};
 }
 
+tl::expected<SocketFdsData, std::string>
+recvFdsWithPayload(int socketFd, std::size_t maxFds, std::size_t bufSize)
+{
+    if (socketFd < 0) {
+        return tl::make_unexpected("Invalid file descriptor");
+    }
+
+    std::string buffer(bufSize, '\0');
+    struct iovec iov{};
+    iov.iov_base = buffer.data();
+    iov.iov_len = buffer.size();
+
+    std::vector<std::byte> controlBuf(CMSG_SPACE(sizeof(int) * maxFds));
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = controlBuf.data();
+    msg.msg_controllen = controlBuf.size();
+
+    ssize_t n;
+    while (true) {
+        n = recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        break;
+    }
+
+    if (n < 0) {
+        return tl::make_unexpected("recvmsg failed: " + error::errorString(errno));
+    }
+
+    if (n == 0) {
+        return tl::make_unexpected("Connection closed");
+    }
+
+    SocketFdsData data;
+    for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+
+        const auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (std::size_t i = 0; i < count; ++i) {
+            int fd{ -1 };
+            std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            data.fds.push_back(fd);
+        }
+    }
+
+    const auto flags = static_cast<std::size_t>(msg.msg_flags);
+    if ((flags & (MSG_CTRUNC | MSG_TRUNC)) != 0) {
+        for (auto fd : data.fds) {
+            ::close(fd);
+        }
+
+        return tl::make_unexpected((flags & MSG_CTRUNC) != 0 ? "Control data truncated"
+                                                             : "Payload truncated");
+    }
+
+    buffer.resize(n);
+    data.payload = std::move(buffer);
+    return data;
+}
+
+tl::expected<void, std::string>
+sendFdsWithPayload(int socketFd, const std::vector<int> &fds, const std::string &payload)
+{
+    if (socketFd < 0) {
+        return tl::make_unexpected("Invalid socket file descriptor");
+    }
+
+    struct iovec iov{};
+    iov.iov_base = const_cast<char *>(payload.data());
+    iov.iov_len = payload.size();
+
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    std::vector<std::byte> controlBuf(CMSG_SPACE(sizeof(int) * fds.size()));
+    if (!fds.empty()) {
+        msg.msg_control = controlBuf.data();
+        msg.msg_controllen = controlBuf.size();
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    }
+
+    while (true) {
+        const auto n = sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return tl::make_unexpected("sendmsg failed: " + error::errorString(errno));
+        }
+
+        if (static_cast<std::size_t>(n) != payload.size()) {
+            return tl::make_unexpected("Payload partially sent");
+        }
+
+        return {};
+    }
+}
+
 tl::expected<int, std::string> createUnixSocket(std::string_view path)
 {
     if (path.empty()) {
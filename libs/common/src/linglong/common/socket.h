@@ -7,6 +7,7 @@
 #include <tl/expected.hpp>
 
 #include <string>
+#include <vector>
 
 namespace linglong::common::socket {
 
@@ -21,6 +22,21 @@ tl::expected<SocketData, std::string> recvFdWithPayload(int socketFd, std::size_
 
 tl::expected<void, std::string> sendFdWithPayload(int socketFd, int fd, const std::string &payload);
 
+struct SocketFdsData
+{
+    std::vector<int> fds;
+    std::string payload;
+};
+
+// Receive one message with up to maxFds file descriptors. Unlike recvFdWithPayload, a message
+// which doesn't fit into bufSize is an error, so it should only be used with SOCK_SEQPACKET.
+tl::expected<SocketFdsData, std::string>
+recvFdsWithPayload(int socketFd, std::size_t maxFds, std::size_t bufSize = 4096);
+
+// Send payload with all of fds in one message.
+tl::expected<void, std::string>
+sendFdsWithPayload(int socketFd, const std::vector<int> &fds, const std::string &payload);
+
 tl::expected<int, std::string> createUnixSocket(std::string_view path);
 
 } // namespace linglong::common::socket
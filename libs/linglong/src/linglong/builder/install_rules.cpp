@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "install_rules.h"
+
+#include "linglong/utils/log/log.h"
+
+#include <utility>
+#include <vector>
+
+namespace linglong::builder {
+
+InstallRules::InstallRules(std::filesystem::path buildOutput,
+                           const std::unordered_set<std::string> &rules)
+    : buildOutput(std::move(buildOutput))
+{
+    std::vector<std::string> patterns;
+    for (const auto &rule : rules) {
+        // skip empty rule and comment start with #<space>
+        if (rule.empty() || (rule.size() > 1 && rule[0] == '#' && rule[1] == ' ')) {
+            continue;
+        }
+
+        if (rule[0] != '^') {
+            addPath(rule);
+            continue;
+        }
+
+        // The build output is inserted after `^` as it is, `^include` is the same as `^/include`.
+        // Only the first branch of a rule with a top-level `|` is anchored at the build output,
+        // the others may match anywhere in the absolute path.
+        auto pattern = rule;
+        pattern.insert(1, this->buildOutput.string() + (rule.rfind("^/", 0) == 0 ? "" : "/"));
+
+        QRegularExpression regexp(QString::fromStdString(pattern));
+        if (!regexp.isValid()) {
+            LogW("invalid install rule {}: {}", rule, regexp.errorString().toStdString());
+            continue;
+        }
+        patterns.emplace_back(std::move(pattern));
+    }
+
+    if (patterns.empty()) {
+        return;
+    }
+
+    // The group numbers are reset in every branch and duplicated names are allowed, so the
+    // backreferences of each rule stay the same as if it was compiled alone. Every rule keeps its
+    // own anchors, so its top-level branches stay branches of the rule.
+    std::string combined = "(?J)(?|";
+    for (std::size_t i = 0; i < patterns.size(); ++i) {
+        if (i != 0) {
+            combined.push_back('|');
+        }
+        combined.append("(?:").append(patterns[i]).append(")");
+    }
+    combined.push_back(')');
+
+    QRegularExpression regexp(QString::fromStdString(combined));
+    if (!regexp.isValid()) {
+        LogW("failed to combine install rules: {}", regexp.errorString().toStdString());
+        return;
+    }
+    // compile it now, matches() could be called from several threads
+    regexp.optimize();
+    regex = std::move(regexp);
+}
+
+void InstallRules::addPath(const std::string &rule)
+{
+    auto *node = &root;
+    for (const auto &component : std::filesystem::path{ rule }.lexically_normal()) {
+        // the root directory of `/lib` and the empty filename of `lib/`
+        if (component.empty() || component == "/" || component == ".") {
+            continue;
+        }
+
+        auto &child = node->children[component.string()];
+        if (!child) {
+            child = std::make_unique<Node>();
+        }
+        node = child.get();
+    }
+    node->terminal = true;
+}
+
+bool InstallRules::matches(const std::filesystem::path &relativePath) const
+{
+    const auto *node = &root;
+    for (const auto &component : relativePath) {
+        if (node->terminal) {
+            break;
+        }
+
+        auto it = node->children.find(component.string());
+        if (it == node->children.end()) {
+            node = nullptr;
+            break;
+        }
+        node = it->second.get();
+    }
+    if (node != nullptr && node->terminal) {
+        return true;
+    }
+
+    if (!regex) {
+        return false;
+    }
+
+    return regex->match(QString::fromStdString((buildOutput / relativePath).string())).hasMatch();
+}
+
+} // namespace linglong::builder
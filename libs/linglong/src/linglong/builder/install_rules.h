@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <QRegularExpression>
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace linglong::builder {
+
+// The install rules of a module, compiled once so every file of the build output is matched in
+// a single pass instead of trying each rule in turn.
+//
+// A rule is either a path relative to the build output, which matches the path itself and
+// everything under it, or a regex starting with `^`. The build output is inserted after the `^` of
+// a regex, which is matched against the absolute path. Empty rules and comments starting with `# `
+// are ignored.
+class InstallRules
+{
+public:
+    InstallRules(std::filesystem::path buildOutput, const std::unordered_set<std::string> &rules);
+
+    // relativePath is relative to the build output. It's safe to be called concurrently.
+    [[nodiscard]] bool matches(const std::filesystem::path &relativePath) const;
+
+private:
+    struct Node
+    {
+        bool terminal{ false };
+        std::unordered_map<std::string, std::unique_ptr<Node>> children;
+    };
+
+    void addPath(const std::string &rule);
+
+    std::filesystem::path buildOutput;
+    // the plain path rules as a trie of path components
+    Node root;
+    // all regex rules combined into one alternation
+    std::optional<QRegularExpression> regex;
+};
+
+} // namespace linglong::builder
@@ -9,6 +9,7 @@
 #include "configure.h"
 #include "linglong/api/types/v1/ExportDirs.hpp"
 #include "linglong/api/types/v1/Generators.hpp"
+#include "linglong/builder/install_rules.h"
 #include "linglong/builder/printer.h"
 #include "linglong/common/global/initialize.h"
 #include "linglong/common/strings.h"
@@ -290,43 +291,12 @@ installModule(const std::filesystem::path &buildOutput,
 {
     LINGLONG_TRACE("install module file");
 
-    auto ret = utils::moveFiles(
-      buildOutput,
-      moduleOutput,
-      [&buildOutput, &rules](const std::filesystem::path &path) {
-          for (auto rule : rules) {
-              LogD("{} - {}", path, rule);
-              // skip empty rule and comment start with #<space>
-              if (rule.empty() || (rule.size() > 1 && rule[0] == '#' && rule[1] == ' ')) {
-                  continue;
-              }
-
-              if (rule.rfind("^", 0) != 0) {
-                  // if rule is not start with ^, it's a normal path
-                  if (rule[0] == '/') {
-                      rule = rule.substr(1);
-                  }
-                  auto rulePath = buildOutput / rule;
-                  auto relativePath = (buildOutput / path).lexically_relative(rulePath);
-                  if (!relativePath.empty() && relativePath.string().rfind("..", 0) != 0) {
-                      return true;
-                  }
-              } else {
-                  // rule is a regex
-                  if (rule.rfind("^/", 0) != 0) {
-                      rule.insert(1, buildOutput.string() + "/");
-                  } else {
-                      rule.insert(1, buildOutput);
-                  }
-
-                  QRegularExpression regexp(rule.c_str());
-                  if (regexp.match((buildOutput / path).c_str()).hasMatch()) {
-                      return true;
-                  }
-              }
-          }
-          return false;
-      });
+    const InstallRules installRules(buildOutput, rules);
+    auto ret = utils::moveFiles(buildOutput,
+                                moduleOutput,
+                                [&installRules](const std::filesystem::path &path) {
+                                    return installRules.matches(path);
+                                });
 
     if (!ret) {
         return LINGLONG_ERR("failed to move files", ret);
@@ -1744,7 +1714,8 @@ utils::error::Result<void> Builder::extractLayer(const QString &layerPath,
 
 linglong::utils::error::Result<void> Builder::push(const std::string &module,
                                                    const std::string &repoUrl,
-                                                   const std::string &repoName)
+                                                   const std::string &repoName,
+                                                   const std::string &deltaFrom)
 {
     LINGLONG_TRACE("push reference to remote repository");
 
@@ -1757,6 +1728,21 @@ linglong::utils::error::Result<void> Builder::push(const std::string &module,
         return LINGLONG_ERR(ref);
     }
 
+    if (!deltaFrom.empty()) {
+        auto fromVersion = package::Version::parse(deltaFrom);
+        if (!fromVersion) {
+            return LINGLONG_ERR(fromVersion);
+        }
+        auto fromRef = package::Reference::create(ref->channel, ref->id, *fromVersion, ref->arch);
+        if (!fromRef) {
+            return LINGLONG_ERR(fromRef);
+        }
+        auto ret = repo.generateStaticDelta(*fromRef, *ref, module);
+        if (!ret) {
+            return LINGLONG_ERR(ret);
+        }
+    }
+
     if (repoName.empty() || repoUrl.empty()) {
         return repo.push(*ref, module);
     }
@@ -110,7 +110,8 @@ public:
 
     auto push(const std::string &module,
               const std::string &repoUrl = "",
-              const std::string &repoName = "") -> utils::error::Result<void>;
+              const std::string &repoName = "",
+              const std::string &deltaFrom = "") -> utils::error::Result<void>;
 
     auto import() -> utils::error::Result<void>;
 
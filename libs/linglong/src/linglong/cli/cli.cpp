@@ -23,16 +23,22 @@
 #include "linglong/api/types/v1/PackageManager1SearchResult.hpp"
 #include "linglong/api/types/v1/PackageManager1UninstallParameters.hpp"
 #include "linglong/api/types/v1/State.hpp"
+#include "linglong/cli/container_watcher.h"
+#include "linglong/cli/launcher.h"
 #include "linglong/cli/printer.h"
 #include "linglong/common/dir.h"
 #include "linglong/common/error.h"
 #include "linglong/common/socket.h"
 #include "linglong/common/strings.h"
+#include "linglong/driver/detection_cache.h"
 #include "linglong/oci-cfg-generators/container_cfg_builder.h"
 #include "linglong/package/layer_file.h"
 #include "linglong/package/version.h"
 #include "linglong/runtime/container_builder.h"
+#include "linglong/runtime/container_index.h"
+#include "linglong/runtime/init_exec.h"
 #include "linglong/runtime/run_context.h"
+#include "linglong/runtime/run_context_cache.h"
 #include "linglong/utils/bash_command_helper.h"
 #include "linglong/utils/error/error.h"
 #include "linglong/utils/file.h"
@@ -42,6 +48,7 @@
 #include "linglong/utils/io/event_loop.h"
 #include "linglong/utils/io/forwarder.h"
 #include "linglong/utils/io/pipe.h"
+#include "linglong/utils/log/trace.h"
 #include "linglong/utils/namespace.h"
 #include "linglong/utils/runtime_config.h"
 #include "linglong/utils/signal/signal_blocker.h"
@@ -88,7 +95,9 @@
 
 #include <fcntl.h>
 #include <pwd.h>
+#include <sched.h>
 #include <sys/mman.h>
+#include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <termios.h>
@@ -122,19 +131,48 @@ struct ContainerStatus
     bool shouldRetry{ false };
 };
 
-ContainerStatus checkContainerStatus(const std::string &id,
-                                     linglong::utils::filelock::FileLock &lock) noexcept
+// the longest wait for ll-init to release the container lock, the caller retries after it
+constexpr auto ContainerLockTimeout = std::chrono::seconds(3);
+
+// ll-init writes the state right before it releases the write lock, the release itself can't be
+// watched, so the lock is tried again in short intervals after a wakeup
+constexpr auto ContainerLockPollInterval = std::chrono::milliseconds(50);
+
+ContainerStatus checkContainerStatus(linglong::utils::filelock::FileLock &lock,
+                                     linglong::cli::ContainerWatcher *watcher) noexcept
 {
-    auto containerLock = linglong::common::dir::getBundleDir(id) / ".lock";
+    // ll-init holds the write lock while initializing the container, wait for it to finish, but
+    // not forever, ll-init may be stuck
+    auto deadline = std::chrono::steady_clock::now() + ContainerLockTimeout;
+    while (true) {
+        auto ret = lock.tryLock(linglong::utils::filelock::LockType::Read);
+        if (!ret) {
+            LogD("failed to lock container lock, will retry: {}", ret.error());
+            return { false, true };
+        }
 
-    auto ret = lock.tryLock(linglong::utils::filelock::LockType::Read);
-    if (!ret) {
-        return { false, true };
-    }
+        if (*ret) {
+            break;
+        }
 
-    if (!*ret) {
-        LogD("container lock is busy, will retry");
-        return { false, true };
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            LogD("container lock is busy, will retry");
+            return { false, true };
+        }
+
+        auto timeout = std::min<std::chrono::milliseconds>(
+          ContainerLockPollInterval,
+          std::chrono::ceil<std::chrono::milliseconds>(deadline - now));
+        if (watcher == nullptr) {
+            std::this_thread::sleep_for(timeout);
+            continue;
+        }
+
+        if (auto changed = watcher->wait(timeout); !changed) {
+            LogD("failed to wait for container lock: {}", changed.error());
+            std::this_thread::sleep_for(timeout);
+        }
     }
 
     // Read state through the locked fd: opening a separate ifstream on the
@@ -289,6 +327,46 @@ std::string makeDebugInstanceID()
     return "debug-" + std::string{ uuidString.data() };
 }
 
+// run ll-cli again with the same arguments in a new user and mount namespace, where it has
+// CAP_SYS_ADMIN, extraArgs are inserted after subcommand
+linglong::utils::error::Result<int>
+rerunInNamespace(const std::string &subcommand, const std::vector<std::string> &extraArgs) noexcept
+{
+    LINGLONG_TRACE("rerun in namespace");
+    LogSpan("rerun in namespace");
+
+    const auto qtArgs = QCoreApplication::arguments();
+    auto selfExe = linglong::utils::getSelfExe();
+    if (!selfExe) {
+        return LINGLONG_ERR(selfExe);
+    }
+
+    std::vector<std::string> args;
+    args.reserve(static_cast<std::size_t>(qtArgs.size()) + extraArgs.size());
+    for (const auto &arg : qtArgs) {
+        args.emplace_back(arg.toStdString());
+    }
+    args[0] = std::move(*selfExe);
+
+    auto insertPos = std::find(args.begin(), args.end(), subcommand);
+    if (insertPos == args.end()) {
+        return LINGLONG_ERR(fmt::format("failed to locate {} subcommand", subcommand));
+    }
+    args.insert(insertPos + 1, extraArgs.begin(), extraArgs.end());
+
+    std::vector<char *> argPointers;
+    argPointers.reserve(args.size() + 1);
+    for (auto &arg : args) {
+        argPointers.push_back(arg.data());
+    }
+    argPointers.push_back(nullptr);
+
+    return linglong::utils::runInNamespace(static_cast<int>(args.size()),
+                                           argPointers.data(),
+                                           geteuid(),
+                                           getegid());
+}
+
 std::string gdbRemoteTarget(const std::string &listen) noexcept
 {
     if (!listen.empty() && listen.front() == ':') {
@@ -1112,6 +1190,7 @@ Cli::Cli(Printer &printer,
 utils::error::Result<repo::OSTreeRepo *> Cli::getRepo(bool forceReload) noexcept
 {
     LINGLONG_TRACE("get local repo");
+    LogSpan("load repo");
 
     if (this->repository && !forceReload) {
         return this->repository.get();
@@ -1270,7 +1349,8 @@ Cli::initializeDBusPackageManager()
 }
 
 utils::error::Result<int> Cli::reuseContainer(const std::string &id,
-                                              const std::vector<std::string> &commands) noexcept
+                                              const std::vector<std::string> &commands,
+                                              ContainerWatcher *watcher) noexcept
 {
     LINGLONG_TRACE(fmt::format("reuse container {}", id));
 
@@ -1288,11 +1368,29 @@ utils::error::Result<int> Cli::reuseContainer(const std::string &id,
     }
     auto lock = std::move(lockRet).value();
 
-    auto status = checkContainerStatus(id, lock);
+    auto status = checkContainerStatus(lock, watcher);
     if (!status.canReuse) {
         return status.shouldRetry ? 0 : -1;
     }
 
+    auto reuseCommand = utils::BashCommandHelper::generateBashCommandBase();
+    reuseCommand.push_back(utils::BashCommandHelper::generateEntrypointScript(commands));
+
+    // ll-init runs the command without the OCI runtime, but the process has no controlling
+    // terminal, interactive commands still go through `ociCLI.exec`
+    if (::isatty(STDIN_FILENO) == 0) {
+        auto ret = runtime::sendInitExecRequest(
+          runtime::initExecSocketPath(common::dir::getBundleDir(id)),
+          runtime::InitExecRequest{ .args = reuseCommand });
+        if (!ret) {
+            return LINGLONG_ERR(ret);
+        }
+
+        if (*ret) {
+            return **ret + 1;
+        }
+    }
+
     auto ioSetup = setupIOChannels();
     if (!ioSetup) {
         return LINGLONG_ERR(ioSetup);
@@ -1324,8 +1422,6 @@ utils::error::Result<int> Cli::reuseContainer(const std::string &id,
             ioSetup->pipes->setupChildStdio();
         }
 
-        auto reuseCommand = utils::BashCommandHelper::generateBashCommandBase();
-        reuseCommand.push_back(utils::BashCommandHelper::generateEntrypointScript(commands));
         auto result =
           ociCLI.exec(id, "/run/linglong/container-init", reuseCommand, ioSetup->option);
         if (!result) {
@@ -1441,6 +1537,7 @@ utils::error::Result<int> Cli::reuseContainer(const std::string &id,
     inFwd.emplace(epoll, 8 * 1024);
     inFwd->setSrc(STDIN_FILENO);
     inFwd->setDst(masterOut.get());
+    inFwd->enableSplice();
 
     bool stdinWatchable = true;
     auto stdinAddRet = epoll.add(STDIN_FILENO, EPOLLIN);
@@ -1458,13 +1555,16 @@ utils::error::Result<int> Cli::reuseContainer(const std::string &id,
             return LINGLONG_ERR(ret);
         }
     } else {
+        // the output of the command is moved in the kernel unless it's written to a terminal
         outFwd.emplace(epoll, 8 * 1024);
         outFwd->setSrc(stdoutRead.get());
         outFwd->setDst(STDOUT_FILENO);
+        outFwd->enableSplice();
 
         errFwd.emplace(epoll, 8 * 1024);
         errFwd->setSrc(stderrRead.get());
         errFwd->setDst(STDERR_FILENO);
+        errFwd->enableSplice();
 
         if (auto ret = epoll.add(stdoutRead.get(), EPOLLIN); !ret) {
             return LINGLONG_ERR(ret);
@@ -1644,6 +1744,7 @@ utils::error::Result<int> Cli::reuseContainer(const std::string &id,
 int Cli::run(const RunOptions &options)
 {
     LINGLONG_TRACE("command run");
+    LogSpan("run");
 
     auto userContainerDir = std::filesystem::path{ "/run/linglong" } / std::to_string(getuid());
     if (auto ret = utils::ensureDirectory(userContainerDir); !ret) {
@@ -1699,8 +1800,10 @@ int Cli::run(const RunOptions &options)
         detectDrivers();
     }
 
+    // the resolved config is reused by the following runs until the repo is changed
+    runtime::RunContextCache contextCache(common::dir::getUserCacheDir() / "run-context");
     auto runContext = std::make_unique<runtime::RunContext>(**repo);
-    auto res = runContext->resolve(*curAppRef, opts);
+    auto res = runContext->resolve(*curAppRef, opts, contextCache);
     if (!res) {
         handleCommonError(res.error());
         return -1;
@@ -1720,7 +1823,7 @@ int Cli::run(const RunOptions &options)
         }
 
         runContext = std::make_unique<runtime::RunContext>(**repo);
-        res = runContext->resolve(*curAppRef, opts);
+        res = runContext->resolve(*curAppRef, opts, contextCache);
         if (!res) {
             handleCommonError(res.error());
             return -1;
@@ -1755,6 +1858,13 @@ int Cli::run(const RunOptions &options)
     }
     auto cli_lock = std::move(cliLockRet).value();
 
+    // watch the container before trying to reuse it, so no state change is missed while waiting
+    auto watcher = ContainerWatcher::create(common::dir::getBundleDir(containerID),
+                                            userContainerDir / lockName);
+    if (!watcher) {
+        LogW("failed to watch container {}: {}", containerID, watcher.error());
+    }
+
     while (true) {
         auto lock_ret = cli_lock.tryLock(utils::filelock::LockType::Write);
         if (!lock_ret) {
@@ -1766,7 +1876,7 @@ int Cli::run(const RunOptions &options)
             break;
         }
 
-        auto ret = reuseContainer(containerID, commands);
+        auto ret = reuseContainer(containerID, commands, watcher ? &*watcher : nullptr);
         if (!ret) {
             LogW("unexpected reuse error: {}", ret.error());
             return -1;
@@ -1782,9 +1892,18 @@ int Cli::run(const RunOptions &options)
             return -1;
         }
 
-        // reuse failed, try again
+        // reuse failed, try again once the container changed, the timeout only covers the
+        // changes which are not watched
         using namespace std::chrono_literals;
-        std::this_thread::sleep_for(3s);
+        if (!watcher) {
+            std::this_thread::sleep_for(3s);
+            continue;
+        }
+
+        if (auto changed = watcher->wait(3s); !changed) {
+            LogW("failed to wait for container {}: {}", containerID, changed.error());
+            std::this_thread::sleep_for(3s);
+        }
     }
 
     LogD("start a new container");
@@ -1818,6 +1937,12 @@ int Cli::run(const RunOptions &options)
         stream << nlohmann::json(runContext->stateInfo());
         stream.close();
 
+        auto added = runtime::ContainerIndex(userContainerDir).add(runContext->stateInfo());
+        if (!added) {
+            this->printer.printErr(added.error());
+            return false;
+        }
+
         return true;
     };
 
@@ -1828,6 +1953,11 @@ int Cli::run(const RunOptions &options)
     auto pidFileGuard = utils::finally::finally([&userContainerDir]() {
         std::error_code ec;
         std::filesystem::remove(userContainerDir / std::to_string(::getpid()), ec);
+
+        auto removed = runtime::ContainerIndex(userContainerDir).remove();
+        if (!removed) {
+            LogW("failed to remove container from index: {}", removed.error());
+        }
     });
 
     auto cacheRes = this->ensureCache(*runContext);
@@ -1844,40 +1974,8 @@ int Cli::run(const RunOptions &options)
 
     if (*namespaceRes) {
         LogD("run in new namespace");
-        const auto qtArgs = QCoreApplication::arguments();
-        auto selfExe = linglong::utils::getSelfExe();
-        if (!selfExe) {
-            this->printer.printErr(selfExe.error());
-            return -1;
-        }
-
-        std::vector<std::string> args;
-        args.reserve(static_cast<std::size_t>(qtArgs.size()) + 2);
-        for (const auto &arg : qtArgs) {
-            args.emplace_back(arg.toStdString());
-        }
-        args[0] = std::move(*selfExe);
-
-        auto insertPos = std::find(args.begin(), args.end(), std::string{ "run" });
-        if (insertPos == args.end()) {
-            this->printer.printErr(LINGLONG_ERRV("failed to locate run subcommand"));
-            return -1;
-        }
-
         auto contextJson = nlohmann::json(runContext->getConfig()).dump();
-        args.insert(insertPos + 1, { "--run-context", contextJson });
-
-        std::vector<char *> argPointers;
-        argPointers.reserve(args.size() + 1);
-        for (auto &arg : args) {
-            argPointers.push_back(arg.data());
-        }
-        argPointers.push_back(nullptr);
-
-        auto runRes = linglong::utils::runInNamespace(static_cast<int>(args.size()),
-                                                      argPointers.data(),
-                                                      geteuid(),
-                                                      getegid());
+        auto runRes = rerunInNamespace("run", { "--run-context", contextJson });
         if (!runRes) {
             this->printer.printErr(runRes.error());
             return -1;
@@ -1892,6 +1990,7 @@ int Cli::run(const RunOptions &options)
 int Cli::runWithContext(const RunOptions &options)
 {
     LINGLONG_TRACE("command run with context");
+    LogSpan("run with context");
 
     if (!options.runContext) {
         this->printer.printErr(LINGLONG_ERRV("run context is required"));
@@ -1929,6 +2028,104 @@ int Cli::runWithContext(const RunOptions &options)
     return this->runResolvedContext(runContext, options, std::move(runtimeConfig));
 }
 
+int Cli::launcher()
+{
+    LINGLONG_TRACE("command launcher");
+
+    auto namespaceRes = linglong::utils::needRunInNamespace();
+    if (!namespaceRes) {
+        this->printer.printErr(namespaceRes.error());
+        return -1;
+    }
+
+    // the launched processes inherit the namespace, so they don't run ll-cli again in a new one
+    if (*namespaceRes) {
+        auto runRes = rerunInNamespace("launcher", {});
+        if (!runRes) {
+            this->printer.printErr(runRes.error());
+            return -1;
+        }
+
+        return *runRes;
+    }
+
+    auto repo = this->getRepo();
+    if (!repo) {
+        this->printer.printErr(repo.error());
+        return -1;
+    }
+
+    auto socketPath = launcherSocketPath();
+    if (auto ret = utils::ensureDirectory(socketPath.parent_path()); !ret) {
+        this->printer.printErr(ret.error());
+        return -1;
+    }
+
+    auto lock = utils::filelock::FileLock::create(socketPath.parent_path() / "launcher.lock",
+                                                  utils::filelock::LockType::Write);
+    if (!lock) {
+        this->printer.printErr(lock.error());
+        return -1;
+    }
+    auto locked = lock->tryLock(utils::filelock::LockType::Write);
+    if (!locked) {
+        this->printer.printErr(locked.error());
+        return -1;
+    }
+    if (!*locked) {
+        this->printer.printErr(LINGLONG_ERRV("another launcher is running"));
+        return -1;
+    }
+
+    auto server = LaunchServer::listen(socketPath);
+    if (!server) {
+        this->printer.printErr(server.error());
+        return -1;
+    }
+    LogI("launcher is listening on {}", socketPath);
+
+    auto handler = [this](const LaunchRequest &request) -> int {
+        LINGLONG_TRACE("launch");
+
+        // every launch gets its own mount namespace, like a run in a new namespace does
+        if (::unshare(CLONE_NEWNS) == -1
+            || ::mount(nullptr, "/", nullptr, MS_REC | MS_SLAVE, nullptr) == -1) {
+            this->printer.printErr(LINGLONG_ERRV("failed to create mount namespace", errno));
+            return -1;
+        }
+
+        if (request.globalOptions.verbose > 0) {
+            utils::log::setLogLevel(utils::log::LogLevel::Debug);
+        }
+        this->setGlobalOptions(request.globalOptions);
+        return this->run(request.options);
+    };
+
+    while (true) {
+        auto launch = (*server)->accept();
+        if (!launch) {
+            this->printer.printErr(launch.error());
+            return -1;
+        }
+
+        // installs and upgrades of the package manager are seen by the next launch
+        if ((*repo)->isCacheOutdated()) {
+            LogD("repo cache is changed, load the repo again");
+            repo = this->getRepo(true);
+            if (!repo) {
+                LaunchServer::refuse(*launch, repo.error().message());
+                this->printer.printErr(repo.error());
+                return -1;
+            }
+        }
+
+        auto ret = (*server)->start(*launch, handler);
+        if (!ret) {
+            LogW("failed to launch {}: {}", launch->request.options.appid, ret.error());
+        }
+    }
+}
+
 utils::error::Result<void> Cli::ensureBaseDevelopModule(runtime::RunContext &runContext)
 {
     LINGLONG_TRACE("ensure base develop module");
@@ -1965,6 +2162,7 @@ int Cli::runResolvedContext(runtime::RunContext &runContext,
                             std::optional<api::types::v1::RuntimeConfigure> runtimeConfig)
 {
     LINGLONG_TRACE("run resolved context");
+    LogSpan("run resolved context");
 
     auto targetItem = runContext.getCachedTargetItem();
     if (!targetItem) {
@@ -2099,6 +2297,20 @@ int Cli::enter(const EnterOptions &options)
         commands = utils::BashCommandHelper::generateDefaultBashCommand();
     }
 
+    if (::isatty(STDIN_FILENO) == 0) {
+        auto ret = runtime::sendInitExecRequest(
+          runtime::initExecSocketPath(common::dir::getBundleDir(containerID)),
+          runtime::InitExecRequest{ .args = commands });
+        if (!ret) {
+            this->printer.printErr(ret.error());
+            return -1;
+        }
+
+        if (*ret) {
+            return **ret;
+        }
+    }
+
     auto opt = ocppi::runtime::ExecOption{
         .uid = ::getuid(),
         .gid = ::getgid(),
@@ -2119,63 +2331,47 @@ Cli::getCurrentContainers() const noexcept
 {
     LINGLONG_TRACE("get current running containers")
 
-    auto containersRet = this->ociCLI.list();
-    if (!containersRet) {
-        return LINGLONG_ERR(containersRet);
-    }
-    auto containers = std::move(containersRet).value();
-
-    std::vector<api::types::v1::CliContainer> myContainers;
     auto infoDir = std::filesystem::path{ "/run/linglong" } / std::to_string(::getuid());
-
-    std::error_code ec;
-    auto it = std::filesystem::directory_iterator{ infoDir, ec };
-    if (ec) {
-        if (ec == std::errc::no_such_file_or_directory) {
-            return myContainers;
-        }
-
-        return LINGLONG_ERR(fmt::format("failed to list {}", infoDir), ec);
+    auto entries = runtime::ContainerIndex(infoDir).list();
+    if (!entries) {
+        return LINGLONG_ERR(entries);
     }
 
-    for (const auto &pidFile : it) {
-        const auto &file = pidFile.path();
-        const auto &process = "/proc" / file.filename();
-
-        std::error_code ec;
-        if (!std::filesystem::exists(process, ec)) {
-            // this process may exit abnormally, skip it.
-            LogD("{} doesn't exist", process.string());
-            continue;
-        }
-
-        if (pidFile.file_size(ec) == 0) {
-            continue;
-        }
-
-        auto info = linglong::utils::serialize::LoadJSONFile<
-          linglong::api::types::v1::ContainerProcessStateInfo>(file);
-        if (!info) {
-            LogD("load info from {}: {}", file.string(), info.error());
-            continue;
-        }
+    std::vector<api::types::v1::CliContainer> myContainers;
+    // the containers started by older versions of ll-cli have no pid file, only list the
+    // containers of the OCI runtime for them
+    std::optional<std::vector<ocppi::types::ContainerListItem>> containers;
+    for (auto &entry : *entries) {
+        auto &info = entry.info;
+        std::optional<int64_t> pid =
+          runtime::containerPid(common::dir::getBundleDir(info.containerID));
+        if (!pid) {
+            if (!containers) {
+                auto containersRet = this->ociCLI.list();
+                if (!containersRet) {
+                    return LINGLONG_ERR(containersRet);
+                }
+                containers = std::move(containersRet).value();
+            }
 
-        auto container = std::find_if(containers.begin(),
-                                      containers.end(),
-                                      [&info](const ocppi::types::ContainerListItem &item) {
-                                          return item.id == info->containerID;
-                                      });
-        if (container == containers.cend()) {
-            LogD("couldn't find container that process {} belongs to", file.filename().string());
-            continue;
+            auto container = std::find_if(containers->begin(),
+                                          containers->end(),
+                                          [&info](const ocppi::types::ContainerListItem &item) {
+                                              return item.id == info.containerID;
+                                          });
+            if (container == containers->cend()) {
+                LogD("couldn't find container that process {} belongs to", entry.pid);
+                continue;
+            }
+            pid = container->pid;
         }
 
         myContainers.emplace_back(api::types::v1::CliContainer{
-          .id = std::move(info->containerID),
-          .package = !info->app.empty()
-            ? info->app
-            : (info->runtime && !info->runtime->empty() ? *info->runtime : info->base),
-          .pid = container->pid,
+          .id = std::move(info.containerID),
+          .package = !info.app.empty()
+            ? info.app
+            : (info.runtime && !info.runtime->empty() ? *info.runtime : info.base),
+          .pid = *pid,
         });
     }
 
@@ -3374,6 +3570,7 @@ void Cli::filterPackageInfosByVersion(
 utils::error::Result<std::filesystem::path> Cli::ensureCache(runtime::RunContext &context) noexcept
 {
     LINGLONG_TRACE("ensure cache via PM");
+    LogSpan("ensure cache");
 
     const auto &containerID = context.getContainerId();
     auto targetItem = context.getCachedTargetItem();
@@ -3781,6 +3978,15 @@ bool Cli::handleCommonError(const utils::error::Error &error)
 
 void Cli::detectDrivers()
 {
+    LogSpan("detect drivers");
+
+    // nothing to install or upgrade since the last detection, and the drivers are not changed
+    driver::detect::DetectionCache cache(driver::detect::DetectionCache::defaultPath());
+    if (auto drivers = cache.lookup(driver::detect::hostDriverStamp());
+        drivers && drivers->empty()) {
+        return;
+    }
+
     QProcess process;
     process.setProgram(QString(LINGLONG_LIBEXEC_DIR "/ll-driver-detect"));
     // 禁用标准输入 (stdin)
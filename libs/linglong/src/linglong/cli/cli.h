@@ -36,6 +36,7 @@ struct PackageManager1InstallParameters;
 namespace linglong::cli {
 
 class Printer;
+class ContainerWatcher;
 
 // 全局选项（仅用于verbose等通用选项）
 struct GlobalOptions
@@ -210,6 +211,9 @@ public:
     int content(const ContentOptions &options);
     int prune();
     int inspect(CLI::App *subcommand, const InspectOptions &options);
+    // Serve the runs of ll-cli of the current user, they are forked from this process with the
+    // repo loaded and the namespace set up already. See launchByLauncher.
+    int launcher();
 
     void cancelCurrentTask();
 
@@ -243,8 +247,10 @@ private:
       std::map<std::string, std::vector<api::types::v1::PackageInfoV2>> &list) noexcept;
     [[nodiscard]] utils::error::Result<std::vector<api::types::v1::CliContainer>>
     getCurrentContainers() const noexcept;
+    // watcher wakes up the wait for the container lock, it may be null
     utils::error::Result<int> reuseContainer(const std::string &id,
-                                             const std::vector<std::string> &command) noexcept;
+                                             const std::vector<std::string> &command,
+                                             ContainerWatcher *watcher) noexcept;
     int installFromFile(const QFileInfo &fileInfo,
                         const api::types::v1::CommonOptions &commonOptions);
     int setRepoConfig(const QVariantMap &config);
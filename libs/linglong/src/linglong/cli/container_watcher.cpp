@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "container_watcher.h"
+
+#include "linglong/common/error.h"
+#include "linglong/utils/log/log.h"
+
+#include <fmt/format.h>
+
+#include <array>
+#include <cstring>
+#include <string_view>
+
+#include <poll.h>
+#include <sys/inotify.h>
+
+namespace linglong::cli {
+
+namespace {
+
+// the name of the lock file in the bundle, see RunContainerOptions::lockName
+constexpr std::string_view bundleLockName = ".lock";
+
+constexpr uint32_t bundleDirEvents = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO;
+
+} // namespace
+
+ContainerWatcher::ContainerWatcher(utils::fd::UniqueFd inotifyFd,
+                                   std::filesystem::path bundleDir,
+                                   std::string cliLockName) noexcept
+    : inotifyFd(std::move(inotifyFd))
+    , bundleDir(std::move(bundleDir))
+    , cliLockName(std::move(cliLockName))
+{
+}
+
+utils::error::Result<ContainerWatcher>
+ContainerWatcher::create(std::filesystem::path bundleDir,
+                         const std::filesystem::path &cliLock) noexcept
+{
+    LINGLONG_TRACE(fmt::format("watch container {}", bundleDir));
+
+    auto fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1) {
+        return LINGLONG_ERR(
+          fmt::format("failed to create inotify: {}", common::error::errorString(errno)));
+    }
+
+    ContainerWatcher watcher{ utils::fd::UniqueFd{ fd },
+                              std::move(bundleDir),
+                              cliLock.filename().string() };
+
+    // the bundle is created by the ll-cli starting the container, the runtime directory is
+    // watched until then
+    auto runtimeDir = watcher.bundleDir.parent_path();
+    std::error_code ec;
+    std::filesystem::create_directories(runtimeDir, ec);
+    if (ec) {
+        return LINGLONG_ERR(fmt::format("failed to create {}: {}", runtimeDir, ec.message()));
+    }
+
+    watcher.runtimeDirWatch =
+      ::inotify_add_watch(fd, runtimeDir.c_str(), IN_CREATE | IN_MOVED_TO | IN_MASK_ADD);
+    if (watcher.runtimeDirWatch == -1) {
+        return LINGLONG_ERR(fmt::format("failed to watch {}: {}",
+                                        runtimeDir,
+                                        common::error::errorString(errno)));
+    }
+
+    // the cli lock is closed once the ll-cli starting the container exits
+    auto cliLockDir = cliLock.parent_path();
+    watcher.cliLockDirWatch =
+      ::inotify_add_watch(fd, cliLockDir.c_str(), IN_CLOSE_WRITE | IN_MASK_ADD);
+    if (watcher.cliLockDirWatch == -1) {
+        return LINGLONG_ERR(fmt::format("failed to watch {}: {}",
+                                        cliLockDir,
+                                        common::error::errorString(errno)));
+    }
+
+    watcher.watchBundleDir();
+    return watcher;
+}
+
+void ContainerWatcher::watchBundleDir() noexcept
+{
+    if (bundleDirWatch != -1) {
+        return;
+    }
+
+    bundleDirWatch =
+      ::inotify_add_watch(inotifyFd.get(), bundleDir.c_str(), bundleDirEvents | IN_MASK_ADD);
+    if (bundleDirWatch == -1 && errno != ENOENT) {
+        LogD("failed to watch {}: {}", bundleDir, common::error::errorString(errno));
+    }
+}
+
+utils::error::Result<bool> ContainerWatcher::wait(std::chrono::milliseconds timeout) noexcept
+{
+    LINGLONG_TRACE(fmt::format("wait for container {}", bundleDir));
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+        if (remaining.count() < 0) {
+            return false;
+        }
+
+        struct pollfd pfd{ .fd = inotifyFd.get(), .events = POLLIN, .revents = 0 };
+        auto ret = ::poll(&pfd, 1, static_cast<int>(remaining.count()));
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return LINGLONG_ERR(
+              fmt::format("failed to poll inotify: {}", common::error::errorString(errno)));
+        }
+
+        if (ret == 0) {
+            return false;
+        }
+
+        auto changed = readEvents();
+        if (!changed) {
+            return LINGLONG_ERR(changed);
+        }
+
+        if (*changed) {
+            return true;
+        }
+    }
+}
+
+utils::error::Result<bool> ContainerWatcher::readEvents() noexcept
+{
+    LINGLONG_TRACE("read inotify events");
+
+    bool changed = false;
+    alignas(struct inotify_event) std::array<char, 4096> buffer{};
+    while (true) {
+        auto len = ::read(inotifyFd.get(), buffer.data(), buffer.size());
+        if (len == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN) {
+                break;
+            }
+
+            return LINGLONG_ERR(
+              fmt::format("failed to read inotify: {}", common::error::errorString(errno)));
+        }
+
+        for (auto offset = 0L; offset < len;) {
+            struct inotify_event event{};
+            std::memcpy(&event, buffer.data() + offset, sizeof(event));
+            std::string_view name;
+            if (event.len > 0) {
+                name = buffer.data() + offset + sizeof(event);
+            }
+            offset += static_cast<long>(sizeof(event) + event.len);
+
+            if (event.wd == bundleDirWatch) {
+                if ((event.mask & IN_IGNORED) != 0) {
+                    // the bundle is removed
+                    bundleDirWatch = -1;
+                    changed = true;
+                } else if (name == bundleLockName) {
+                    changed = true;
+                }
+            }
+
+            if (event.wd == runtimeDirWatch && name == bundleDir.filename().native()) {
+                watchBundleDir();
+                changed = true;
+            }
+
+            if (event.wd == cliLockDirWatch && name == cliLockName) {
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+} // namespace linglong::cli
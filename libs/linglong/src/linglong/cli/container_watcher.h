@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/utils/error/error.h"
+#include "linglong/utils/unique_fd.h"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+namespace linglong::cli {
+
+// ContainerWatcher wakes up an `ll-cli run` which waits for the container of another `ll-cli run`
+// to become reusable. The state of a container is kept in the lock file of its bundle, the
+// container is started by the ll-cli holding the cli lock. Any creation or modification of the
+// bundle lock, and the cli lock being closed, wakes up the waiter.
+//
+// Create the watcher before checking the state of the container, so no change in between is
+// missed. Wakeups may be spurious, the caller must check the state again.
+class ContainerWatcher
+{
+public:
+    static utils::error::Result<ContainerWatcher>
+    create(std::filesystem::path bundleDir, const std::filesystem::path &cliLock) noexcept;
+
+    // Returns true if something may have changed, false on timeout.
+    utils::error::Result<bool> wait(std::chrono::milliseconds timeout) noexcept;
+
+private:
+    ContainerWatcher(utils::fd::UniqueFd inotifyFd,
+                     std::filesystem::path bundleDir,
+                     std::string cliLockName) noexcept;
+
+    void watchBundleDir() noexcept;
+    utils::error::Result<bool> readEvents() noexcept;
+
+    utils::fd::UniqueFd inotifyFd;
+    std::filesystem::path bundleDir;
+    std::string cliLockName;
+    int runtimeDirWatch{ -1 };
+    int cliLockDirWatch{ -1 };
+    int bundleDirWatch{ -1 };
+};
+
+} // namespace linglong::cli
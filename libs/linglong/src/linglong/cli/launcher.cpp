@@ -0,0 +1,676 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "linglong/cli/launcher.h"
+
+#include "configure.h"
+#include "linglong/common/dir.h"
+#include "linglong/common/error.h"
+#include "linglong/common/socket.h"
+#include "linglong/utils/log/log.h"
+#include "linglong/utils/log/trace.h"
+
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+extern char **environ; // NOLINT
+
+namespace linglong::cli {
+
+namespace {
+
+// the environment is the largest part of a request
+constexpr std::size_t maxRequestSize = 256 * 1024;
+// a client must send its request right after connecting
+constexpr auto receiveTimeout = std::chrono::seconds(5);
+// connections beyond it are refused until the pending requests are received
+constexpr std::size_t maxPendingRequests = 64;
+// forwarded from the client to the launched process
+constexpr std::array<int, 3> forwardedSignals{ SIGINT, SIGTERM, SIGHUP };
+
+template <typename T>
+void writeOptional(nlohmann::json &json, const char *key, const std::optional<T> &value)
+{
+    if (value) {
+        json[key] = *value;
+    }
+}
+
+template <typename T>
+void readOptional(const nlohmann::json &json, const char *key, std::optional<T> &value)
+{
+    if (auto it = json.find(key); it != json.end() && !it->is_null()) {
+        value = it->template get<T>();
+    }
+}
+
+// The debug options and the run context are not sent, such runs are never handed over.
+nlohmann::json toJson(const LaunchRequest &request)
+{
+    const auto &options = request.options;
+    nlohmann::json json{
+        { "version", request.version },
+        { "env", request.env },
+        { "cwd", request.cwd },
+        { "verbose", request.globalOptions.verbose },
+        { "noProgress", request.globalOptions.noProgress },
+        { "appid", options.appid },
+        { "filePaths", options.filePaths },
+        { "fileUrls", options.fileUrls },
+        { "envs", options.envs },
+        { "commands", options.commands },
+        { "extensions", options.extensions },
+        { "privileged", options.privileged },
+        { "capsAdd", options.capsAdd },
+        { "cdiSpecDir", options.cdiSpecDir },
+        { "cdiDevices", options.cdiDevices },
+        { "deviceOptions", options.deviceOptions },
+        { "umask", request.umask },
+        { "rlimits", nlohmann::json::array() },
+    };
+    for (const auto &limit : request.rlimits) {
+        json["rlimits"].push_back({
+          { "resource", limit.resource },
+          { "soft", limit.soft },
+          { "hard", limit.hard },
+        });
+    }
+    writeOptional(json, "base", options.base);
+    writeOptional(json, "runtime", options.runtime);
+    writeOptional(json, "workdir", options.workdir);
+    writeOptional(json, "disableXdp", options.disableXdp);
+    writeOptional(json, "enablePipewireSocketMount", options.enablePipewireSocketMount);
+    writeOptional(json, "enableAtSpiSocketMount", options.enableAtSpiSocketMount);
+    writeOptional(json, "instance", options.instance);
+    return json;
+}
+
+utils::error::Result<LaunchRequest> fromJson(const std::string &payload) noexcept
+{
+    LINGLONG_TRACE("parse launch request");
+
+    try {
+        auto json = nlohmann::json::parse(payload);
+        LaunchRequest request;
+        auto &options = request.options;
+        json.at("version").get_to(request.version);
+        json.at("env").get_to(request.env);
+        json.at("cwd").get_to(request.cwd);
+        json.at("verbose").get_to(request.globalOptions.verbose);
+        json.at("noProgress").get_to(request.globalOptions.noProgress);
+        json.at("appid").get_to(options.appid);
+        json.at("filePaths").get_to(options.filePaths);
+        json.at("fileUrls").get_to(options.fileUrls);
+        json.at("envs").get_to(options.envs);
+        json.at("commands").get_to(options.commands);
+        json.at("extensions").get_to(options.extensions);
+        json.at("privileged").get_to(options.privileged);
+        json.at("capsAdd").get_to(options.capsAdd);
+        json.at("cdiSpecDir").get_to(options.cdiSpecDir);
+        json.at("cdiDevices").get_to(options.cdiDevices);
+        json.at("deviceOptions").get_to(options.deviceOptions);
+        json.at("umask").get_to(request.umask);
+        for (const auto &limit : json.at("rlimits")) {
+            request.rlimits.push_back(ResourceLimit{
+              .resource = limit.at("resource").get<int>(),
+              .soft = limit.at("soft").get<rlim_t>(),
+              .hard = limit.at("hard").get<rlim_t>(),
+            });
+        }
+        readOptional(json, "base", options.base);
+        readOptional(json, "runtime", options.runtime);
+        readOptional(json, "workdir", options.workdir);
+        readOptional(json, "disableXdp", options.disableXdp);
+        readOptional(json, "enablePipewireSocketMount", options.enablePipewireSocketMount);
+        readOptional(json, "enableAtSpiSocketMount", options.enableAtSpiSocketMount);
+        readOptional(json, "instance", options.instance);
+        return request;
+    } catch (const nlohmann::json::exception &e) {
+        return LINGLONG_ERR(e.what());
+    }
+}
+
+// pidfd_open(2) and pidfd_send_signal(2), glibc only wraps them since 2.36
+int pidfdOpen(pid_t pid) noexcept
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int pidfdSendSignal(int pidfd, int sig) noexcept
+{
+#ifdef SYS_pidfd_send_signal
+    return static_cast<int>(::syscall(SYS_pidfd_send_signal, pidfd, sig, nullptr, 0));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// the launched process of sendLaunchRequest, the pid is only used if there is no pidfd
+std::atomic_int forwardPidfd{ -1 };
+std::atomic<pid_t> forwardPid{ 0 };
+
+void forwardSignal(int sig) noexcept
+{
+    auto savedErrno = errno;
+    if (auto pidfd = forwardPidfd.load(); pidfd != -1) {
+        pidfdSendSignal(pidfd, sig);
+    } else if (auto pid = forwardPid.load(); pid > 0) {
+        ::kill(pid, sig);
+    }
+    errno = savedErrno;
+}
+
+// Forward the signals which would stop the client to the launched process while it's alive, the
+// launched process is in another session, so a signal to the foreground process group of the
+// terminal only reaches the client.
+class SignalForwarder
+{
+public:
+    SignalForwarder(pid_t pid, int pidfd) noexcept
+    {
+        forwardPid = pid;
+        forwardPidfd = pidfd;
+
+        struct sigaction sa{};
+        sa.sa_handler = forwardSignal;
+        sigemptyset(&sa.sa_mask);
+        for (std::size_t i = 0; i < forwardedSignals.size(); ++i) {
+            ::sigaction(forwardedSignals[i], &sa, &this->oldActions[i]);
+        }
+    }
+
+    SignalForwarder(const SignalForwarder &) = delete;
+    SignalForwarder &operator=(const SignalForwarder &) = delete;
+    SignalForwarder(SignalForwarder &&) = delete;
+    SignalForwarder &operator=(SignalForwarder &&) = delete;
+
+    ~SignalForwarder()
+    {
+        for (std::size_t i = 0; i < forwardedSignals.size(); ++i) {
+            ::sigaction(forwardedSignals[i], &this->oldActions[i], nullptr);
+        }
+        forwardPidfd = -1;
+        forwardPid = 0;
+    }
+
+private:
+    std::array<struct sigaction, forwardedSignals.size()> oldActions{};
+};
+
+void refuseConnection(int connection, const std::string &reason) noexcept
+{
+    auto reply = nlohmann::json{ { "error", reason } }.dump();
+    if (::send(connection, reply.data(), reply.size(), MSG_NOSIGNAL) == -1) {
+        LogD("failed to refuse launch request: {}", common::error::errorString(errno));
+    }
+}
+
+void flushOutput() noexcept
+{
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+}
+
+} // namespace
+
+std::filesystem::path launcherSocketPath() noexcept
+{
+    return common::dir::getRuntimeDir() / "launcher.sock";
+}
+
+utils::error::Result<std::optional<int>>
+sendLaunchRequest(const std::filesystem::path &socketPath, const LaunchRequest &request) noexcept
+{
+    LINGLONG_TRACE("send launch request");
+
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.native().size() >= sizeof(addr.sun_path)) {
+        LogD("launcher socket path {} is too long", socketPath);
+        return std::nullopt;
+    }
+    std::copy(socketPath.native().begin(), socketPath.native().end(), addr.sun_path);
+
+    utils::fd::UniqueFd fd{ ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0) };
+    if (!fd) {
+        LogD("failed to create launcher socket: {}", common::error::errorString(errno));
+        return std::nullopt;
+    }
+
+    if (::connect(fd.get(), reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+        LogD("no launcher on {}: {}", socketPath, common::error::errorString(errno));
+        return std::nullopt;
+    }
+
+    auto sent = common::socket::sendFdsWithPayload(fd.get(),
+                                                   { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO },
+                                                   toJson(request).dump());
+    if (!sent) {
+        LogD("failed to send launch request: {}", sent.error());
+        return std::nullopt;
+    }
+
+    // Until the launched process replies with its pid nothing is started, so whatever goes wrong
+    // the caller can still run the command by itself.
+    auto started = common::socket::recvFdsWithPayload(fd.get(), 1);
+    if (!started) {
+        LogD("launcher didn't start {}: {}", request.options.appid, started.error());
+        return std::nullopt;
+    }
+    utils::fd::UniqueFd pidfd;
+    if (!started->fds.empty()) {
+        pidfd.reset(started->fds.front());
+        for (std::size_t i = 1; i < started->fds.size(); ++i) {
+            ::close(started->fds[i]);
+        }
+    }
+
+    pid_t pid{ 0 };
+    try {
+        auto json = nlohmann::json::parse(started->payload);
+        if (auto error = json.find("error"); error != json.end()) {
+            LogD("launcher refused to run {}: {}", request.options.appid, error->dump());
+            return std::nullopt;
+        }
+
+        json.at("pid").get_to(pid);
+    } catch (const nlohmann::json::exception &e) {
+        LogD("invalid reply of launcher: {}", e.what());
+        return std::nullopt;
+    }
+
+    SignalForwarder forwarder(pid, pidfd.get());
+
+    std::string reply(4096, '\0');
+    ssize_t n = -1;
+    while ((n = ::recv(fd.get(), reply.data(), reply.size(), 0)) == -1 && errno == EINTR) { }
+    if (n == -1) {
+        return LINGLONG_ERR("failed to receive the reply of launcher", errno);
+    }
+    if (n == 0) {
+        return LINGLONG_ERR(fmt::format("launched process {} exited without exit code", pid));
+    }
+    reply.resize(static_cast<std::size_t>(n));
+
+    try {
+        return nlohmann::json::parse(reply).at("exitCode").get<int>();
+    } catch (const nlohmann::json::exception &e) {
+        return LINGLONG_ERR(fmt::format("invalid reply of launcher: {}", e.what()));
+    }
+}
+
+std::optional<int> launchByLauncher(const RunOptions &options,
+                                    const GlobalOptions &globalOptions) noexcept
+{
+    // the launched process has no controlling terminal and gdbserver needs the cold path
+    if (options.runContext || options.debug || ::isatty(STDIN_FILENO) != 0) {
+        return std::nullopt;
+    }
+
+    std::error_code ec;
+    auto cwd = std::filesystem::current_path(ec);
+    if (ec) {
+        return std::nullopt;
+    }
+
+    auto mask = ::umask(0);
+    ::umask(mask);
+
+    LaunchRequest request{
+        .version = LINGLONG_VERSION_FULL,
+        .options = options,
+        .globalOptions = globalOptions,
+        .env = {},
+        .cwd = cwd.string(),
+        .umask = mask,
+        .rlimits = {},
+    };
+    for (auto **env = environ; *env != nullptr; ++env) {
+        request.env.emplace_back(*env);
+    }
+    for (int resource = 0; resource < RLIMIT_NLIMITS; ++resource) {
+        struct rlimit limit{};
+        if (::getrlimit(resource, &limit) == 0) {
+            request.rlimits.push_back(ResourceLimit{
+              .resource = resource,
+              .soft = limit.rlim_cur,
+              .hard = limit.rlim_max,
+            });
+        }
+    }
+
+    auto result = sendLaunchRequest(launcherSocketPath(), request);
+    if (!result) {
+        LogE("{}", result.error());
+        return -1;
+    }
+
+    return *result;
+}
+
+LaunchServer::LaunchServer(utils::fd::UniqueFd listenFd, std::filesystem::path socketPath) noexcept
+    : listenFd(std::move(listenFd))
+    , socketPath(std::move(socketPath))
+{
+}
+
+LaunchServer::~LaunchServer()
+{
+    std::error_code ec;
+    std::filesystem::remove(this->socketPath, ec);
+}
+
+utils::error::Result<std::unique_ptr<LaunchServer>>
+LaunchServer::listen(const std::filesystem::path &socketPath) noexcept
+{
+    LINGLONG_TRACE(fmt::format("listen on {}", socketPath));
+
+    auto fd = common::socket::createUnixSocket(socketPath.string());
+    if (!fd) {
+        return LINGLONG_ERR(fd.error());
+    }
+
+    return std::unique_ptr<LaunchServer>(
+      new LaunchServer(utils::fd::UniqueFd{ *fd }, socketPath));
+}
+
+utils::error::Result<LaunchServer::Launch>
+LaunchServer::receive(utils::fd::UniqueFd connection) noexcept
+{
+    LINGLONG_TRACE("receive launch request");
+
+    auto data = common::socket::recvFdsWithPayload(connection.get(), 3, maxRequestSize);
+    if (!data) {
+        refuseConnection(connection.get(), data.error());
+        return LINGLONG_ERR(data.error());
+    }
+
+    Launch launch;
+    launch.connection = std::move(connection);
+    for (std::size_t i = 0; i < data->fds.size(); ++i) {
+        if (i < launch.stdio.size()) {
+            launch.stdio[i].reset(data->fds[i]);
+        } else {
+            ::close(data->fds[i]);
+        }
+    }
+    if (data->fds.size() != launch.stdio.size()) {
+        auto reason = fmt::format("expect 3 file descriptors, got {}", data->fds.size());
+        refuse(launch, reason);
+        return LINGLONG_ERR(reason);
+    }
+
+    auto request = fromJson(data->payload);
+    if (!request) {
+        refuse(launch, request.error().message());
+        return LINGLONG_ERR(request);
+    }
+    launch.request = std::move(request).value();
+
+    if (launch.request.version != LINGLONG_VERSION_FULL) {
+        auto reason = fmt::format("version {} of client doesn't match version {} of launcher",
+                                  launch.request.version,
+                                  LINGLONG_VERSION_FULL);
+        refuse(launch, reason);
+        return LINGLONG_ERR(reason);
+    }
+
+    // the replies are sent by the launched process, which has nothing else to do
+    auto flags = ::fcntl(launch.connection.get(), F_GETFL);
+    if (flags == -1 || ::fcntl(launch.connection.get(), F_SETFL, flags & ~O_NONBLOCK) == -1) {
+        auto error = errno;
+        refuse(launch, "failed to set up connection");
+        return LINGLONG_ERR("failed to set up connection", error);
+    }
+
+    return launch;
+}
+
+utils::error::Result<LaunchServer::Launch> LaunchServer::accept() noexcept
+{
+    LINGLONG_TRACE("accept launch request");
+
+    std::vector<struct pollfd> fds;
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        auto expired = std::stable_partition(this->pending.begin(),
+                                             this->pending.end(),
+                                             [now](const Pending &pending) {
+                                                 return pending.deadline > now;
+                                             });
+        for (auto it = expired; it != this->pending.end(); ++it) {
+            LogW("skip launch request: no request received in time");
+            refuseConnection(it->connection.get(), "no request received in time");
+        }
+        this->pending.erase(expired, this->pending.end());
+
+        // the connections are checked before new ones are accepted
+        fds.clear();
+        int timeout = -1;
+        for (const auto &pending : this->pending) {
+            fds.push_back({ .fd = pending.connection.get(), .events = POLLIN, .revents = 0 });
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(pending.deadline - now);
+            if (timeout == -1 || left.count() < timeout) {
+                timeout = static_cast<int>(left.count());
+            }
+        }
+        fds.push_back({ .fd = this->listenFd.get(), .events = POLLIN, .revents = 0 });
+
+        if (::poll(fds.data(), fds.size(), timeout) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return LINGLONG_ERR("failed to poll launcher socket", errno);
+        }
+
+        for (std::size_t i = 0; i < this->pending.size(); ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+
+            auto connection = std::move(this->pending[i].connection);
+            this->pending.erase(this->pending.begin() + static_cast<std::ptrdiff_t>(i));
+            auto launch = receive(std::move(connection));
+            if (!launch) {
+                LogW("skip launch request: {}", launch.error());
+                break;
+            }
+
+            return launch;
+        }
+
+        if (fds.back().revents == 0) {
+            continue;
+        }
+
+        utils::fd::UniqueFd connection{
+            ::accept4(this->listenFd.get(), nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)
+        };
+        if (!connection) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) {
+                continue;
+            }
+
+            return LINGLONG_ERR("failed to accept connection", errno);
+        }
+
+        struct ucred cred{};
+        socklen_t len = sizeof(cred);
+        if (::getsockopt(connection.get(), SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+            LogW("skip launch request: failed to get peer credentials: {}",
+                 common::error::errorString(errno));
+            refuseConnection(connection.get(), "failed to get peer credentials");
+            continue;
+        }
+        if (cred.uid != ::getuid()) {
+            LogW("skip launch request: request of uid {} is not allowed", cred.uid);
+            refuseConnection(connection.get(), "request of other users is not allowed");
+            continue;
+        }
+        if (this->pending.size() >= maxPendingRequests) {
+            LogW("skip launch request: too many pending requests");
+            refuseConnection(connection.get(), "too many pending requests");
+            continue;
+        }
+
+        this->pending.push_back(Pending{
+          .connection = std::move(connection),
+          .deadline = now + receiveTimeout,
+        });
+    }
+}
+
+void LaunchServer::refuse(Launch &launch, const std::string &reason) noexcept
+{
+    refuseConnection(launch.connection.get(), reason);
+    launch.connection.reset();
+}
+
+utils::error::Result<void> LaunchServer::start(Launch &launch, const Handler &handler) noexcept
+{
+    LINGLONG_TRACE(fmt::format("launch {}", launch.request.options.appid));
+
+    // or the buffered output would be written by the launched process again
+    flushOutput();
+
+    auto pid = ::fork();
+    if (pid == -1) {
+        refuse(launch, "failed to fork");
+        return LINGLONG_ERR("fork failed", errno);
+    }
+
+    if (pid == 0) {
+        // fork again so the launched process is reparented and the server never waits for it
+        auto launched = ::fork();
+        if (launched == 0) {
+            this->runLaunch(launch, handler);
+        }
+        ::_exit(launched == -1 ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    int status{ 0 };
+    while (::waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return LINGLONG_ERR("waitpid failed", errno);
+        }
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        refuse(launch, "failed to fork");
+        return LINGLONG_ERR("failed to fork the launched process");
+    }
+
+    launch.connection.reset();
+    for (auto &fd : launch.stdio) {
+        fd.reset();
+    }
+
+    return LINGLONG_OK;
+}
+
+void LaunchServer::runLaunch(Launch &launch, const Handler &handler) noexcept
+{
+    this->listenFd.reset();
+    this->pending.clear();
+    ::setsid();
+
+    // Everything which could fail is set up before the client is told that the command is
+    // started, a refused client runs the command by itself.
+    auto fail = [&launch](const std::string &reason, int error) {
+        LogD("{}: {}", reason, common::error::errorString(error));
+        refuse(launch, reason);
+        ::_exit(EXIT_FAILURE);
+    };
+
+    ::umask(launch.request.umask);
+    for (const auto &limit : launch.request.rlimits) {
+        struct rlimit value{ .rlim_cur = limit.soft, .rlim_max = limit.hard };
+        if (::setrlimit(limit.resource, &value) == -1) {
+            fail(fmt::format("failed to set resource limit {}", limit.resource), errno);
+        }
+    }
+
+    if (::chdir(launch.request.cwd.c_str()) == -1) {
+        fail(fmt::format("failed to change directory to {}", launch.request.cwd), errno);
+    }
+
+    // the received descriptors may occupy 0, 1 or 2 if the server has closed its stdio
+    std::array<int, 3> stdio{};
+    for (std::size_t i = 0; i < stdio.size(); ++i) {
+        stdio[i] = ::fcntl(launch.stdio[i].get(), F_DUPFD_CLOEXEC, 3);
+        if (stdio[i] == -1) {
+            fail("failed to set up stdio of launched process", errno);
+        }
+        launch.stdio[i].reset();
+    }
+    for (std::size_t i = 0; i < stdio.size(); ++i) {
+        if (::dup2(stdio[i], static_cast<int>(i)) == -1) {
+            fail("failed to set up stdio of launched process", errno);
+        }
+        ::close(stdio[i]);
+    }
+
+    ::clearenv();
+    for (const auto &env : launch.request.env) {
+        auto pos = env.find('=');
+        if (pos == std::string::npos || pos == 0) {
+            continue;
+        }
+        ::setenv(env.substr(0, pos).c_str(), env.c_str() + pos + 1, 1);
+    }
+    // trace to the file of the client, if any
+    auto *traceFile = ::getenv(utils::log::TraceFileEnv);
+    utils::log::g_tracer.setTraceFile(traceFile != nullptr ? traceFile : "");
+
+    // the client forwards its signals to the pidfd, or to the pid on kernels without pidfd
+    utils::fd::UniqueFd pidfd{ pidfdOpen(::getpid()) };
+    std::vector<int> fds;
+    if (pidfd) {
+        fds.push_back(pidfd.get());
+    }
+    auto reply = nlohmann::json{ { "pid", ::getpid() } }.dump();
+    auto started = common::socket::sendFdsWithPayload(launch.connection.get(), fds, reply);
+    if (!started) {
+        LogD("failed to start launched process: {}", started.error());
+        ::_exit(EXIT_FAILURE);
+    }
+    pidfd.reset();
+
+    int code = handler(launch.request);
+
+    flushOutput();
+    reply = nlohmann::json{ { "exitCode", code } }.dump();
+    if (::send(launch.connection.get(), reply.data(), reply.size(), MSG_NOSIGNAL) == -1) {
+        LogD("failed to send exit code: {}", common::error::errorString(errno));
+    }
+
+    ::_exit(code == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+} // namespace linglong::cli
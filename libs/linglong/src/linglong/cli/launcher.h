@@ -0,0 +1,122 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/cli/cli.h"
+#include "linglong/utils/error/error.h"
+#include "linglong/utils/unique_fd.h"
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace linglong::cli {
+
+struct ResourceLimit
+{
+    int resource{ 0 };
+    rlim_t soft{ RLIM_INFINITY };
+    rlim_t hard{ RLIM_INFINITY };
+};
+
+// A `ll-cli run` handed over to the launcher, see Cli::launcher. The launched process gets the
+// stdin, stdout and stderr of the client, its environment, working directory, umask and resource
+// limits. SIGINT, SIGTERM and SIGHUP of the client are forwarded to it. Everything else comes
+// from the launcher, the launched process runs in its own session, in the cgroup of the launcher
+// and with the signal mask and dispositions of the launcher.
+struct LaunchRequest
+{
+    // requests of a different version of ll-cli are refused
+    std::string version;
+    RunOptions options;
+    GlobalOptions globalOptions;
+    std::vector<std::string> env;
+    std::string cwd;
+    mode_t umask{ 022 };
+    // the launch is refused if one of them can't be set, the launcher may have lower hard limits
+    std::vector<ResourceLimit> rlimits;
+};
+
+// the socket of the launcher of the current user
+std::filesystem::path launcherSocketPath() noexcept;
+
+// Send request to the launcher listening on socketPath and wait for the launched command.
+// Returns std::nullopt if the command wasn't started by the launcher, because there is no
+// launcher, it refused the request or closed the connection before the launched process replied.
+// The caller should run the command by itself then. An error means the command was started but
+// the connection is lost before it exited.
+utils::error::Result<std::optional<int>>
+sendLaunchRequest(const std::filesystem::path &socketPath, const LaunchRequest &request) noexcept;
+
+// Run the command by the launcher of the current user if possible, see sendLaunchRequest.
+// Interactive and debug runs are never handed over.
+std::optional<int> launchByLauncher(const RunOptions &options,
+                                    const GlobalOptions &globalOptions) noexcept;
+
+// LaunchServer accepts the requests of sendLaunchRequest, every request is handled in a forked
+// process so the state of the server, like the loaded repo, is shared by all launches.
+class LaunchServer
+{
+public:
+    struct Launch
+    {
+        utils::fd::UniqueFd connection;
+        std::array<utils::fd::UniqueFd, 3> stdio;
+        LaunchRequest request;
+    };
+
+    // the launched process calls handler and reports the returned exit code to the client
+    using Handler = std::function<int(const LaunchRequest &request)>;
+
+    static utils::error::Result<std::unique_ptr<LaunchServer>>
+    listen(const std::filesystem::path &socketPath) noexcept;
+
+    LaunchServer(const LaunchServer &) = delete;
+    LaunchServer &operator=(const LaunchServer &) = delete;
+    LaunchServer(LaunchServer &&) = delete;
+    LaunchServer &operator=(LaunchServer &&) = delete;
+    ~LaunchServer();
+
+    // Wait for the next valid request. Invalid requests, requests of other users or versions and
+    // clients which don't send their request in time are refused and skipped, a slow client
+    // doesn't hold up the others. An error is only returned if the socket is broken.
+    utils::error::Result<Launch> accept() noexcept;
+
+    // Refuse launch, the client runs the command by itself.
+    static void refuse(Launch &launch, const std::string &reason) noexcept;
+
+    // Fork a process for launch and return once it's started. The process is not a child of the
+    // server, so there is nothing to wait for.
+    utils::error::Result<void> start(Launch &launch, const Handler &handler) noexcept;
+
+private:
+    // a connection whose request is not received yet
+    struct Pending
+    {
+        utils::fd::UniqueFd connection;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    LaunchServer(utils::fd::UniqueFd listenFd, std::filesystem::path socketPath) noexcept;
+
+    static utils::error::Result<Launch> receive(utils::fd::UniqueFd connection) noexcept;
+    [[noreturn]] void runLaunch(Launch &launch, const Handler &handler) noexcept;
+
+    utils::fd::UniqueFd listenFd;
+    std::filesystem::path socketPath;
+    std::vector<Pending> pending;
+};
+
+} // namespace linglong::cli
@@ -0,0 +1,147 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "detection_cache.h"
+
+#include "linglong/common/dir.h"
+#include "linglong/utils/file.h"
+#include "linglong/utils/log/log.h"
+
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+
+namespace linglong::driver::detect {
+
+namespace {
+
+// kernel modules of graphics drivers, only their versions are part of the stamp as reading all
+// modules would be much slower
+constexpr std::array<std::string_view, 8> graphicsModules{
+    "amdgpu", "i915", "nouveau", "nvidia", "nvidia_drm", "nvidia_modeset", "radeon", "xe",
+};
+
+std::string readSmallFile(const std::filesystem::path &path) noexcept
+{
+    std::ifstream stream(path);
+    if (!stream.is_open()) {
+        return {};
+    }
+
+    std::stringstream content;
+    content << stream.rdbuf();
+    return content.str();
+}
+
+} // namespace
+
+std::string hostDriverStamp(const std::filesystem::path &root) noexcept
+{
+    std::string stamp = readSmallFile(root / "proc/sys/kernel/osrelease");
+    stamp += '\n';
+    stamp += readSmallFile(root / "proc/driver/nvidia/version");
+    for (auto module : graphicsModules) {
+        stamp += '\n';
+        stamp += module;
+        stamp += '=';
+        stamp += readSmallFile(root / "sys/module" / module / "version");
+    }
+
+    return stamp;
+}
+
+std::filesystem::path DetectionCache::defaultPath() noexcept
+{
+    return common::dir::getUserCacheDir() / "driver-detection.json";
+}
+
+DetectionCache::DetectionCache(std::filesystem::path file) noexcept
+    : file(std::move(file))
+{
+}
+
+std::optional<std::vector<GraphicsDriverInfo>>
+DetectionCache::lookup(const std::string &stamp) const noexcept
+{
+    std::ifstream stream(file);
+    if (!stream.is_open()) {
+        return std::nullopt;
+    }
+
+    try {
+        auto json = nlohmann::json::parse(stream);
+        if (json.at("stamp").get<std::string>() != stamp) {
+            return std::nullopt;
+        }
+
+        auto detectedAt = std::chrono::system_clock::time_point{ std::chrono::seconds{
+          json.at("detectedAt").get<int64_t>() } };
+        auto age = std::chrono::system_clock::now() - detectedAt;
+        if (age < std::chrono::seconds::zero() || age > maxAge) {
+            return std::nullopt;
+        }
+
+        std::vector<GraphicsDriverInfo> drivers;
+        for (const auto &item : json.at("drivers")) {
+            drivers.push_back(GraphicsDriverInfo{
+              .identify = item.at("identify").get<std::string>(),
+              .packageName = item.at("packageName").get<std::string>(),
+              .packageVersion = item.at("packageVersion").get<std::string>(),
+              .repoName = item.at("repoName").get<std::string>(),
+            });
+        }
+        return drivers;
+    } catch (const std::exception &e) {
+        LogD("ignore invalid driver detection cache {}: {}", file, e.what());
+    }
+
+    return std::nullopt;
+}
+
+void DetectionCache::store(const std::string &stamp,
+                           const std::vector<GraphicsDriverInfo> &drivers) noexcept
+{
+    std::error_code ec;
+    std::filesystem::create_directories(file.parent_path(), ec);
+    if (ec) {
+        LogD("failed to create directory of {}: {}", file, ec.message());
+        return;
+    }
+
+    std::string content;
+    try {
+        auto items = nlohmann::json::array();
+        for (const auto &driver : drivers) {
+            items.push_back(nlohmann::json{
+              { "identify", driver.identify },
+              { "packageName", driver.packageName },
+              { "packageVersion", driver.packageVersion },
+              { "repoName", driver.repoName },
+            });
+        }
+
+        auto detectedAt = std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch());
+        content = nlohmann::json{
+            { "stamp", stamp },
+            { "detectedAt", detectedAt.count() },
+            { "drivers", std::move(items) },
+        }.dump();
+    } catch (const std::exception &e) {
+        LogD("failed to serialize driver detection cache: {}", e.what());
+        return;
+    }
+
+    auto ret = utils::replaceFile(file, content);
+    if (!ret) {
+        LogD("failed to write driver detection cache: {}", ret.error());
+    }
+}
+
+} // namespace linglong::driver::detect
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace linglong::driver::detect {
+
+struct GraphicsDriverInfo
+{
+    std::string identify;
+    std::string packageName;
+    std::string packageVersion;
+    std::string repoName{ "stable" };
+};
+
+// The versions of the graphics drivers loaded on the host and the kernel release, read from
+// procfs and sysfs under root. Any driver change results in a different stamp.
+std::string hostDriverStamp(const std::filesystem::path &root = "/") noexcept;
+
+// DetectionCache keeps the drivers found by the last detection of ll-driver-detect, so ll-cli
+// only starts a detection if there may be something to do. A result is valid for the host driver
+// stamp it's detected with, and for maxAge as new driver packages may be published.
+class DetectionCache
+{
+public:
+    static constexpr std::chrono::hours maxAge{ 24 };
+
+    // the cache of the current user
+    static std::filesystem::path defaultPath() noexcept;
+
+    explicit DetectionCache(std::filesystem::path file) noexcept;
+
+    [[nodiscard]] std::optional<std::vector<GraphicsDriverInfo>>
+    lookup(const std::string &stamp) const noexcept;
+    void store(const std::string &stamp, const std::vector<GraphicsDriverInfo> &drivers) noexcept;
+
+private:
+    std::filesystem::path file;
+};
+
+} // namespace linglong::driver::detect
@@ -30,6 +30,7 @@
 #include "linglong/package_manager/uab_installation.h"
 #include "linglong/repo/ostree_repo.h"
 #include "linglong/runtime/container_builder.h"
+#include "linglong/runtime/container_index.h"
 #include "linglong/runtime/run_context.h"
 #include "linglong/utils/cmd.h"
 #include "linglong/utils/error/error.h"
@@ -288,50 +289,15 @@ PackageManager::getAllRunningContainers() noexcept
 {
     LINGLONG_TRACE("get all running containers");
 
-    std::error_code ec;
-    auto user_iterator = std::filesystem::directory_iterator{ "/run/linglong", ec };
-    if (ec) {
-        return LINGLONG_ERR("failed to list /run/linglong", ec);
+    auto entries = runtime::ContainerIndex::listAll();
+    if (!entries) {
+        return LINGLONG_ERR(entries);
     }
 
     std::vector<api::types::v1::ContainerProcessStateInfo> result;
-    for (const auto &entry : user_iterator) {
-        if (!entry.is_directory()) {
-            continue;
-        }
-
-        auto process_iterator = std::filesystem::directory_iterator{ entry.path(), ec };
-        if (ec) {
-            return LINGLONG_ERR(fmt::format("failed to list {}", entry.path()), ec);
-        }
-
-        for (const auto &process_entry : process_iterator) {
-            if (!process_entry.is_regular_file()) {
-                continue;
-            }
-
-            auto pid = process_entry.path().filename().string();
-            if (auto procDir = "/proc/" + pid; !std::filesystem::exists(procDir, ec)) {
-                if (ec) {
-                    return LINGLONG_ERR(fmt::format("failed to get state of {}", procDir), ec);
-                }
-
-                LogI("ignore {} because corresponding process is not found",
-                     process_entry.path().c_str());
-                continue;
-            }
-
-            auto content =
-              utils::serialize::LoadJSONFile<api::types::v1::ContainerProcessStateInfo>(
-                process_entry.path());
-            if (!content) {
-                return LINGLONG_ERR(
-                  fmt::format("failed to load info from {}", process_entry.path()),
-                  content);
-            }
-
-            result.emplace_back(std::move(content).value());
-        }
+    result.reserve(entries->size());
+    for (auto &entry : *entries) {
+        result.emplace_back(std::move(entry.info));
     }
 
     return result;
@@ -1280,6 +1246,39 @@ utils::error::Result<void> PackageManager::installRefModule(Task &task,
     return LINGLONG_OK;
 }
 
+utils::error::Result<void> PackageManager::installRefModules(
+  Task &task, const std::vector<std::pair<package::ReferenceWithRepo, std::string>> &refs) noexcept
+{
+    LINGLONG_TRACE(fmt::format("install {} ref modules", refs.size()));
+
+    std::vector<std::pair<package::ReferenceWithRepo, std::string>> refsToPull;
+    for (const auto &[ref, module] : refs) {
+        if (repo->isMarkedDeleted(ref.reference, module)) {
+            auto res = repo->markDeleted(ref.reference, false, module);
+            if (res) {
+                continue;
+            }
+
+            LogW(fmt::format("failed to unmark deleted {} {}, try to pull",
+                             ref.reference.toString(),
+                             module));
+        }
+
+        refsToPull.emplace_back(ref, module);
+    }
+
+    if (refsToPull.empty()) {
+        return LINGLONG_OK;
+    }
+
+    auto res = repo->pullAll(task, refsToPull);
+    if (!res) {
+        return LINGLONG_ERR(res);
+    }
+
+    return LINGLONG_OK;
+}
+
 utils::error::Result<void> PackageManager::installRef(Task &task,
                                                       const package::ReferenceWithRepo &ref,
                                                       std::vector<std::string> modules) noexcept
@@ -1538,7 +1537,8 @@ PackageManager::needToInstall(const std::string &refStr, std::optional<std::stri
 utils::error::Result<std::optional<std::pair<package::ReferenceWithRepo, std::vector<std::string>>>>
 PackageManager::needToUpgrade(const package::FuzzyReference &fuzzyRef,
                               std::optional<package::Reference> &local,
-                              bool installIfMissing)
+                              bool installIfMissing,
+                              const repo::RemotePackages *candidates)
 {
     LINGLONG_TRACE(fmt::format("need to upgrade ref {}", fuzzyRef.toString()));
 
@@ -1553,9 +1553,15 @@ PackageManager::needToUpgrade(const package::FuzzyReference &fuzzyRef,
         return std::nullopt;
     }
 
-    auto candidates = repo->matchRemoteByPriority(fuzzyRef);
-    if (!candidates) {
-        return LINGLONG_ERR(candidates);
+    // candidates may be matched in advance by the caller
+    std::optional<repo::RemotePackages> matched;
+    if (candidates == nullptr) {
+        auto res = repo->matchRemoteByPriority(fuzzyRef);
+        if (!res) {
+            return LINGLONG_ERR(res);
+        }
+        matched = std::move(res).value();
+        candidates = &matched.value();
     }
 
     auto target = candidates->getLatestPackage();
@@ -2033,23 +2039,28 @@ utils::error::Result<void> PackageManager::initRunContext(const std::string &run
         return LINGLONG_OK;
     }
 
-    auto container = this->containerBuilder->createInitContainer(
-      ctx,
-      runtime::CommonContainerOptions{ .containerCachePath = appCache });
-    if (!container) {
-        return LINGLONG_ERR(container);
-    }
+    runtime::CommonContainerOptions options{ .containerCachePath = appCache };
+    // generating the ld.so.cache on the host is much faster than running ldconfig in a container
+    auto initRet = this->containerBuilder->initContainerCache(ctx, options);
+    if (!initRet) {
+        LogD("run ldconfig in init container: {}", initRet.error());
 
-    ocppi::runtime::config::types::Process process{};
-    process.cwd = "/";
-    process.noNewPrivileges = true;
-    process.args = std::vector<std::string>{ "/sbin/ldconfig" };
+        auto container = this->containerBuilder->createInitContainer(ctx, options);
+        if (!container) {
+            return LINGLONG_ERR(container);
+        }
 
-    ocppi::runtime::RunOption opt{};
-    opt.GlobalOption::root = common::dir::getRuntimeDir() / "ll-box";
-    auto result = (*container)->run(process, opt);
-    if (!result) {
-        return LINGLONG_ERR(result);
+        ocppi::runtime::config::types::Process process{};
+        process.cwd = "/";
+        process.noNewPrivileges = true;
+        process.args = std::vector<std::string>{ "/sbin/ldconfig" };
+
+        ocppi::runtime::RunOption opt{};
+        opt.GlobalOption::root = common::dir::getRuntimeDir() / "ll-box";
+        auto result = (*container)->run(process, opt);
+        if (!result) {
+            return LINGLONG_ERR(result);
+        }
     }
 
     ret = utils::writeFile(runContextConfigFile, runContextCfg);
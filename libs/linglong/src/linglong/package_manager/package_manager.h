@@ -90,7 +90,8 @@ public
       std::optional<std::pair<package::ReferenceWithRepo, std::vector<std::string>>>>
     needToUpgrade(const package::FuzzyReference &fuzzyRef,
                   std::optional<package::Reference> &local,
-                  bool installIfMissing = false);
+                  bool installIfMissing = false,
+                  const linglong::repo::RemotePackages *candidates = nullptr);
     virtual utils::error::Result<void>
     installDependsRef(Task &task,
                       const std::string &refStr,
@@ -102,6 +103,10 @@ public
     virtual utils::error::Result<void> installRefModule(Task &task,
                                                         const package::ReferenceWithRepo &ref,
                                                         const std::string &module) noexcept;
+    // install the modules of many refs, the ones to download are pulled in one batch
+    virtual utils::error::Result<void> installRefModules(
+      Task &task,
+      const std::vector<std::pair<package::ReferenceWithRepo, std::string>> &refs) noexcept;
     utils::error::Result<void> Uninstall(PackageTask &taskContext,
                                          const package::Reference &ref,
                                          const std::string &module,
@@ -136,6 +136,10 @@ utils::error::Result<void> PackageUpdateAction::update(PackageTask &task)
                          }
                      });
 
+    if (!depsOnly) {
+        prefetchCandidates();
+    }
+
     bool allFailed = true;
     for (const auto &app : appsToUpgrade) {
         if (task.isTaskDone()) {
@@ -175,6 +179,33 @@ utils::error::Result<void> PackageUpdateAction::postUpdate([[maybe_unused]] Task
     return LINGLONG_OK;
 }
 
+void PackageUpdateAction::prefetchCandidates()
+{
+    std::vector<package::FuzzyReference> fuzzyRefs;
+    for (const auto &app : appsToUpgrade) {
+        auto fuzzyRef =
+          package::FuzzyReference::create(app.channel, app.id, std::nullopt, std::nullopt);
+        if (!fuzzyRef) {
+            continue;
+        }
+        fuzzyRefs.emplace_back(std::move(fuzzyRef).value());
+    }
+
+    auto candidates = repo.batchMatchRemoteByPriority(fuzzyRefs);
+    for (std::size_t i = 0; i < fuzzyRefs.size(); ++i) {
+        // failed ones are matched again by needToUpgrade, which reports the error
+        if (!candidates[i]) {
+            LogD("failed to prefetch candidates of {}: {}",
+                 fuzzyRefs[i].toString(),
+                 candidates[i].error());
+            continue;
+        }
+
+        prefetchedCandidates.insert_or_assign(fuzzyRefs[i].toString(),
+                                              std::move(candidates[i]).value());
+    }
+}
+
 utils::error::Result<void> PackageUpdateAction::updateApp(Task &task,
                                                           const api::types::v1::PackageInfoV2 &app,
                                                           bool depsOnly)
@@ -249,17 +280,21 @@ utils::error::Result<void> PackageUpdateAction::updateApp(Task &task,
             }
         });
     }
+    std::vector<std::pair<package::ReferenceWithRepo, std::string>> refModules;
     for (const auto &[refRepo, modules] : refsToInstall) {
         for (const auto &[module, meta] : modules) {
-            taskMessage = fmt::format("Updating {}/{}", refRepo.reference.toString(), module);
-            task.updateStateMessage(taskMessage);
-            auto res = pm.installRefModule(task, refRepo, module);
-            if (!res) {
-                return LINGLONG_ERR(res);
-            }
-            repositoryChanged = true;
+            refModules.emplace_back(refRepo, module);
         }
     }
+    if (!refModules.empty()) {
+        taskMessage = fmt::format("Updating {}", refsToInstall.front().first.reference.toString());
+        task.updateStateMessage(taskMessage);
+        auto res = pm.installRefModules(task, refModules);
+        if (!res) {
+            return LINGLONG_ERR(res);
+        }
+        repositoryChanged = true;
+    }
 
     if (!refsToInstall.empty()) {
         auto merged = repo.mergeModules();
@@ -315,7 +350,13 @@ PackageUpdateAction::gatherRefsToUpdate(RefsToInstall &refsToInstall,
 
     LogD("needToUpgrade {}", fuzzyRef.toString());
 
-    auto res = pm.needToUpgrade(fuzzyRef, local, installIfMissing);
+    const repo::RemotePackages *candidates = nullptr;
+    if (auto it = prefetchedCandidates.find(fuzzyRef.toString());
+        it != prefetchedCandidates.end()) {
+        candidates = &it->second;
+    }
+
+    auto res = pm.needToUpgrade(fuzzyRef, local, installIfMissing, candidates);
     if (!res) {
         return LINGLONG_ERR(res);
     }
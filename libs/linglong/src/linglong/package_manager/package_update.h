@@ -10,6 +10,10 @@
 #include "linglong/repo/ostree_repo.h"
 #include "linglong/utils/transaction.h"
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 namespace linglong::package {
 class FuzzyReference;
 }
@@ -50,6 +54,7 @@ private:
                         PackageManager &pm,
                         repo::OSTreeRepo &repo);
 
+    void prefetchCandidates();
     utils::error::Result<void> updateApp(Task &task,
                                          const api::types::v1::PackageInfoV2 &app,
                                          bool depsOnly);
@@ -79,6 +84,8 @@ private:
     utils::Transaction transaction;
     bool prepared = false;
     std::vector<api::types::v1::PackageInfoV2> appsToUpgrade;
+    // remote candidates of appsToUpgrade keyed by fuzzy reference, matched in one batch
+    std::unordered_map<std::string, repo::RemotePackages> prefetchedCandidates;
     uint64_t taskTotalSize;
     uint64_t taskNeededSize;
     uint64_t taskFetchedSize;
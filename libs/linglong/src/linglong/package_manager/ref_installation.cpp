@@ -352,16 +352,19 @@ utils::error::Result<void> RefInstallationAction::install(Task &task)
                  res.error());
         }
     });
+    std::vector<std::pair<package::ReferenceWithRepo, std::string>> refModules;
+    refModules.reserve(refsToInstall.size());
     for (const auto &item : refsToInstall) {
         const auto &[refRepo, module, meta] = item;
+        refModules.emplace_back(refRepo, module);
+    }
 
-        taskMessage = fmt::format("Installing {}/{}", refRepo.reference.toString(), module);
-        task.updateStateMessage(taskMessage);
+    taskMessage = fmt::format("Installing {}", operation.newRef->reference.toString());
+    task.updateStateMessage(taskMessage);
 
-        auto res = pm.installRefModule(task, refRepo, module);
-        if (!res) {
-            return LINGLONG_ERR(res);
-        }
+    auto installed = pm.installRefModules(task, refModules);
+    if (!installed) {
+        return LINGLONG_ERR(installed);
     }
 
     auto merged = repo.mergeModules();
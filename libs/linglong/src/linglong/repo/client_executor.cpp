@@ -0,0 +1,198 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "client_executor.h"
+
+#include "linglong/utils/log/log.h"
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QMetaObject>
+#include <QThread>
+
+#include <memory>
+#include <system_error>
+
+namespace linglong::repo {
+
+namespace {
+
+thread_local const CancelToken *currentToken = nullptr;
+thread_local bool workerThread = false;
+
+} // namespace
+
+CancelToken::Scope::Scope(const CancelToken *token) noexcept
+    : previous(currentToken)
+{
+    currentToken = token;
+}
+
+CancelToken::Scope::~Scope()
+{
+    currentToken = previous;
+}
+
+const CancelToken *CancelToken::current() noexcept
+{
+    return currentToken;
+}
+
+ClientExecutor &ClientExecutor::instance()
+{
+    static ClientExecutor executor(16);
+    return executor;
+}
+
+ClientExecutor::ClientExecutor(std::size_t maxWorkers) noexcept
+    : maxWorkers(maxWorkers)
+{
+}
+
+ClientExecutor::~ClientExecutor()
+{
+    shutdown.cancel();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+bool ClientExecutor::isMainThread() noexcept
+{
+    auto *app = QCoreApplication::instance();
+    return app != nullptr && QThread::currentThread() == app->thread();
+}
+
+bool ClientExecutor::isWorkerThread() noexcept
+{
+    return workerThread;
+}
+
+void ClientExecutor::runAll(std::vector<std::function<void()>> tasks) noexcept
+{
+    if (tasks.empty()) {
+        return;
+    }
+
+    // a worker waiting for other workers could exhaust the pool
+    if (isWorkerThread() || (tasks.size() == 1 && !isMainThread())) {
+        for (auto &task : tasks) {
+            task();
+        }
+        return;
+    }
+
+    struct Batch
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::size_t remaining{ 0 };
+        QEventLoop *loop{ nullptr };
+    };
+
+    auto batch = std::make_shared<Batch>();
+    batch->remaining = tasks.size();
+
+    std::optional<QEventLoop> loop;
+    if (isMainThread()) {
+        loop.emplace();
+        batch->loop = &loop.value();
+    }
+
+    for (auto &task : tasks) {
+        post([batch, task = std::move(task)]() {
+            task();
+
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if (--batch->remaining != 0) {
+                return;
+            }
+
+            batch->cond.notify_all();
+            if (batch->loop != nullptr) {
+                // posted to the event loop, it's fine if exec() has not been called yet
+                QMetaObject::invokeMethod(batch->loop, &QEventLoop::quit, Qt::QueuedConnection);
+            }
+        });
+    }
+
+    if (loop) {
+        loop->exec();
+    }
+
+    // the loop could also be stopped by QCoreApplication::exit, tasks must be done before
+    // returning as they may refer to the stack of the caller
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->cond.wait(lock, [&batch] {
+        return batch->remaining == 0;
+    });
+    batch->loop = nullptr;
+}
+
+void ClientExecutor::runDetached(std::function<void()> task) noexcept
+{
+    post([this, task = std::move(task)]() {
+        CancelToken::Scope scope(&shutdown);
+        task();
+    });
+}
+
+void ClientExecutor::post(std::function<void()> task) noexcept
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    tasks.emplace_back(std::move(task));
+
+    if (tasks.size() > idleWorkers && workers.size() < maxWorkers) {
+        try {
+            workers.emplace_back(&ClientExecutor::work, this);
+        } catch (const std::system_error &e) {
+            LogW("failed to start client worker: {}", e.what());
+            if (workers.empty()) {
+                // nobody would run the task, run it here instead
+                auto pending = std::move(tasks.back());
+                tasks.pop_back();
+                lock.unlock();
+                pending();
+                return;
+            }
+        }
+    }
+
+    lock.unlock();
+    cond.notify_one();
+}
+
+void ClientExecutor::work() noexcept
+{
+    workerThread = true;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        ++idleWorkers;
+        cond.wait(lock, [this] {
+            return stopping || !tasks.empty();
+        });
+        --idleWorkers;
+
+        if (tasks.empty()) {
+            return;
+        }
+
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+} // namespace linglong::repo
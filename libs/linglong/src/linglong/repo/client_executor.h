@@ -0,0 +1,125 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace linglong::repo {
+
+// CancelToken aborts the ClientAPI requests issued on threads where it is bound by a Scope, once
+// cancel() is called, the deadline has passed or the parent token is canceled. The transfer is
+// aborted by libcurl, so the request returns a NULL response like a network error.
+class CancelToken
+{
+public:
+    explicit CancelToken(
+      std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt,
+      const CancelToken *parent = CancelToken::current()) noexcept
+        : deadline(deadline)
+        , parent(parent)
+    {
+    }
+
+    void cancel() noexcept { canceled.store(true, std::memory_order_relaxed); }
+
+    [[nodiscard]] bool isCanceled() const noexcept
+    {
+        return canceled.load(std::memory_order_relaxed)
+          || (deadline && std::chrono::steady_clock::now() >= *deadline)
+          || (parent != nullptr && parent->isCanceled());
+    }
+
+    class Scope
+    {
+    public:
+        explicit Scope(const CancelToken *token) noexcept;
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+        Scope(Scope &&) = delete;
+        Scope &operator=(Scope &&) = delete;
+        ~Scope();
+
+    private:
+        const CancelToken *previous;
+    };
+
+    // the token bound to the calling thread, nullptr if there is none
+    static const CancelToken *current() noexcept;
+
+private:
+    std::atomic_bool canceled{ false };
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    const CancelToken *parent;
+};
+
+// ClientExecutor runs blocking ClientAPI requests on a pool of reusable worker threads. Workers
+// are started on demand up to maxWorkers and are kept for later requests.
+class ClientExecutor
+{
+public:
+    static ClientExecutor &instance();
+
+    ClientExecutor(const ClientExecutor &) = delete;
+    ClientExecutor &operator=(const ClientExecutor &) = delete;
+    ClientExecutor(ClientExecutor &&) = delete;
+    ClientExecutor &operator=(ClientExecutor &&) = delete;
+    ~ClientExecutor();
+
+    // Run all tasks concurrently and wait for them. The Qt event loop keeps running when called
+    // from the main thread. Tasks are run on the calling thread if it is a worker, or if there is
+    // only one task and the calling thread is not the main thread.
+    void runAll(std::vector<std::function<void()>> tasks) noexcept;
+
+    // Run task on a worker without waiting for it. The requests of the task are aborted when the
+    // executor is destroyed at exit.
+    void runDetached(std::function<void()> task) noexcept;
+
+    // Run fn and return its result. Off the main thread fn is called directly, on the main thread
+    // it's called by a worker so the Qt event loop is not blocked.
+    template <typename Fn>
+    auto run(Fn &&fn) -> decltype(fn())
+    {
+        if (!isMainThread()) {
+            return fn();
+        }
+
+        std::optional<decltype(fn())> result;
+        runAll({ [&result, &fn]() {
+            result.emplace(fn());
+        } });
+        return std::move(result).value();
+    }
+
+private:
+    explicit ClientExecutor(std::size_t maxWorkers) noexcept;
+
+    static bool isMainThread() noexcept;
+    static bool isWorkerThread() noexcept;
+
+    void post(std::function<void()> task) noexcept;
+    void work() noexcept;
+
+    std::size_t maxWorkers;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    std::size_t idleWorkers{ 0 };
+    bool stopping{ false };
+    CancelToken shutdown{ std::nullopt, nullptr };
+};
+
+} // namespace linglong::repo
@@ -11,11 +11,9 @@ extern "C" {
 }
 
 #include "configure.h"
-
-#include <QEventLoop>
+#include "linglong/repo/client_executor.h"
 
 #include <memory>
-#include <thread>
 
 #define SYNCREQ(type, func, ...) \
     syncRun<type##_t, decltype(&type##_free)>(func, type##_free, __VA_ARGS__)
@@ -36,19 +34,13 @@ public:
     template <typename R, typename D, typename T, typename... Args>
     auto syncRun(T func, D deleter, Args... args) -> std::unique_ptr<R, D>
     {
-        QEventLoop loop;
-        R *response = nullptr;
-        std::thread t(
-          [&loop, &func, &response](apiClient_t *client, Args... args) {
-              response = func(client, args...);
-              loop.exit();
-          },
-          client,
-          args...);
-        loop.exec();
-        if (t.joinable()) {
-            t.join();
-        }
+        // the token must be taken on the calling thread, the request may run on a worker
+        const auto *token = CancelToken::current();
+        R *response = ClientExecutor::instance().run([this, token, &func, &args...]() {
+            client->progress_func = token != nullptr ? &ClientAPIWrapper::onProgress : nullptr;
+            client->progress_data = const_cast<CancelToken *>(token);
+            return func(client, args...);
+        });
         return std::unique_ptr<R, D>(response, deleter);
     }
 
@@ -86,6 +78,16 @@ public:
     }
 
 private:
+    static int onProgress(void *data,
+                          [[maybe_unused]] curl_off_t dltotal,
+                          [[maybe_unused]] curl_off_t dlnow,
+                          [[maybe_unused]] curl_off_t ultotal,
+                          [[maybe_unused]] curl_off_t ulnow)
+    {
+        // a non-zero value aborts the transfer
+        return static_cast<const CancelToken *>(data)->isCanceled() ? 1 : 0;
+    }
+
     apiClient_t *client;
     std::string m_user_agent = "linglong/" LINGLONG_VERSION_FULL;
 };
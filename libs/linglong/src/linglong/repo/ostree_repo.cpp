@@ -20,7 +20,9 @@
 #include "linglong/package/layer_dir.h"
 #include "linglong/package/reference.h"
 #include "linglong/package_manager/package_task.h"
+#include "linglong/repo/client_executor.h"
 #include "linglong/repo/config.h"
+#include "linglong/repo/remote_search_cache.h"
 #include "linglong/utils/cmd.h"
 #include "linglong/utils/env.h"
 #include "linglong/utils/error/error.h"
@@ -47,18 +49,22 @@
 #include <QtGlobal>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -380,6 +386,198 @@ utils::error::Result<bool> semanticMatch(const package::FuzzyReference &fuzzy,
     return reference->semanticMatch(fuzzy);
 }
 
+utils::error::Result<std::vector<api::types::v1::PackageInfoV2>>
+fetchRemotePackages(ClientAPIWrapper &client,
+                    const package::FuzzyReference &fuzzyRef,
+                    const api::types::v1::Repo &repo) noexcept
+{
+    LINGLONG_TRACE("fetch remote packages");
+
+    char *app_id = strndup(fuzzyRef.id.data(), fuzzyRef.id.size());
+    if (app_id == nullptr) {
+        return LINGLONG_ERR(fmt::format("strndup app_id failed: {}", fuzzyRef.id));
+    }
+    char *repo_name = strndup(repo.name.data(), repo.name.size());
+    if (repo_name == nullptr) {
+        return LINGLONG_ERR(fmt::format("strndup repo_name failed: {}", repo.name));
+    }
+
+    char *channel = nullptr;
+    if (fuzzyRef.channel) {
+        channel = strndup(fuzzyRef.channel->data(), fuzzyRef.channel->size());
+        if (channel == nullptr) {
+            return LINGLONG_ERR(fmt::format("strndup channel failed: {}", *fuzzyRef.channel));
+        }
+    }
+
+    // use prefix matching on version strings when searching the remote server
+    char *version = nullptr;
+    if (fuzzyRef.version) {
+        version = strndup(fuzzyRef.version->data(), fuzzyRef.version->size());
+        if (version == nullptr) {
+            return LINGLONG_ERR(fmt::format("strndup version failed: {}", *fuzzyRef.version));
+        }
+    }
+
+    // use current CPU architecture if no architecture is specified
+    auto arch = fuzzyRef.arch.value_or(package::Architecture::currentCPUArchitecture()).toString();
+    char *archStr = strndup(arch.data(), arch.size());
+    if (archStr == nullptr) {
+        return LINGLONG_ERR(fmt::format("strndup arch failed: {}", arch));
+    }
+
+    auto req = request_fuzzy_search_req_create(app_id, archStr, channel, repo_name, version);
+    if (!req) {
+        return LINGLONG_ERR("failed to create request");
+    }
+    auto freeIfNotNull = utils::finally::finally([req] {
+        request_fuzzy_search_req_free(req);
+    });
+    auto response = client.fuzzySearch(req);
+    if (!response) {
+        return LINGLONG_ERR("failed to send request to remote server\nIf the network is slow, "
+                            "set a longer timeout via the LINGLONG_CONNECT_TIMEOUT environment "
+                            "variable (current default: 5 seconds).",
+                            utils::error::ErrorCode::NetworkError);
+    }
+
+    if (response->code != 200) {
+        std::string msg = (response->msg != nullptr)
+          ? response->msg
+          : fmt::format("cannot send request to remote server: {}\nIf the network is slow, "
+                        "set a longer timeout via the LINGLONG_CONNECT_TIMEOUT environment "
+                        "variable (current default: 5 seconds).",
+                        response->code);
+
+        return LINGLONG_ERR(msg,
+                            (response->msg != nullptr ? utils::error::ErrorCode::Failed
+                                                      : utils::error::ErrorCode::NetworkError));
+    }
+
+    if (response->data == nullptr || response->data->count == 0) {
+        return {};
+    }
+
+    std::vector<api::types::v1::PackageInfoV2> pkgInfos;
+    pkgInfos.reserve(response->data->count);
+    for (auto *entry = response->data->firstEntry; entry != nullptr; entry = entry->nextListEntry) {
+        auto *item = (request_register_struct_t *)entry->data;
+        auto packageInfo = api::types::v1::PackageInfoV2{
+            .arch = { item->arch },
+            .base = { item->base },
+            .channel = item->channel,
+            .description = item->description,
+            .id = item->app_id,
+            .kind = item->kind,
+            .packageInfoV2Module = item->module,
+            .name = item->name,
+            .runtime = item->runtime,
+            .size = item->size,
+            .version = item->version,
+        };
+
+        pkgInfos.emplace_back(std::move(packageInfo));
+    }
+
+    return pkgInfos;
+}
+
+std::size_t positiveNumberFromEnv(const char *name, std::size_t defaultValue) noexcept
+{
+    auto *env = ::getenv(name);
+    if (env == nullptr) {
+        return defaultValue;
+    }
+
+    try {
+        auto value = std::stoi(env);
+        if (value > 0) {
+            return static_cast<std::size_t>(value);
+        }
+        LogW("invalid {}[{}], must be positive", name, env);
+    } catch (std::invalid_argument &e) {
+        LogW("failed to parse {}[{}]: {}", name, env, e.what());
+    } catch (std::out_of_range &e) {
+        LogW("failed to parse {}[{}]: {}", name, env, e.what());
+    }
+
+    return defaultValue;
+}
+
+// the number of concurrent remote requests
+std::size_t maxInFlightRequests() noexcept
+{
+    return positiveNumberFromEnv("LINGLONG_MAX_INFLIGHT_REQUESTS", 8);
+}
+
+// the deadline shared by the searches of repos with the same priority
+std::chrono::seconds searchTimeout() noexcept
+{
+    return std::chrono::seconds(positiveNumberFromEnv("LINGLONG_SEARCH_TIMEOUT", 30));
+}
+
+// Options to check out a commit as hard links to the objects of the repo, which is bare-user-only,
+// instead of copying every file. ostree falls back to copying when the checkout is on another
+// device. Setting LINGLONG_CHECKOUT_FORCE_COPY=1 always copies.
+OstreeRepoCheckoutAtOptions
+checkoutOptions(OstreeRepoCheckoutOverwriteMode overwriteMode = OSTREE_REPO_CHECKOUT_OVERWRITE_NONE)
+{
+    OstreeRepoCheckoutAtOptions opt = {};
+    opt.mode = OSTREE_REPO_CHECKOUT_MODE_USER;
+    opt.overwrite_mode = overwriteMode;
+    opt.no_copy_fallback = FALSE;
+
+    auto *env = ::getenv("LINGLONG_CHECKOUT_FORCE_COPY");
+    opt.force_copy = env != nullptr && std::string_view{ env } == "1" ? TRUE : FALSE;
+
+    return opt;
+}
+
+// Recreate the tree of src in dest with hard links to the files of src. The checkouts on top of
+// dest only add files, so src, which may be bind-mounted by running containers, stays unchanged.
+utils::error::Result<void> cloneTreeAsHardLinks(const std::filesystem::path &src,
+                                                const std::filesystem::path &dest) noexcept
+{
+    LINGLONG_TRACE(fmt::format("clone {} to {} as hard links", src, dest));
+
+    std::error_code ec;
+    std::filesystem::create_directories(dest, ec);
+    if (ec) {
+        return LINGLONG_ERR(fmt::format("create {}", dest), ec);
+    }
+
+    auto iterator = std::filesystem::recursive_directory_iterator(src, ec);
+    if (ec) {
+        return LINGLONG_ERR(fmt::format("read {}", src), ec);
+    }
+    for (; iterator != std::filesystem::recursive_directory_iterator(); iterator.increment(ec)) {
+        if (ec) {
+            return LINGLONG_ERR(fmt::format("iterate {}", src), ec);
+        }
+        const auto &entry = *iterator;
+        auto target = dest / entry.path().lexically_relative(src);
+        auto status = entry.symlink_status(ec);
+        if (ec) {
+            return LINGLONG_ERR(fmt::format("stat {}", entry.path()), ec);
+        }
+        if (std::filesystem::is_symlink(status)) {
+            std::filesystem::copy_symlink(entry.path(), target, ec);
+        } else if (std::filesystem::is_directory(status)) {
+            std::filesystem::create_directory(target, entry.path(), ec);
+        } else {
+            std::filesystem::create_hard_link(entry.path(), target, ec);
+        }
+        if (ec) {
+            return LINGLONG_ERR(fmt::format("clone {}", entry.path()), ec);
+        }
+    }
+    if (ec) {
+        return LINGLONG_ERR(fmt::format("iterate {}", src), ec);
+    }
+
+    return LINGLONG_OK;
+}
+
 } // namespace
 
 utils::error::Result<package::Reference> OSTreeRepo::clearReferenceLocal(
@@ -544,8 +742,9 @@ utils::error::Result<void> OSTreeRepo::handleRepositoryUpdate(
         return LINGLONG_ERR(fmt::format("ostree_repo_resolve_rev {}", ptr_view(gErr)));
     }
 
+    auto opt = checkoutOptions();
     if (ostree_repo_checkout_at(this->ostreeRepo.get(),
-                                nullptr,
+                                &opt,
                                 root,
                                 path.toUtf8().constData(),
                                 commit,
@@ -618,6 +817,8 @@ std::filesystem::path OSTreeRepo::configFilePath() const noexcept
 OSTreeRepo::OSTreeRepo(std::filesystem::path path, api::types::v1::RepoConfigV2 cfg) noexcept
     : cfg(std::move(cfg))
     , repoDir(std::move(path))
+    , searchCache(std::make_shared<RemoteSearchCache>(
+        this->repoDir.empty() ? this->repoDir : this->repoDir / "search-cache"))
 {
 }
 
@@ -649,6 +850,16 @@ utils::error::Result<void> OSTreeRepo::init(bool create) noexcept
     return initCache(create);
 }
 
+bool OSTreeRepo::isCacheOutdated() const noexcept
+{
+    return this->cache->isOutdated();
+}
+
+uint64_t OSTreeRepo::cacheGeneration() const noexcept
+{
+    return this->cache ? this->cache->generation() : 0;
+}
+
 utils::error::Result<void> OSTreeRepo::initCache(bool create) noexcept
 {
     LINGLONG_TRACE("init repo cache");
@@ -840,6 +1051,9 @@ utils::error::Result<void> OSTreeRepo::setConfig(const api::types::v1::RepoConfi
 
     this->cfg = cfg;
 
+    // the cached search results may come from repos which are changed or removed
+    this->searchCache->clear();
+
     transaction.commit();
 
     return LINGLONG_OK;
@@ -1183,6 +1397,53 @@ utils::error::Result<void> OSTreeRepo::prune()
     return LINGLONG_OK;
 }
 
+utils::error::Result<void> OSTreeRepo::generateStaticDelta(const package::Reference &from,
+                                                           const package::Reference &to,
+                                                           const std::string &module) const noexcept
+{
+    LINGLONG_TRACE(
+      fmt::format("generate static delta from {} to {}", from.toString(), to.toString()));
+
+    auto fromItem = this->getLayerItem(from, module);
+    if (!fromItem) {
+        return LINGLONG_ERR(fromItem);
+    }
+    auto toItem = this->getLayerItem(to, module);
+    if (!toItem) {
+        return LINGLONG_ERR(toItem);
+    }
+    if (fromItem->commit == toItem->commit) {
+        return LINGLONG_ERR(fmt::format("{} and {} are the same commit {}",
+                                        from.toString(),
+                                        to.toString(),
+                                        toItem->commit));
+    }
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_autoptr(GVariant) params = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+    g_autoptr(GError) gErr = nullptr;
+    if (ostree_repo_static_delta_generate(this->ostreeRepo.get(),
+                                          OSTREE_STATIC_DELTA_GENERATE_OPT_MAJOR,
+                                          fromItem->commit.c_str(),
+                                          toItem->commit.c_str(),
+                                          nullptr,
+                                          params,
+                                          nullptr,
+                                          &gErr)
+        == FALSE) {
+        return LINGLONG_ERR(fmt::format("ostree_repo_static_delta_generate {}", ptr_view(gErr)));
+    }
+
+    // pulls look up the deltas ending at the target commit in the summary
+    if (ostree_repo_regenerate_summary(this->ostreeRepo.get(), nullptr, nullptr, &gErr) == FALSE) {
+        return LINGLONG_ERR(fmt::format("ostree_repo_regenerate_summary {}", ptr_view(gErr)));
+    }
+
+    return LINGLONG_OK;
+}
+
 utils::error::Result<RefMetaData>
 OSTreeRepo::fetchRefMetaData(const package::ReferenceWithRepo &refRepo,
                              const std::string &module,
@@ -1198,7 +1459,7 @@ OSTreeRepo::fetchRefMetaData(const package::ReferenceWithRepo &refRepo,
     for (size_t idx = 0; idx < refCandidates.size(); ++idx) {
         refString = refCandidates[idx];
 
-        GVariantBuilder builder = this->initOStreePullOptions(refString);
+        GVariantBuilder builder = this->initOStreePullOptions({ refString });
         if (fetchPackageInfo) {
             std::vector<const char *> subdirs{ "/info.json", nullptr };
             g_variant_builder_add(&builder,
@@ -1344,9 +1605,16 @@ OSTreeRepo::getRefStatistics(const RefMetaData &meta) const noexcept
 }
 
 // 初始化一个GVariantBuilder
-GVariantBuilder OSTreeRepo::initOStreePullOptions(const std::string &ref) noexcept
+GVariantBuilder OSTreeRepo::initOStreePullOptions(const std::vector<std::string> &refs,
+                                                  bool staticDeltas) noexcept
 {
-    std::array<const char *, 2> refs{ ref.c_str(), nullptr };
+    std::vector<const char *> refList;
+    refList.reserve(refs.size() + 1);
+    for (const auto &ref : refs) {
+        refList.emplace_back(ref.c_str());
+    }
+    refList.emplace_back(nullptr);
+
     GVariantBuilder builder;
     g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
     std::string userAgent = "linglong/" LINGLONG_VERSION_FULL;
@@ -1354,15 +1622,18 @@ GVariantBuilder OSTreeRepo::initOStreePullOptions(const std::string &ref) noexce
                           "{s@v}",
                           "append-user-agent",
                           g_variant_new_variant(g_variant_new_string(userAgent.c_str())));
+    // With static deltas enabled, ostree looks up the deltas ending at the pulled commit in the
+    // summary and uses the one whose from-commit exists locally, e.g. the installed version.
+    // The pull falls back to fetching objects one by one if there isn't such a delta.
     g_variant_builder_add(&builder,
                           "{s@v}",
                           "disable-static-deltas",
-                          g_variant_new_variant(g_variant_new_boolean(true)));
+                          g_variant_new_variant(g_variant_new_boolean(!staticDeltas)));
 
     g_variant_builder_add(&builder,
                           "{s@v}",
                           "refs",
-                          g_variant_new_variant(g_variant_new_strv(refs.data(), -1)));
+                          g_variant_new_variant(g_variant_new_strv(refList.data(), -1)));
     return builder;
 }
 
@@ -1407,7 +1678,8 @@ utils::error::Result<void> OSTreeRepo::pull(service::Task &taskContext,
     for (size_t idx = 0; idx < refCandidates.size(); ++idx) {
         refString = refCandidates[idx];
 
-        auto builder = this->initOStreePullOptions(refString);
+        auto builder =
+          this->initOStreePullOptions({ refString }, refRepo.repo.staticDeltas.value_or(false));
         g_autoptr(GVariant) pull_options = g_variant_ref_sink(g_variant_builder_end(&builder));
         // 这里不能使用g_main_context_push_thread_default，因为会阻塞Qt的事件循环
 
@@ -1435,11 +1707,116 @@ utils::error::Result<void> OSTreeRepo::pull(service::Task &taskContext,
         Q_ASSERT(progress != nullptr);
     }
 
+    auto result = this->deployPulledRef(repoName, refString, cancellable);
+    if (!result) {
+        return LINGLONG_ERR(result);
+    }
+
+    return LINGLONG_OK;
+}
+
+utils::error::Result<void> OSTreeRepo::pullAll(
+  service::Task &taskContext,
+  const std::vector<std::pair<package::ReferenceWithRepo, std::string>> &refs) noexcept
+{
+    LINGLONG_TRACE(fmt::format("pull {} refs", refs.size()));
+
+    if (refs.size() == 1) {
+        auto res = this->pull(taskContext, refs.front().first, refs.front().second);
+        if (!res) {
+            return LINGLONG_ERR(res);
+        }
+        return LINGLONG_OK;
+    }
+
+    // ostree pulls from one remote at a time, pull all refs of the same remote together
+    std::vector<std::vector<std::size_t>> groups;
+    std::unordered_map<std::string, std::size_t> groupIndex;
+    for (std::size_t i = 0; i < refs.size(); ++i) {
+        const auto &repo = refs[i].first.repo;
+        auto [it, inserted] = groupIndex.try_emplace(repo.alias.value_or(repo.name), groups.size());
+        if (inserted) {
+            groups.emplace_back();
+        }
+        groups[it->second].emplace_back(i);
+    }
+
+    auto *cancellable = taskContext.cancellable();
+    for (const auto &group : groups) {
+        const auto &repo = refs[group.front()].first.repo;
+        auto repoName = repo.alias.value_or(repo.name);
+
+        std::vector<std::string> refStrings;
+        bool hasBinary = false;
+        for (auto idx : group) {
+            const auto &[refRepo, module] = refs[idx];
+            auto refString = buildPullRefCandidates(refRepo.reference, module).front();
+            if (std::find(refStrings.begin(), refStrings.end(), refString) == refStrings.end()) {
+                refStrings.emplace_back(std::move(refString));
+            }
+            hasBinary = hasBinary || module == "binary";
+        }
+
+        ostreeUserData data;
+        data.taskContext = &taskContext;
+        g_autoptr(OstreeAsyncProgress) progress =
+          ostree_async_progress_new_and_connect(progress_changed, (void *)&data);
+        Q_ASSERT(progress != nullptr);
+
+        auto builder = this->initOStreePullOptions(refStrings, repo.staticDeltas.value_or(false));
+        g_autoptr(GVariant) pull_options = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+        g_autoptr(GError) gErr = nullptr;
+        auto status = ostree_repo_pull_with_options(this->ostreeRepo.get(),
+                                                    repoName.c_str(),
+                                                    pull_options,
+                                                    progress,
+                                                    cancellable,
+                                                    &gErr);
+        ostree_async_progress_finish(progress);
+        if (status == FALSE) {
+            if (!hasBinary || !shouldFallbackToRuntimeBranch("binary", gErr)) {
+                return LINGLONG_ERR(
+                  fmt::format("ostree_repo_pull_with_options {}", ptr_view(gErr)));
+            }
+
+            // some binary modules are published as runtime, pull them one by one so that each
+            // can fall back separately, the objects fetched so far are kept in the repo
+            LogW("pull {} refs from {} failed: {}, pull them separately",
+                 refStrings.size(),
+                 repoName,
+                 gErr->message);
+            for (auto idx : group) {
+                auto res = this->pull(taskContext, refs[idx].first, refs[idx].second);
+                if (!res) {
+                    return LINGLONG_ERR(res);
+                }
+            }
+            continue;
+        }
+
+        for (const auto &refString : refStrings) {
+            auto res = this->deployPulledRef(repoName, refString, cancellable);
+            if (!res) {
+                return LINGLONG_ERR(res);
+            }
+        }
+    }
+
+    return LINGLONG_OK;
+}
+
+utils::error::Result<void> OSTreeRepo::deployPulledRef(const std::string &repoName,
+                                                       const std::string &refString,
+                                                       GCancellable *cancellable) noexcept
+{
+    LINGLONG_TRACE(fmt::format("deploy {} from {}", refString, repoName));
+
+    g_autoptr(GError) gErr = nullptr;
     g_autofree char *commit = nullptr;
     g_autoptr(GFile) layerRootDir = nullptr;
     api::types::v1::RepositoryCacheLayersItem item;
 
-    g_clear_error(&gErr);
     if (ostree_repo_read_commit(this->ostreeRepo.get(),
                                 refString.c_str(),
                                 &layerRootDir,
@@ -1585,107 +1962,57 @@ OSTreeRepo::searchRemote(const package::FuzzyReference &fuzzyRef,
          semanticMatching,
          nlohmann::json(repo).dump());
 
-    auto client = this->createClientV2(repo.url);
-
-    char *app_id = strndup(fuzzyRef.id.data(), fuzzyRef.id.size());
-    if (app_id == nullptr) {
-        return LINGLONG_ERR(fmt::format("strndup app_id failed: {}", fuzzyRef.id));
-    }
-    char *repo_name = strndup(repo.name.data(), repo.name.size());
-    if (repo_name == nullptr) {
-        return LINGLONG_ERR(fmt::format("strndup repo_name failed: {}", repo.name));
-    }
+    RemoteSearchCache::Key key{
+        .repoName = repo.name,
+        .repoUrl = repo.url,
+        .id = fuzzyRef.id,
+        .channel = fuzzyRef.channel.value_or(""),
+        .version = fuzzyRef.version.value_or(""),
+        .arch =
+          fuzzyRef.arch.value_or(package::Architecture::currentCPUArchitecture()).toString(),
+    };
 
-    char *channel = nullptr;
-    if (fuzzyRef.channel) {
-        channel = strndup(fuzzyRef.channel->data(), fuzzyRef.channel->size());
-        if (channel == nullptr) {
-            return LINGLONG_ERR(fmt::format("strndup channel failed: {}", *fuzzyRef.channel));
+    std::vector<api::types::v1::PackageInfoV2> pkgInfos;
+    auto cached = this->searchCache->lookup(key);
+    if (cached) {
+        pkgInfos = std::move(cached->packages);
+        // serve the stale entry and refresh it in the background
+        if (cached->stale && this->searchCache->beginRevalidate(key)) {
+            std::shared_ptr<ClientAPIWrapper> client = this->createClientV2(repo.url);
+            ClientExecutor::instance().runDetached(
+              [client, fuzzyRef, repo, key, cache = this->searchCache]() {
+                  auto fetched = fetchRemotePackages(*client, fuzzyRef, repo);
+                  if (fetched) {
+                      cache->store(key, *fetched);
+                  } else {
+                      LogD("failed to revalidate search cache: {}", fetched.error());
+                  }
+                  cache->endRevalidate(key);
+              });
         }
-    }
-
-    // use prefix matching on version strings when searching the remote server
-    char *version = nullptr;
-    if (fuzzyRef.version) {
-        version = strndup(fuzzyRef.version->data(), fuzzyRef.version->size());
-        if (version == nullptr) {
-            return LINGLONG_ERR(fmt::format("strndup version failed: {}", *fuzzyRef.version));
+    } else {
+        auto client = this->createClientV2(repo.url);
+        auto fetched = fetchRemotePackages(*client, fuzzyRef, repo);
+        if (!fetched) {
+            return LINGLONG_ERR(fetched);
         }
+        this->searchCache->store(key, *fetched);
+        pkgInfos = std::move(fetched).value();
     }
 
-    // use current CPU architecture if no architecture is specified
-    auto arch = fuzzyRef.arch.value_or(package::Architecture::currentCPUArchitecture()).toString();
-    char *archStr = strndup(arch.data(), arch.size());
-    if (archStr == nullptr) {
-        return LINGLONG_ERR(fmt::format("strndup arch failed: {}", arch));
-    }
-
-    auto req = request_fuzzy_search_req_create(app_id, archStr, channel, repo_name, version);
-    if (!req) {
-        return LINGLONG_ERR("failed to create request");
-    }
-    auto freeIfNotNull = utils::finally::finally([req] {
-        request_fuzzy_search_req_free(req);
-    });
-    auto response = client->fuzzySearch(req);
-    if (!response) {
-        return LINGLONG_ERR("failed to send request to remote server\nIf the network is slow, "
-                            "set a longer timeout via the LINGLONG_CONNECT_TIMEOUT environment "
-                            "variable (current default: 5 seconds).",
-                            utils::error::ErrorCode::NetworkError);
-    }
-
-    if (response->code != 200) {
-        std::string msg = (response->msg != nullptr)
-          ? response->msg
-          : fmt::format("cannot send request to remote server: {}\nIf the network is slow, "
-                        "set a longer timeout via the LINGLONG_CONNECT_TIMEOUT environment "
-                        "variable (current default: 5 seconds).",
-                        response->code);
-
-        return LINGLONG_ERR(msg,
-                            (response->msg != nullptr ? utils::error::ErrorCode::Failed
-                                                      : utils::error::ErrorCode::NetworkError));
-    }
-
-    if (response->data == nullptr || response->data->count == 0) {
-        return {};
-    }
-
-    std::vector<api::types::v1::PackageInfoV2> pkgInfos;
-    pkgInfos.reserve(response->data->count);
-    for (auto *entry = response->data->firstEntry; entry != nullptr; entry = entry->nextListEntry) {
-        auto *item = (request_register_struct_t *)entry->data;
-        auto packageInfo = api::types::v1::PackageInfoV2{
-            .arch = { item->arch },
-            .base = { item->base },
-            .channel = item->channel,
-            .description = item->description,
-            .id = item->app_id,
-            .kind = item->kind,
-            .packageInfoV2Module = item->module,
-            .name = item->name,
-            .runtime = item->runtime,
-            .size = item->size,
-            .version = item->version,
-        };
-
-        // apply semantic matching to search results to correctly filter:
-        // versions like app/1.10 when match for app/1.1
-        // id like app.1 when match for app
-        if (semanticMatching) {
-            auto matched = semanticMatch(fuzzyRef, packageInfo);
+    // apply semantic matching to search results to correctly filter:
+    // versions like app/1.10 when match for app/1.1
+    // id like app.1 when match for app
+    if (semanticMatching) {
+        auto it = std::remove_if(pkgInfos.begin(), pkgInfos.end(), [&fuzzyRef](const auto &info) {
+            auto matched = semanticMatch(fuzzyRef, info);
             if (!matched) {
                 LogE("invalid packageInfo", matched.error());
-                continue;
-            }
-
-            if (!*matched) {
-                continue;
+                return true;
             }
-        }
-
-        pkgInfos.emplace_back(std::move(packageInfo));
+            return !*matched;
+        });
+        pkgInfos.erase(it, pkgInfos.end());
     }
 
     return pkgInfos;
@@ -1713,8 +2040,24 @@ OSTreeRepo::matchRemoteByPriority(const package::FuzzyReference &fuzzyRef,
         bool allError = true;
         auto repos = this->getPriorityGroupedRepos();
         for (const auto &repoGroup : repos) {
-            for (const auto &repo : repoGroup) {
-                auto list = this->searchRemote(fuzzyRef, repo, true);
+            // repos with the same priority are searched concurrently, the searches still running
+            // at the deadline are aborted and treated as failed
+            CancelToken token(std::chrono::steady_clock::now() + searchTimeout());
+            std::vector<utils::error::Result<std::vector<api::types::v1::PackageInfoV2>>> lists(
+              repoGroup.size());
+            std::vector<std::function<void()>> tasks;
+            tasks.reserve(repoGroup.size());
+            for (std::size_t i = 0; i < repoGroup.size(); ++i) {
+                tasks.emplace_back([this, &fuzzyRef, &repoGroup, &lists, &token, i]() {
+                    CancelToken::Scope scope(&token);
+                    lists[i] = this->searchRemote(fuzzyRef, repoGroup[i], true);
+                });
+            }
+            ClientExecutor::instance().runAll(std::move(tasks));
+
+            for (std::size_t i = 0; i < repoGroup.size(); ++i) {
+                const auto &repo = repoGroup[i];
+                auto &list = lists[i];
                 if (!list) {
                     LogW("failed to search remote packages from {}: {}", repo.name, list.error());
                     continue;
@@ -1743,6 +2086,45 @@ OSTreeRepo::matchRemoteByPriority(const package::FuzzyReference &fuzzyRef,
     return remotePackages;
 }
 
+std::vector<utils::error::Result<repo::RemotePackages>>
+OSTreeRepo::batchMatchRemoteByPriority(const std::vector<package::FuzzyReference> &fuzzyRefs,
+                                       std::optional<std::size_t> maxInFlight) const noexcept
+{
+    // The remote server has no batch search API, so the searches are pipelined instead of
+    // being sent one after another. They run as lanes on the ClientExecutor, which keeps the Qt
+    // event loop running on the main thread, and every lane takes the next reference until all
+    // are matched. Every reference has its own slot in results.
+    std::vector<utils::error::Result<repo::RemotePackages>> results(fuzzyRefs.size());
+    auto begin = std::chrono::steady_clock::now();
+    auto workers = std::min(std::max<std::size_t>(maxInFlight.value_or(maxInFlightRequests()), 1),
+                            fuzzyRefs.size());
+
+    // the lanes are canceled with the caller, the deadline of each search is set by
+    // matchRemoteByPriority
+    const auto *token = CancelToken::current();
+    std::atomic_size_t next{ 0 };
+    std::vector<std::function<void()>> lanes;
+    lanes.reserve(workers);
+    for (std::size_t lane = 0; lane < workers; ++lane) {
+        lanes.emplace_back([this, &fuzzyRefs, &results, &next, token]() {
+            CancelToken::Scope scope(token);
+            for (auto i = next.fetch_add(1); i < fuzzyRefs.size(); i = next.fetch_add(1)) {
+                results[i] = this->matchRemoteByPriority(fuzzyRefs[i]);
+            }
+        });
+    }
+    ClientExecutor::instance().runAll(std::move(lanes));
+
+    LogD("matched {} references from remote in {}ms with {} workers",
+         fuzzyRefs.size(),
+         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                                                               - begin)
+           .count(),
+         workers);
+
+    return results;
+}
+
 void OSTreeRepo::unexportReference(const std::string &layerDir) noexcept
 {
     QString layerDirStr = layerDir.c_str();
@@ -2193,28 +2575,44 @@ void OSTreeRepo::updateSharedInfo() noexcept
         }
     }
 
+    // the databases are independent, update them concurrently
+    std::vector<std::pair<std::string, utils::Cmd::Process>> updates;
+    auto startUpdate = [&updates](const std::string &command,
+                                  const std::vector<std::string> &args,
+                                  const std::string &target) {
+        auto process = utils::Cmd(command).start(args);
+        if (!process) {
+            LogW("failed to update {}: {}", target, process.error());
+            return;
+        }
+        updates.emplace_back(target, std::move(process).value());
+    };
+
     // 更新 desktop database
     if (!desktopDirs.empty()) {
-        auto ret = utils::Cmd("update-desktop-database").exec(desktopDirs);
-        if (!ret) {
-            LogW("failed to update desktop database in {}",
-                 common::strings::join(desktopDirs, ' '));
-        }
+        startUpdate("update-desktop-database",
+                    desktopDirs,
+                    fmt::format("desktop database in {}", common::strings::join(desktopDirs, ' ')));
     }
 
     // 更新 mime type database
     if (std::filesystem::exists(mimeDataDir, ec)) {
-        auto ret = utils::Cmd("update-mime-database").exec({ mimeDataDir });
-        if (!ret) {
-            LogW("failed to update mime type database in {}: {}", mimeDataDir, ret.error());
-        }
+        startUpdate("update-mime-database",
+                    { mimeDataDir },
+                    fmt::format("mime type database in {}", mimeDataDir));
     }
 
     // 更新 glib-2.0/schemas
     if (std::filesystem::exists(glibSchemasDir, ec)) {
-        auto ret = utils::Cmd("glib-compile-schemas").exec({ glibSchemasDir });
+        startUpdate("glib-compile-schemas",
+                    { glibSchemasDir },
+                    fmt::format("schemas in {}", glibSchemasDir));
+    }
+
+    for (auto &[target, process] : updates) {
+        auto ret = process.wait();
         if (!ret) {
-            LogW("failed to update schemas in {}: {}", glibSchemasDir, ret.error());
+            LogW("failed to update {}: {}", target, ret.error());
         }
     }
 }
@@ -2248,27 +2646,12 @@ OSTreeRepo::markDeleted(const package::Reference &ref,
         return LINGLONG_ERR(item);
     }
 
-    auto it = this->cache->findMatchingItem(*item);
-    if (!it) {
-        return LINGLONG_ERR(it);
-    }
-
-    auto originalValue = (*it)->deleted;
     std::optional<bool> deletedOpt = deleted ? std::optional<bool>(true) : std::nullopt;
-
-    utils::Transaction transaction;
-    (*it)->deleted = deletedOpt;
-    transaction.addRollBack([iterator = *it, originalValue]() noexcept {
-        iterator->deleted = originalValue;
-    });
-
-    auto result = this->cache->writeToDisk();
+    auto result = this->cache->markLayerItemDeleted(*item, deletedOpt);
     if (!result) {
         return LINGLONG_ERR(result);
     }
 
-    transaction.commit();
-
     return LINGLONG_OK;
 }
 
@@ -2643,30 +3026,61 @@ utils::error::Result<void> OSTreeRepo::mergeModules() const noexcept
         if (ec) {
             return LINGLONG_ERR("clean merge tmp dir", ec);
         }
+        // nothing is left behind when a step below fails, mergeTmp is gone after the last rename
+        auto cleanTmp = utils::finally::finally([&mergeTmp] {
+            std::error_code ec;
+            std::filesystem::remove_all(mergeTmp, ec);
+        });
+        // ADD_FILES keeps files from the first checkout, so the previous merged dir of the group
+        // can be reused when its modules are the leading modules of the new merge, e.g. a module
+        // was added. It is cloned as hard links and only the remaining modules are checked out on
+        // the clone, the previous dir is left untouched until the new one replaces it.
+        std::size_t reusedCount = 0;
+        if (mergedItems.has_value()) {
+            auto previous =
+              std::find_if(mergedItems->cbegin(), mergedItems->cend(), [&](const auto &merge) {
+                  return merge.name == it.first && merge.commits.size() < commits.size()
+                    && std::equal(merge.commits.cbegin(), merge.commits.cend(), commits.cbegin());
+              });
+            if (previous != mergedItems->cend()) {
+                auto cloned = cloneTreeAsHardLinks(mergedDir / previous->id, mergeTmp);
+                if (!cloned) {
+                    LogD("failed to reuse merged dir {}: {}",
+                         previous->id,
+                         cloned.error().message());
+                    std::filesystem::remove_all(mergeTmp, ec);
+                    if (ec) {
+                        return LINGLONG_ERR("clean merge tmp dir", ec);
+                    }
+                } else {
+                    reusedCount = previous->commits.size();
+                    LogD("reuse {} merged modules of {}", reusedCount, it.first);
+                }
+            }
+        }
         std::filesystem::create_directories(mergeTmp, ec);
         if (ec) {
             return LINGLONG_ERR("create merge tmp dir", ec);
         }
         // 将所有module文件合并到临时目录
-        for (const auto &layer : layers) {
-            LogD("merge module {} {}", it.first, layer.info.packageInfoV2Module);
+        for (auto layer = layers.cbegin() + reusedCount; layer != layers.cend(); ++layer) {
+            LogD("merge module {} {}", it.first, layer->info.packageInfoV2Module);
             int root = open("/", O_DIRECTORY);
             auto _ = utils::finally::finally([root]() {
                 close(root);
             });
             g_autoptr(GError) gErr = nullptr;
-            OstreeRepoCheckoutAtOptions opt = {};
-            opt.overwrite_mode = OSTREE_REPO_CHECKOUT_OVERWRITE_ADD_FILES;
+            auto opt = checkoutOptions(OSTREE_REPO_CHECKOUT_OVERWRITE_ADD_FILES);
             if (ostree_repo_checkout_at(this->ostreeRepo.get(),
                                         &opt,
                                         root,
                                         mergeTmp.relative_path().c_str(),
-                                        layer.commit.c_str(),
+                                        layer->commit.c_str(),
                                         nullptr,
                                         &gErr)
                 == FALSE) {
                 return LINGLONG_ERR(
-                  fmt::format("ostree_repo_checkout_at {} {}", layer.commit, ptr_view(gErr)));
+                  fmt::format("ostree_repo_checkout_at {} {}", layer->commit, ptr_view(gErr)));
             }
         }
         // 将临时目录改名到正式目录，以binary模块的commit为文件名
@@ -3067,7 +3481,8 @@ OSTreeRepo::upgradableApps() const noexcept
         return LINGLONG_ERR(appPkgs);
     }
 
-    std::vector<std::pair<package::Reference, package::ReferenceWithRepo>> upgradeList;
+    std::vector<std::reference_wrapper<const api::types::v1::PackageInfoV2>> pkgs;
+    std::vector<package::FuzzyReference> fuzzyRefs;
     for (const auto &pkg : *appPkgs) {
         auto fuzzy =
           package::FuzzyReference::create(pkg.channel,
@@ -3079,21 +3494,43 @@ OSTreeRepo::upgradableApps() const noexcept
             continue;
         }
 
-        auto remoteRef = this->latestRemoteReference(*fuzzy);
+        pkgs.emplace_back(pkg);
+        fuzzyRefs.emplace_back(std::move(fuzzy).value());
+    }
+
+    auto candidates = this->batchMatchRemoteByPriority(fuzzyRefs);
+
+    std::vector<std::pair<package::Reference, package::ReferenceWithRepo>> upgradeList;
+    for (std::size_t i = 0; i < pkgs.size(); ++i) {
+        if (!candidates[i]) {
+            LogD("Failed to find remote latest reference: {}", candidates[i].error());
+            continue;
+        }
+
+        auto latestPackage = candidates[i]->getLatestPackage();
+        if (!latestPackage) {
+            LogD("Failed to find remote latest reference: {}", latestPackage.error());
+            continue;
+        }
+
+        auto remoteRef = package::Reference::fromPackageInfo(latestPackage->second);
         if (!remoteRef) {
-            LogD("Failed to find remote latest reference: {}", remoteRef.error());
+            LogW("failed to parse remote reference: {}", remoteRef.error());
             continue;
         }
 
-        auto localRef = package::Reference::fromPackageInfo(pkg);
+        auto localRef = package::Reference::fromPackageInfo(pkgs[i].get());
         if (!localRef) {
             LogW("failed to parse local reference: {}", localRef.error());
             continue;
         }
 
-        if (remoteRef->reference.version > localRef->version) {
-            upgradeList.emplace_back(
-              std::make_pair(std::move(localRef).value(), std::move(remoteRef).value()));
+        if (remoteRef->version > localRef->version) {
+            upgradeList.emplace_back(std::move(localRef).value(),
+                                     package::ReferenceWithRepo{
+                                       .repo = latestPackage->first,
+                                       .reference = std::move(remoteRef).value(),
+                                     });
         }
     }
     return upgradeList;
@@ -27,10 +27,13 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace linglong::repo {
 
+class RemoteSearchCache;
+
 class RefMetaData
 {
 public:
@@ -94,6 +97,11 @@ public:
     [[nodiscard]] virtual std::vector<std::vector<api::types::v1::Repo>>
     getPriorityGroupedRepos() const noexcept;
     utils::error::Result<void> setConfig(const api::types::v1::RepoConfigV2 &cfg) noexcept;
+    // Whether the repo cache was changed on disk since it was loaded, a long-lived process should
+    // load the repo again then to see the changes of the package manager.
+    [[nodiscard]] bool isCacheOutdated() const noexcept;
+    // the generation of the loaded repo cache, see RepoCache::generation
+    [[nodiscard]] uint64_t cacheGeneration() const noexcept;
 
     utils::error::Result<package::LayerDir>
     importLayerDir(const package::LayerDir &dir,
@@ -112,9 +120,20 @@ public:
                  const std::string &url,
                  const package::Reference &reference,
                  const std::string &module = "binary") const noexcept;
+    // Generate a static delta from the commit of from to the commit of to, both must exist in
+    // the local repo. The summary is regenerated so that pulls can find the delta.
+    [[nodiscard]] utils::error::Result<void>
+    generateStaticDelta(const package::Reference &from,
+                        const package::Reference &to,
+                        const std::string &module = "binary") const noexcept;
     [[nodiscard]] virtual utils::error::Result<void> pull(service::Task &taskContext,
                                                           const package::ReferenceWithRepo &refRepo,
                                                           const std::string &module) noexcept;
+    // Pull the modules of many references, those from the same remote are pulled in one ostree
+    // transaction so objects shared between them are fetched only once.
+    [[nodiscard]] virtual utils::error::Result<void>
+    pullAll(service::Task &taskContext,
+            const std::vector<std::pair<package::ReferenceWithRepo, std::string>> &refs) noexcept;
 
     [[nodiscard]] virtual utils::error::Result<package::Reference> clearReferenceLocal(
       const package::FuzzyReference &fuzzyRef, bool semanticMatching = false) const noexcept;
@@ -130,6 +149,11 @@ public:
     utils::error::Result<repo::RemotePackages> virtual matchRemoteByPriority(
       const package::FuzzyReference &fuzzyRef,
       const std::optional<api::types::v1::Repo> &repo = std::nullopt) const noexcept;
+    // Match many references concurrently with at most maxInFlight requests at the same time,
+    // LINGLONG_MAX_INFLIGHT_REQUESTS or 8 by default. Results are in the order of fuzzyRefs.
+    std::vector<utils::error::Result<repo::RemotePackages>> batchMatchRemoteByPriority(
+      const std::vector<package::FuzzyReference> &fuzzyRefs,
+      std::optional<std::size_t> maxInFlight = std::nullopt) const noexcept;
 
     utils::error::Result<std::vector<api::types::v1::RepositoryCacheLayersItem>>
     listLayerItem() const noexcept;
@@ -225,6 +249,8 @@ private:
     std::unique_ptr<OstreeRepo, OstreeRepoDeleter> ostreeRepo = nullptr;
     std::filesystem::path repoDir;
     std::unique_ptr<linglong::repo::RepoCache> cache{ nullptr };
+    // shared with the background revalidations which may outlive the repo
+    std::shared_ptr<linglong::repo::RemoteSearchCache> searchCache;
 
     utils::error::Result<void> updateConfig(const api::types::v1::RepoConfigV2 &newCfg) noexcept;
     std::filesystem::path ostreeRepoDir() const noexcept;
@@ -259,7 +285,12 @@ private:
     utils::error::Result<void> exportAllEntries() noexcept;
     utils::error::Result<std::vector<guint64>> getCommitSize(const std::string &remote,
                                                              const std::string &refString) noexcept;
-    GVariantBuilder initOStreePullOptions(const std::string &ref) noexcept;
+    GVariantBuilder initOStreePullOptions(const std::vector<std::string> &refs,
+                                          bool staticDeltas = false) noexcept;
+    // register the layer of a ref pulled from repoName in the repo cache
+    utils::error::Result<void> deployPulledRef(const std::string &repoName,
+                                               const std::string &refString,
+                                               GCancellable *cancellable) noexcept;
 
 protected:
     OSTreeRepo(std::filesystem::path path, api::types::v1::RepoConfigV2 cfg) noexcept;
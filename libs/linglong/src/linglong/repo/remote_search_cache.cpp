@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "remote_search_cache.h"
+
+#include "linglong/api/types/v1/Generators.hpp" // IWYU pragma: keep
+#include "linglong/utils/file.h"
+#include "linglong/utils/log/log.h"
+#include "linglong/utils/sha256.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace linglong::repo {
+
+namespace {
+
+nlohmann::json keyToJson(const RemoteSearchCache::Key &key)
+{
+    return nlohmann::json{
+        { "repoName", key.repoName }, { "repoUrl", key.repoUrl }, { "id", key.id },
+        { "channel", key.channel },   { "version", key.version }, { "arch", key.arch },
+    };
+}
+
+int64_t nowInSeconds() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+std::chrono::seconds RemoteSearchCache::defaultTTL() noexcept
+{
+    constexpr std::chrono::seconds ttl{ 300 };
+
+    auto *env = ::getenv("LINGLONG_SEARCH_CACHE_TTL");
+    if (env == nullptr) {
+        return ttl;
+    }
+
+    try {
+        auto value = std::stoi(env);
+        if (value >= 0) {
+            return std::chrono::seconds(value);
+        }
+        LogW("invalid LINGLONG_SEARCH_CACHE_TTL[{}], must not be negative", env);
+    } catch (std::invalid_argument &e) {
+        LogW("failed to parse LINGLONG_SEARCH_CACHE_TTL[{}]: {}", env, e.what());
+    } catch (std::out_of_range &e) {
+        LogW("failed to parse LINGLONG_SEARCH_CACHE_TTL[{}]: {}", env, e.what());
+    }
+
+    return ttl;
+}
+
+RemoteSearchCache::RemoteSearchCache(std::filesystem::path dir, std::chrono::seconds ttl) noexcept
+    : dir(std::move(dir))
+    , ttl(ttl)
+{
+}
+
+bool RemoteSearchCache::enabled() const noexcept
+{
+    return !dir.empty() && ttl.count() > 0;
+}
+
+std::filesystem::path RemoteSearchCache::entryFile(const Key &key) const noexcept
+{
+    return dir / (digest::sha256Hex(keyToJson(key).dump()) + ".json");
+}
+
+std::optional<RemoteSearchCache::Entry> RemoteSearchCache::lookup(const Key &key) const noexcept
+{
+    if (!enabled()) {
+        return std::nullopt;
+    }
+
+    auto file = entryFile(key);
+    std::ifstream stream(file);
+    if (!stream.is_open()) {
+        return std::nullopt;
+    }
+
+    try {
+        auto json = nlohmann::json::parse(stream);
+        // guard against hash collisions
+        if (json.at("key") != keyToJson(key)) {
+            return std::nullopt;
+        }
+
+        auto age = std::chrono::seconds(nowInSeconds() - json.at("fetchedAt").get<int64_t>());
+        if (age >= ttl * 2) {
+            return std::nullopt;
+        }
+
+        return Entry{
+            .packages = json.at("packages").get<std::vector<api::types::v1::PackageInfoV2>>(),
+            // an entry from the future means the clock has been changed, revalidate it
+            .stale = age >= ttl || age.count() < 0,
+        };
+    } catch (const std::exception &e) {
+        LogD("ignore invalid search cache {}: {}", file, e.what());
+    }
+
+    return std::nullopt;
+}
+
+void RemoteSearchCache::store(const Key &key,
+                              const std::vector<api::types::v1::PackageInfoV2> &packages) noexcept
+{
+    if (!enabled()) {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        LogD("failed to create search cache directory {}: {}", dir, ec.message());
+        return;
+    }
+
+    std::string content;
+    try {
+        content = nlohmann::json{
+            { "key", keyToJson(key) },
+            { "fetchedAt", nowInSeconds() },
+            { "packages", packages },
+        }.dump();
+    } catch (const std::exception &e) {
+        LogD("failed to serialize search cache: {}", e.what());
+        return;
+    }
+
+    // entries may be written by several threads or processes
+    auto ret = utils::replaceFile(entryFile(key), content);
+    if (!ret) {
+        LogD("failed to write search cache: {}", ret.error());
+    }
+}
+
+void RemoteSearchCache::clear() noexcept
+{
+    if (dir.empty()) {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    if (ec) {
+        LogW("failed to clear search cache {}: {}", dir, ec.message());
+    }
+}
+
+bool RemoteSearchCache::beginRevalidate(const Key &key) noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return revalidating.emplace(entryFile(key).filename().string()).second;
+}
+
+void RemoteSearchCache::endRevalidate(const Key &key) noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    revalidating.erase(entryFile(key).filename().string());
+}
+
+} // namespace linglong::repo
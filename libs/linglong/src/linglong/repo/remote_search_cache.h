@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/api/types/v1/PackageInfoV2.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace linglong::repo {
+
+// RemoteSearchCache keeps the responses of remote fuzzy searches on disk, one JSON file per
+// query. An entry is fresh within ttl, after that it is stale for another ttl: it's still
+// returned but should be revalidated by the caller. Older entries are ignored.
+//
+// The cache is best effort, failures of reading or writing entries are only logged.
+class RemoteSearchCache
+{
+public:
+    struct Key
+    {
+        std::string repoName;
+        std::string repoUrl;
+        std::string id;
+        std::string channel;
+        std::string version;
+        std::string arch;
+    };
+
+    struct Entry
+    {
+        std::vector<api::types::v1::PackageInfoV2> packages;
+        bool stale{ false };
+    };
+
+    // the ttl is LINGLONG_SEARCH_CACHE_TTL seconds or 5 minutes by default, 0 disables the cache
+    static std::chrono::seconds defaultTTL() noexcept;
+
+    explicit RemoteSearchCache(std::filesystem::path dir,
+                               std::chrono::seconds ttl = defaultTTL()) noexcept;
+
+    [[nodiscard]] std::optional<Entry> lookup(const Key &key) const noexcept;
+    void store(const Key &key, const std::vector<api::types::v1::PackageInfoV2> &packages) noexcept;
+    void clear() noexcept;
+
+    // returns false if the key is being revalidated already
+    bool beginRevalidate(const Key &key) noexcept;
+    void endRevalidate(const Key &key) noexcept;
+
+private:
+    [[nodiscard]] bool enabled() const noexcept;
+    [[nodiscard]] std::filesystem::path entryFile(const Key &key) const noexcept;
+
+    std::filesystem::path dir;
+    std::chrono::seconds ttl;
+    std::mutex mutex;
+    std::unordered_set<std::string> revalidating;
+};
+
+} // namespace linglong::repo
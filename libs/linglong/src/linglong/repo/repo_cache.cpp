@@ -9,15 +9,63 @@
 #include "configure.h"
 #include "linglong/common/formatter.h"
 #include "linglong/package/version.h"
+#include "linglong/repo/repo_cache_image.h"
 #include "linglong/utils/log/log.h"
+#include "linglong/utils/parallel.h"
 #include "linglong/utils/serialize/json.h"
 #include "linglong/utils/serialize/packageinfo_handler.h"
+#include "linglong/utils/unique_fd.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace linglong::repo {
 
+namespace {
+
+// visit the value of the given key, or all values if the key is not specified
+template <typename Map, typename Fn>
+void forEachMatched(const Map &map, const std::optional<std::string> &key, Fn &&fn) noexcept
+{
+    if (key) {
+        auto it = map.find(key.value());
+        if (it != map.end()) {
+            fn(it->second);
+        }
+        return;
+    }
+
+    for (const auto &[key, value] : map) {
+        fn(value);
+    }
+}
+
+// fsync a file or directory by its path
+utils::error::Result<void> syncPath(const std::filesystem::path &path) noexcept
+{
+    LINGLONG_TRACE(fmt::format("sync {}", path));
+
+    utils::fd::UniqueFd fd{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+    if (!fd) {
+        return LINGLONG_ERR("failed to open", errno);
+    }
+
+    if (::fsync(fd.get()) == -1) {
+        return LINGLONG_ERR("failed to sync", errno);
+    }
+
+    return LINGLONG_OK;
+}
+
+} // namespace
+
 RepoCache::RepoCache(std::filesystem::path cacheFile)
     : cacheFile(std::move(cacheFile))
 {
@@ -25,10 +73,35 @@ RepoCache::RepoCache(std::filesystem::path cacheFile)
     this->cache.version = cacheFileVersion;
 }
 
+RepoCache::~RepoCache() = default;
+
 utils::error::Result<void> RepoCache::load()
 {
     LINGLONG_TRACE("load repo cache");
 
+    auto stamp = RepoCacheImage::currentStamp(this->cacheFile, journalFile());
+    this->loadedStamp = stamp ? std::make_optional(*stamp) : std::nullopt;
+
+    this->image.reset();
+    auto imageRet = this->loadImage();
+    if (imageRet) {
+        return LINGLONG_OK;
+    }
+    LogD("fallback to load {}: {}", this->cacheFile.string(), imageRet.error());
+
+    auto ret = this->loadSnapshot();
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+
+    return LINGLONG_OK;
+}
+
+utils::error::Result<void> RepoCache::loadSnapshot() noexcept
+{
+    LINGLONG_TRACE(fmt::format("load {} and its journal", this->cacheFile));
+
+    this->image.reset();
     std::error_code ec;
     if (!std::filesystem::exists(this->cacheFile, ec)) {
         if (ec) {
@@ -49,18 +122,43 @@ utils::error::Result<void> RepoCache::load()
                       cacheFileVersion));
     }
     this->cache = std::move(result).value();
+    this->rebuildIndex();
+
+    auto ret = this->replayJournal();
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
 
     return LINGLONG_OK;
 }
 
+bool RepoCache::isOutdated() const noexcept
+{
+    auto stamp = RepoCacheImage::currentStamp(this->cacheFile, journalFile());
+    return !stamp || !this->loadedStamp || !(*stamp == *this->loadedStamp);
+}
+
+uint64_t RepoCache::generation() const noexcept
+{
+    return static_cast<uint64_t>(this->cache.generation.value_or(0));
+}
+
 utils::error::Result<void> RepoCache::rebuild(const api::types::v1::RepoConfigV2 &repoConfig,
                                               OstreeRepo &repo) noexcept
 {
     LINGLONG_TRACE("rebuild repo cache");
 
+    this->image.reset();
     this->cache.config = repoConfig;
     this->cache.layers.clear();
 
+    // the cache may be rebuilt because it's lost, continue from the current time in that case
+    // so the generations of the lost cache are never reused
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+    this->cache.generation = std::max<int64_t>(static_cast<int64_t>(this->generation()) + 1, now);
+
     g_autoptr(GHashTable) refsTable = nullptr;
     g_autoptr(GError) gErr = nullptr;
     std::vector<std::string_view> refs;
@@ -80,11 +178,15 @@ utils::error::Result<void> RepoCache::rebuild(const api::types::v1::RepoConfigV2
       },
       &refs);
 
-    for (auto ref : refs) {
+    // sort refs to make the order of layers deterministic, the hash table is unordered
+    std::sort(refs.begin(), refs.end());
+
+    auto loadRef = [&repo](std::string_view ref)
+      -> std::optional<api::types::v1::RepositoryCacheLayersItem> {
         auto pos = ref.find(':');
         if (pos == std::string::npos) {
             LogW("invalid ref: {}", ref.data());
-            continue;
+            return std::nullopt;
         }
 
         api::types::v1::RepositoryCacheLayersItem item;
@@ -95,7 +197,7 @@ utils::error::Result<void> RepoCache::rebuild(const api::types::v1::RepoConfigV2
         g_autoptr(GFile) root{ nullptr };
         if (ostree_repo_read_commit(&repo, ref.data(), &root, &commit, nullptr, &gErr) == FALSE) {
             LogW("ostree_repo_read_commit failed: {}", ptr_view(gErr));
-            continue;
+            return std::nullopt;
         }
         item.commit = commit;
 
@@ -105,18 +207,46 @@ utils::error::Result<void> RepoCache::rebuild(const api::types::v1::RepoConfigV2
         g_autofree gchar *content = nullptr;
         if (!g_file_load_contents(infoFile, nullptr, &content, nullptr, nullptr, &gErr)) {
             LogE("skip broken ref {}, failed to load info.json: {}", ref, ptr_view(gErr));
-            continue;
+            return std::nullopt;
         }
         auto info = utils::serialize::parsePackageInfo(content);
         if (!info) {
             LogW("invalid info.json on ref {}: {}", ref, info.error());
-            continue;
+            return std::nullopt;
         }
 
         item.info = std::move(info).value();
-        this->cache.layers.emplace_back(std::move(item));
+        return item;
+    };
+
+    // reading commits and parsing info.json are independent for each ref, fan them out over a
+    // bounded set of workers. every worker writes to its own slot, so the result keeps the order
+    // of refs.
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::optional<api::types::v1::RepositoryCacheLayersItem>> items(refs.size());
+    auto workers = utils::parallelFor(
+      refs.size(),
+      std::min<std::size_t>(std::thread::hardware_concurrency(), rebuildMaxWorkers),
+      [&](std::size_t i) noexcept {
+          items[i] = loadRef(refs[i]);
+      });
+
+    for (auto &item : items) {
+        if (item) {
+            this->cache.layers.emplace_back(std::move(item).value());
+        }
     }
 
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - begin);
+    LogI("rebuilt repo cache: {} layers from {} refs in {}ms with {} workers",
+         this->cache.layers.size(),
+         refs.size(),
+         elapsed.count(),
+         workers);
+
+    this->rebuildIndex();
+
     auto ret = writeToDisk();
     if (!ret) {
         return LINGLONG_ERR(ret);
@@ -130,14 +260,20 @@ RepoCache::addLayerItem(const api::types::v1::RepositoryCacheLayersItem &item)
 {
     LINGLONG_TRACE("add layer item");
 
+    auto materialized = this->materialize();
+    if (!materialized) {
+        return LINGLONG_ERR(materialized);
+    }
     auto it = findMatchingItem(item);
     if (it) {
         Q_ASSERT(false);
         return LINGLONG_ERR("item already exist");
     }
 
-    cache.layers.emplace_back(item);
-    auto ret = writeToDisk();
+    nlohmann::json record{ { "op", "add" },
+                           { "item", item },
+                           { "generation", this->generation() + 1 } };
+    auto ret = commitRecord(record);
     if (!ret) {
         return LINGLONG_ERR(ret);
     }
@@ -149,22 +285,41 @@ utils::error::Result<std::vector<api::types::v1::RepositoryCacheLayersItem>::ite
 RepoCache::findMatchingItem(const api::types::v1::RepositoryCacheLayersItem &item) noexcept
 {
     LINGLONG_TRACE("find matching item");
-    auto it = std::find_if(
-      cache.layers.begin(),
-      cache.layers.end(),
-      [&item](const api::types::v1::RepositoryCacheLayersItem &val) {
-          return !(item.commit != val.commit || item.repo != val.repo
-                   || item.info.channel != val.info.channel || item.info.id != val.info.id
-                   || item.info.version != val.info.version
-                   || item.info.arch.front() != val.info.arch.front()
-                   || item.info.packageInfoV2Module != val.info.packageInfoV2Module);
-      });
 
-    if (it == cache.layers.end()) {
+    auto materialized = this->materialize();
+    if (!materialized) {
+        return LINGLONG_ERR(materialized);
+    }
+
+    const std::vector<IndexedLayer> *bucket{ nullptr };
+    if (auto idIt = index.find(item.info.id); idIt != index.end()) {
+        const auto &channels = idIt->second;
+        if (auto channelIt = channels.find(item.info.channel); channelIt != channels.end()) {
+            const auto &arches = channelIt->second;
+            if (auto archIt = arches.find(item.info.arch.front()); archIt != arches.end()) {
+                const auto &modules = archIt->second;
+                if (auto moduleIt = modules.find(item.info.packageInfoV2Module);
+                    moduleIt != modules.end()) {
+                    bucket = &moduleIt->second;
+                }
+            }
+        }
+    }
+
+    if (bucket == nullptr) {
         return LINGLONG_ERR("item doesn't exist");
     }
 
-    return it;
+    auto entry = std::find_if(bucket->cbegin(), bucket->cend(), [&](const IndexedLayer &entry) {
+        const auto &val = cache.layers[entry.pos];
+        return item.commit == val.commit && item.repo == val.repo
+          && item.info.version == val.info.version;
+    });
+    if (entry == bucket->cend()) {
+        return LINGLONG_ERR("item doesn't exist");
+    }
+
+    return cache.layers.begin() + static_cast<std::ptrdiff_t>(entry->pos);
 }
 
 utils::error::Result<void>
@@ -178,8 +333,33 @@ RepoCache::deleteLayerItem(const api::types::v1::RepositoryCacheLayersItem &item
         return LINGLONG_ERR(it);
     }
 
-    cache.layers.erase(*it);
-    auto ret = writeToDisk();
+    nlohmann::json record{ { "op", "delete" },
+                           { "item", item },
+                           { "generation", this->generation() + 1 } };
+    auto ret = commitRecord(record);
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+
+    return LINGLONG_OK;
+}
+
+utils::error::Result<void>
+RepoCache::markLayerItemDeleted(const api::types::v1::RepositoryCacheLayersItem &item,
+                                std::optional<bool> deleted) noexcept
+{
+    LINGLONG_TRACE("mark layer item deleted");
+
+    auto it = findMatchingItem(item);
+    if (!it) {
+        return LINGLONG_ERR(it);
+    }
+
+    nlohmann::json record{ { "op", "mark-deleted" },
+                           { "item", item },
+                           { "generation", this->generation() + 1 } };
+    record["deleted"] = deleted ? nlohmann::json(*deleted) : nlohmann::json(nullptr);
+    auto ret = commitRecord(record);
     if (!ret) {
         return LINGLONG_ERR(ret);
     }
@@ -191,6 +371,21 @@ std::vector<api::types::v1::RepositoryCacheLayersItem>
 RepoCache::queryExistingLayerItem() const noexcept
 {
     auto layers = this->cache.layers;
+    if (this->image) {
+        auto ret = this->image->layers();
+        if (!ret) {
+            LogW("repo cache image is broken, list layers from {}: {}",
+                 this->cacheFile,
+                 ret.error());
+            RepoCache snapshot(this->cacheFile);
+            if (auto loaded = snapshot.loadSnapshot(); !loaded) {
+                LogW("failed to load repo cache: {}", loaded.error());
+                return {};
+            }
+            return snapshot.queryExistingLayerItem();
+        }
+        layers = std::move(ret).value();
+    }
     auto it = std::remove_if(layers.begin(),
                              layers.end(),
                              [](const api::types::v1::RepositoryCacheLayersItem &item) {
@@ -201,89 +396,539 @@ RepoCache::queryExistingLayerItem() const noexcept
     return layers;
 }
 
+bool RepoCache::matchQuery(const api::types::v1::RepositoryCacheLayersItem &layer,
+                           const repoCacheQuery &query) const noexcept
+{
+    if (query.id && query.id.value() != layer.info.id) {
+        return false;
+    }
+
+    if (query.repo && query.repo.value() != layer.repo) {
+        return false;
+    }
+
+    if (query.channel && query.channel.value() != layer.info.channel) {
+        return false;
+    }
+
+    if (query.version && query.version.value() != layer.info.version) {
+        return false;
+    }
+
+    if (query.module && query.module.value() != layer.info.packageInfoV2Module) {
+        return false;
+    }
+
+    if (query.architecture && query.architecture.value() != layer.info.arch.front()) {
+        return false;
+    }
+
+    if (query.deleted) {
+        auto layerDeleted = layer.deleted.value_or(false);
+        if (query.deleted.value() != layerDeleted) {
+            return false;
+        }
+    }
+
+    if (query.uuid) {
+        if (!layer.info.uuid) {
+            return false;
+        }
+
+        if (query.uuid.value() != layer.info.uuid.value()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 std::vector<api::types::v1::RepositoryCacheLayersItem>
 RepoCache::queryLayerItem(const repoCacheQuery &query) const noexcept
 {
-    using itemRef = std::reference_wrapper<const api::types::v1::RepositoryCacheLayersItem>;
-    std::vector<itemRef> layers_view;
-    for (const auto &layer : cache.layers) {
-        if (query.id && query.id.value() != layer.info.id) {
-            continue;
+    if (this->image) {
+        auto ret = this->image->query(query);
+        if (ret) {
+            return std::move(ret).value();
         }
+        LogW("repo cache image is broken, query {}: {}", this->cacheFile, ret.error());
+        RepoCache snapshot(this->cacheFile);
+        if (auto loaded = snapshot.loadSnapshot(); !loaded) {
+            LogW("failed to load repo cache: {}", loaded.error());
+            return {};
+        }
+        return snapshot.queryLayerItem(query);
+    }
+
+    std::vector<const IndexedLayer *> matched;
+    std::size_t buckets{ 0 };
+
+    forEachMatched(index, query.id, [&](const ChannelIndex &channels) {
+        forEachMatched(channels, query.channel, [&](const ArchIndex &arches) {
+            forEachMatched(arches, query.architecture, [&](const ModuleIndex &modules) {
+                forEachMatched(modules, query.module, [&](const std::vector<IndexedLayer> &layers) {
+                    ++buckets;
+                    for (const auto &entry : layers) {
+                        if (matchQuery(cache.layers[entry.pos], query)) {
+                            matched.emplace_back(&entry);
+                        }
+                    }
+                });
+            });
+        });
+    });
+
+    // every bucket is already sorted, only merge them when the query spans multiple buckets
+    if (buckets > 1) {
+        std::sort(matched.begin(),
+                  matched.end(),
+                  [](const IndexedLayer *lhs, const IndexedLayer *rhs) {
+                      return isNewerThan(*lhs, *rhs);
+                  });
+    }
+
+    std::vector<api::types::v1::RepositoryCacheLayersItem> layers;
+    layers.reserve(matched.size());
+    for (const auto *entry : matched) {
+        layers.emplace_back(cache.layers[entry->pos]);
+    }
+
+    return layers;
+}
+
+bool RepoCache::isNewerThan(const IndexedLayer &lhs, const IndexedLayer &rhs) noexcept
+{
+    // layers with invalid version are placed at the end
+    if (lhs.version.has_value() != rhs.version.has_value()) {
+        return lhs.version.has_value();
+    }
 
-        if (query.repo && query.repo.value() != layer.repo) {
-            continue;
+    if (lhs.version && rhs.version) {
+        if (*lhs.version > *rhs.version) {
+            return true;
         }
+        if (*rhs.version > *lhs.version) {
+            return false;
+        }
+    }
+
+    // keep the order of cache.layers for the same version
+    return lhs.pos < rhs.pos;
+}
+
+void RepoCache::rebuildIndex() noexcept
+{
+    index.clear();
+    for (std::size_t pos = 0; pos < cache.layers.size(); ++pos) {
+        indexLayer(pos);
+    }
+}
 
-        if (query.channel && query.channel.value() != layer.info.channel) {
-            continue;
+void RepoCache::indexLayer(std::size_t pos) noexcept
+{
+    const auto &layer = cache.layers[pos];
+    if (layer.info.arch.empty()) {
+        LogW("skip indexing layer {} without architecture", layer.info.id);
+        return;
+    }
+
+    IndexedLayer entry{ .version = std::nullopt, .pos = pos };
+    auto version = package::Version::parse(layer.info.version);
+    if (version) {
+        entry.version = std::move(version).value();
+    } else {
+        LogW("failed to parse version {} of layer {}: {}",
+             layer.info.version,
+             layer.info.id,
+             version.error());
+    }
+
+    auto &bucket = index[layer.info.id][layer.info.channel][layer.info.arch.front()]
+                        [layer.info.packageInfoV2Module];
+    auto it = std::upper_bound(bucket.begin(), bucket.end(), entry, isNewerThan);
+    bucket.insert(it, std::move(entry));
+}
+
+void RepoCache::unindexLayer(std::size_t pos) noexcept
+{
+    const auto &layer = cache.layers[pos];
+    if (!layer.info.arch.empty()) {
+        auto &bucket = index[layer.info.id][layer.info.channel][layer.info.arch.front()]
+                            [layer.info.packageInfoV2Module];
+        bucket.erase(std::remove_if(bucket.begin(),
+                                    bucket.end(),
+                                    [pos](const IndexedLayer &entry) {
+                                        return entry.pos == pos;
+                                    }),
+                     bucket.end());
+    }
+
+    // the layers after pos will be moved forward by erasing it from cache.layers,
+    // the relative order of them is not changed so the buckets are still sorted
+    for (auto &[id, channels] : index) {
+        for (auto &[channel, arches] : channels) {
+            for (auto &[arch, modules] : arches) {
+                for (auto &[module, bucket] : modules) {
+                    for (auto &entry : bucket) {
+                        if (entry.pos > pos) {
+                            --entry.pos;
+                        }
+                    }
+                }
+            }
         }
+    }
+}
+
+utils::error::Result<void> RepoCache::updateMergedItems(
+  const std::vector<api::types::v1::RepositoryCacheMergedItem> &items) noexcept
+{
+    LINGLONG_TRACE("update merged items");
+
+    auto materialized = this->materialize();
+    if (!materialized) {
+        return LINGLONG_ERR(materialized);
+    }
+    nlohmann::json record{ { "op", "merge" },
+                           { "items", items },
+                           { "generation", this->generation() + 1 } };
+    auto ret = commitRecord(record);
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+    return LINGLONG_OK;
+};
+
+std::filesystem::path RepoCache::journalFile() const noexcept
+{
+    auto journal = this->cacheFile;
+    journal += ".journal";
+    return journal;
+}
+
+std::filesystem::path RepoCache::imageFile() const noexcept
+{
+    return this->cacheFile.parent_path() / (this->cacheFile.stem().string() + ".bin");
+}
+
+utils::error::Result<void> RepoCache::loadImage() noexcept
+{
+    LINGLONG_TRACE("load repo cache image");
+
+    auto stamp = RepoCacheImage::currentStamp(this->cacheFile, journalFile());
+    if (!stamp) {
+        return LINGLONG_ERR(stamp);
+    }
 
-        if (query.version && query.version.value() != layer.info.version) {
-            continue;
+    auto image = RepoCacheImage::open(imageFile(), *stamp);
+    if (!image) {
+        return LINGLONG_ERR(image);
+    }
+
+    if ((*image)->version() != cacheFileVersion) {
+        return LINGLONG_ERR(fmt::format("image version mismatch: image version {}, expected {}",
+                                        (*image)->version(),
+                                        cacheFileVersion));
+    }
+
+    auto config = (*image)->config();
+    if (!config) {
+        return LINGLONG_ERR(config);
+    }
+
+    auto merged = (*image)->merged();
+    if (!merged) {
+        return LINGLONG_ERR(merged);
+    }
+
+    this->cache.version = (*image)->version();
+    this->cache.llVersion = (*image)->llVersion();
+    this->cache.config = std::move(config).value();
+    this->cache.merged = std::move(merged).value();
+    this->cache.generation = static_cast<int64_t>((*image)->generation());
+    this->cache.layers.clear();
+    this->index.clear();
+    this->journalRecords = (*image)->journalRecords();
+    this->journalBroken = false;
+    this->image = std::move(image).value();
+
+    return LINGLONG_OK;
+}
+
+void RepoCache::writeImage() noexcept
+{
+    // the rank of a layer is its position in the whole cache sorted by version,
+    // layers which are not indexed are placed at the end
+    std::vector<uint32_t> ranks(cache.layers.size(), static_cast<uint32_t>(cache.layers.size()));
+    std::vector<const IndexedLayer *> sorted;
+    sorted.reserve(cache.layers.size());
+    for (const auto &[id, channels] : index) {
+        for (const auto &[channel, arches] : channels) {
+            for (const auto &[arch, modules] : arches) {
+                for (const auto &[module, bucket] : modules) {
+                    for (const auto &entry : bucket) {
+                        sorted.emplace_back(&entry);
+                    }
+                }
+            }
         }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const IndexedLayer *lhs, const IndexedLayer *rhs) {
+        return isNewerThan(*lhs, *rhs);
+    });
+    for (std::size_t rank = 0; rank < sorted.size(); ++rank) {
+        ranks[sorted[rank]->pos] = static_cast<uint32_t>(rank);
+    }
 
-        if (query.module && query.module.value() != layer.info.packageInfoV2Module) {
-            continue;
+    // the image is optional, readers will fallback to states.json if it's out of date
+    auto stamp = RepoCacheImage::currentStamp(this->cacheFile, journalFile());
+    if (!stamp) {
+        LogW("failed to get stamp of repo cache: {}", stamp.error());
+        return;
+    }
+
+    auto ret = RepoCacheImage::write(imageFile(),
+                                     this->cache,
+                                     ranks,
+                                     *stamp,
+                                     static_cast<uint32_t>(this->journalRecords));
+    if (!ret) {
+        LogW("failed to write repo cache image: {}", ret.error());
+    }
+}
+
+utils::error::Result<void> RepoCache::materialize() noexcept
+{
+    LINGLONG_TRACE("materialize repo cache");
+
+    if (!this->image) {
+        return LINGLONG_OK;
+    }
+
+    // the layers are written back to states.json by the next compaction, a broken image must not
+    // drop any of them
+    auto layers = this->image->layers();
+    if (!layers) {
+        LogW("repo cache image is broken, reload {}: {}", this->cacheFile, layers.error());
+        auto ret = this->loadSnapshot();
+        if (!ret) {
+            return LINGLONG_ERR(ret);
         }
+        return LINGLONG_OK;
+    }
+
+    this->cache.layers = std::move(layers).value();
+    this->image.reset();
+    this->rebuildIndex();
+    return LINGLONG_OK;
+}
+
+utils::error::Result<void> RepoCache::applyJournalRecord(const nlohmann::json &record) noexcept
+{
+    LINGLONG_TRACE("apply journal record");
 
-        if (query.architecture && query.architecture.value() != layer.info.arch.front()) {
-            continue;
+    // records are applied idempotently, the journal may be replayed on a snapshot which already
+    // contains some of them if the process was interrupted during compaction
+    std::string op;
+    try {
+        // records written by old versions have no generation
+        auto generation = this->generation() + 1;
+        if (auto it = record.find("generation"); it != record.end()) {
+            generation = std::max(this->generation(), it->get<uint64_t>());
         }
+        cache.generation = static_cast<int64_t>(generation);
 
-        if (query.deleted) {
-            auto layerDeleted = layer.deleted.value_or(false);
-            if (query.deleted.value() != layerDeleted) {
-                continue;
+        op = record.at("op").get<std::string>();
+        if (op == "add") {
+            auto item = record.at("item").get<api::types::v1::RepositoryCacheLayersItem>();
+            if (findMatchingItem(item)) {
+                return LINGLONG_OK;
             }
+
+            cache.layers.emplace_back(std::move(item));
+            this->indexLayer(cache.layers.size() - 1);
+            return LINGLONG_OK;
         }
 
-        if (query.uuid) {
-            if (!layer.info.uuid) {
-                continue;
+        if (op == "delete") {
+            auto item = record.at("item").get<api::types::v1::RepositoryCacheLayersItem>();
+            auto it = findMatchingItem(item);
+            if (!it) {
+                return LINGLONG_OK;
             }
 
-            if (query.uuid.value() != layer.info.uuid.value()) {
-                continue;
-            }
+            auto pos = static_cast<std::size_t>(std::distance(cache.layers.begin(), *it));
+            this->unindexLayer(pos);
+            cache.layers.erase(*it);
+            return LINGLONG_OK;
         }
 
-        layers_view.emplace_back(layer);
-    }
+        if (op == "mark-deleted") {
+            auto item = record.at("item").get<api::types::v1::RepositoryCacheLayersItem>();
+            auto it = findMatchingItem(item);
+            if (!it) {
+                return LINGLONG_OK;
+            }
 
-    std::sort(layers_view.begin(), layers_view.end(), [](itemRef lhs, itemRef rhs) {
-        auto lhsVersion = linglong::package::Version::parse(lhs.get().info.version.c_str());
-        if (!lhsVersion) {
-            LogE("Failed to parse lhs version: {}", lhs.get().info.version);
-            return false;
+            const auto &deleted = record.at("deleted");
+            (*it)->deleted =
+              deleted.is_null() ? std::nullopt : std::optional<bool>(deleted.get<bool>());
+            return LINGLONG_OK;
         }
-        auto rhsVersion = linglong::package::Version::parse(rhs.get().info.version.c_str());
-        if (!rhsVersion) {
-            LogE("Failed to parse rhs version: {}", rhs.get().info.version);
-            return false;
+
+        if (op == "merge") {
+            cache.merged =
+              record.at("items").get<std::vector<api::types::v1::RepositoryCacheMergedItem>>();
+            return LINGLONG_OK;
         }
-        return *lhsVersion > *rhsVersion;
-    });
+    } catch (const std::exception &e) {
+        return LINGLONG_ERR("invalid journal record", e);
+    }
 
-    return { layers_view.cbegin(), layers_view.cend() };
+    return LINGLONG_ERR(fmt::format("unknown journal operation {}", op));
 }
 
-utils::error::Result<void> RepoCache::updateMergedItems(
-  const std::vector<api::types::v1::RepositoryCacheMergedItem> &items) noexcept
+utils::error::Result<void> RepoCache::commitRecord(const nlohmann::json &record) noexcept
 {
-    LINGLONG_TRACE("update merged items");
-    cache.merged = items;
-    auto ret = writeToDisk();
+    LINGLONG_TRACE("commit repo cache record");
+
+    // the record is applied only once it's persisted, the cache in memory always matches the disk
+    std::error_code ec;
+    if (!this->journalBroken && this->journalRecords < journalCompactThreshold
+        && std::filesystem::exists(this->cacheFile, ec)) {
+        auto ret = appendJournal(record);
+        if (ret) {
+            ++this->journalRecords;
+            // the image is left outdated, it's rewritten by the next compaction. readers see the
+            // journal has grown and fall back to states.json with the journal until then
+            ret = applyJournalRecord(record);
+            if (!ret) {
+                return LINGLONG_ERR(ret);
+            }
+            return LINGLONG_OK;
+        }
+
+        // the journal may end with a part of the record now
+        LogW("fallback to write the whole cache: {}", ret.error());
+        this->journalBroken = true;
+    }
+
+    // compact the journal into the snapshot together with the record
+    auto backup = this->cache;
+    auto ret = applyJournalRecord(record);
+    if (ret) {
+        ret = writeToDisk();
+    }
     if (!ret) {
+        this->cache = std::move(backup);
+        this->rebuildIndex();
         return LINGLONG_ERR(ret);
     }
+
     return LINGLONG_OK;
-};
+}
+
+utils::error::Result<void> RepoCache::appendJournal(const nlohmann::json &record) noexcept
+{
+    LINGLONG_TRACE("append repo cache journal");
+
+    auto journal = journalFile();
+    std::error_code ec;
+    auto created = !std::filesystem::exists(journal, ec);
+    utils::fd::UniqueFd fd{ ::open(journal.c_str(),
+                                   O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                                   0644) };
+    if (!fd) {
+        return LINGLONG_ERR(fmt::format("failed to open journal {}", journal), errno);
+    }
+
+    // one record per line, a record without trailing newline is treated as a torn write
+    auto line = record.dump() + '\n';
+    std::string_view remaining = line;
+    while (!remaining.empty()) {
+        auto written = ::write(fd.get(), remaining.data(), remaining.size());
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return LINGLONG_ERR(fmt::format("failed to append journal {}", journal), errno);
+        }
+        remaining.remove_prefix(static_cast<std::size_t>(written));
+    }
+
+    if (::fdatasync(fd.get()) == -1) {
+        return LINGLONG_ERR(fmt::format("failed to sync journal {}", journal), errno);
+    }
+
+    if (created) {
+        auto ret = syncPath(journal.parent_path());
+        if (!ret) {
+            return LINGLONG_ERR(ret);
+        }
+    }
+
+    return LINGLONG_OK;
+}
+
+utils::error::Result<void> RepoCache::replayJournal() noexcept
+{
+    LINGLONG_TRACE("replay repo cache journal");
+
+    this->journalRecords = 0;
+    this->journalBroken = false;
+
+    auto journal = journalFile();
+    std::error_code ec;
+    if (!std::filesystem::exists(journal, ec)) {
+        if (ec) {
+            return LINGLONG_ERR("checking journal existence failed", ec);
+        }
+        return LINGLONG_OK;
+    }
+
+    std::ifstream ifs(journal);
+    if (!ifs.is_open()) {
+        return LINGLONG_ERR(fmt::format("failed to open journal {}", journal.string()));
+    }
+
+    std::string line;
+    std::size_t lineNumber{ 0 };
+    while (std::getline(ifs, line)) {
+        ++lineNumber;
+        // only the last record may be incomplete, if the process crashed while appending it
+        if (ifs.eof()) {
+            LogW("drop torn record at the tail of journal {}", journal.string());
+            this->journalBroken = true;
+            break;
+        }
+
+        // a complete record is never rewritten, the journal is corrupted if it's invalid
+        auto record = nlohmann::json::parse(line, nullptr, false);
+        if (record.is_discarded()) {
+            return LINGLONG_ERR(
+              fmt::format("invalid record at line {} of journal {}", lineNumber, journal));
+        }
+
+        auto ret = applyJournalRecord(record);
+        if (!ret) {
+            return LINGLONG_ERR(
+              fmt::format("failed to apply line {} of journal {}", lineNumber, journal),
+              ret);
+        }
+        ++this->journalRecords;
+    }
+
+    return LINGLONG_OK;
+}
 
 utils::error::Result<void> RepoCache::writeToDisk()
 {
     LINGLONG_TRACE("save repo cache");
 
+    auto materialized = this->materialize();
+    if (!materialized) {
+        return LINGLONG_ERR(materialized);
+    }
     std::error_code ec;
     auto parent_path = this->cacheFile.parent_path();
     if (!std::filesystem::exists(parent_path, ec)) {
@@ -330,6 +975,17 @@ utils::error::Result<void> RepoCache::writeToDisk()
     ofs << data;
     ofs.close();
 
+    // the journal is dropped below, the snapshot must be on disk before replacing the old one
+    if (ofs.fail()) {
+        std::filesystem::remove(tmpFile, ec);
+        return LINGLONG_ERR(fmt::format("failed to write {}", tmpFile));
+    }
+    auto synced = syncPath(tmpFile);
+    if (!synced) {
+        std::filesystem::remove(tmpFile, ec);
+        return LINGLONG_ERR(synced);
+    }
+
     std::filesystem::rename(tmpFile, this->cacheFile, ec);
     if (ec) {
         LogE("failed to rename from {} to {}: {}",
@@ -357,6 +1013,20 @@ utils::error::Result<void> RepoCache::writeToDisk()
         return LINGLONG_ERR("failed to update cache");
     }
 
+    // all records of journal are compacted into the snapshot now
+    synced = syncPath(parent_path);
+    if (!synced) {
+        LogW("failed to sync {}: {}", parent_path.string(), synced.error());
+    }
+    std::filesystem::remove(journalFile(), ec);
+    if (ec) {
+        LogW("failed to remove journal {}: {}", journalFile().string(), ec.message());
+        ec.clear();
+    }
+    this->journalRecords = 0;
+    this->journalBroken = false;
+    this->writeImage();
+
     auto versionTag = parent_path / ".version";
     ofs.open(parent_path / ".version", std::ios::out | std::ios::trunc);
     if (ofs.fail()) {
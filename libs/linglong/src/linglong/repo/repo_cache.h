@@ -10,11 +10,15 @@
 #include "linglong/api/types/v1/RepositoryCache.hpp"
 #include "linglong/api/types/v1/RepositoryCacheMergedItem.hpp"
 #include "linglong/package/architecture.h"
+#include "linglong/package/version.h"
 #include "linglong/utils/error/error.h"
+#include "nlohmann/json.hpp"
 
 #include <ostree.h>
 
 #include <filesystem>
+#include <memory>
+#include <unordered_map>
 
 namespace linglong::repo {
 
@@ -46,6 +50,22 @@ struct repoCacheQuery
 
 enum class MigrationStage : int64_t { RefsWithoutRepo };
 
+// the state of states.json and its journal on disk
+struct RepoCacheStamp
+{
+    uint64_t snapshotSize{ 0 };
+    int64_t snapshotMtime{ 0 };
+    uint64_t journalSize{ 0 };
+
+    bool operator==(const RepoCacheStamp &that) const noexcept
+    {
+        return snapshotSize == that.snapshotSize && snapshotMtime == that.snapshotMtime
+          && journalSize == that.journalSize;
+    }
+};
+
+class RepoCacheImage;
+
 class RepoCache
 {
 public:
@@ -54,15 +74,24 @@ public:
     RepoCache &operator=(const RepoCache &) = delete;
     RepoCache(RepoCache &&other) = delete;
     RepoCache &operator=(RepoCache &&other) = delete;
-    ~RepoCache() = default;
+    ~RepoCache();
 
     utils::error::Result<void> load();
+    // whether states.json or its journal was changed since the cache was loaded, e.g. by
+    // another process
+    [[nodiscard]] bool isOutdated() const noexcept;
+    // The generation is bumped by every change of the cache and persisted with it, a cache with
+    // the same generation has the same content.
+    [[nodiscard]] uint64_t generation() const noexcept;
     utils::error::Result<void> rebuild(const api::types::v1::RepoConfigV2 &repoConfig,
                                        OstreeRepo &repo) noexcept;
 
     utils::error::Result<void> addLayerItem(const api::types::v1::RepositoryCacheLayersItem &item);
     utils::error::Result<void>
     deleteLayerItem(const api::types::v1::RepositoryCacheLayersItem &item) noexcept;
+    utils::error::Result<void>
+    markLayerItemDeleted(const api::types::v1::RepositoryCacheLayersItem &item,
+                         std::optional<bool> deleted) noexcept;
 
     [[nodiscard]] std::vector<api::types::v1::RepositoryCacheLayersItem>
     queryLayerItem(const repoCacheQuery &query) const noexcept;
@@ -81,11 +110,63 @@ public:
 
     utils::error::Result<std::vector<api::types::v1::RepositoryCacheLayersItem>::iterator>
     findMatchingItem(const api::types::v1::RepositoryCacheLayersItem &item) noexcept;
+    // write the whole cache to the snapshot file and drop the journal
     utils::error::Result<void> writeToDisk();
 
 private:
+    // An entry of the layer index, the version is parsed once when the layer is indexed.
+    // pos is the position of the layer in cache.layers.
+    struct IndexedLayer
+    {
+        std::optional<package::Version> version;
+        std::size_t pos;
+    };
+
+    // module -> layers sorted by version in descending order
+    using ModuleIndex = std::unordered_map<std::string, std::vector<IndexedLayer>>;
+    // arch -> module
+    using ArchIndex = std::unordered_map<std::string, ModuleIndex>;
+    // channel -> arch
+    using ChannelIndex = std::unordered_map<std::string, ArchIndex>;
+    // id -> channel
+    using LayerIndex = std::unordered_map<std::string, ChannelIndex>;
+
+    static bool isNewerThan(const IndexedLayer &lhs, const IndexedLayer &rhs) noexcept;
+    [[nodiscard]] bool matchQuery(const api::types::v1::RepositoryCacheLayersItem &layer,
+                                  const repoCacheQuery &query) const noexcept;
+    void rebuildIndex() noexcept;
+
+    [[nodiscard]] std::filesystem::path journalFile() const noexcept;
+    [[nodiscard]] std::filesystem::path imageFile() const noexcept;
+    utils::error::Result<void> loadImage() noexcept;
+    // load states.json and replay its journal without the image
+    utils::error::Result<void> loadSnapshot() noexcept;
+    void writeImage() noexcept;
+    // move the layers of the image into cache.layers, the cache is reloaded from states.json if
+    // the image is broken
+    utils::error::Result<void> materialize() noexcept;
+    utils::error::Result<void> applyJournalRecord(const nlohmann::json &record) noexcept;
+    // persist record and apply it to the cache, the cache is unchanged if it can't be persisted
+    utils::error::Result<void> commitRecord(const nlohmann::json &record) noexcept;
+    // append record to the journal and sync it to disk
+    utils::error::Result<void> appendJournal(const nlohmann::json &record) noexcept;
+    utils::error::Result<void> replayJournal() noexcept;
+    void indexLayer(std::size_t pos) noexcept;
+    void unindexLayer(std::size_t pos) noexcept;
+
     static constexpr auto cacheFileVersion = "2";
+    // the max number of threads used to read refs when rebuilding the cache
+    static constexpr std::size_t rebuildMaxWorkers = 8;
+    // compact the journal into the snapshot file once it has this many records
+    static constexpr std::size_t journalCompactThreshold = 64;
     api::types::v1::RepositoryCache cache;
     std::filesystem::path cacheFile;
+    LayerIndex index;
+    std::size_t journalRecords{ 0 };
+    // the tail of journal is broken, it must be compacted before appending new records
+    bool journalBroken{ false };
+    // if the image is loaded, cache.layers and index are empty until the cache is materialized
+    std::unique_ptr<RepoCacheImage> image;
+    std::optional<RepoCacheStamp> loadedStamp;
 };
 } // namespace linglong::repo
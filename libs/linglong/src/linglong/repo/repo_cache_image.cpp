@@ -0,0 +1,528 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "repo_cache_image.h"
+
+#include "linglong/common/error.h"
+#include "linglong/utils/finally/finally.h"
+#include "linglong/utils/serialize/json.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace linglong::repo {
+
+namespace {
+
+constexpr char imageMagic[8] = { 'L', 'L', 'R', 'C', 'I', 'M', 'G', '\0' };
+constexpr uint32_t imageFormatVersion = 2;
+
+enum RecordFlag : uint32_t {
+    HasDeleted = 1U << 0U,
+    Deleted = 1U << 1U,
+    HasUUID = 1U << 2U,
+};
+
+} // namespace
+
+struct RepoCacheImage::StringRef
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct RepoCacheImage::Header
+{
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t recordCount;
+    uint64_t snapshotSize;
+    int64_t snapshotMtime;
+    uint64_t journalSize;
+    uint32_t journalRecords;
+    uint32_t hasMerged;
+    StringRef version;
+    StringRef llVersion;
+    StringRef config;
+    StringRef merged;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t generation;
+};
+
+struct RepoCacheImage::Record
+{
+    StringRef id;
+    StringRef channel;
+    StringRef arch;
+    StringRef module;
+    StringRef version;
+    StringRef repo;
+    StringRef commit;
+    StringRef uuid;
+    StringRef info;
+    uint32_t pos;
+    uint32_t rank;
+    uint32_t flags;
+};
+
+utils::error::Result<RepoCacheImage::Stamp>
+RepoCacheImage::currentStamp(const std::filesystem::path &cacheFile,
+                             const std::filesystem::path &journalFile) noexcept
+{
+    LINGLONG_TRACE("get stamp of repo cache");
+
+    struct stat st{};
+    if (::stat(cacheFile.c_str(), &st) == -1) {
+        return LINGLONG_ERR(fmt::format("failed to stat {}", cacheFile.string()), errno);
+    }
+
+    Stamp stamp;
+    stamp.snapshotSize = static_cast<uint64_t>(st.st_size);
+    stamp.snapshotMtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000
+      + static_cast<int64_t>(st.st_mtim.tv_nsec);
+
+    if (::stat(journalFile.c_str(), &st) == 0) {
+        stamp.journalSize = static_cast<uint64_t>(st.st_size);
+    } else if (errno != ENOENT) {
+        return LINGLONG_ERR(fmt::format("failed to stat {}", journalFile.string()), errno);
+    }
+
+    return stamp;
+}
+
+utils::error::Result<void> RepoCacheImage::write(const std::filesystem::path &imageFile,
+                                                 const api::types::v1::RepositoryCache &cache,
+                                                 const std::vector<uint32_t> &ranks,
+                                                 const Stamp &stamp,
+                                                 uint32_t journalRecords) noexcept
+{
+    LINGLONG_TRACE(fmt::format("write repo cache image {}", imageFile.string()));
+
+    if (ranks.size() != cache.layers.size()) {
+        return LINGLONG_ERR("the size of ranks doesn't match layers");
+    }
+
+    std::string strings;
+    auto addString = [&strings](std::string_view value) -> StringRef {
+        StringRef ref{ static_cast<uint32_t>(strings.size()),
+                       static_cast<uint32_t>(value.size()) };
+        strings.append(value);
+        return ref;
+    };
+
+    Header header{};
+    std::memcpy(header.magic, imageMagic, sizeof(imageMagic));
+    header.formatVersion = imageFormatVersion;
+    header.recordCount = static_cast<uint32_t>(cache.layers.size());
+    header.snapshotSize = stamp.snapshotSize;
+    header.snapshotMtime = stamp.snapshotMtime;
+    header.journalSize = stamp.journalSize;
+    header.journalRecords = journalRecords;
+    header.hasMerged = cache.merged.has_value() ? 1 : 0;
+    header.generation = static_cast<uint64_t>(cache.generation.value_or(0));
+
+    std::vector<Record> records;
+    records.reserve(cache.layers.size());
+    try {
+        header.version = addString(cache.version);
+        header.llVersion = addString(cache.llVersion);
+        header.config = addString(nlohmann::json(cache.config).dump());
+        if (cache.merged) {
+            header.merged = addString(nlohmann::json(*cache.merged).dump());
+        }
+
+        for (std::size_t pos = 0; pos < cache.layers.size(); ++pos) {
+            const auto &layer = cache.layers[pos];
+            Record record{};
+            record.id = addString(layer.info.id);
+            record.channel = addString(layer.info.channel);
+            record.arch = addString(layer.info.arch.empty() ? "" : layer.info.arch.front());
+            record.module = addString(layer.info.packageInfoV2Module);
+            record.version = addString(layer.info.version);
+            record.repo = addString(layer.repo);
+            record.commit = addString(layer.commit);
+            record.uuid = addString(layer.info.uuid.value_or(""));
+            record.info = addString(nlohmann::json(layer.info).dump());
+            record.pos = static_cast<uint32_t>(pos);
+            record.rank = ranks[pos];
+            if (layer.deleted) {
+                record.flags |= HasDeleted;
+                if (*layer.deleted) {
+                    record.flags |= Deleted;
+                }
+            }
+            if (layer.info.uuid) {
+                record.flags |= HasUUID;
+            }
+            records.emplace_back(record);
+        }
+    } catch (const std::exception &e) {
+        return LINGLONG_ERR("failed to serialize repo cache", e);
+    }
+
+    if (strings.size() > std::numeric_limits<uint32_t>::max()) {
+        return LINGLONG_ERR("repo cache is too large");
+    }
+
+    std::sort(records.begin(), records.end(), [&strings](const Record &lhs, const Record &rhs) {
+        auto lhsId = std::string_view(strings).substr(lhs.id.offset, lhs.id.size);
+        auto rhsId = std::string_view(strings).substr(rhs.id.offset, rhs.id.size);
+        if (lhsId != rhsId) {
+            return lhsId < rhsId;
+        }
+        return lhs.rank < rhs.rank;
+    });
+
+    header.stringsOffset = sizeof(Header) + records.size() * sizeof(Record);
+    header.stringsSize = strings.size();
+
+    auto tmpFile = imageFile.parent_path() / ("temp-" + imageFile.filename().string());
+    std::ofstream ofs(tmpFile, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!ofs.is_open()) {
+        return LINGLONG_ERR(fmt::format("failed to open {}", tmpFile.string()));
+    }
+
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(records.data()),
+              static_cast<std::streamsize>(records.size() * sizeof(Record)));
+    ofs.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    ofs.close();
+
+    std::error_code ec;
+    if (ofs.fail()) {
+        std::filesystem::remove(tmpFile, ec);
+        return LINGLONG_ERR(fmt::format("failed to write {}", tmpFile.string()));
+    }
+
+    // the stamp only tells whether the image is up to date, not whether it was written completely
+    auto fd = ::open(tmpFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1 || ::fsync(fd) == -1) {
+        auto msg = fmt::format("failed to sync {}: {}",
+                               tmpFile.string(),
+                               common::error::errorString(errno));
+        if (fd != -1) {
+            ::close(fd);
+        }
+        std::filesystem::remove(tmpFile, ec);
+        return LINGLONG_ERR(msg);
+    }
+    ::close(fd);
+
+    std::filesystem::rename(tmpFile, imageFile, ec);
+    if (ec) {
+        auto msg = fmt::format("failed to rename {} to {}: {}",
+                               tmpFile.string(),
+                               imageFile.string(),
+                               ec.message());
+        std::filesystem::remove(tmpFile, ec);
+        return LINGLONG_ERR(msg);
+    }
+
+    return LINGLONG_OK;
+}
+
+utils::error::Result<std::unique_ptr<RepoCacheImage>>
+RepoCacheImage::open(const std::filesystem::path &imageFile, const Stamp &expected) noexcept
+{
+    LINGLONG_TRACE(fmt::format("open repo cache image {}", imageFile.string()));
+
+    auto fd = ::open(imageFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return LINGLONG_ERR("failed to open image", errno);
+    }
+    auto closeFd = utils::finally::finally([fd] {
+        ::close(fd);
+    });
+
+    struct stat st{};
+    if (::fstat(fd, &st) == -1) {
+        return LINGLONG_ERR("failed to stat image", errno);
+    }
+
+    auto size = static_cast<std::size_t>(st.st_size);
+    if (size < sizeof(Header)) {
+        return LINGLONG_ERR("image is truncated");
+    }
+
+    auto *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return LINGLONG_ERR("failed to mmap image", errno);
+    }
+
+    std::unique_ptr<RepoCacheImage> image(new RepoCacheImage(data, size));
+    if (!image->validate()) {
+        return LINGLONG_ERR("image is broken");
+    }
+
+    const auto &header = image->header();
+    Stamp stamp{ .snapshotSize = header.snapshotSize,
+                 .snapshotMtime = header.snapshotMtime,
+                 .journalSize = header.journalSize };
+    if (!(stamp == expected)) {
+        return LINGLONG_ERR("image is out of date");
+    }
+
+    return image;
+}
+
+RepoCacheImage::RepoCacheImage(void *data, std::size_t size) noexcept
+    : data(data)
+    , size(size)
+{
+}
+
+RepoCacheImage::~RepoCacheImage()
+{
+    if (this->data != nullptr) {
+        ::munmap(this->data, this->size);
+    }
+}
+
+const RepoCacheImage::Header &RepoCacheImage::header() const noexcept
+{
+    return *static_cast<const Header *>(this->data);
+}
+
+const RepoCacheImage::Record *RepoCacheImage::records() const noexcept
+{
+    return reinterpret_cast<const Record *>(static_cast<const char *>(this->data)
+                                            + sizeof(Header));
+}
+
+std::string_view RepoCacheImage::str(const StringRef &ref) const noexcept
+{
+    const auto &header = this->header();
+    return { static_cast<const char *>(this->data) + header.stringsOffset + ref.offset, ref.size };
+}
+
+bool RepoCacheImage::validate() const noexcept
+{
+    const auto &header = this->header();
+    if (std::memcmp(header.magic, imageMagic, sizeof(imageMagic)) != 0
+        || header.formatVersion != imageFormatVersion) {
+        return false;
+    }
+
+    auto recordsEnd = sizeof(Header) + static_cast<uint64_t>(header.recordCount) * sizeof(Record);
+    if (recordsEnd > header.stringsOffset || header.stringsOffset > this->size
+        || header.stringsSize > this->size - header.stringsOffset) {
+        return false;
+    }
+
+    auto valid = [&header](const StringRef &ref) {
+        return static_cast<uint64_t>(ref.offset) + ref.size <= header.stringsSize;
+    };
+
+    if (!valid(header.version) || !valid(header.llVersion) || !valid(header.config)
+        || !valid(header.merged)) {
+        return false;
+    }
+
+    const auto *records = this->records();
+    return std::all_of(records, records + header.recordCount, [&valid](const Record &record) {
+        return valid(record.id) && valid(record.channel) && valid(record.arch)
+          && valid(record.module) && valid(record.version) && valid(record.repo)
+          && valid(record.commit) && valid(record.uuid) && valid(record.info);
+    });
+}
+
+std::string_view RepoCacheImage::version() const noexcept
+{
+    return str(header().version);
+}
+
+std::string_view RepoCacheImage::llVersion() const noexcept
+{
+    return str(header().llVersion);
+}
+
+uint32_t RepoCacheImage::journalRecords() const noexcept
+{
+    return header().journalRecords;
+}
+
+uint64_t RepoCacheImage::generation() const noexcept
+{
+    return header().generation;
+}
+
+utils::error::Result<api::types::v1::RepoConfigV2> RepoCacheImage::config() const noexcept
+{
+    return utils::serialize::LoadJSON<api::types::v1::RepoConfigV2>(
+      std::string(str(header().config)));
+}
+
+utils::error::Result<std::optional<std::vector<api::types::v1::RepositoryCacheMergedItem>>>
+RepoCacheImage::merged() const noexcept
+{
+    LINGLONG_TRACE("load merged items from image");
+
+    if (header().hasMerged == 0) {
+        return std::nullopt;
+    }
+
+    using MergedItems = std::vector<api::types::v1::RepositoryCacheMergedItem>;
+    auto merged = utils::serialize::LoadJSON<MergedItems>(std::string(str(header().merged)));
+    if (!merged) {
+        return LINGLONG_ERR(merged);
+    }
+
+    return std::move(merged).value();
+}
+
+bool RepoCacheImage::matchQuery(const Record &record, const repoCacheQuery &query) const noexcept
+{
+    if (query.id && query.id.value() != str(record.id)) {
+        return false;
+    }
+
+    if (query.repo && query.repo.value() != str(record.repo)) {
+        return false;
+    }
+
+    if (query.channel && query.channel.value() != str(record.channel)) {
+        return false;
+    }
+
+    if (query.version && query.version.value() != str(record.version)) {
+        return false;
+    }
+
+    if (query.module && query.module.value() != str(record.module)) {
+        return false;
+    }
+
+    if (query.architecture && query.architecture.value() != str(record.arch)) {
+        return false;
+    }
+
+    if (query.deleted) {
+        auto layerDeleted = (record.flags & Deleted) != 0;
+        if (query.deleted.value() != layerDeleted) {
+            return false;
+        }
+    }
+
+    if (query.uuid) {
+        if ((record.flags & HasUUID) == 0) {
+            return false;
+        }
+
+        if (query.uuid.value() != str(record.uuid)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+utils::error::Result<api::types::v1::RepositoryCacheLayersItem>
+RepoCacheImage::toLayerItem(const Record &record) const noexcept
+{
+    LINGLONG_TRACE(fmt::format("load layer {} from image", str(record.id)));
+
+    auto info =
+      utils::serialize::LoadJSON<api::types::v1::PackageInfoV2>(std::string(str(record.info)));
+    if (!info) {
+        return LINGLONG_ERR(info);
+    }
+
+    api::types::v1::RepositoryCacheLayersItem item;
+    item.commit = str(record.commit);
+    item.repo = str(record.repo);
+    item.info = std::move(info).value();
+    if ((record.flags & HasDeleted) != 0) {
+        item.deleted = (record.flags & Deleted) != 0;
+    }
+
+    return item;
+}
+
+utils::error::Result<std::vector<api::types::v1::RepositoryCacheLayersItem>>
+RepoCacheImage::query(const repoCacheQuery &query) const noexcept
+{
+    LINGLONG_TRACE("query repo cache image");
+
+    const auto *begin = this->records();
+    const auto *end = begin + header().recordCount;
+    if (query.id) {
+        // records are sorted by id, and the records of one id are sorted by version
+        std::string_view id = query.id.value();
+        begin =
+          std::lower_bound(begin, end, id, [this](const Record &record, std::string_view value) {
+              return str(record.id) < value;
+          });
+        end =
+          std::upper_bound(begin, end, id, [this](std::string_view value, const Record &record) {
+              return value < str(record.id);
+          });
+    }
+
+    std::vector<const Record *> matched;
+    for (const auto *record = begin; record != end; ++record) {
+        if (matchQuery(*record, query)) {
+            matched.emplace_back(record);
+        }
+    }
+
+    if (!query.id) {
+        std::sort(matched.begin(), matched.end(), [](const Record *lhs, const Record *rhs) {
+            return lhs->rank < rhs->rank;
+        });
+    }
+
+    std::vector<api::types::v1::RepositoryCacheLayersItem> layers;
+    layers.reserve(matched.size());
+    for (const auto *record : matched) {
+        auto item = toLayerItem(*record);
+        if (!item) {
+            return LINGLONG_ERR(item);
+        }
+        layers.emplace_back(std::move(item).value());
+    }
+
+    return layers;
+}
+
+utils::error::Result<std::vector<api::types::v1::RepositoryCacheLayersItem>>
+RepoCacheImage::layers() const noexcept
+{
+    LINGLONG_TRACE("list layers of repo cache image");
+
+    const auto *records = this->records();
+    std::vector<const Record *> sorted;
+    sorted.reserve(header().recordCount);
+    for (uint32_t i = 0; i < header().recordCount; ++i) {
+        sorted.emplace_back(records + i);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Record *lhs, const Record *rhs) {
+        return lhs->pos < rhs->pos;
+    });
+
+    std::vector<api::types::v1::RepositoryCacheLayersItem> layers;
+    layers.reserve(sorted.size());
+    for (const auto *record : sorted) {
+        auto item = toLayerItem(*record);
+        if (!item) {
+            return LINGLONG_ERR(item);
+        }
+        layers.emplace_back(std::move(item).value());
+    }
+
+    return layers;
+}
+
+} // namespace linglong::repo
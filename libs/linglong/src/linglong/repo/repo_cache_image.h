@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/api/types/v1/RepositoryCache.hpp"
+#include "linglong/repo/repo_cache.h"
+#include "linglong/utils/error/error.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace linglong::repo {
+
+// RepoCacheImage is a compact binary sidecar of states.json, it could be mmapped read-only and
+// queried without parsing the whole cache. The layout is:
+//
+//   | Header | Record * recordCount | string table |
+//
+// Records are sorted by id and then by version in descending order, so a query by id is a
+// binary search plus a range walk. The PackageInfoV2 of a layer is stored as a JSON string and
+// only parsed for the layers returned by a query.
+//
+// states.json and its journal are still the source of truth, an image is only used when its
+// stamp matches both of them.
+class RepoCacheImage
+{
+public:
+    using Stamp = RepoCacheStamp;
+
+    static utils::error::Result<Stamp>
+    currentStamp(const std::filesystem::path &cacheFile,
+                 const std::filesystem::path &journalFile) noexcept;
+
+    // ranks[i] is the position of cache.layers[i] in the whole cache sorted by version
+    static utils::error::Result<void> write(const std::filesystem::path &imageFile,
+                                            const api::types::v1::RepositoryCache &cache,
+                                            const std::vector<uint32_t> &ranks,
+                                            const Stamp &stamp,
+                                            uint32_t journalRecords) noexcept;
+    static utils::error::Result<std::unique_ptr<RepoCacheImage>>
+    open(const std::filesystem::path &imageFile, const Stamp &expected) noexcept;
+
+    RepoCacheImage(const RepoCacheImage &) = delete;
+    RepoCacheImage &operator=(const RepoCacheImage &) = delete;
+    RepoCacheImage(RepoCacheImage &&) = delete;
+    RepoCacheImage &operator=(RepoCacheImage &&) = delete;
+    ~RepoCacheImage();
+
+    [[nodiscard]] std::string_view version() const noexcept;
+    [[nodiscard]] std::string_view llVersion() const noexcept;
+    [[nodiscard]] uint32_t journalRecords() const noexcept;
+    [[nodiscard]] uint64_t generation() const noexcept;
+    [[nodiscard]] utils::error::Result<api::types::v1::RepoConfigV2> config() const noexcept;
+    [[nodiscard]] utils::error::Result<
+      std::optional<std::vector<api::types::v1::RepositoryCacheMergedItem>>>
+    merged() const noexcept;
+
+    // same as RepoCache::queryLayerItem, a layer which couldn't be decoded fails the query and
+    // the image should not be used anymore
+    [[nodiscard]] utils::error::Result<std::vector<api::types::v1::RepositoryCacheLayersItem>>
+    query(const repoCacheQuery &query) const noexcept;
+    // all layers in the order of RepositoryCache::layers
+    [[nodiscard]] utils::error::Result<std::vector<api::types::v1::RepositoryCacheLayersItem>>
+    layers() const noexcept;
+
+private:
+    struct StringRef;
+    struct Header;
+    struct Record;
+
+    RepoCacheImage(void *data, std::size_t size) noexcept;
+
+    [[nodiscard]] const Header &header() const noexcept;
+    [[nodiscard]] const Record *records() const noexcept;
+    [[nodiscard]] std::string_view str(const StringRef &ref) const noexcept;
+    [[nodiscard]] bool validate() const noexcept;
+    [[nodiscard]] bool matchQuery(const Record &record, const repoCacheQuery &query) const noexcept;
+    [[nodiscard]] utils::error::Result<api::types::v1::RepositoryCacheLayersItem>
+    toLayerItem(const Record &record) const noexcept;
+
+    void *data{ nullptr };
+    std::size_t size{ 0 };
+};
+
+} // namespace linglong::repo
@@ -12,6 +12,7 @@
 #include "linglong/common/helper.h"
 #include "linglong/common/socket.h"
 #include "linglong/runtime/container_builder.h"
+#include "linglong/runtime/container_index.h"
 #include "linglong/runtime/overlayfs_driver.h"
 #include "linglong/runtime/run_context.h"
 #include "linglong/utils/bash_command_helper.h"
@@ -19,6 +20,7 @@
 #include "linglong/utils/filelock.h"
 #include "linglong/utils/finally/finally.h"
 #include "linglong/utils/log/log.h"
+#include "linglong/utils/log/trace.h"
 #include "linglong/utils/overlayfs.h"
 #include "ocppi/runtime/ExecOption.hpp"
 #include "ocppi/runtime/RunOption.hpp"
@@ -358,7 +360,12 @@ utils::error::Result<void> Container::run(const ocppi::runtime::config::types::P
     LogD("run container with bundle {}", bundleDir);
     // 禁用crun自己创建cgroup，便于AM识别和管理玲珑应用
     opt.GlobalOption::extra.emplace_back("--cgroup-manager=disabled");
+    // the pid of the container is read by `ll-cli ps`, so the OCI runtime isn't queried
+    opt.extra.emplace_back("--pid-file");
+    opt.extra.emplace_back((bundleDir / ContainerPidFile).string());
 
+    // the span lasts until the container exits, ll-init traces when the application starts
+    LogSpan("run OCI runtime");
     auto result = this->cli.run(this->context->getContainerID(), bundleDir, opt);
     if (!result) {
         return LINGLONG_ERR("cli run", result.error());
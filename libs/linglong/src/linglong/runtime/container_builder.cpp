@@ -6,14 +6,20 @@
 
 #include "linglong/runtime/container_builder.h"
 
+#include "configure.h"
 #include "linglong/cli/cli.h"
 #include "linglong/common/dir.h"
+#include "linglong/common/error.h"
 #include "linglong/common/strings.h"
 #include "linglong/common/xdg.h"
 #include "linglong/oci-cfg-generators/container_cfg_builder.h"
 #include "linglong/package/architecture.h"
+#include "linglong/runtime/init_exec.h"
+#include "linglong/runtime/ld_cache_generator.h"
 #include "linglong/runtime/run_context.h"
+#include "linglong/utils/file.h"
 #include "linglong/utils/log/log.h"
+#include "linglong/utils/log/trace.h"
 
 #include <fmt/format.h>
 #include <fmt/ranges.h>
@@ -25,6 +31,8 @@
 #include <algorithm>
 #include <fstream>
 
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
 
 namespace linglong::runtime {
@@ -582,6 +590,120 @@ auto ContainerBuilder::createInitContainer(runtime::RunContext &context,
     return this->finalizeContainer(*prepared);
 }
 
+auto ContainerBuilder::initContainerCache(runtime::RunContext &context,
+                                          const CommonContainerOptions &options) noexcept
+  -> utils::error::Result<void>
+{
+    LINGLONG_TRACE("init container cache");
+
+    if (::getenv("LINGLONG_LDCONFIG_IN_CONTAINER") != nullptr) {
+        return LINGLONG_ERR("disabled by LINGLONG_LDCONFIG_IN_CONTAINER");
+    }
+
+    const auto &config = context.getConfig();
+    if (!config.overlayfs) {
+        return LINGLONG_ERR("overlayfs is disabled");
+    }
+
+    // the files of CDI devices and extra mounts are only visible inside of the container
+    if ((config.cdiDevices && !config.cdiDevices->empty())
+        || (config.mounts && !config.mounts->empty()) || !options.extraMounts.empty()) {
+        return LINGLONG_ERR("container has extra mounts");
+    }
+
+    if (!options.containerCachePath) {
+        return LINGLONG_ERR("container cache is empty");
+    }
+    const auto &appCache = *options.containerCachePath;
+
+    const auto &baseLayer = context.getBaseLayer();
+    if (!baseLayer) {
+        return LINGLONG_ERR("base layer not found");
+    }
+    auto basePath = baseLayer->getLayerDir()->filesDirPath();
+
+    auto targetLayer = context.getTargetLayer();
+    if (!targetLayer) {
+        return LINGLONG_ERR("target layer not found", targetLayer);
+    }
+    const auto &arch = targetLayer->get().getReference().arch;
+
+    generator::ContainerCfgBuilder cfgBuilder;
+    auto res = context.fillContextCfg(cfgBuilder, appCache);
+    if (!res) {
+        return LINGLONG_ERR(res);
+    }
+    cfgBuilder.setAppId(context.getTargetID());
+    auto ldConf = cfgBuilder.ldConf(arch.getTriplet());
+
+    // the init container writes to the upper dir of its persistent overlay, which is a lower dir
+    // of the run containers
+    auto upperDir = appCache / "overlay" / "upperdir";
+    const std::filesystem::path ldConfPath = "/etc/ld.so.conf.d/zz_deepin-linglong-app.conf";
+
+    std::vector<LdCacheGenerator::Mount> mounts{ { "/", basePath } };
+    for (auto &[destination, source] : cfgBuilder.ldConfMounts()) {
+        mounts.push_back({ std::move(destination), std::move(source) });
+    }
+
+    LdCacheGenerator ldCache(std::move(mounts), arch);
+    ldCache.addFile(ldConfPath, ldConf);
+    res = ldCache.addConfFile("/etc/ld.so.conf");
+    if (!res) {
+        return LINGLONG_ERR(res);
+    }
+    ldCache.addSystemDirs();
+
+    res = ldCache.write(upperDir / "etc/ld.so.cache", fmt::format("linglong {}", LINGLONG_VERSION));
+    if (!res) {
+        return LINGLONG_ERR(res);
+    }
+
+    res = utils::ensureDirectory(upperDir / ldConfPath.relative_path().parent_path());
+    if (!res) {
+        return LINGLONG_ERR(res);
+    }
+
+    res = utils::writeFile(upperDir / ldConfPath.relative_path(), ldConf);
+    if (!res) {
+        return LINGLONG_ERR(res);
+    }
+
+    // what normalizeContainerRootfs does in the init container, these files of the base are hidden
+    // by whiteouts, which can be created without privileges since Linux 5.8
+    for (const auto *name : { "localtime", "resolv.conf" }) {
+        auto target = upperDir / "etc" / name;
+        std::error_code ec;
+        std::filesystem::remove(target, ec);
+
+        struct stat st{};
+        if (::lstat((basePath / "etc" / name).c_str(), &st) != 0) {
+            continue;
+        }
+
+        if (::mknod(target.c_str(), S_IFCHR, ::makedev(0, 0)) != 0) {
+            return LINGLONG_ERR(fmt::format("failed to create whiteout {}: {}",
+                                            target,
+                                            common::error::errorString(errno)));
+        }
+    }
+
+    if (config.timezone && !config.timezone->empty()) {
+        auto localtimePath = upperDir / "etc/localtime";
+        auto timezonePath = generator::ContainerCfgBuilder::zoneinfoMountPoint / *config.timezone;
+        std::error_code ec;
+        std::filesystem::remove(localtimePath, ec);
+        std::filesystem::create_symlink(timezonePath, localtimePath, ec);
+        if (ec) {
+            return LINGLONG_ERR(
+              fmt::format("failed to create symlink {} -> {}", localtimePath, timezonePath),
+              ec);
+        }
+    }
+
+    return LINGLONG_OK;
+}
+
 auto ContainerBuilder::configureRunContainer(PreparedContainer &prepared,
                                              const RunContainerOptions &options) noexcept
   -> utils::error::Result<void>
@@ -605,7 +727,8 @@ auto ContainerBuilder::configureRunContainer(PreparedContainer &prepared,
       .mapPrivate((homePath / ".ssh").string(), true)
       .mapPrivate((homePath / ".gnupg").string(), true)
       .bindIPC()
-      .forwardDefaultEnv();
+      .forwardDefaultEnv()
+      .setTemplateCacheDir(common::dir::getRuntimeDir() / "config-templates");
 
     if (!options.isXdpDisabled()) {
         auto docMountPoint = getXDPDocumentsMountPoint();
@@ -648,6 +771,19 @@ auto ContainerBuilder::configureRunContainer(PreparedContainer &prepared,
                                             .source = socketDir.string(),
                                             .type = "bind" });
 
+    // let ll-init append its events to the trace of the launch
+    if (auto *traceFile = ::getenv(utils::log::TraceFileEnv);
+        traceFile != nullptr && std::filesystem::is_regular_file(traceFile, ec)) {
+        constexpr auto containerTraceFile = "/run/linglong/trace.json";
+        prepared.cfgBuilder
+          .addExtraMount(
+            ocppi::runtime::config::types::Mount{ .destination = containerTraceFile,
+                                                  .options = std::vector<std::string>{ "bind" },
+                                                  .source = traceFile,
+                                                  .type = "bind" })
+          .appendEnv(utils::log::TraceFileEnv, containerTraceFile, true);
+    }
+
     if (!options.getEnv().empty()) {
         prepared.cfgBuilder.appendEnv(options.getEnv());
     }
@@ -742,6 +878,20 @@ auto ContainerBuilder::createRunContainer(runtime::RunContext &context,
           .source = lockPath.string(),
           .type = "bind",
         });
+
+        // ll-init serves the reuses of the container on a socket in this directory
+        const auto initExecDir = prepared->context->getBundleDir() / InitExecDir;
+        std::error_code ec;
+        std::filesystem::create_directories(initExecDir, ec);
+        if (ec) {
+            return LINGLONG_ERR(fmt::format("failed to create {}", initExecDir), ec);
+        }
+        prepared->cfgBuilder.addExtraMount({
+          .destination = common::dir::containerInitExecDir,
+          .options = std::vector<std::string>{ "bind" },
+          .source = initExecDir.string(),
+          .type = "bind",
+        });
     }
 
     auto res = this->configureRunContainer(*prepared, options);
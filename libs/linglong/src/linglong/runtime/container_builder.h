@@ -95,6 +95,12 @@ public:
                              const CommonContainerOptions &options = {}) noexcept
       -> utils::error::Result<std::unique_ptr<Container>>;
 
+    // Prepare the container cache like the init container does, but on the host without starting
+    // a container. An error means the cache must be prepared by the init container.
+    auto initContainerCache(runtime::RunContext &context,
+                            const CommonContainerOptions &options) noexcept
+      -> utils::error::Result<void>;
+
     auto createRunContainer(runtime::RunContext &context,
                             const RunContainerOptions &options) noexcept
       -> utils::error::Result<std::unique_ptr<Container>>;
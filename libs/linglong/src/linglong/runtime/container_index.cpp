@@ -0,0 +1,320 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "container_index.h"
+
+#include "linglong/api/types/v1/Generators.hpp" // IWYU pragma: keep
+#include "linglong/utils/file.h"
+#include "linglong/utils/filelock.h"
+#include "linglong/utils/log/log.h"
+#include "linglong/utils/serialize/json.h"
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace linglong::runtime {
+
+namespace {
+
+constexpr auto IndexFile = "containers.json";
+// updates are serialized by this lock, readers only see complete files as they are renamed
+constexpr auto IndexLockFile = ".containers.lock";
+
+std::optional<pid_t> parsePid(std::string_view str) noexcept
+{
+    pid_t pid{ 0 };
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), pid);
+    if (ec != std::errc{} || ptr != str.data() + str.size() || pid <= 0) {
+        return std::nullopt;
+    }
+
+    return pid;
+}
+
+// the start time of pid in clock ticks since boot, see proc_pid_stat(5)
+std::optional<uint64_t> processStartTime(pid_t pid) noexcept
+{
+    std::ifstream stream(fmt::format("/proc/{}/stat", pid));
+    if (!stream.is_open()) {
+        return std::nullopt;
+    }
+
+    std::stringstream content;
+    content << stream.rdbuf();
+    auto stat = content.str();
+
+    // the command may contain spaces and parentheses, fields are counted from the last one
+    auto pos = stat.rfind(')');
+    if (pos == std::string::npos) {
+        return std::nullopt;
+    }
+
+    std::istringstream fields(stat.substr(pos + 1));
+    std::string field;
+    // starttime is the 22nd field, the 20th after the command
+    for (auto i = 0; i < 20; ++i) {
+        if (!(fields >> field)) {
+            return std::nullopt;
+        }
+    }
+
+    uint64_t startTime{ 0 };
+    auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), startTime);
+    if (ec != std::errc{}) {
+        return std::nullopt;
+    }
+
+    return startTime;
+}
+
+bool isAlive(const ContainerIndex::Entry &entry) noexcept
+{
+    return processStartTime(entry.pid) == entry.startTime;
+}
+
+nlohmann::json entryToJson(const ContainerIndex::Entry &entry)
+{
+    return nlohmann::json{
+        { "pid", entry.pid },
+        { "startTime", entry.startTime },
+        { "info", entry.info },
+    };
+}
+
+ContainerIndex::Entry entryFromJson(const nlohmann::json &json)
+{
+    return ContainerIndex::Entry{
+        .pid = json.at("pid").get<pid_t>(),
+        .startTime = json.at("startTime").get<uint64_t>(),
+        .info = json.at("info").get<api::types::v1::ContainerProcessStateInfo>(),
+    };
+}
+
+// the containers of the pid files written by ll-cli before the index is used
+std::vector<ContainerIndex::Entry> scanPidFiles(const std::filesystem::path &dir) noexcept
+{
+    std::vector<ContainerIndex::Entry> entries;
+    std::error_code ec;
+    for (const auto &file : std::filesystem::directory_iterator{ dir, ec }) {
+        auto pid = parsePid(file.path().filename().string());
+        if (!pid) {
+            continue;
+        }
+
+        auto startTime = processStartTime(*pid);
+        if (!startTime) {
+            LogD("ignore {} because corresponding process is not found", file.path());
+            continue;
+        }
+
+        auto info =
+          utils::serialize::LoadJSONFile<api::types::v1::ContainerProcessStateInfo>(file.path());
+        if (!info) {
+            LogD("load info from {}: {}", file.path(), info.error());
+            continue;
+        }
+
+        entries.push_back(ContainerIndex::Entry{
+          .pid = *pid,
+          .startTime = *startTime,
+          .info = std::move(info).value(),
+        });
+    }
+
+    return entries;
+}
+
+} // namespace
+
+std::optional<pid_t> containerPid(const std::filesystem::path &bundleDir) noexcept
+{
+    std::ifstream stream(bundleDir / ContainerPidFile);
+    std::string content;
+    if (!stream.is_open() || !(stream >> content)) {
+        return std::nullopt;
+    }
+
+    return parsePid(content);
+}
+
+ContainerIndex::ContainerIndex(std::filesystem::path dir) noexcept
+    : dir(std::move(dir))
+{
+}
+
+utils::error::Result<std::vector<ContainerIndex::Entry>>
+ContainerIndex::listAll(const std::filesystem::path &root) noexcept
+{
+    LINGLONG_TRACE(fmt::format("list containers in {}", root));
+
+    std::error_code ec;
+    auto userIterator = std::filesystem::directory_iterator{ root, ec };
+    if (ec) {
+        return LINGLONG_ERR(fmt::format("failed to list {}", root), ec);
+    }
+
+    std::vector<Entry> result;
+    for (const auto &entry : userIterator) {
+        if (!entry.is_directory(ec)) {
+            continue;
+        }
+
+        // one broken user doesn't hide the containers of the others, the pid files are still
+        // written next to the index
+        auto entries = ContainerIndex(entry.path()).list();
+        if (!entries) {
+            LogW("failed to list containers in {}: {}", entry.path(), entries.error());
+            entries = scanPidFiles(entry.path());
+        }
+
+        std::move(entries->begin(), entries->end(), std::back_inserter(result));
+    }
+
+    return result;
+}
+
+utils::error::Result<std::vector<ContainerIndex::Entry>> ContainerIndex::load() const noexcept
+{
+    LINGLONG_TRACE(fmt::format("load container index {}", dir / IndexFile));
+
+    auto file = dir / IndexFile;
+    std::ifstream stream(file);
+    if (!stream.is_open()) {
+        std::error_code ec;
+        if (std::filesystem::exists(file, ec) || ec) {
+            return LINGLONG_ERR("failed to open file");
+        }
+
+        return scanPidFiles(dir);
+    }
+
+    std::vector<Entry> entries;
+    try {
+        auto json = nlohmann::json::parse(stream);
+        for (const auto &item : json) {
+            entries.push_back(entryFromJson(item));
+        }
+    } catch (const std::exception &e) {
+        return LINGLONG_ERR(e.what());
+    }
+
+    return entries;
+}
+
+utils::error::Result<std::vector<ContainerIndex::Entry>> ContainerIndex::list() const noexcept
+{
+    LINGLONG_TRACE("list containers");
+
+    auto entries = load();
+    if (!entries) {
+        return LINGLONG_ERR(entries);
+    }
+
+    entries->erase(std::remove_if(entries->begin(),
+                                  entries->end(),
+                                  [](const Entry &entry) {
+                                      return !isAlive(entry);
+                                  }),
+                   entries->end());
+    return entries;
+}
+
+utils::error::Result<void>
+ContainerIndex::update(const std::function<void(std::vector<Entry> &)> &modify) noexcept
+{
+    LINGLONG_TRACE(fmt::format("update container index {}", dir / IndexFile));
+
+    auto lock = utils::filelock::FileLock::create(dir / IndexLockFile,
+                                                  utils::filelock::LockType::Write);
+    if (!lock) {
+        return LINGLONG_ERR(lock);
+    }
+
+    auto ret = lock->lock(utils::filelock::LockType::Write);
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+
+    // an unreadable index is rebuilt from the pid files
+    auto entries = list();
+    if (!entries) {
+        LogW("rebuild container index: {}", entries.error());
+        entries = scanPidFiles(dir);
+    }
+
+    modify(*entries);
+    return save(*entries);
+}
+
+utils::error::Result<void> ContainerIndex::save(const std::vector<Entry> &entries) noexcept
+{
+    LINGLONG_TRACE("save container index");
+
+    std::string content;
+    try {
+        auto json = nlohmann::json::array();
+        for (const auto &entry : entries) {
+            json.push_back(entryToJson(entry));
+        }
+        content = json.dump();
+    } catch (const std::exception &e) {
+        return LINGLONG_ERR("failed to serialize entries", e);
+    }
+
+    auto ret = utils::replaceFile(dir / IndexFile, content);
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+
+    return LINGLONG_OK;
+}
+
+utils::error::Result<void>
+ContainerIndex::add(const api::types::v1::ContainerProcessStateInfo &info) noexcept
+{
+    LINGLONG_TRACE(fmt::format("add container {} to index", info.containerID));
+
+    auto pid = ::getpid();
+    auto startTime = processStartTime(pid);
+    if (!startTime) {
+        return LINGLONG_ERR("failed to get the start time of current process");
+    }
+
+    return update([&](std::vector<Entry> &entries) {
+        // the entry may be rebuilt from the pid file of the current process
+        entries.erase(std::remove_if(entries.begin(),
+                                     entries.end(),
+                                     [pid](const Entry &entry) {
+                                         return entry.pid == pid;
+                                     }),
+                      entries.end());
+        entries.push_back(Entry{ .pid = pid, .startTime = *startTime, .info = info });
+    });
+}
+
+utils::error::Result<void> ContainerIndex::remove() noexcept
+{
+    LINGLONG_TRACE("remove container from index");
+
+    auto pid = ::getpid();
+    return update([pid](std::vector<Entry> &entries) {
+        entries.erase(std::remove_if(entries.begin(),
+                                     entries.end(),
+                                     [pid](const Entry &entry) {
+                                         return entry.pid == pid;
+                                     }),
+                      entries.end());
+    });
+}
+
+} // namespace linglong::runtime
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/api/types/v1/ContainerProcessStateInfo.hpp"
+#include "linglong/utils/error/error.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace linglong::runtime {
+
+// the file in the bundle which the OCI runtime writes the pid of the container process to
+constexpr auto ContainerPidFile = "init.pid";
+
+// The pid of the container process in bundleDir, std::nullopt if the container isn't started.
+std::optional<pid_t> containerPid(const std::filesystem::path &bundleDir) noexcept;
+
+// ContainerIndex lists the containers started by `ll-cli run` of a user, which are kept in one
+// file of the user's directory in /run/linglong. The entry of a container is added by the ll-cli
+// starting it and removed when that ll-cli exits, entries of processes exited abnormally are
+// skipped and dropped by the next update.
+//
+// ll-cli still writes /run/linglong/<uid>/<pid> for older versions, the index is rebuilt from
+// these files if it doesn't exist yet.
+class ContainerIndex
+{
+public:
+    struct Entry
+    {
+        // the ll-cli starting the container
+        pid_t pid{ 0 };
+        // pids are reused, an entry only belongs to the process started at this time
+        uint64_t startTime{ 0 };
+        api::types::v1::ContainerProcessStateInfo info;
+    };
+
+    explicit ContainerIndex(std::filesystem::path dir) noexcept;
+
+    // the containers of all users in root
+    static utils::error::Result<std::vector<Entry>>
+    listAll(const std::filesystem::path &root = "/run/linglong") noexcept;
+
+    // add the container started by the current process
+    utils::error::Result<void> add(const api::types::v1::ContainerProcessStateInfo &info) noexcept;
+    // remove the container started by the current process
+    utils::error::Result<void> remove() noexcept;
+
+    // the containers whose ll-cli is still running
+    [[nodiscard]] utils::error::Result<std::vector<Entry>> list() const noexcept;
+
+private:
+    [[nodiscard]] utils::error::Result<std::vector<Entry>> load() const noexcept;
+    utils::error::Result<void>
+    update(const std::function<void(std::vector<Entry> &)> &modify) noexcept;
+    utils::error::Result<void> save(const std::vector<Entry> &entries) noexcept;
+
+    std::filesystem::path dir;
+};
+
+} // namespace linglong::runtime
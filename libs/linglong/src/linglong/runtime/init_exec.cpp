@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "init_exec.h"
+
+#include "linglong/common/error.h"
+#include "linglong/common/socket.h"
+#include "linglong/utils/log/log.h"
+#include "linglong/utils/unique_fd.h"
+
+#include <fmt/format.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <charconv>
+#include <string_view>
+
+namespace linglong::runtime {
+
+namespace {
+
+// The request is a single message of NUL terminated fields: the number of arguments, the number
+// of environment variables, the working directory, the arguments and the environment variables.
+// ll-init can't link any json library, keep it in sync with apps/ll-init/src/ll-init.cpp.
+std::string encodeRequest(const InitExecRequest &request)
+{
+    std::string payload;
+    auto append = [&payload](std::string_view field) {
+        payload.append(field);
+        payload.push_back('\0');
+    };
+
+    append(std::to_string(request.args.size()));
+    append(std::to_string(request.env.size()));
+    append(request.cwd);
+    for (const auto &arg : request.args) {
+        append(arg);
+    }
+    for (const auto &env : request.env) {
+        append(env);
+    }
+
+    return payload;
+}
+
+} // namespace
+
+std::filesystem::path initExecSocketPath(const std::filesystem::path &bundleDir) noexcept
+{
+    return bundleDir / InitExecDir / InitExecSocket;
+}
+
+utils::error::Result<std::optional<int>>
+sendInitExecRequest(const std::filesystem::path &socketPath,
+                    const InitExecRequest &request) noexcept
+{
+    LINGLONG_TRACE("send exec request to ll-init");
+
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.native().size() >= sizeof(addr.sun_path)) {
+        LogD("exec socket path {} is too long", socketPath);
+        return std::nullopt;
+    }
+    std::copy(socketPath.native().begin(), socketPath.native().end(), addr.sun_path);
+
+    utils::fd::UniqueFd fd{ ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0) };
+    if (!fd) {
+        LogD("failed to create exec socket: {}", common::error::errorString(errno));
+        return std::nullopt;
+    }
+
+    if (::connect(fd.get(), reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+        LogD("ll-init doesn't listen on {}: {}", socketPath, common::error::errorString(errno));
+        return std::nullopt;
+    }
+
+    auto sent = common::socket::sendFdsWithPayload(fd.get(),
+                                                   { request.stdio.begin(), request.stdio.end() },
+                                                   encodeRequest(request));
+    if (!sent) {
+        LogD("failed to send exec request: {}", sent.error());
+        return std::nullopt;
+    }
+
+    // "exit <code>" once the command exited, or "error <reason>" if it isn't started
+    std::string reply(4096, '\0');
+    ssize_t n = -1;
+    while ((n = ::recv(fd.get(), reply.data(), reply.size(), 0)) == -1 && errno == EINTR) { }
+    if (n == -1) {
+        return LINGLONG_ERR("failed to receive the reply of ll-init", errno);
+    }
+    if (n == 0) {
+        return LINGLONG_ERR("ll-init closed the connection before the command exited");
+    }
+    reply.resize(static_cast<std::size_t>(n));
+
+    constexpr std::string_view errorPrefix = "error ";
+    if (reply.rfind(errorPrefix, 0) == 0) {
+        LogD("ll-init refused to run {}: {}",
+             request.args.empty() ? "" : request.args.front(),
+             reply.substr(errorPrefix.size()));
+        return std::nullopt;
+    }
+
+    constexpr std::string_view exitPrefix = "exit ";
+    int code{ -1 };
+    if (reply.rfind(exitPrefix, 0) == 0) {
+        const auto *begin = reply.data() + exitPrefix.size();
+        const auto *end = reply.data() + reply.size();
+        auto [ptr, ec] = std::from_chars(begin, end, code);
+        if (ec == std::errc{} && ptr == end) {
+            return code;
+        }
+    }
+
+    return LINGLONG_ERR(fmt::format("invalid reply of ll-init: {}", reply));
+}
+
+} // namespace linglong::runtime
@@ -0,0 +1,48 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/utils/error/error.h"
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace linglong::runtime {
+
+// the directory in the bundle which is mounted to common::dir::containerInitExecDir
+constexpr auto InitExecDir = "init";
+// ll-init of a running container listens on this socket in InitExecDir
+constexpr auto InitExecSocket = "exec.sock";
+
+// A command run by ll-init in a running container. The process gets stdio as its stdin, stdout
+// and stderr. It inherits the environment and working directory of ll-init if env or cwd is
+// empty, which are the ones of the container process like `ociCLI.exec`.
+struct InitExecRequest
+{
+    std::vector<std::string> args;
+    std::vector<std::string> env;
+    std::string cwd;
+    std::array<int, 3> stdio{ STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+};
+
+// the exec socket of the container in bundleDir
+std::filesystem::path initExecSocketPath(const std::filesystem::path &bundleDir) noexcept;
+
+// Send request to ll-init listening on socketPath and wait for the command. Returns std::nullopt
+// if ll-init doesn't listen or refused the request, the caller should run the command by the OCI
+// runtime then. An error means the command was started but the connection to ll-init is lost
+// before it exited.
+utils::error::Result<std::optional<int>>
+sendInitExecRequest(const std::filesystem::path &socketPath,
+                    const InitExecRequest &request) noexcept;
+
+} // namespace linglong::runtime
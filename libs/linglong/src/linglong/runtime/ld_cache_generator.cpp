@@ -0,0 +1,882 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "linglong/runtime/ld_cache_generator.h"
+
+#include "linglong/utils/file.h"
+#include "linglong/utils/finally/finally.h"
+#include "linglong/utils/log/log.h"
+
+#include <elf.h>
+#include <fmt/format.h>
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef EM_LOONGARCH
+#  define EM_LOONGARCH 258
+#endif
+
+namespace linglong::runtime {
+
+namespace {
+
+// the values below are from elf/ldconfig.h and sysdeps/generic/dl-cache.h of glibc
+constexpr int32_t flagElfLibc6 = 0x0003;
+constexpr int32_t flagX8664Lib64 = 0x0300;
+constexpr int32_t flagAArch64Lib64 = 0x0a00;
+constexpr int32_t flagRiscvFloatAbiSoft = 0x0f00;
+constexpr int32_t flagRiscvFloatAbiDouble = 0x1000;
+constexpr int32_t flagLarchFloatAbiSoft = 0x1100;
+constexpr int32_t flagLarchFloatAbiDouble = 0x1200;
+
+constexpr std::string_view cacheMagic = "glibc-ld.so.cache1.1";
+constexpr uint8_t cacheFlagsLittleEndian = 2;
+constexpr uint32_t cacheExtensionMagic = 0xeaa42174;
+constexpr uint32_t cacheExtensionTagGenerator = 0;
+constexpr std::size_t cacheHeaderSize = 48;
+constexpr std::size_t cacheEntrySize = 24;
+
+constexpr int maxSymlinks = 40;
+constexpr int maxIncludeDepth = 16;
+
+// _dl_is_dso of glibc, the dynamic loader is a shared library as well
+bool isDso(std::string_view name) noexcept
+{
+    return (name.rfind("lib", 0) == 0 || name.rfind("ld-", 0) == 0)
+      && name.find(".so") != std::string_view::npos;
+}
+
+// subdirectories which ldconfig would scan as legacy hwcaps directories
+bool isHwcapDir(std::string_view name) noexcept
+{
+    constexpr std::array<std::string_view, 8> names{
+        "tls", "x86_64", "avx512_1", "i586", "i686", "haswell", "xeon_phi", "glibc-hwcaps",
+    };
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+// _dl_cache_libcmp of glibc, numbers in names are compared by their values
+int libcmp(std::string_view left, std::string_view right) noexcept
+{
+    auto isDigit = [](char c) {
+        return c >= '0' && c <= '9';
+    };
+
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < left.size()) {
+        auto l = left[i];
+        auto r = j < right.size() ? right[j] : '\0';
+        if (isDigit(l)) {
+            if (!isDigit(r)) {
+                return 1;
+            }
+
+            int leftValue = 0;
+            int rightValue = 0;
+            while (i < left.size() && isDigit(left[i])) {
+                leftValue = leftValue * 10 + left[i++] - '0';
+            }
+            while (j < right.size() && isDigit(right[j])) {
+                rightValue = rightValue * 10 + right[j++] - '0';
+            }
+            if (leftValue != rightValue) {
+                return leftValue - rightValue;
+            }
+        } else if (isDigit(r)) {
+            return -1;
+        } else if (l != r) {
+            return static_cast<signed char>(l) - static_cast<signed char>(r);
+        } else {
+            ++i;
+            ++j;
+        }
+    }
+
+    return j < right.size() ? -static_cast<signed char>(right[j]) : 0;
+}
+
+// tail_cmp of glibc, descending by the reversed strings so a suffix comes after the strings it
+// can be merged into
+bool tailLess(const std::string &left, const std::string &right) noexcept
+{
+    auto count = std::min(left.size(), right.size());
+    for (std::size_t i = 1; i <= count; ++i) {
+        auto l = static_cast<unsigned char>(left[left.size() - i]);
+        auto r = static_cast<unsigned char>(right[right.size() - i]);
+        if (l != r) {
+            return l > r;
+        }
+    }
+
+    return left.size() > right.size();
+}
+
+template <typename T>
+void append(std::string &buffer, T value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// the flags of libraries of the architecture that ldconfig would write into the cache
+utils::error::Result<int32_t> libraryFlags(const package::Architecture &arch,
+                                           const Elf64_Ehdr &header)
+{
+    LINGLONG_TRACE("get library flags");
+
+    auto machine = [&arch]() -> std::optional<Elf64_Half> {
+        if (arch == package::Architecture(package::Architecture::X86_64)) {
+            return EM_X86_64;
+        }
+        if (arch == package::Architecture(package::Architecture::ARM64)) {
+            return EM_AARCH64;
+        }
+        if (arch == package::Architecture(package::Architecture::LOONG64)) {
+            return EM_LOONGARCH;
+        }
+        if (arch == package::Architecture(package::Architecture::RISCV64)) {
+            return EM_RISCV;
+        }
+        return std::nullopt;
+    }();
+    if (!machine) {
+        return LINGLONG_ERR("unsupported architecture " + arch.toString());
+    }
+
+    if (header.e_ident[EI_CLASS] != ELFCLASS64 || header.e_ident[EI_DATA] != ELFDATA2LSB
+        || header.e_machine != *machine) {
+        return LINGLONG_ERR(fmt::format("library of machine {} class {} is not supported",
+                                        header.e_machine,
+                                        header.e_ident[EI_CLASS]));
+    }
+
+    switch (header.e_machine) {
+    case EM_X86_64:
+        return flagX8664Lib64 | flagElfLibc6;
+    case EM_AARCH64:
+        return flagAArch64Lib64 | flagElfLibc6;
+    case EM_LOONGARCH: {
+        // EF_LARCH_ABI_MODIFIER_MASK
+        auto abi = header.e_flags & 0x7;
+        if (abi == 0x1) {
+            return flagLarchFloatAbiSoft | flagElfLibc6;
+        }
+        if (abi == 0x3) {
+            return flagLarchFloatAbiDouble | flagElfLibc6;
+        }
+        break;
+    }
+    case EM_RISCV: {
+        // EF_RISCV_FLOAT_ABI, libraries of RV64E are ignored by ldconfig
+        auto abi = header.e_flags & 0x6;
+        if ((header.e_flags & 0x8) == 0 && abi == 0x0) {
+            return flagRiscvFloatAbiSoft | flagElfLibc6;
+        }
+        if ((header.e_flags & 0x8) == 0 && abi == 0x4) {
+            return flagRiscvFloatAbiDouble | flagElfLibc6;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return LINGLONG_ERR(fmt::format("library flags {:#x} are not supported", header.e_flags));
+}
+
+} // namespace
+
+LdCacheGenerator::LdCacheGenerator(std::vector<Mount> mounts, package::Architecture arch) noexcept
+    : mounts(std::move(mounts))
+    , arch(arch)
+{
+    for (auto &mount : this->mounts) {
+        mount.destination = mount.destination.lexically_normal();
+    }
+
+    // the deepest mount point of a path wins
+    std::stable_sort(this->mounts.begin(),
+                     this->mounts.end(),
+                     [](const Mount &left, const Mount &right) {
+                         return left.destination.string().size()
+                           > right.destination.string().size();
+                     });
+}
+
+void LdCacheGenerator::addFile(const std::filesystem::path &path, std::string content) noexcept
+{
+    this->files[path.lexically_normal()] = std::move(content);
+}
+
+std::filesystem::path LdCacheGenerator::hostPath(const std::filesystem::path &path) const
+{
+    for (const auto &mount : this->mounts) {
+        auto relative = path.lexically_relative(mount.destination);
+        if (relative.empty() || *relative.begin() == "..") {
+            continue;
+        }
+
+        return relative == "." ? mount.source : mount.source / relative;
+    }
+
+    return {};
+}
+
+std::optional<std::filesystem::path>
+LdCacheGenerator::resolve(const std::filesystem::path &path) const
+{
+    // like realpath(3), but symlinks are resolved inside of the container
+    std::vector<std::string> pending;
+    for (const auto &part : path.relative_path()) {
+        pending.emplace_back(part.string());
+    }
+    std::reverse(pending.begin(), pending.end());
+
+    std::filesystem::path resolved{ "/" };
+    int links = 0;
+    while (!pending.empty()) {
+        auto part = std::move(pending.back());
+        pending.pop_back();
+        if (part.empty() || part == ".") {
+            continue;
+        }
+        if (part == "..") {
+            resolved = resolved.parent_path();
+            continue;
+        }
+
+        auto next = resolved / part;
+        if (this->files.find(next) != this->files.end()) {
+            resolved = std::move(next);
+            continue;
+        }
+
+        auto host = hostPath(next);
+        struct stat st{};
+        if (host.empty() || ::lstat(host.c_str(), &st) != 0) {
+            // the parent directories of mount points are created by the runtime
+            auto isParent =
+              std::any_of(this->mounts.begin(), this->mounts.end(), [&next](const Mount &mount) {
+                  auto relative = mount.destination.lexically_relative(next);
+                  return !relative.empty() && *relative.begin() != "..";
+              });
+            if (!isParent) {
+                return std::nullopt;
+            }
+
+            resolved = std::move(next);
+            continue;
+        }
+
+        if (!S_ISLNK(st.st_mode)) {
+            resolved = std::move(next);
+            continue;
+        }
+
+        std::error_code ec;
+        auto target = std::filesystem::read_symlink(host, ec);
+        if (ec || ++links > maxSymlinks) {
+            return std::nullopt;
+        }
+
+        if (target.is_absolute()) {
+            resolved = "/";
+        }
+
+        std::vector<std::string> parts;
+        for (const auto &targetPart : target.relative_path()) {
+            parts.emplace_back(targetPart.string());
+        }
+        pending.insert(pending.end(), parts.rbegin(), parts.rend());
+    }
+
+    return resolved;
+}
+
+std::optional<std::string> LdCacheGenerator::readFile(const std::filesystem::path &path) const
+{
+    auto resolved = resolve(path);
+    if (!resolved) {
+        return std::nullopt;
+    }
+
+    auto file = this->files.find(*resolved);
+    if (file != this->files.end()) {
+        return file->second;
+    }
+
+    std::ifstream stream(hostPath(*resolved));
+    if (!stream.is_open()) {
+        return std::nullopt;
+    }
+
+    std::stringstream content;
+    content << stream.rdbuf();
+    return content.str();
+}
+
+utils::error::Result<void>
+LdCacheGenerator::addConfFile(const std::filesystem::path &path) noexcept
+{
+    LINGLONG_TRACE(fmt::format("add ld config {}", path));
+
+    auto content = readFile(path);
+    if (!content) {
+        // ldconfig ignores a missing config as well
+        LogD("ld config {} doesn't exist", path);
+        return LINGLONG_OK;
+    }
+
+    auto ret = parseConf(path, *content, 0);
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+
+    return LINGLONG_OK;
+}
+
+// parse_conf of ldconfig
+utils::error::Result<void> LdCacheGenerator::parseConf(const std::filesystem::path &path,
+                                                       const std::string &content,
+                                                       int depth) noexcept
+{
+    LINGLONG_TRACE(fmt::format("parse ld config {}", path));
+
+    if (depth > maxIncludeDepth) {
+        return LINGLONG_ERR("too many levels of includes");
+    }
+
+    std::istringstream stream(content);
+    std::string line;
+    while (std::getline(stream, line)) {
+        line.erase(std::min(line.find('#'), line.size()));
+
+        auto begin = std::find_if_not(line.begin(), line.end(), [](unsigned char c) {
+            return std::isspace(c);
+        });
+        std::string entry(begin, line.end());
+        if (entry.empty()) {
+            continue;
+        }
+
+        auto isBlank = [&entry](std::size_t pos) {
+            return entry.size() > pos && (entry[pos] == ' ' || entry[pos] == '\t');
+        };
+
+        if (entry.rfind("include", 0) == 0 && isBlank(7)) {
+            std::size_t begin = 8;
+            while (begin <= entry.size()) {
+                auto end = std::min(entry.find_first_of(" \t", begin), entry.size());
+                if (end > begin) {
+                    auto ret = includeConf(path, entry.substr(begin, end - begin), depth);
+                    if (!ret) {
+                        return LINGLONG_ERR(ret);
+                    }
+                }
+                begin = end + 1;
+            }
+            continue;
+        }
+
+        if (::strncasecmp(entry.c_str(), "hwcap", 5) == 0 && isBlank(5)) {
+            LogD("{}: hwcap directive ignored", path);
+            continue;
+        }
+
+        addDir(entry);
+    }
+
+    return LINGLONG_OK;
+}
+
+// parse_conf_include of ldconfig, which globs the pattern
+utils::error::Result<void> LdCacheGenerator::includeConf(const std::filesystem::path &conf,
+                                                         const std::string &pattern,
+                                                         int depth) noexcept
+{
+    LINGLONG_TRACE(fmt::format("include {}", pattern));
+
+    std::filesystem::path fullPattern{ pattern };
+    if (fullPattern.is_relative()) {
+        fullPattern = conf.parent_path() / fullPattern;
+    }
+
+    auto dir = fullPattern.parent_path();
+    auto name = fullPattern.filename().string();
+    if (dir.string().find_first_of("*?[") != std::string::npos) {
+        return LINGLONG_ERR("wildcards in directories are not supported");
+    }
+
+    std::set<std::string> matched;
+    if (name.find_first_of("*?[") == std::string::npos) {
+        matched.emplace(name);
+    } else {
+        auto resolvedDir = resolve(dir);
+        if (!resolvedDir) {
+            return LINGLONG_OK;
+        }
+
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(hostPath(*resolvedDir), ec)) {
+            matched.emplace(entry.path().filename().string());
+        }
+        for (const auto &file : this->files) {
+            if (file.first.parent_path() == *resolvedDir) {
+                matched.emplace(file.first.filename().string());
+            }
+        }
+
+        for (auto it = matched.begin(); it != matched.end();) {
+            if (::fnmatch(name.c_str(), it->c_str(), FNM_PERIOD) != 0) {
+                it = matched.erase(it);
+                continue;
+            }
+            ++it;
+        }
+    }
+
+    for (const auto &file : matched) {
+        auto path = dir / file;
+        auto content = readFile(path);
+        if (!content) {
+            continue;
+        }
+
+        auto ret = parseConf(path, *content, depth + 1);
+        if (!ret) {
+            return LINGLONG_ERR(ret);
+        }
+    }
+
+    return LINGLONG_OK;
+}
+
+void LdCacheGenerator::addSystemDirs() noexcept
+{
+    auto triplet = this->arch.getTriplet();
+    for (const std::string base : { "/lib", "/usr/lib" }) {
+        addDir(base + "/" + triplet);
+        addDir(base);
+    }
+}
+
+// add_dir_1 of ldconfig, missing directories are skipped
+void LdCacheGenerator::addDir(const std::string &dir) noexcept
+{
+    auto path = dir;
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+
+    auto resolved = resolve(path);
+    if (!resolved) {
+        LogD("can't stat {}", path);
+        return;
+    }
+
+    auto host = hostPath(*resolved);
+    struct stat st{};
+    if (host.empty() || ::stat(host.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        LogD("{} is not a directory", path);
+        return;
+    }
+
+    auto duplicated = std::any_of(this->dirs.begin(), this->dirs.end(), [&st](const Dir &dir) {
+        return dir.dev == st.st_dev && dir.ino == st.st_ino;
+    });
+    if (duplicated) {
+        LogD("path {} given more than once", path);
+        return;
+    }
+
+    this->dirs.push_back(Dir{
+      .path = std::move(path),
+      .hostPath = std::move(host),
+      .dev = st.st_dev,
+      .ino = st.st_ino,
+    });
+}
+
+// process_elf_file of ldconfig, which ignores files that are not shared libraries
+utils::error::Result<std::optional<std::pair<std::string, int32_t>>>
+LdCacheGenerator::readLibrary(const std::filesystem::path &file) const
+{
+    LINGLONG_TRACE(fmt::format("read library {}", file));
+
+    auto fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return std::nullopt;
+    }
+    auto closeFd = utils::finally::finally([fd]() {
+        ::close(fd);
+    });
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+        || static_cast<std::size_t>(st.st_size) < sizeof(Elf64_Ehdr)) {
+        return std::nullopt;
+    }
+
+    auto size = static_cast<std::size_t>(st.st_size);
+    auto *contents = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (contents == MAP_FAILED) {
+        return std::nullopt;
+    }
+    auto unmap = utils::finally::finally([contents, size]() {
+        ::munmap(contents, size);
+    });
+
+    const auto *begin = static_cast<const char *>(contents);
+    auto inFile = [size](uint64_t offset, uint64_t length) {
+        return offset <= size && length <= size - offset;
+    };
+
+    Elf64_Ehdr header{};
+    std::memcpy(&header, begin, sizeof(header));
+    if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0) {
+        return std::nullopt;
+    }
+
+    auto flags = libraryFlags(this->arch, header);
+    if (!flags) {
+        return LINGLONG_ERR(flags);
+    }
+
+    if (header.e_type != ET_DYN
+        || !inFile(header.e_phoff, uint64_t{ header.e_phnum } * sizeof(Elf64_Phdr))) {
+        return std::nullopt;
+    }
+
+    std::vector<Elf64_Phdr> segments(header.e_phnum);
+    std::memcpy(segments.data(), begin + header.e_phoff, segments.size() * sizeof(Elf64_Phdr));
+
+    std::optional<Elf64_Addr> loadAddress;
+    Elf64_Off dynamicOffset = 0;
+    Elf64_Xword dynamicSize = 0;
+    for (const auto &segment : segments) {
+        if (segment.p_type == PT_LOAD && !loadAddress) {
+            loadAddress = segment.p_vaddr - segment.p_offset;
+        } else if (segment.p_type == PT_DYNAMIC) {
+            dynamicOffset = segment.p_offset;
+            dynamicSize = segment.p_filesz;
+        }
+    }
+
+    if (dynamicSize == 0) {
+        return std::nullopt;
+    }
+
+    std::vector<Elf64_Dyn> dynamic;
+    for (auto offset = dynamicOffset;; offset += sizeof(Elf64_Dyn)) {
+        if (!inFile(offset, sizeof(Elf64_Dyn))) {
+            return std::nullopt;
+        }
+
+        Elf64_Dyn entry{};
+        std::memcpy(&entry, begin + offset, sizeof(entry));
+        if (entry.d_tag == DT_NULL) {
+            break;
+        }
+        dynamic.push_back(entry);
+    }
+
+    // the file offset of the dynamic string table
+    std::optional<uint64_t> strings;
+    for (const auto &entry : dynamic) {
+        if (entry.d_tag != DT_STRTAB) {
+            continue;
+        }
+
+        uint64_t offset = -loadAddress.value_or(0);
+        for (const auto &segment : segments) {
+            if (segment.p_type == PT_LOAD && entry.d_un.d_val >= segment.p_vaddr
+                && entry.d_un.d_val - segment.p_vaddr < segment.p_filesz) {
+                offset = segment.p_offset - segment.p_vaddr;
+                break;
+            }
+        }
+        strings = entry.d_un.d_val + offset;
+        break;
+    }
+
+    if (!strings || !inFile(*strings, 1)) {
+        return std::nullopt;
+    }
+
+    std::string soname;
+    for (const auto &entry : dynamic) {
+        if (entry.d_tag != DT_SONAME) {
+            continue;
+        }
+
+        auto offset = *strings + entry.d_un.d_val;
+        if (!inFile(offset, 1)) {
+            return std::nullopt;
+        }
+        soname.assign(begin + offset, ::strnlen(begin + offset, size - offset));
+    }
+
+    return std::make_pair(std::move(soname), *flags);
+}
+
+// search_dir of ldconfig without creating the symlinks of sonames
+utils::error::Result<std::vector<LdCacheGenerator::Library>>
+LdCacheGenerator::scanDir(const Dir &dir) const
+{
+    LINGLONG_TRACE(fmt::format("scan {}", dir.path));
+
+    std::vector<Library> libraries;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(dir.hostPath, ec)) {
+        auto name = entry.path().filename().string();
+        auto dso = isDso(name);
+        if (!dso && !isHwcapDir(name)) {
+            continue;
+        }
+
+        // temporary files of prelink
+        if (name.find(".#prelink#") != std::string::npos) {
+            continue;
+        }
+
+        struct stat lst{};
+        if (::lstat(entry.path().c_str(), &lst) != 0) {
+            continue;
+        }
+
+        auto isLink = S_ISLNK(lst.st_mode);
+        std::filesystem::path file = entry.path();
+        struct stat st = lst;
+        if (isLink) {
+            auto resolved = resolve(dir.path + "/" + name);
+            if (!resolved) {
+                continue;
+            }
+
+            file = hostPath(*resolved);
+            if (::stat(file.c_str(), &st) != 0) {
+                continue;
+            }
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            if (isHwcapDir(name)) {
+                return LINGLONG_ERR(fmt::format("hwcap subdirectory {} is not supported", name));
+            }
+            continue;
+        }
+
+        if (!dso || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        auto library = readLibrary(file);
+        if (!library) {
+            return LINGLONG_ERR(library);
+        }
+        if (!*library) {
+            continue;
+        }
+
+        auto [soname, flags] = std::move(**library);
+        if (soname.empty()) {
+            soname = name;
+        }
+
+        // a link is only a link if it's the soname or the .so symlink for ld(1), otherwise it's
+        // treated like a normal file
+        if (isLink && name != soname) {
+            constexpr std::string_view suffix = ".so";
+            if (name.size() < suffix.size()
+                || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0
+                || soname.compare(0, name.size(), name) != 0) {
+                isLink = false;
+            }
+        }
+        if (isLink) {
+            soname = name;
+        }
+
+        auto existing =
+          std::find_if(libraries.begin(), libraries.end(), [&soname](const Library &library) {
+              return library.soname == soname;
+          });
+        if (existing == libraries.end()) {
+            libraries.push_back(Library{
+              .name = std::move(name),
+              .soname = std::move(soname),
+              .flags = flags,
+              .isLink = isLink,
+            });
+            continue;
+        }
+
+        // prefer a file to a link, otherwise the newer one
+        if ((!isLink && existing->isLink)
+            || (isLink == existing->isLink && libcmp(existing->name, name) < 0)) {
+            existing->name = std::move(name);
+            existing->flags = flags;
+            existing->isLink = isLink;
+        }
+    }
+
+    if (ec) {
+        LogD("can't open directory {}: {}", dir.path, ec.message());
+    }
+
+    // ldconfig adds the libraries in the reverse order of the directory entries
+    std::reverse(libraries.begin(), libraries.end());
+    return libraries;
+}
+
+// save_cache of ldconfig for the new format
+utils::error::Result<std::string>
+LdCacheGenerator::generate(std::string_view generator) const noexcept
+{
+    LINGLONG_TRACE("generate ld.so.cache");
+
+    struct Entry
+    {
+        std::string key;
+        std::string value;
+        int32_t flags;
+    };
+
+    std::vector<Entry> entries;
+    for (const auto &dir : this->dirs) {
+        auto libraries = scanDir(dir);
+        if (!libraries) {
+            return LINGLONG_ERR(libraries);
+        }
+
+        for (auto &library : *libraries) {
+            auto value = dir.path + "/" + library.soname;
+            entries.push_back(Entry{
+              .key = std::move(library.soname),
+              .value = std::move(value),
+              .flags = library.flags,
+            });
+        }
+    }
+
+    // descending by names then flags, entries in earlier directories come first
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &left, const Entry &right) {
+        auto res = libcmp(right.key, left.key);
+        return res < 0 || (res == 0 && left.flags > right.flags);
+    });
+
+    // the string table merges strings which are suffixes of others
+    std::vector<std::string> strings;
+    for (const auto &entry : entries) {
+        strings.push_back(entry.key);
+        strings.push_back(entry.value);
+    }
+    std::sort(strings.begin(), strings.end(), tailLess);
+    strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+
+    std::map<std::string_view, uint32_t> offsets;
+    std::string table;
+    for (std::size_t i = 0; i < strings.size(); ++i) {
+        const auto &current = strings[i];
+        if (i > 0) {
+            const auto &previous = strings[i - 1];
+            if (previous.size() > current.size()
+                && previous.compare(previous.size() - current.size(), current.size(), current)
+                  == 0) {
+                offsets[current] =
+                  offsets[previous] + static_cast<uint32_t>(previous.size() - current.size());
+                continue;
+            }
+        }
+
+        offsets[current] = static_cast<uint32_t>(table.size());
+        table.append(current);
+        table.push_back('\0');
+    }
+
+    auto stringsOffset = static_cast<uint32_t>(cacheHeaderSize + entries.size() * cacheEntrySize);
+    auto extensionOffset = static_cast<uint32_t>((stringsOffset + table.size() + 3) & ~3U);
+
+    std::string cache;
+    cache.reserve(extensionOffset + 24 + generator.size());
+    cache.append(cacheMagic);
+    append(cache, static_cast<uint32_t>(entries.size()));
+    append(cache, static_cast<uint32_t>(table.size()));
+    append(cache, cacheFlagsLittleEndian);
+    cache.append(3, '\0');
+    append(cache, extensionOffset);
+    cache.append(12, '\0');
+
+    for (const auto &entry : entries) {
+        append(cache, entry.flags);
+        append(cache, stringsOffset + offsets[entry.key]);
+        append(cache, stringsOffset + offsets[entry.value]);
+        append(cache, uint32_t{ 0 });
+        append(cache, uint64_t{ 0 });
+    }
+
+    cache.append(table);
+    cache.resize(extensionOffset, '\0');
+
+    append(cache, cacheExtensionMagic);
+    append(cache, uint32_t{ 1 });
+    append(cache, cacheExtensionTagGenerator);
+    append(cache, uint32_t{ 0 });
+    append(cache, static_cast<uint32_t>(cache.size() + 2 * sizeof(uint32_t)));
+    append(cache, static_cast<uint32_t>(generator.size()));
+    cache.append(generator);
+
+    return cache;
+}
+
+utils::error::Result<void> LdCacheGenerator::write(const std::filesystem::path &file,
+                                                   std::string_view generator) const noexcept
+{
+    LINGLONG_TRACE(fmt::format("write ld.so.cache to {}", file));
+
+    auto cache = generate(generator);
+    if (!cache) {
+        return LINGLONG_ERR(cache);
+    }
+
+    auto ret = utils::ensureDirectory(file.parent_path());
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+
+    // the loader may read the cache at any time, replace it atomically like ldconfig
+    auto tmpFile = file;
+    tmpFile += "~";
+    ret = utils::writeFile(tmpFile, *cache);
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpFile, file, ec);
+    if (ec) {
+        std::filesystem::remove(tmpFile, ec);
+        return LINGLONG_ERR(fmt::format("failed to rename {}", tmpFile), ec);
+    }
+
+    return LINGLONG_OK;
+}
+
+} // namespace linglong::runtime
@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/package/architecture.h"
+#include "linglong/utils/error/error.h"
+
+#include <sys/types.h>
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace linglong::runtime {
+
+// LdCacheGenerator generates the ld.so.cache of a container on the host, so the container doesn't
+// have to be started to run ldconfig in it. The filesystem of the container is described by the
+// mounts from container paths to host paths, symlinks are resolved inside of the container.
+//
+// The cache is in the new format of glibc 2.32 and later. It's the same as the cache written by
+// `ldconfig -X` of such a glibc with the same generator string, as long as the scanned
+// directories only contain libraries of the target architecture. Everything else, like
+// glibc-hwcaps subdirectories, is reported as an error and the caller should run ldconfig.
+class LdCacheGenerator
+{
+public:
+    struct Mount
+    {
+        std::filesystem::path destination;
+        std::filesystem::path source;
+    };
+
+    LdCacheGenerator(std::vector<Mount> mounts, package::Architecture arch) noexcept;
+
+    // Add a file which is not in the mounts, it shadows the files of the mounts.
+    void addFile(const std::filesystem::path &path, std::string content) noexcept;
+
+    // Add the directories of the ld.so.conf at path in the container.
+    utils::error::Result<void> addConfFile(const std::filesystem::path &path) noexcept;
+
+    // Add the directories that ldconfig of Debian based distributions always scans.
+    void addSystemDirs() noexcept;
+
+    void addDir(const std::string &dir) noexcept;
+
+    [[nodiscard]] utils::error::Result<std::string>
+    generate(std::string_view generator) const noexcept;
+
+    [[nodiscard]] utils::error::Result<void> write(const std::filesystem::path &file,
+                                                   std::string_view generator) const noexcept;
+
+private:
+    struct Dir
+    {
+        std::string path;
+        std::filesystem::path hostPath;
+        dev_t dev;
+        ino_t ino;
+    };
+
+    struct Library
+    {
+        std::string name;
+        std::string soname;
+        int32_t flags;
+        bool isLink;
+    };
+
+    [[nodiscard]] std::filesystem::path hostPath(const std::filesystem::path &path) const;
+    [[nodiscard]] std::optional<std::filesystem::path>
+    resolve(const std::filesystem::path &path) const;
+    [[nodiscard]] std::optional<std::string> readFile(const std::filesystem::path &path) const;
+
+    utils::error::Result<void> parseConf(const std::filesystem::path &path,
+                                         const std::string &content,
+                                         int depth) noexcept;
+    utils::error::Result<void> includeConf(const std::filesystem::path &conf,
+                                           const std::string &pattern,
+                                           int depth) noexcept;
+
+    [[nodiscard]] utils::error::Result<std::vector<Library>> scanDir(const Dir &dir) const;
+    [[nodiscard]] utils::error::Result<std::optional<std::pair<std::string, int32_t>>>
+    readLibrary(const std::filesystem::path &file) const;
+
+    std::vector<Mount> mounts;
+    package::Architecture arch;
+    std::map<std::filesystem::path, std::string> files;
+    std::vector<Dir> dirs;
+};
+
+} // namespace linglong::runtime
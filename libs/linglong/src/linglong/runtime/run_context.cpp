@@ -12,7 +12,9 @@
 #include "linglong/oci-cfg-generators/container_cfg_builder.h"
 #include "linglong/runtime/container_builder.h"
 #include "linglong/runtime/overlayfs_driver.h"
+#include "linglong/runtime/run_context_cache.h"
 #include "linglong/utils/log/log.h"
+#include "linglong/utils/log/trace.h"
 
 #include <fmt/ranges.h>
 
@@ -182,6 +184,7 @@ utils::error::Result<void> RunContext::resolve(const linglong::package::Referenc
                                                const ResolveOptions &opts)
 {
     LINGLONG_TRACE("resolve RunContext from runnable " + runnable.toString());
+    LogSpan("resolve run context");
 
     auto layer = RuntimeLayer::create(runnable, *this);
     if (!layer) {
@@ -391,8 +394,86 @@ utils::error::Result<void> RunContext::resolve(const api::types::v1::BuilderProj
 }
 
 utils::error::Result<void> RunContext::resolve(const api::types::v1::RunContextConfig &config)
+{
+    return resolveFromConfig(config, false, {});
+}
+
+utils::error::Result<void> RunContext::resolve(const linglong::package::Reference &runnable,
+                                               const ResolveOptions &opts,
+                                               RunContextCache &cache)
+{
+    LINGLONG_TRACE("resolve RunContext from runnable " + runnable.toString() + " with cache");
+    LogSpan("resolve cached run context");
+
+    RunContextCache::Key key{ .repoDir = repo.getRepoDir(),
+                              .ref = runnable.toString(),
+                              .options = opts };
+    auto generation = repo.cacheGeneration();
+    if (auto cached = cache.lookup(key, generation); cached) {
+        // the cached config only contains what is resolved from the repo
+        auto config = std::move(cached).value();
+        auto ret = resolveTimeZone();
+        if (ret) {
+            ret = resolveNetworkConf();
+        }
+        if (ret) {
+            config.timezone = contextCfg.timezone;
+            config.resolvConf = contextCfg.resolvConf;
+            config.cdiDevices = opts.cdiDevices;
+            config.instance = opts.instance;
+            config.mounts = opts.mounts;
+            if (config.mounts) {
+                ensureMountSrcType(*config.mounts);
+            }
+
+            ret = resolveFromConfig(config,
+                                    opts.depsExcludeDev,
+                                    opts.appModules.value_or(std::vector<std::string>{}));
+        }
+        if (ret) {
+            LogD("reuse run context of {} at repo generation {}", runnable.toString(), generation);
+            return LINGLONG_OK;
+        }
+
+        LogW("failed to reuse cached run context of {}: {}", runnable.toString(), ret.error());
+        reset();
+    }
+
+    auto ret = resolve(runnable, opts);
+    if (!ret) {
+        return LINGLONG_ERR(ret);
+    }
+
+    auto config = contextCfg;
+    config.timezone = std::nullopt;
+    config.resolvConf = std::nullopt;
+    config.cdiDevices = std::nullopt;
+    config.instance = std::nullopt;
+    config.mounts = std::nullopt;
+    cache.store(key, generation, config);
+
+    return LINGLONG_OK;
+}
+
+void RunContext::reset() noexcept
+{
+    baseLayer.reset();
+    runtimeLayer.reset();
+    appLayer.reset();
+    extensionLayers.clear();
+    targetId.clear();
+    containerID.clear();
+    environment.clear();
+    contextCfg = api::types::v1::RunContextConfig{};
+}
+
+utils::error::Result<void>
+RunContext::resolveFromConfig(const api::types::v1::RunContextConfig &config,
+                              bool depsExcludeDev,
+                              const std::vector<std::string> &appModules)
 {
     LINGLONG_TRACE("resolve RunContext from config");
+    LogSpan("resolve run context from config");
 
     if (config.version != runContextConfigVersion) {
         return LINGLONG_ERR(fmt::format("run context config version mismatch: config version {}, "
@@ -566,7 +647,7 @@ utils::error::Result<void> RunContext::resolve(const api::types::v1::RunContextC
     contextCfg.mounts = config.mounts;
     contextCfg.version = runContextConfigVersion;
 
-    return resolveLayer(false, {});
+    return resolveLayer(depsExcludeDev, appModules);
 }
 
 utils::error::Result<void> RunContext::setupCDIDevices(generator::ContainerCfgBuilder &builder,
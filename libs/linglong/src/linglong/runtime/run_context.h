@@ -52,6 +52,8 @@ struct ResolveOptions
                       const cli::RunOptions &options) -> utils::error::Result<void>;
 };
 
+class RunContextCache;
+
 class RunContext
 {
 public:
@@ -70,6 +72,13 @@ public:
 
     utils::error::Result<void> resolve(const api::types::v1::RunContextConfig &config);
 
+    // Same as resolve(runnable, opts), but the config resolved by a previous call is reused if
+    // the repo cache isn't changed since then. The time zone and network configuration of the
+    // host are always resolved again.
+    utils::error::Result<void> resolve(const linglong::package::Reference &runnable,
+                                       const ResolveOptions &opts,
+                                       RunContextCache &cache);
+
     [[nodiscard]] const api::types::v1::RunContextConfig &getConfig() const { return contextCfg; }
 
     utils::error::Result<void> fillContextCfg(generator::ContainerCfgBuilder &builder,
@@ -119,6 +128,10 @@ protected:
       -> utils::error::Result<utils::OverlayMode>;
 
 private:
+    void reset() noexcept;
+    utils::error::Result<void> resolveFromConfig(const api::types::v1::RunContextConfig &config,
+                                                 bool depsExcludeDev,
+                                                 const std::vector<std::string> &appModules);
     utils::error::Result<void> resolveLayer(bool depsExcludeDev,
                                             const std::vector<std::string> &appModules);
     utils::error::Result<void> resolveLayerExtensions(
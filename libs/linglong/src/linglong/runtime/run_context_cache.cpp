@@ -0,0 +1,139 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "run_context_cache.h"
+
+#include "linglong/api/types/v1/Generators.hpp" // IWYU pragma: keep
+#include "linglong/utils/file.h"
+#include "linglong/utils/log/log.h"
+#include "linglong/utils/sha256.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+#include <sys/utsname.h>
+
+namespace linglong::runtime {
+
+namespace {
+
+template <typename T>
+nlohmann::json optionalToJson(const std::optional<T> &value)
+{
+    return value ? nlohmann::json(*value) : nlohmann::json(nullptr);
+}
+
+nlohmann::json keyToJson(const RunContextCache::Key &key)
+{
+    const auto &options = key.options;
+    return nlohmann::json{
+        { "repoDir", key.repoDir.string() },
+        { "ref", key.ref },
+        { "depsExcludeDev", options.depsExcludeDev },
+        { "appModules", optionalToJson(options.appModules) },
+        { "baseRef", optionalToJson(options.baseRef) },
+        { "runtimeRef", optionalToJson(options.runtimeRef) },
+        { "extensionRefs", optionalToJson(options.extensionRefs) },
+        { "externalExtensionDefs", optionalToJson(options.externalExtensionDefs) },
+    };
+}
+
+// the overlayfs mode is detected from the kernel, entries are not shared between kernels
+std::string kernelRelease() noexcept
+{
+    struct utsname name{};
+    if (::uname(&name) == -1) {
+        return {};
+    }
+
+    return name.release;
+}
+
+} // namespace
+
+RunContextCache::RunContextCache(std::filesystem::path dir) noexcept
+    : dir(std::move(dir))
+{
+}
+
+std::filesystem::path RunContextCache::entryFile(const std::string &key) const noexcept
+{
+    return dir / (digest::sha256Hex(key) + ".json");
+}
+
+std::optional<api::types::v1::RunContextConfig>
+RunContextCache::lookup(const Key &key, uint64_t generation) const noexcept
+{
+    if (dir.empty()) {
+        return std::nullopt;
+    }
+
+    std::optional<api::types::v1::RunContextConfig> config;
+    std::filesystem::path file;
+    try {
+        auto keyJson = keyToJson(key);
+        file = entryFile(keyJson.dump());
+        std::ifstream stream(file);
+        if (!stream.is_open()) {
+            return std::nullopt;
+        }
+
+        auto json = nlohmann::json::parse(stream);
+        // guard against hash collisions
+        if (json.at("key") != keyJson || json.at("generation").get<uint64_t>() != generation
+            || json.at("kernel").get<std::string>() != kernelRelease()) {
+            LogD("run context cache {} is outdated", file);
+            return std::nullopt;
+        }
+
+        config = json.at("config").get<api::types::v1::RunContextConfig>();
+    } catch (const std::exception &e) {
+        LogD("ignore invalid run context cache {}: {}", file, e.what());
+    }
+
+    return config;
+}
+
+void RunContextCache::store(const Key &key,
+                            uint64_t generation,
+                            const api::types::v1::RunContextConfig &config) noexcept
+{
+    if (dir.empty()) {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        LogD("failed to create run context cache directory {}: {}", dir, ec.message());
+        return;
+    }
+
+    std::filesystem::path file;
+    std::string content;
+    try {
+        auto keyJson = keyToJson(key);
+        file = entryFile(keyJson.dump());
+        content = nlohmann::json{
+            { "key", std::move(keyJson) },
+            { "generation", generation },
+            { "kernel", kernelRelease() },
+            { "config", config },
+        }.dump();
+    } catch (const std::exception &e) {
+        LogD("failed to serialize run context cache: {}", e.what());
+        return;
+    }
+
+    // entries may be written by several processes
+    auto ret = utils::replaceFile(file, content);
+    if (!ret) {
+        LogD("failed to write run context cache: {}", ret.error());
+    }
+}
+
+} // namespace linglong::runtime
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/api/types/v1/RunContextConfig.hpp"
+#include "linglong/runtime/run_context.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace linglong::runtime {
+
+// RunContextCache keeps the RunContextConfig resolved from a runnable on disk, one JSON file per
+// runnable and resolve options. An entry is only valid for the repo cache generation it was
+// resolved with, so any install, upgrade or uninstall invalidates it. The entry of an older
+// generation is replaced by the next store.
+//
+// The cache is best effort, failures of reading or writing entries are only logged.
+class RunContextCache
+{
+public:
+    struct Key
+    {
+        std::filesystem::path repoDir;
+        std::string ref;
+        // only the options which affect the resolution of layers are part of the key
+        ResolveOptions options;
+    };
+
+    explicit RunContextCache(std::filesystem::path dir) noexcept;
+
+    [[nodiscard]] std::optional<api::types::v1::RunContextConfig>
+    lookup(const Key &key, uint64_t generation) const noexcept;
+    void store(const Key &key,
+               uint64_t generation,
+               const api::types::v1::RunContextConfig &config) noexcept;
+
+private:
+    [[nodiscard]] std::filesystem::path entryFile(const std::string &key) const noexcept;
+
+    std::filesystem::path dir;
+};
+
+} // namespace linglong::runtime
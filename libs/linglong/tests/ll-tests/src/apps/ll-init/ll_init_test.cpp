@@ -0,0 +1,243 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "common/tempdir.h"
+#include "linglong/runtime/init_exec.h"
+
+#include <sys/mount.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+#ifdef LL_INIT_PATH
+constexpr auto InitPath = LL_INIT_PATH;
+#else
+constexpr auto InitPath = "";
+#endif
+
+// the exit code of startInit if the namespaces can't be created
+constexpr int SkipCode = 77;
+
+bool writeFile(const char *path, const std::string &content) noexcept
+{
+    auto fd = ::open(path, O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    auto written = ::write(fd, content.data(), content.size());
+    ::close(fd);
+    return written == static_cast<ssize_t>(content.size());
+}
+
+std::string readFile(const std::filesystem::path &path)
+{
+    std::ifstream stream(path);
+    std::stringstream content;
+    content << stream.rdbuf();
+    return content.str();
+}
+
+// Run ll-init with args as the init process of new user, mount and pid namespaces like the OCI
+// runtime, with lockFile mounted as the lock of the container and execDir, if any, as the
+// directory of the exec socket. The returned process exits with the exit code of ll-init.
+pid_t startInit(const std::filesystem::path &lockFile,
+                std::vector<std::string> args,
+                const std::filesystem::path &execDir = {})
+{
+    args.insert(args.begin(), InitPath);
+    std::vector<char *> argv;
+    for (auto &arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+    auto uidMap = "0 " + std::to_string(::getuid()) + " 1";
+    auto gidMap = "0 " + std::to_string(::getgid()) + " 1";
+
+    auto pid = ::fork();
+    if (pid != 0) {
+        return pid;
+    }
+
+    if (::unshare(CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWPID) == -1
+        || !writeFile("/proc/self/setgroups", "deny")
+        || !writeFile("/proc/self/uid_map", uidMap) || !writeFile("/proc/self/gid_map", gidMap)) {
+        ::_exit(SkipCode);
+    }
+
+    auto init = ::fork();
+    if (init == 0) {
+        if (::mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) == -1
+            || ::mount("tmpfs", "/run", "tmpfs", 0, nullptr) == -1
+            || ::mkdir("/run/linglong", 0755) == -1) {
+            ::_exit(SkipCode);
+        }
+
+        auto fd = ::open("/run/linglong/.lock", O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            ::_exit(SkipCode);
+        }
+        ::close(fd);
+
+        if (::mount(lockFile.c_str(), "/run/linglong/.lock", nullptr, MS_BIND, nullptr) == -1) {
+            ::_exit(SkipCode);
+        }
+
+        if (!execDir.empty()
+            && (::mkdir("/run/linglong/init", 0755) == -1
+                || ::mount(execDir.c_str(), "/run/linglong/init", nullptr, MS_BIND, nullptr)
+                  == -1)) {
+            ::_exit(SkipCode);
+        }
+
+        ::execv(argv[0], argv.data());
+        ::_exit(EXIT_FAILURE);
+    }
+
+    int status = 0;
+    if (init == -1 || ::waitpid(init, &status, 0) != init || !WIFEXITED(status)) {
+        ::_exit(EXIT_FAILURE);
+    }
+    ::_exit(WEXITSTATUS(status));
+}
+
+int waitInit(pid_t pid)
+{
+    int status = 0;
+    EXPECT_EQ(::waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+class LLInitTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        if (std::string_view{ InitPath }.empty()) {
+            GTEST_SKIP() << "the path of ll-init is unknown";
+        }
+        lockFile = tempDir.path() / ".lock";
+        std::ofstream{ lockFile } << "initializing";
+    }
+
+    bool waitForRunning() const
+    {
+        for (auto i = 0; i < 500; ++i) {
+            if (readFile(lockFile) == "running") {
+                return true;
+            }
+            std::this_thread::sleep_for(10ms);
+        }
+        return false;
+    }
+
+    TempDir tempDir;
+    std::filesystem::path lockFile;
+};
+
+TEST_F(LLInitTest, ExitWithChild)
+{
+    auto init = startInit(lockFile, { "sh", "-c", "exit 3" });
+    ASSERT_NE(init, -1);
+
+    auto code = waitInit(init);
+    if (code == SkipCode) {
+        GTEST_SKIP() << "failed to create namespaces";
+    }
+    EXPECT_EQ(code, 3);
+    EXPECT_EQ(readFile(lockFile), "quitting");
+}
+
+// ll-init waits for the lock instead of polling it once the child exited while ll-cli was reusing
+// the container, it quits as soon as the lock is released.
+TEST_F(LLInitTest, QuitOnceLockReleased)
+{
+    auto init = startInit(lockFile, { "sh", "-c", "sleep 0.2; exit 3" });
+    ASSERT_NE(init, -1);
+    if (!waitForRunning()) {
+        auto code = waitInit(init);
+        if (code == SkipCode) {
+            GTEST_SKIP() << "failed to create namespaces";
+        }
+        FAIL() << "ll-init exited with " << code;
+    }
+
+    // ll-cli holds the read lock while reusing the container, the lock of this process is
+    // released once any fd of the file is closed, the file is not opened again until then
+    auto fd = ::open(lockFile.c_str(), O_RDONLY | O_CLOEXEC);
+    ASSERT_NE(fd, -1);
+    struct flock fl{};
+    fl.l_type = F_RDLCK;
+    fl.l_whence = SEEK_SET;
+    ASSERT_NE(::fcntl(fd, F_SETLKW, &fl), -1);
+
+    std::this_thread::sleep_for(500ms);
+    int status = 0;
+    ASSERT_EQ(::waitpid(init, &status, WNOHANG), 0) << "ll-init quit while the lock is held";
+
+    ::close(fd);
+    EXPECT_EQ(waitInit(init), 3);
+    EXPECT_EQ(readFile(lockFile), "quitting");
+}
+
+// A client which connects to the exec socket without sending its request doesn't stall ll-init,
+// the requests of other clients are still served.
+TEST_F(LLInitTest, IdleExecClient)
+{
+    auto execDir = tempDir.path() / "init";
+    std::filesystem::create_directories(execDir);
+    auto init = startInit(lockFile, { "sh", "-c", "sleep 1; exit 3" }, execDir);
+    ASSERT_NE(init, -1);
+    if (!waitForRunning()) {
+        auto code = waitInit(init);
+        if (code == SkipCode) {
+            GTEST_SKIP() << "failed to create namespaces";
+        }
+        FAIL() << "ll-init exited with " << code;
+    }
+
+    auto socketPath = execDir / linglong::runtime::InitExecSocket;
+    auto idle = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    ASSERT_NE(idle, -1);
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(::connect(idle, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)), 0);
+
+    auto begin = std::chrono::steady_clock::now();
+    auto ret = linglong::runtime::sendInitExecRequest(
+      socketPath,
+      linglong::runtime::InitExecRequest{ .args = { "sh", "-c", "exit 7" } });
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - begin);
+    ::close(idle);
+    ASSERT_TRUE(ret) << ret.error().message();
+    ASSERT_TRUE(ret->has_value());
+    EXPECT_EQ(**ret, 7);
+    EXPECT_LT(elapsed.count(), 500);
+
+    EXPECT_EQ(waitInit(init), 3);
+}
+
+} // namespace
@@ -0,0 +1,21 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+// Benchmarks are built into ll-tests but skipped unless LINGLONG_BENCHMARK is set, they are too
+// slow and too noisy to pass or fail a test run. They don't assert on timing, the results are
+// recorded as test properties:
+//
+//   LINGLONG_BENCHMARK=1 ll-tests --gtest_filter='*Benchmark*' --gtest_output=json:bench.json
+#define SKIP_UNLESS_BENCHMARK()                                                \
+    do {                                                                       \
+        if (std::getenv("LINGLONG_BENCHMARK") == nullptr) {                    \
+            GTEST_SKIP() << "benchmarks only run with LINGLONG_BENCHMARK set"; \
+        }                                                                      \
+    } while (false)
@@ -0,0 +1,207 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "../../common/benchmark.h"
+#include "linglong/builder/install_rules.h"
+
+#include <QRegularExpression>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using linglong::builder::InstallRules;
+
+namespace {
+
+// the matcher of installModule before the rules were compiled, every rule is tried for every
+// file and the regex rules are compiled again each time
+bool legacyMatches(const std::filesystem::path &buildOutput,
+                   const std::unordered_set<std::string> &rules,
+                   const std::filesystem::path &path)
+{
+    for (auto rule : rules) {
+        if (rule.empty() || (rule.size() > 1 && rule[0] == '#' && rule[1] == ' ')) {
+            continue;
+        }
+
+        if (rule.rfind("^", 0) != 0) {
+            if (rule[0] == '/') {
+                rule = rule.substr(1);
+            }
+            auto rulePath = buildOutput / rule;
+            auto relativePath = (buildOutput / path).lexically_relative(rulePath);
+            if (!relativePath.empty() && relativePath.string().rfind("..", 0) != 0) {
+                return true;
+            }
+        } else {
+            if (rule.rfind("^/", 0) != 0) {
+                rule.insert(1, buildOutput.string() + "/");
+            } else {
+                rule.insert(1, buildOutput);
+            }
+
+            QRegularExpression regexp(rule.c_str());
+            if (regexp.match((buildOutput / path).c_str()).hasMatch()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// a build output like the one of a Qt or Chromium based application
+std::vector<std::filesystem::path> syntheticTree(std::size_t count)
+{
+    std::vector<std::filesystem::path> paths;
+    paths.reserve(count);
+    for (std::size_t i = 0; paths.size() < count; ++i) {
+        auto n = std::to_string(i);
+        switch (i % 6) {
+        case 0:
+            paths.emplace_back("include/module" + std::to_string(i % 97) + "/header" + n + ".h");
+            break;
+        case 1:
+            paths.emplace_back("lib/x86_64-linux-gnu/libmodule" + n + ".so.5");
+            break;
+        case 2:
+            paths.emplace_back("lib/x86_64-linux-gnu/cmake/Module" + n + "Config.cmake");
+            break;
+        case 3:
+            paths.emplace_back("share/locale/" + std::to_string(i % 211) + "/LC_MESSAGES/app" + n
+                               + ".mo");
+            break;
+        case 4:
+            paths.emplace_back("share/icons/hicolor/" + std::to_string(i % 13) + "x"
+                               + std::to_string(i % 13) + "/apps/icon" + n + ".png");
+            break;
+        default:
+            paths.emplace_back("share/doc/app/page" + n + ".html");
+            break;
+        }
+    }
+    return paths;
+}
+
+const std::unordered_set<std::string> moduleRules = {
+    "# development files",
+    "",
+    "/include",
+    "^/lib/.+/cmake/.+",
+    "^/lib/.+\\.a$",
+    "/lib/x86_64-linux-gnu/pkgconfig/",
+    "/lib/x86_64-linux-gnu/libmodule42.so.5",
+    "^share/locale/1[0-9]/.+",
+    "^/share/icons/hicolor/(1)x\\1/.+",
+    "/share/doc/app/page5.html",
+    "^share/icons/hicolor/2x2/.+|page1[0-9]\\.html$",
+};
+
+const std::filesystem::path buildOutput{ "/project/linglong/output/binary" };
+
+TEST(InstallRules, PathRules)
+{
+    InstallRules rules(buildOutput, { "/bin/tool", "lib/", "share/applications", "# /share" });
+
+    EXPECT_TRUE(rules.matches("bin/tool"));
+    EXPECT_TRUE(rules.matches("lib"));
+    EXPECT_TRUE(rules.matches("lib/libfoo.so"));
+    EXPECT_TRUE(rules.matches("share/applications/app.desktop"));
+
+    EXPECT_FALSE(rules.matches("bin"));
+    EXPECT_FALSE(rules.matches("bin/tool2"));
+    EXPECT_FALSE(rules.matches("libexec/helper"));
+    EXPECT_FALSE(rules.matches("share"));
+    EXPECT_FALSE(rules.matches("share/app.desktop"));
+}
+
+TEST(InstallRules, RegexRules)
+{
+    InstallRules rules(buildOutput,
+                       { "^/include/.+", "^share/icons/(a|b)/\\1$", "^/lib/[", "^.+\\.debug$" });
+
+    EXPECT_TRUE(rules.matches("include/header.h"));
+    EXPECT_TRUE(rules.matches("share/icons/a/a"));
+    EXPECT_TRUE(rules.matches("lib/debug/libfoo.so.debug"));
+
+    EXPECT_FALSE(rules.matches("include"));
+    EXPECT_FALSE(rules.matches("share/icons/a/b"));
+    // the invalid rule is ignored
+    EXPECT_FALSE(rules.matches("lib/["));
+}
+
+// only the first branch of a rule is anchored at the build output
+TEST(InstallRules, TopLevelAlternation)
+{
+    const std::unordered_set<std::string> alternation = { "^/include/.+|lib",
+                                                          "^share$|binary/doc" };
+    InstallRules rules(buildOutput, alternation);
+
+    EXPECT_TRUE(rules.matches("include/header.h"));
+    EXPECT_TRUE(rules.matches("share"));
+    EXPECT_TRUE(rules.matches("lib"));
+    EXPECT_TRUE(rules.matches("share/libfoo.so"));
+    EXPECT_TRUE(rules.matches("doc/README"));
+
+    EXPECT_FALSE(rules.matches("include"));
+    EXPECT_FALSE(rules.matches("share/doc"));
+    EXPECT_FALSE(rules.matches("bin/tool"));
+
+    for (const auto *path : { "include/header.h", "share", "lib", "share/libfoo.so", "doc/README",
+                              "include", "share/doc", "bin/tool" }) {
+        EXPECT_EQ(rules.matches(path), legacyMatches(buildOutput, alternation, path)) << path;
+    }
+}
+
+TEST(InstallRules, SameAsLegacyMatcher)
+{
+    const InstallRules rules(buildOutput, moduleRules);
+
+    std::size_t matched = 0;
+    for (const auto &path : syntheticTree(3000)) {
+        auto expected = legacyMatches(buildOutput, moduleRules, path);
+        EXPECT_EQ(rules.matches(path), expected) << path;
+        matched += expected ? 1 : 0;
+    }
+    EXPECT_GT(matched, 0);
+}
+
+// matching the files of a synthetic 200k-file build output against the rules of a module, the
+// legacy matcher is timed on a sample and scaled to the whole tree
+TEST(InstallRules, MatchBenchmark)
+{
+    SKIP_UNLESS_BENCHMARK();
+
+    constexpr std::size_t FileCount = 200000;
+    constexpr std::size_t LegacySample = 2000;
+    using Clock = std::chrono::steady_clock;
+
+    auto paths = syntheticTree(FileCount);
+
+    auto begin = Clock::now();
+    const InstallRules rules(buildOutput, moduleRules);
+    std::size_t matched = 0;
+    for (const auto &path : paths) {
+        matched += rules.matches(path) ? 1 : 0;
+    }
+    std::chrono::duration<double, std::milli> compiled = Clock::now() - begin;
+
+    begin = Clock::now();
+    for (std::size_t i = 0; i < LegacySample; ++i) {
+        legacyMatches(buildOutput, moduleRules, paths[i]);
+    }
+    std::chrono::duration<double, std::milli> legacy =
+      (Clock::now() - begin) * (static_cast<double>(FileCount) / LegacySample);
+
+    EXPECT_GT(matched, 0);
+    EXPECT_LT(matched, FileCount);
+    RecordProperty("compiledMs", std::to_string(compiled.count()));
+    RecordProperty("legacyMs", std::to_string(legacy.count()));
+}
+
+} // namespace
@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "../../common/tempdir.h"
+#include "linglong/cdi/cdi.h"
+
+#include <cstdlib>
+#include <fstream>
+
+using namespace linglong;
+
+namespace {
+
+class CDITest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        if (auto *env = ::getenv("XDG_CACHE_HOME"); env != nullptr) {
+            oldCacheHome = env;
+        }
+        ::setenv("XDG_CACHE_HOME", (tempDir.path() / "cache").c_str(), 1);
+        specDir = tempDir.path() / "cdi";
+        std::filesystem::create_directories(specDir);
+    }
+
+    void TearDown() override
+    {
+        if (oldCacheHome) {
+            ::setenv("XDG_CACHE_HOME", oldCacheHome->c_str(), 1);
+        } else {
+            ::unsetenv("XDG_CACHE_HOME");
+        }
+    }
+
+    void writeSpec(const std::string &env)
+    {
+        std::ofstream spec(specDir / "vendor.yaml");
+        spec << "cdiVersion: \"0.6.0\"\n"
+             << "kind: \"vendor.com/device\"\n"
+             << "devices:\n"
+             << "  - name: \"gpu0\"\n"
+             << "    containerEdits:\n"
+             << "      env:\n"
+             << "        - \"" << env << "\"\n";
+    }
+
+    std::vector<std::filesystem::path> cacheFiles()
+    {
+        std::vector<std::filesystem::path> files;
+        std::error_code ec;
+        for (const auto &entry :
+             std::filesystem::directory_iterator(tempDir.path() / "cache/linglong/cdi", ec)) {
+            files.push_back(entry.path());
+        }
+        return files;
+    }
+
+    TempDir tempDir;
+    std::filesystem::path specDir;
+    std::optional<std::string> oldCacheHome;
+};
+
+TEST_F(CDITest, CacheParsedSpec)
+{
+    writeSpec("FOO=1");
+
+    auto devices = cdi::getCDIDevices({ specDir.string() }, std::nullopt);
+    ASSERT_TRUE(devices.has_value()) << devices.error().message();
+    ASSERT_EQ(devices->size(), 1);
+    EXPECT_EQ(devices->at(0).kind, "vendor.com/device");
+    EXPECT_EQ(devices->at(0).name, "gpu0");
+
+    auto files = cacheFiles();
+    ASSERT_EQ(files.size(), 1);
+    auto cacheTime = std::filesystem::last_write_time(files[0]);
+
+    // the cached spec is used without being written again
+    auto edits = cdi::getCDIDeviceEdits(devices->at(0));
+    ASSERT_TRUE(edits.has_value()) << edits.error().message();
+    ASSERT_TRUE(edits->env.has_value());
+    EXPECT_THAT(*edits->env, ::testing::ElementsAre("FOO=1"));
+    EXPECT_EQ(std::filesystem::last_write_time(files[0]), cacheTime);
+
+    // a changed spec is parsed again
+    writeSpec("FOO=2");
+    auto changed = cdi::getCDIDevices({ specDir.string() }, std::nullopt);
+    ASSERT_TRUE(changed.has_value()) << changed.error().message();
+    ASSERT_EQ(changed->size(), 1);
+    EXPECT_NE(changed->at(0).spec.checksum, devices->at(0).spec.checksum);
+
+    edits = cdi::getCDIDeviceEdits(changed->at(0));
+    ASSERT_TRUE(edits.has_value()) << edits.error().message();
+    ASSERT_TRUE(edits->env.has_value());
+    EXPECT_THAT(*edits->env, ::testing::ElementsAre("FOO=2"));
+    EXPECT_EQ(cacheFiles().size(), 1);
+
+    // the old device entry doesn't match the changed spec
+    EXPECT_FALSE(cdi::getCDIDeviceEdits(devices->at(0)).has_value());
+}
+
+} // namespace
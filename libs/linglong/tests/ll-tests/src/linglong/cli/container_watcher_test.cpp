@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "../../common/tempdir.h"
+#include "linglong/cli/container_watcher.h"
+
+#include <fstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace linglong::cli::test {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+class ContainerWatcherTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        bundleDir = tempDir.path() / "runtime" / "container";
+        cliLock = tempDir.path() / "user" / ".cli.container.lock";
+        std::filesystem::create_directories(cliLock.parent_path());
+        std::ofstream{ cliLock };
+    }
+
+    TempDir tempDir;
+    std::filesystem::path bundleDir;
+    std::filesystem::path cliLock;
+};
+
+TEST_F(ContainerWatcherTest, WakeUpOnContainerStarted)
+{
+    auto watcher = ContainerWatcher::create(bundleDir, cliLock);
+    ASSERT_TRUE(watcher) << watcher.error().message();
+
+    // the bundle is created by another ll-cli, then ll-init marks the container as running
+    std::thread starter([this]() {
+        std::this_thread::sleep_for(50ms);
+        std::filesystem::create_directories(bundleDir);
+        std::ofstream{ bundleDir / ".lock" } << "initializing";
+    });
+
+    auto changed = watcher->wait(30s);
+    ASSERT_TRUE(changed) << changed.error().message();
+    EXPECT_TRUE(*changed);
+    EXPECT_TRUE(std::filesystem::exists(bundleDir));
+    starter.join();
+
+    std::thread runner([this]() {
+        std::this_thread::sleep_for(50ms);
+        std::ofstream{ bundleDir / ".lock" } << "running";
+    });
+
+    // every wake up is caused by a change, the writes of the starter may wake it up once more
+    std::string state;
+    while (state != "running") {
+        changed = watcher->wait(30s);
+        ASSERT_TRUE(changed) << changed.error().message();
+        ASSERT_TRUE(*changed) << "container not marked as running";
+        std::ifstream{ bundleDir / ".lock" } >> state;
+    }
+    runner.join();
+}
+
+TEST_F(ContainerWatcherTest, WakeUpOnCliExited)
+{
+    auto watcher = ContainerWatcher::create(bundleDir, cliLock);
+    ASSERT_TRUE(watcher) << watcher.error().message();
+
+    auto fd = ::open(cliLock.c_str(), O_WRONLY | O_CLOEXEC);
+    ASSERT_NE(fd, -1);
+    std::thread cli([fd]() {
+        std::this_thread::sleep_for(50ms);
+        ::close(fd);
+    });
+
+    auto changed = watcher->wait(30s);
+    ASSERT_TRUE(changed) << changed.error().message();
+    EXPECT_TRUE(*changed);
+    cli.join();
+}
+
+TEST_F(ContainerWatcherTest, IgnoreUnrelatedChanges)
+{
+    std::filesystem::create_directories(bundleDir);
+    auto watcher = ContainerWatcher::create(bundleDir, cliLock);
+    ASSERT_TRUE(watcher) << watcher.error().message();
+
+    std::ofstream{ bundleDir / "config.json" } << "{}";
+    std::ofstream{ cliLock.parent_path() / "1234" } << "{}";
+    std::filesystem::create_directories(bundleDir.parent_path() / "other");
+
+    auto changed = watcher->wait(100ms);
+    ASSERT_TRUE(changed) << changed.error().message();
+    EXPECT_FALSE(*changed);
+}
+
+} // namespace
+
+} // namespace linglong::cli::test
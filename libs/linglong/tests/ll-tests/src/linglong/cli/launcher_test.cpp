@@ -0,0 +1,341 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "../../common/benchmark.h"
+#include "../../common/tempdir.h"
+#include "configure.h"
+#include "linglong/cli/launcher.h"
+#include "linglong/common/socket.h"
+
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+namespace linglong::cli::test {
+
+namespace {
+
+LaunchRequest createRequest(const std::filesystem::path &cwd)
+{
+    LaunchRequest request;
+    request.version = LINGLONG_VERSION_FULL;
+    request.options.appid = "org.deepin.demo";
+    request.options.base = "main:org.deepin.base/23.1.0";
+    request.options.commands = { "bash", "-c", "true" };
+    request.env = { "LAUNCH_TEST=launched", "PATH=/usr/bin" };
+    request.cwd = cwd.string();
+    return request;
+}
+
+utils::fd::UniqueFd connectTo(const std::filesystem::path &socketPath)
+{
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::copy(socketPath.native().begin(), socketPath.native().end(), addr.sun_path);
+    utils::fd::UniqueFd fd{ ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0) };
+    if (fd && ::connect(fd.get(), reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+        fd.reset();
+    }
+    return fd;
+}
+
+// the reply of the launcher to a request which sent fds and payload
+std::string sendRawRequest(const std::filesystem::path &socketPath,
+                           const std::vector<int> &fds,
+                           const std::string &payload)
+{
+    auto fd = connectTo(socketPath);
+    if (!fd || !common::socket::sendFdsWithPayload(fd.get(), fds, payload)) {
+        return {};
+    }
+    std::string reply(4096, '\0');
+    auto n = ::recv(fd.get(), reply.data(), reply.size(), 0);
+    reply.resize(n > 0 ? static_cast<std::size_t>(n) : 0);
+    return reply;
+}
+
+template <typename Pred>
+bool waitFor(Pred pred)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+volatile std::sig_atomic_t terminated = 0;
+
+TEST(LauncherTest, NoLauncher)
+{
+    TempDir tempDir;
+    auto result = sendLaunchRequest(tempDir.path() / "launcher.sock", createRequest("/"));
+    ASSERT_TRUE(result) << result.error().message();
+    EXPECT_FALSE(result->has_value());
+}
+
+TEST(LauncherTest, LaunchInForkedProcess)
+{
+    TempDir tempDir;
+    auto socketPath = tempDir.path() / "launcher.sock";
+    auto server = LaunchServer::listen(socketPath);
+    ASSERT_TRUE(server) << server.error().message();
+
+    std::optional<int> refused{ 0 };
+    std::optional<int> exitCode;
+    std::thread client([&]() {
+        auto request = createRequest(tempDir.path());
+        request.version = "0.0.0";
+        auto result = sendLaunchRequest(socketPath, request);
+        if (result) {
+            refused = *result;
+        }
+
+        request = createRequest(tempDir.path());
+        request.umask = 027;
+        request.rlimits = { ResourceLimit{ .resource = RLIMIT_CORE, .soft = 0, .hard = 0 } };
+        result = sendLaunchRequest(socketPath, request);
+        if (result) {
+            exitCode = *result;
+        }
+    });
+
+    // the request of another version is skipped
+    auto launch = (*server)->accept();
+    ASSERT_TRUE(launch) << launch.error().message();
+    EXPECT_EQ(launch->request.options.appid, "org.deepin.demo");
+    EXPECT_EQ(launch->request.options.base, "main:org.deepin.base/23.1.0");
+    EXPECT_FALSE(launch->request.options.runtime.has_value());
+
+    auto parent = ::getpid();
+    auto ret = (*server)->start(*launch, [parent](const LaunchRequest &request) -> int {
+        struct rlimit core{};
+        ::getrlimit(RLIMIT_CORE, &core);
+        std::ofstream result("result");
+        result << (::getpid() != parent) << ' ' << std::getenv("LAUNCH_TEST") << ' '
+               << request.options.commands.size() << ' ' << std::oct << ::umask(0) << ' '
+               << std::dec << core.rlim_cur;
+        return 42;
+    });
+    ASSERT_TRUE(ret) << ret.error().message();
+    client.join();
+
+    EXPECT_FALSE(refused.has_value());
+    EXPECT_EQ(exitCode, 42);
+
+    std::ifstream result(tempDir.path() / "result");
+    std::stringstream content;
+    content << result.rdbuf();
+    EXPECT_EQ(content.str(), "1 launched 3 27 0");
+}
+
+TEST(LauncherTest, RefuseInvalidRequests)
+{
+    TempDir tempDir;
+    auto socketPath = tempDir.path() / "launcher.sock";
+    auto server = LaunchServer::listen(socketPath);
+    ASSERT_TRUE(server) << server.error().message();
+
+    std::string invalidJson;
+    std::string missingFds;
+    std::optional<int> exitCode{ 0 };
+    std::thread client([&]() {
+        invalidJson =
+          sendRawRequest(socketPath, { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO }, "{");
+        missingFds = sendRawRequest(socketPath,
+                                    { STDIN_FILENO },
+                                    nlohmann::json{ { "version", LINGLONG_VERSION_FULL } }.dump());
+        auto result = sendLaunchRequest(socketPath, createRequest(tempDir.path()));
+        if (result) {
+            exitCode = *result;
+        }
+    });
+
+    auto launch = (*server)->accept();
+    ASSERT_TRUE(launch) << launch.error().message();
+    LaunchServer::refuse(*launch, "refused by test");
+    client.join();
+
+    EXPECT_TRUE(nlohmann::json::parse(invalidJson, nullptr, false).contains("error"))
+      << invalidJson;
+    EXPECT_TRUE(nlohmann::json::parse(missingFds, nullptr, false).contains("error")) << missingFds;
+    // a refused request is run by the client
+    EXPECT_FALSE(exitCode.has_value());
+}
+
+TEST(LauncherTest, SlowClientDoesNotHoldUpOthers)
+{
+    TempDir tempDir;
+    auto socketPath = tempDir.path() / "launcher.sock";
+    auto server = LaunchServer::listen(socketPath);
+    ASSERT_TRUE(server) << server.error().message();
+
+    // connects but never sends its request
+    auto slow = connectTo(socketPath);
+    ASSERT_TRUE(slow);
+
+    std::thread client([&]() {
+        auto result = sendLaunchRequest(socketPath, createRequest(tempDir.path()));
+        EXPECT_TRUE(result && !result->has_value());
+    });
+
+    auto launch = (*server)->accept();
+    ASSERT_TRUE(launch) << launch.error().message();
+    LaunchServer::refuse(*launch, "refused by test");
+    client.join();
+
+    // the slow client is still waiting, it's not refused for timing out before the other one
+    // was handled
+    char buf[64];
+    EXPECT_EQ(::recv(slow.get(), buf, sizeof(buf), MSG_DONTWAIT), -1);
+    EXPECT_EQ(errno, EAGAIN);
+}
+
+TEST(LauncherTest, FallBackIfClosedBeforeStart)
+{
+    TempDir tempDir;
+    auto socketPath = tempDir.path() / "launcher.sock";
+    auto server = LaunchServer::listen(socketPath);
+    ASSERT_TRUE(server) << server.error().message();
+
+    utils::error::Result<std::optional<int>> result = std::optional<int>{ 0 };
+    std::thread client([&]() {
+        result = sendLaunchRequest(socketPath, createRequest(tempDir.path()));
+    });
+
+    {
+        auto launch = (*server)->accept();
+        ASSERT_TRUE(launch) << launch.error().message();
+    }
+    client.join();
+
+    ASSERT_TRUE(result) << result.error().message();
+    EXPECT_FALSE(result->has_value());
+}
+
+TEST(LauncherTest, ForwardSignals)
+{
+    TempDir tempDir;
+    auto socketPath = tempDir.path() / "launcher.sock";
+    auto server = LaunchServer::listen(socketPath);
+    ASSERT_TRUE(server) << server.error().message();
+
+    std::optional<int> exitCode;
+    std::thread client([&]() {
+        auto result = sendLaunchRequest(socketPath, createRequest(tempDir.path()));
+        if (result) {
+            exitCode = *result;
+        }
+    });
+
+    auto launch = (*server)->accept();
+    ASSERT_TRUE(launch) << launch.error().message();
+    auto ret = (*server)->start(*launch, [](const LaunchRequest &) -> int {
+        std::signal(SIGTERM, [](int) {
+            terminated = 1;
+        });
+        std::ofstream("ready").close();
+        for (int i = 0; i < 1000 && terminated == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return terminated != 0 ? 128 + SIGTERM : 0;
+    });
+    ASSERT_TRUE(ret) << ret.error().message();
+
+    // the launched process is ready and the client forwards SIGTERM
+    ASSERT_TRUE(waitFor([&]() {
+        struct sigaction action{};
+        ::sigaction(SIGTERM, nullptr, &action);
+        return action.sa_handler != SIG_DFL && std::filesystem::exists(tempDir.path() / "ready");
+    }));
+    ::kill(::getpid(), SIGTERM);
+    client.join();
+
+    EXPECT_EQ(exitCode, 128 + SIGTERM);
+    struct sigaction action{};
+    ::sigaction(SIGTERM, nullptr, &action);
+    EXPECT_EQ(action.sa_handler, SIG_DFL);
+}
+
+// The latency until a run is started, handed over to a launcher or by a new process. A cold
+// `ll-cli run` also loads the repo before it starts the container, which needs an installed
+// ll-cli. Starting a process of ll-tests, which loads the same libraries as ll-cli, is reported
+// as the lower bound of it.
+TEST(LauncherTest, HandoffLatencyBenchmark)
+{
+    SKIP_UNLESS_BENCHMARK();
+
+    constexpr std::size_t Rounds = 50;
+    using Clock = std::chrono::steady_clock;
+
+    TempDir tempDir;
+    auto socketPath = tempDir.path() / "launcher.sock";
+    auto server = LaunchServer::listen(socketPath);
+    ASSERT_TRUE(server) << server.error().message();
+
+    std::thread launcher([&]() {
+        for (std::size_t i = 0; i < Rounds; ++i) {
+            auto launch = (*server)->accept();
+            ASSERT_TRUE(launch) << launch.error().message();
+            auto ret = (*server)->start(*launch, [](const LaunchRequest &) -> int {
+                return 0;
+            });
+            ASSERT_TRUE(ret) << ret.error().message();
+        }
+    });
+
+    auto begin = Clock::now();
+    for (std::size_t i = 0; i < Rounds; ++i) {
+        auto result = sendLaunchRequest(socketPath, createRequest(tempDir.path()));
+        ASSERT_TRUE(result) << result.error().message();
+        ASSERT_EQ(result->value_or(-1), 0);
+    }
+    std::chrono::duration<double, std::micro> handoff = (Clock::now() - begin) / Rounds;
+    launcher.join();
+
+    begin = Clock::now();
+    for (std::size_t i = 0; i < Rounds; ++i) {
+        auto pid = ::fork();
+        ASSERT_NE(pid, -1);
+        if (pid == 0) {
+            // the results of this process must not be overwritten
+            ::unsetenv("GTEST_OUTPUT");
+            ::execl("/proc/self/exe",
+                    "ll-tests",
+                    "--gtest_filter=-*",
+                    "--gtest_brief=1",
+                    nullptr);
+            ::_exit(EXIT_FAILURE);
+        }
+        int status = 0;
+        ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+        ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    std::chrono::duration<double, std::micro> cold = (Clock::now() - begin) / Rounds;
+
+    RecordProperty("handoffUs", std::to_string(handoff.count()));
+    RecordProperty("coldStartUs", std::to_string(cold.count()));
+}
+
+} // namespace
+
+} // namespace linglong::cli::test
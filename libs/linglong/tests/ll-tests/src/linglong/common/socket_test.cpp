@@ -8,6 +8,8 @@
 
 #include <sys/socket.h>
 
+#include <fcntl.h>
+
 class SocketFdTest : public ::testing::Test
 {
 protected:
@@ -193,3 +195,50 @@ TEST_F(SocketFdTest, LargePayloadHandling)
 
     waitpid(child, nullptr, 0);
 }
+
+TEST_F(SocketFdTest, MultipleFdsTransfer)
+{
+    std::array<int, 2> first{};
+    std::array<int, 2> second{};
+    ASSERT_EQ(pipe(first.data()), 0);
+    ASSERT_EQ(pipe(second.data()), 0);
+
+    auto ret = sendFdsWithPayload(sv[0], { first[1], second[1] }, "two-fds");
+    ASSERT_TRUE(ret) << ret.error();
+    close(first[1]);
+    close(second[1]);
+
+    auto res = recvFdsWithPayload(sv[1], 3);
+    ASSERT_TRUE(res.has_value()) << res.error();
+    EXPECT_EQ(res->payload, "two-fds");
+    ASSERT_EQ(res->fds.size(), 2);
+    EXPECT_NE(fcntl(res->fds[0], F_GETFD) & FD_CLOEXEC, 0);
+
+    ASSERT_EQ(write(res->fds[1], "b", 1), 1);
+    ASSERT_EQ(write(res->fds[0], "a", 1), 1);
+    char buf{ 0 };
+    ASSERT_EQ(read(first[0], &buf, 1), 1);
+    EXPECT_EQ(buf, 'a');
+    ASSERT_EQ(read(second[0], &buf, 1), 1);
+    EXPECT_EQ(buf, 'b');
+
+    for (auto fd : { first[0], second[0], res->fds[0], res->fds[1] }) {
+        close(fd);
+    }
+}
+
+TEST_F(SocketFdTest, MultipleFdsTruncatedPayload)
+{
+    auto ret = sendFdsWithPayload(sv[0], { STDOUT_FILENO }, std::string(200, 'Z'));
+    ASSERT_TRUE(ret) << ret.error();
+
+    auto res = recvFdsWithPayload(sv[1], 1, 50);
+    EXPECT_FALSE(res.has_value());
+
+    ret = sendFdsWithPayload(sv[0], {}, "no-fds");
+    ASSERT_TRUE(ret) << ret.error();
+    res = recvFdsWithPayload(sv[1], 1);
+    ASSERT_TRUE(res.has_value()) << res.error();
+    EXPECT_TRUE(res->fds.empty());
+    EXPECT_EQ(res->payload, "no-fds");
+}
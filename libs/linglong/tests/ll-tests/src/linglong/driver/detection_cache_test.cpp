@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "../../common/tempdir.h"
+#include "linglong/driver/detection_cache.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+using namespace linglong::driver::detect;
+
+namespace {
+
+void writeFile(const std::filesystem::path &path, const std::string &content)
+{
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream stream(path);
+    stream << content;
+}
+
+std::vector<GraphicsDriverInfo> nvidiaDrivers()
+{
+    return { GraphicsDriverInfo{
+      .identify = "nvidia",
+      .packageName = "org.deepin.driver.display.nvidia.570-124-04",
+      .packageVersion = "570.124.04",
+    } };
+}
+
+} // namespace
+
+TEST(DetectionCacheTest, HostDriverStamp)
+{
+    TempDir root;
+    writeFile(root.path() / "proc/sys/kernel/osrelease", "6.6.0\n");
+    writeFile(root.path() / "sys/module/nvidia/version", "570.124.04\n");
+
+    auto stamp = hostDriverStamp(root.path());
+    EXPECT_EQ(stamp, hostDriverStamp(root.path()));
+
+    writeFile(root.path() / "sys/module/nvidia/version", "575.57.08\n");
+    EXPECT_NE(stamp, hostDriverStamp(root.path()));
+}
+
+TEST(DetectionCacheTest, LookupStoredDrivers)
+{
+    TempDir dir;
+    DetectionCache cache(dir.path() / "driver-detection.json");
+    EXPECT_FALSE(cache.lookup("stamp").has_value());
+
+    cache.store("stamp", nvidiaDrivers());
+    auto drivers = cache.lookup("stamp");
+    ASSERT_TRUE(drivers.has_value());
+    ASSERT_EQ(drivers->size(), 1);
+    EXPECT_EQ(drivers->front().identify, "nvidia");
+    EXPECT_EQ(drivers->front().packageName, "org.deepin.driver.display.nvidia.570-124-04");
+    EXPECT_EQ(drivers->front().packageVersion, "570.124.04");
+    EXPECT_EQ(drivers->front().repoName, "stable");
+
+    // the drivers are changed
+    EXPECT_FALSE(cache.lookup("other stamp").has_value());
+
+    cache.store("stamp", {});
+    drivers = cache.lookup("stamp");
+    ASSERT_TRUE(drivers.has_value());
+    EXPECT_TRUE(drivers->empty());
+}
+
+TEST(DetectionCacheTest, ExpiredResult)
+{
+    TempDir dir;
+    auto file = dir.path() / "driver-detection.json";
+    DetectionCache cache(file);
+
+    auto writeDetectedAt = [&file](std::chrono::system_clock::time_point time) {
+        nlohmann::json json{
+            { "stamp", "stamp" },
+            { "detectedAt",
+              std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count() },
+            { "drivers", nlohmann::json::array() },
+        };
+        writeFile(file, json.dump());
+    };
+
+    auto now = std::chrono::system_clock::now();
+    writeDetectedAt(now - std::chrono::hours{ 1 });
+    EXPECT_TRUE(cache.lookup("stamp").has_value());
+
+    writeDetectedAt(now - DetectionCache::maxAge - std::chrono::hours{ 1 });
+    EXPECT_FALSE(cache.lookup("stamp").has_value());
+
+    // the clock is changed
+    writeDetectedAt(now + std::chrono::hours{ 1 });
+    EXPECT_FALSE(cache.lookup("stamp").has_value());
+
+    writeFile(file, "invalid");
+    EXPECT_FALSE(cache.lookup("stamp").has_value());
+}
@@ -0,0 +1,283 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "../../common/benchmark.h"
+#include "../../common/tempdir.h"
+#include "linglong/oci-cfg-generators/container_cfg_builder.h"
+#include "ocppi/runtime/config/types/Generators.hpp"
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+using namespace linglong;
+
+namespace {
+
+std::size_t countLines(const std::filesystem::path &file)
+{
+    std::ifstream stream(file);
+    std::size_t lines = 0;
+    for (std::string line; std::getline(stream, line);) {
+        ++lines;
+    }
+    return lines;
+}
+
+TEST(ContainerCfgBuilderTest, ReuseConfigTemplate)
+{
+    TempDir tempDir;
+    const auto basePath = tempDir.path() / "base";
+    const auto bundlePath = tempDir.path() / "bundle";
+    const auto patchDir = tempDir.path() / "config.d";
+    const auto counter = tempDir.path() / "counter";
+    std::filesystem::create_directories(basePath);
+    std::filesystem::create_directories(bundlePath);
+    std::filesystem::create_directories(patchDir);
+
+    const auto generatorPath = patchDir / "10-annotate";
+    {
+        std::ofstream script(generatorPath);
+        script << "#!/bin/sh\n"
+               << "echo >> " << counter << "\n"
+               << R"(sed 's/"annotations":{/"annotations":{"patched":"yes",/')" << "\n";
+    }
+    std::filesystem::permissions(generatorPath, std::filesystem::perms::owner_all);
+
+    auto build = [&](const std::string &pid) -> ocppi::runtime::config::types::Config {
+        generator::ContainerCfgBuilder builder;
+        builder.setAppId("org.deepin.demo")
+          .setBasePath(basePath)
+          .setBundlePath(bundlePath)
+          .setPatchDir(patchDir)
+          .setTemplateCacheDir(tempDir.path() / "templates")
+          .setAnnotation(generator::ANNOTATION::LAST_PID, pid);
+        auto result = builder.build();
+        EXPECT_TRUE(result.has_value()) << result.error().message();
+        return builder.getConfig();
+    };
+
+    auto config = build("100");
+    EXPECT_EQ(countLines(counter), 1);
+    ASSERT_TRUE(config.annotations.has_value());
+    EXPECT_EQ(config.annotations->at("patched"), "yes");
+    EXPECT_EQ(config.annotations->at("cn.org.linyaps.runtime.ns_last_pid"), "100");
+
+    // the patched config is reused, only the volatile annotations are refreshed
+    config = build("200");
+    EXPECT_EQ(countLines(counter), 1);
+    ASSERT_TRUE(config.annotations.has_value());
+    EXPECT_EQ(config.annotations->at("patched"), "yes");
+    EXPECT_EQ(config.annotations->at("cn.org.linyaps.runtime.ns_last_pid"), "200");
+
+    // modified patches invalidate the template
+    std::filesystem::last_write_time(generatorPath,
+                                     std::filesystem::last_write_time(generatorPath)
+                                       + std::chrono::seconds(1));
+    config = build("300");
+    EXPECT_EQ(countLines(counter), 2);
+    ASSERT_TRUE(config.annotations.has_value());
+    EXPECT_EQ(config.annotations->at("cn.org.linyaps.runtime.ns_last_pid"), "300");
+}
+
+TEST(ContainerCfgBuilderTest, SelfAdjustingMountWithManyMounts)
+{
+    TempDir tempDir;
+    const auto basePath = tempDir.path() / "base";
+    const auto bundlePath = tempDir.path() / "bundle";
+    std::filesystem::create_directories(basePath / "etc");
+    std::filesystem::create_directories(basePath / "usr");
+    std::filesystem::create_directories(bundlePath);
+
+    // none of the destinations exists in the base, so the root is replaced by a tmpfs
+    constexpr std::size_t count = 5000;
+    std::vector<ocppi::runtime::config::types::Mount> extraMounts;
+    for (std::size_t i = 0; i < count; ++i) {
+        extraMounts.push_back(ocppi::runtime::config::types::Mount{
+          .destination = fmt::format("/opt/mount{}", i),
+          .options = std::vector<std::string>{ "nodev" },
+          .source = "tmpfs",
+          .type = "tmpfs",
+        });
+    }
+
+    generator::ContainerCfgBuilder builder;
+    builder.setAppId("org.deepin.demo")
+      .setBasePath(basePath)
+      .setBundlePath(bundlePath)
+      .addExtraMounts(std::move(extraMounts))
+      .enableSelfAdjustingMount()
+      .disablePatch();
+    auto result = builder.build();
+    ASSERT_TRUE(result.has_value()) << result.error().message();
+
+    const auto &config = builder.getConfig();
+    EXPECT_EQ(config.root->path, "rootfs");
+    ASSERT_TRUE(config.mounts.has_value());
+
+    std::vector<std::string> destinations;
+    for (const auto &mount : *config.mounts) {
+        destinations.push_back(mount.destination);
+    }
+    EXPECT_EQ(std::count(destinations.begin(), destinations.end(), "/etc"), 1);
+    EXPECT_EQ(std::count(destinations.begin(), destinations.end(), "/usr"), 1);
+
+    // the mounts keep their order
+    auto first = std::find(destinations.begin(), destinations.end(), "/opt/mount0");
+    ASSERT_NE(first, destinations.end());
+    ASSERT_GE(std::distance(first, destinations.end()), count);
+    for (std::size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(*(first + i), fmt::format("/opt/mount{}", i));
+    }
+}
+
+TEST(ContainerCfgBuilderTest, ReuseAdjustedMounts)
+{
+    TempDir tempDir;
+    const auto basePath = tempDir.path() / "base";
+    const auto bundlePath = tempDir.path() / "bundle";
+    std::filesystem::create_directories(basePath / "etc");
+    std::filesystem::create_directories(bundlePath);
+
+    auto build = [&](bool cached) -> nlohmann::json {
+        generator::ContainerCfgBuilder builder;
+        builder.setAppId("org.deepin.demo")
+          .setBasePath(basePath)
+          .setBundlePath(bundlePath)
+          .addExtraMounts({ ocppi::runtime::config::types::Mount{
+            .destination = "/opt/app",
+            .options = std::vector<std::string>{ "nodev" },
+            .source = "tmpfs",
+            .type = "tmpfs",
+          } })
+          .enableSelfAdjustingMount()
+          .disablePatch();
+        if (cached) {
+            builder.setTemplateCacheDir(tempDir.path() / "templates");
+        }
+        auto result = builder.build();
+        EXPECT_TRUE(result.has_value()) << result.error().message();
+        return nlohmann::json(builder.getConfig());
+    };
+
+    auto adjusted = build(true);
+    EXPECT_EQ(adjusted, build(false));
+
+    // a layer never changes under the same path, the new entry shows the adjusted mounts are
+    // taken from the template instead of looking into the layer again
+    std::ofstream(basePath / "new").close();
+    EXPECT_EQ(build(true), adjusted);
+    EXPECT_NE(build(false), adjusted);
+}
+
+TEST(ContainerCfgBuilderTest, PruneConfigTemplates)
+{
+    TempDir tempDir;
+    const auto basePath = tempDir.path() / "base";
+    const auto bundlePath = tempDir.path() / "bundle";
+    const auto templateDir = tempDir.path() / "templates";
+    std::filesystem::create_directories(basePath);
+    std::filesystem::create_directories(bundlePath);
+    std::filesystem::create_directories(templateDir);
+
+    // templates of containers which are not run anymore, the lower the index the older
+    constexpr auto staleCount = generator::ContainerCfgBuilder::maxTemplates + 10;
+    auto now = std::filesystem::file_time_type::clock::now();
+    for (std::size_t i = 0; i < staleCount; ++i) {
+        auto file = templateDir / fmt::format("stale-{}.json", i);
+        std::ofstream(file).close();
+        std::filesystem::last_write_time(file, now - std::chrono::hours(staleCount - i));
+    }
+
+    generator::ContainerCfgBuilder builder;
+    builder.setAppId("org.deepin.demo")
+      .setBasePath(basePath)
+      .setBundlePath(bundlePath)
+      .setPatchDir(tempDir.path() / "config.d")
+      .setTemplateCacheDir(templateDir);
+    auto result = builder.build();
+    ASSERT_TRUE(result.has_value()) << result.error().message();
+
+    std::size_t stale = 0;
+    std::size_t total = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(templateDir)) {
+        ++total;
+        stale += entry.path().filename().string().rfind("stale-", 0) == 0 ? 1 : 0;
+    }
+    EXPECT_EQ(total, generator::ContainerCfgBuilder::maxTemplates);
+    // the new template is kept, the oldest ones are removed
+    EXPECT_EQ(stale, generator::ContainerCfgBuilder::maxTemplates - 1);
+    EXPECT_FALSE(std::filesystem::exists(templateDir / "stale-0.json"));
+    EXPECT_TRUE(
+      std::filesystem::exists(templateDir / fmt::format("stale-{}.json", staleCount - 1)));
+}
+
+// generating the config of a container with a config.d generator and adjusted mounts and writing
+// it to config.json like Container::run, with and without the template
+TEST(ContainerCfgBuilderTest, ConfigTemplateBenchmark)
+{
+    SKIP_UNLESS_BENCHMARK();
+
+    constexpr std::size_t Rounds = 20;
+    using Clock = std::chrono::steady_clock;
+
+    TempDir tempDir;
+    const auto basePath = tempDir.path() / "base";
+    const auto bundlePath = tempDir.path() / "bundle";
+    const auto patchDir = tempDir.path() / "config.d";
+    std::filesystem::create_directories(basePath / "etc");
+    std::filesystem::create_directories(basePath / "usr");
+    std::filesystem::create_directories(bundlePath);
+    std::filesystem::create_directories(patchDir);
+    const auto generatorPath = patchDir / "10-annotate";
+    {
+        std::ofstream script(generatorPath);
+        script << "#!/bin/sh\n"
+               << R"(sed 's/"annotations":{/"annotations":{"patched":"yes",/')" << "\n";
+    }
+    std::filesystem::permissions(generatorPath, std::filesystem::perms::owner_all);
+
+    std::vector<ocppi::runtime::config::types::Mount> extraMounts;
+    for (std::size_t i = 0; i < 200; ++i) {
+        extraMounts.push_back(ocppi::runtime::config::types::Mount{
+          .destination = fmt::format("/opt/mount{}", i),
+          .options = std::vector<std::string>{ "nodev" },
+          .source = "tmpfs",
+          .type = "tmpfs",
+        });
+    }
+
+    auto run = [&](bool cached) -> std::chrono::duration<double, std::milli> {
+        auto begin = Clock::now();
+        for (std::size_t i = 0; i < Rounds; ++i) {
+            generator::ContainerCfgBuilder builder;
+            builder.setAppId("org.deepin.demo")
+              .setBasePath(basePath)
+              .setBundlePath(bundlePath)
+              .setPatchDir(patchDir)
+              .addExtraMounts(extraMounts)
+              .enableSelfAdjustingMount()
+              .setAnnotation(generator::ANNOTATION::LAST_PID, std::to_string(100 + i));
+            if (cached) {
+                builder.setTemplateCacheDir(tempDir.path() / "templates");
+            }
+            auto result = builder.build();
+            EXPECT_TRUE(result.has_value()) << result.error().message();
+            std::ofstream(bundlePath / "config.json") << nlohmann::json(builder.getConfig()).dump();
+        }
+        return (Clock::now() - begin) / Rounds;
+    };
+
+    auto uncached = run(false);
+    auto cached = run(true);
+    RecordProperty("uncachedMs", std::to_string(uncached.count()));
+    RecordProperty("cachedMs", std::to_string(cached.count()));
+}
+
+} // namespace
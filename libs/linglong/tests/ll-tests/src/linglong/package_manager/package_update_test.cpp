@@ -22,9 +22,11 @@ using namespace linglong;
 using ::testing::_;
 using ::testing::AllOf;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::Field;
 using ::testing::HasSubstr;
 using ::testing::IsSubsetOf;
+using ::testing::Pair;
 using ::testing::Return;
 using ::testing::SetArgReferee;
 
@@ -130,14 +132,14 @@ public:
                 needToUpgrade,
                 (const package::FuzzyReference &fuzzy,
                  std::optional<package::Reference> &local,
-                 bool installIfMissing),
+                 bool installIfMissing,
+                 const repo::RemotePackages *candidates),
                 (override));
 
     MOCK_METHOD(utils::error::Result<void>,
-                installRefModule,
+                installRefModules,
                 (service::Task & task,
-                 const package::ReferenceWithRepo &ref,
-                 const std::string &module),
+                 (const std::vector<std::pair<package::ReferenceWithRepo, std::string>> &refs)),
                 (override, noexcept));
 
     MOCK_METHOD(utils::error::Result<void>,
@@ -261,7 +263,7 @@ TEST_F(PackageUpdateActionTest, Update)
     auto runtimeRef = package::Reference::fromPackageInfo(testdata::runtimeV100);
     ASSERT_TRUE(runtimeRef.has_value());
 
-    EXPECT_CALL(*pm, needToUpgrade(_, _, false))
+    EXPECT_CALL(*pm, needToUpgrade(_, _, false, _))
       // id1: app has no updates
       .WillOnce(Return(std::nullopt))
       // id1: runtime's extension has no updates
@@ -275,7 +277,7 @@ TEST_F(PackageUpdateActionTest, Update)
       // id2's dependencies: runtime's extension has no updates
       .WillOnce(Return(std::nullopt));
 
-    EXPECT_CALL(*pm, needToUpgrade(_, _, true))
+    EXPECT_CALL(*pm, needToUpgrade(_, _, true, _))
       // id1: base has updates
       .WillOnce(Return(std::make_pair(
         package::ReferenceWithRepo{ .repo = api::types::v1::Repo{ .name = "repo" },
@@ -315,10 +317,8 @@ TEST_F(PackageUpdateActionTest, Update)
           .info = testdata::runtimeV100,
         } }));
 
-    EXPECT_CALL(*pm, installRefModule(_, _, _))
-      .WillRepeatedly([](service::Task &, const package::ReferenceWithRepo &, const std::string &) {
-          return utils::error::Result<void>{};
-      });
+    EXPECT_CALL(*pm, installRefModules(_, _))
+      .WillRepeatedly(Return(utils::error::Result<void>{}));
 
     EXPECT_CALL(*repo, mergeModules()).Times(2).WillRepeatedly([]() {
         return utils::error::Result<void>{};
@@ -355,12 +355,12 @@ TEST_F(PackageUpdateActionTest, SkipPruneWhenNothingChanged)
     auto runtimeRef = package::Reference::fromPackageInfo(testdata::runtimeV100);
     ASSERT_TRUE(runtimeRef.has_value());
 
-    EXPECT_CALL(*pm, needToUpgrade(_, _, false))
+    EXPECT_CALL(*pm, needToUpgrade(_, _, false, _))
       // app has no updates
       .WillOnce(Return(std::nullopt))
       // runtime's extension has no updates
       .WillOnce(Return(std::nullopt));
-    EXPECT_CALL(*pm, needToUpgrade(_, _, true))
+    EXPECT_CALL(*pm, needToUpgrade(_, _, true, _))
       // base has no updates
       .WillOnce(DoAll(SetArgReferee<1>(*baseRef), Return(std::nullopt)))
       // runtime has no updates
@@ -400,7 +400,7 @@ TEST_F(PackageUpdateActionTest, PruneRepositoryWhenAutoPruneDisabled)
     auto runtimeRef = package::Reference::fromPackageInfo(testdata::runtimeV100);
     ASSERT_TRUE(runtimeRef.has_value());
 
-    EXPECT_CALL(*pm, needToUpgrade(_, _, false))
+    EXPECT_CALL(*pm, needToUpgrade(_, _, false, _))
       .WillOnce(Return(std::make_pair(
         package::ReferenceWithRepo{ .repo = api::types::v1::Repo{ .name = "repo" },
                                     .reference =
@@ -408,7 +408,7 @@ TEST_F(PackageUpdateActionTest, PruneRepositoryWhenAutoPruneDisabled)
         std::vector<std::string>{ "binary" })))
       // runtime's extension has no updates
       .WillOnce(Return(std::nullopt));
-    EXPECT_CALL(*pm, needToUpgrade(_, _, true))
+    EXPECT_CALL(*pm, needToUpgrade(_, _, true, _))
       .WillOnce(DoAll(SetArgReferee<1>(*baseRef), Return(std::nullopt)))
       .WillOnce(DoAll(SetArgReferee<1>(*runtimeRef), Return(std::nullopt)));
     EXPECT_CALL(*repo, fetchRefMetaData(_, "binary", true))
@@ -420,7 +420,7 @@ TEST_F(PackageUpdateActionTest, PruneRepositoryWhenAutoPruneDisabled)
         api::types::v1::RepositoryCacheLayersItem{ .info = testdata::baseV101 } }))
       .WillOnce(Return(utils::error::Result<api::types::v1::RepositoryCacheLayersItem>{
         api::types::v1::RepositoryCacheLayersItem{ .info = testdata::runtimeV100 } }));
-    EXPECT_CALL(*pm, installRefModule(_, _, "binary"))
+    EXPECT_CALL(*pm, installRefModules(_, ElementsAre(Pair(_, "binary"))))
       .WillOnce(Return(utils::error::Result<void>{}));
     EXPECT_CALL(*pm, switchAppVersion(_, _, true)).WillOnce(Return(utils::error::Result<void>{}));
     EXPECT_CALL(*repo, mergeModules()).WillOnce(Return(utils::error::Result<void>{}));
@@ -450,7 +450,7 @@ TEST_F(PackageUpdateActionTest, InstallChangedDependencyAndPruneUnusedWhenAppUpd
     auto runtimeRef = package::Reference::fromPackageInfo(testdata::runtimeV100);
     ASSERT_TRUE(runtimeRef.has_value());
 
-    EXPECT_CALL(*pm, needToUpgrade(_, _, false))
+    EXPECT_CALL(*pm, needToUpgrade(_, _, false, _))
       .WillOnce(Return(std::make_pair(
         package::ReferenceWithRepo{ .repo = api::types::v1::Repo{ .name = "repo" },
                                     .reference =
@@ -458,7 +458,7 @@ TEST_F(PackageUpdateActionTest, InstallChangedDependencyAndPruneUnusedWhenAppUpd
         std::vector<std::string>{ "binary" })))
       // runtime's extension has no updates
       .WillOnce(Return(std::nullopt));
-    EXPECT_CALL(*pm, needToUpgrade(_, _, true))
+    EXPECT_CALL(*pm, needToUpgrade(_, _, true, _))
       // the updated app requires a new base
       .WillOnce(Return(std::make_pair(
         package::ReferenceWithRepo{ .repo = api::types::v1::Repo{ .name = "repo" },
@@ -477,11 +477,9 @@ TEST_F(PackageUpdateActionTest, InstallChangedDependencyAndPruneUnusedWhenAppUpd
     EXPECT_CALL(*repo, getLayerItem(_, _, _))
       .WillOnce(Return(utils::error::Result<api::types::v1::RepositoryCacheLayersItem>{
         api::types::v1::RepositoryCacheLayersItem{ .info = testdata::runtimeV100 } }));
-    EXPECT_CALL(*pm, installRefModule(_, _, "binary"))
-      .Times(2)
-      .WillRepeatedly([](service::Task &, const package::ReferenceWithRepo &, const std::string &) {
-          return utils::error::Result<void>{};
-      });
+    // the app and its new base are pulled in one batch
+    EXPECT_CALL(*pm, installRefModules(_, ElementsAre(Pair(_, "binary"), Pair(_, "binary"))))
+      .WillOnce(Return(utils::error::Result<void>{}));
     EXPECT_CALL(*pm, switchAppVersion(_, _, true)).WillOnce(Return(utils::error::Result<void>{}));
     EXPECT_CALL(*repo, mergeModules()).WillOnce(Return(utils::error::Result<void>{}));
     EXPECT_CALL(*pm, pruneUnused()).WillOnce(Return(utils::error::Result<void>{}));
@@ -509,7 +507,7 @@ TEST_F(PackageUpdateActionTest, SendMessageWhenAppUpdateFails)
     auto res = action->prepare();
     ASSERT_TRUE(res.has_value());
 
-    EXPECT_CALL(*pm, needToUpgrade(_, _, false)).WillOnce(Return(LINGLONG_ERR("update error")));
+    EXPECT_CALL(*pm, needToUpgrade(_, _, false, _)).WillOnce(Return(LINGLONG_ERR("update error")));
     EXPECT_CALL(*pm, pruneUnused()).Times(0);
 
     MockPackageTask task;
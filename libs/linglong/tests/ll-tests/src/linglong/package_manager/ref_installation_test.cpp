@@ -24,7 +24,9 @@ namespace {
 using namespace linglong;
 using ::testing::_;
 using ::testing::AllOf;
+using ::testing::ElementsAre;
 using ::testing::Field;
+using ::testing::Pair;
 using ::testing::Return;
 
 class MockPackageManager : public service::PackageManager
@@ -38,10 +40,9 @@ public:
     }
 
     MOCK_METHOD(utils::error::Result<void>,
-                installRefModule,
+                installRefModules,
                 (service::Task & task,
-                 const package::ReferenceWithRepo &ref,
-                 const std::string &module),
+                 (const std::vector<std::pair<package::ReferenceWithRepo, std::string>> &refs)),
                 (override, noexcept));
 
     MOCK_METHOD(utils::error::Result<void>,
@@ -196,7 +197,7 @@ TEST_F(RefInstallationTest, InstallApp)
         };
     });
 
-    EXPECT_CALL(*pm, installRefModule(_, _, "binary"))
+    EXPECT_CALL(*pm, installRefModules(_, ElementsAre(Pair(_, "binary"))))
       .WillOnce(Return(utils::error::Result<void>{}));
 
     EXPECT_CALL(*pm, needToInstall("base", _)).WillOnce(Return(std::nullopt));
@@ -288,7 +289,7 @@ TEST_F(RefInstallationTest, InstallExtraOnly)
         };
     });
 
-    EXPECT_CALL(*pm, installRefModule(_, _, "develop"))
+    EXPECT_CALL(*pm, installRefModules(_, ElementsAre(Pair(_, "develop"))))
       .WillOnce(Return(utils::error::Result<void>{}));
 
     EXPECT_CALL(*pm, needToInstall("base", _)).WillOnce(Return(std::nullopt));
@@ -360,9 +361,7 @@ TEST_F(RefInstallationTest, InstallMultipleModules)
         };
     });
 
-    EXPECT_CALL(*pm, installRefModule(_, _, "binary"))
-      .WillOnce(Return(utils::error::Result<void>{}));
-    EXPECT_CALL(*pm, installRefModule(_, _, "develop"))
+    EXPECT_CALL(*pm, installRefModules(_, ElementsAre(Pair(_, "binary"), Pair(_, "develop"))))
       .WillOnce(Return(utils::error::Result<void>{}));
     EXPECT_CALL(*pm, executePostInstallHooks(_))
       .Times(1)
@@ -441,7 +440,7 @@ TEST_F(RefInstallationTest, InstallDowngrade)
         };
     });
 
-    EXPECT_CALL(*pm, installRefModule(_, _, "binary"))
+    EXPECT_CALL(*pm, installRefModules(_, ElementsAre(Pair(_, "binary"))))
       .WillOnce(Return(utils::error::Result<void>{}));
 
     EXPECT_CALL(*pm, needToInstall("base", _)).WillOnce(Return(std::nullopt));
@@ -542,9 +541,7 @@ TEST_F(RefInstallationTest, InstallDowngradeKeepsInstalledModules)
         };
     });
 
-    EXPECT_CALL(*pm, installRefModule(_, _, "binary"))
-      .WillOnce(Return(utils::error::Result<void>{}));
-    EXPECT_CALL(*pm, installRefModule(_, _, "develop"))
+    EXPECT_CALL(*pm, installRefModules(_, ElementsAre(Pair(_, "binary"), Pair(_, "develop"))))
       .WillOnce(Return(utils::error::Result<void>{}));
 
     EXPECT_CALL(*pm, needToInstall("base", _)).WillOnce(Return(std::nullopt));
@@ -617,7 +614,7 @@ TEST_F(RefInstallationTest, InstallDowngradeDeduplicatesRuntimeFallback)
         };
     });
 
-    EXPECT_CALL(*pm, installRefModule(_, _, "runtime"))
+    EXPECT_CALL(*pm, installRefModules(_, ElementsAre(Pair(_, "runtime"))))
       .WillOnce(Return(utils::error::Result<void>{}));
 
     EXPECT_CALL(*pm, needToInstall("base", _)).WillOnce(Return(std::nullopt));
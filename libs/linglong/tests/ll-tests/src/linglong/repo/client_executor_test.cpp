@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/repo/client_executor.h"
+
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace linglong::repo;
+
+namespace {
+
+TEST(ClientExecutorTest, RunAllRunsTasksConcurrently)
+{
+    constexpr int count = 4;
+    std::atomic_int running{ 0 };
+    std::atomic_int peak{ 0 };
+    std::vector<int> results(count, 0);
+
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < count; ++i) {
+        tasks.emplace_back([&running, &peak, &results, i]() {
+            auto now = ++running;
+            auto prev = peak.load();
+            while (now > prev && !peak.compare_exchange_weak(prev, now)) { }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            --running;
+            results[i] = i + 1;
+        });
+    }
+    ClientExecutor::instance().runAll(std::move(tasks));
+
+    EXPECT_GT(peak.load(), 1);
+    for (int i = 0; i < count; ++i) {
+        EXPECT_EQ(results[i], i + 1);
+    }
+}
+
+TEST(ClientExecutorTest, RunKeepsEventLoopRunningOnMainThread)
+{
+    int argc = 0;
+    QCoreApplication app(argc, nullptr);
+
+    bool timerFired = false;
+    QTimer::singleShot(0, [&timerFired]() {
+        timerFired = true;
+    });
+
+    auto ret = ClientExecutor::instance().run([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return 42;
+    });
+
+    EXPECT_EQ(ret, 42);
+    EXPECT_TRUE(timerFired);
+}
+
+TEST(ClientExecutorTest, CancelTokenFollowsDeadlineAndParent)
+{
+    CancelToken expired(std::chrono::steady_clock::now());
+    EXPECT_TRUE(expired.isCanceled());
+
+    CancelToken parent;
+    CancelToken::Scope scope(&parent);
+    EXPECT_EQ(CancelToken::current(), &parent);
+
+    CancelToken child(std::chrono::steady_clock::now() + std::chrono::hours(1));
+    EXPECT_FALSE(child.isCanceled());
+
+    parent.cancel();
+    EXPECT_TRUE(child.isCanceled());
+}
+
+} // namespace
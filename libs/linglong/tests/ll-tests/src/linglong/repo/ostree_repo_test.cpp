@@ -16,12 +16,26 @@
 #include "linglong/repo/ostree_repo.h"
 #include "linglong/utils/error/error.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace linglong::repo::test {
 
@@ -192,6 +206,114 @@ TEST_F(RepoTest, moduleMergesUseBinaryInfo)
     EXPECT_EQ(persistentMergedInfo->packageInfoV2Module, "binary");
 }
 
+TEST_F(RepoTest, mergeModulesReusesPreviousMergedDir)
+{
+    TempDir tempDir;
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto repoRoot = tempDir.path() / "repo-root";
+    ASSERT_TRUE(fs::create_directories(repoRoot));
+    auto repo = OSTreeRepo::create(repoRoot, createRepoConfig());
+    ASSERT_TRUE(repo.has_value()) << repo.error().message();
+
+    TempDir binaryDir;
+    TempDir developDir;
+    TempDir langDir;
+    auto importModule = [&repo](const TempDir &dir, std::string module) {
+        auto info = api::types::v1::PackageInfoV2{
+            .arch = std::vector<std::string>{ "x86_64" },
+            .channel = "main",
+            .id = "org.test.reuse",
+            .kind = "app",
+            .packageInfoV2Module = module,
+            .version = "1.0.0",
+        };
+        std::ofstream(dir.path() / "info.json") << nlohmann::json(info).dump();
+        fs::create_directories(dir.path() / "files");
+        std::ofstream(dir.path() / "files" / module) << module;
+        return repo->get()->importLayerDir(package::LayerDir{ dir.path() });
+    };
+
+    ASSERT_TRUE(importModule(binaryDir, "binary").has_value());
+    ASSERT_TRUE(importModule(developDir, "develop").has_value());
+    ASSERT_TRUE(repo->get()->mergeModules().has_value());
+
+    auto ref = package::Reference::parse("main:org.test.reuse/1.0.0/x86_64");
+    ASSERT_TRUE(ref.has_value()) << ref.error().message();
+    auto merged = repo->get()->getMergedModuleDir(*ref, false);
+    ASSERT_TRUE(merged.has_value()) << merged.error().message();
+    auto mergedPath = merged->path();
+    EXPECT_TRUE(fs::exists(mergedPath / "files" / "develop"));
+    // files are hard links to the objects of the repo
+    EXPECT_GT(fs::hard_link_count(mergedPath / "files" / "binary"), 1);
+    // a marker that only survives if the merged dir is reused
+    std::ofstream(mergedPath / "reused");
+
+    ASSERT_TRUE(importModule(langDir, "lang").has_value());
+    ASSERT_TRUE(repo->get()->mergeModules().has_value());
+
+    auto remerged = repo->get()->getMergedModuleDir(*ref, false);
+    ASSERT_TRUE(remerged.has_value()) << remerged.error().message();
+    auto remergedPath = remerged->path();
+    EXPECT_NE(remergedPath, mergedPath);
+    EXPECT_FALSE(fs::exists(mergedPath));
+    EXPECT_TRUE(fs::exists(remergedPath / "reused"));
+    EXPECT_TRUE(fs::exists(remergedPath / "files" / "binary"));
+    EXPECT_TRUE(fs::exists(remergedPath / "files" / "develop"));
+    EXPECT_TRUE(fs::exists(remergedPath / "files" / "lang"));
+}
+
+TEST_F(RepoTest, generateStaticDeltaBetweenVersions)
+{
+    TempDir tempDir;
+    TempDir oldDir;
+    TempDir newDir;
+    ASSERT_TRUE(tempDir.isValid());
+    ASSERT_TRUE(oldDir.isValid());
+    ASSERT_TRUE(newDir.isValid());
+
+    auto repoRoot = tempDir.path() / "repo-root";
+    ASSERT_TRUE(fs::create_directories(repoRoot));
+    auto repo = OSTreeRepo::create(repoRoot, createRepoConfig());
+    ASSERT_TRUE(repo.has_value()) << repo.error().message();
+
+    auto makeInfo = [](std::string version) {
+        return api::types::v1::PackageInfoV2{
+            .arch = std::vector<std::string>{ "x86_64" },
+            .channel = "main",
+            .id = "org.test.delta",
+            .kind = "app",
+            .packageInfoV2Module = "binary",
+            .version = std::move(version),
+        };
+    };
+    const auto oldInfo = makeInfo("1.0.0");
+    const auto newInfo = makeInfo("1.0.1");
+
+    std::ofstream(oldDir.path() / "info.json") << nlohmann::json(oldInfo).dump();
+    std::ofstream(newDir.path() / "info.json") << nlohmann::json(newInfo).dump();
+    ASSERT_TRUE(fs::create_directories(oldDir.path() / "files"));
+    ASSERT_TRUE(fs::create_directories(newDir.path() / "files"));
+    std::ofstream(oldDir.path() / "files" / "data") << std::string(4096, 'a');
+    std::ofstream(newDir.path() / "files" / "data") << std::string(4096, 'a') << "b";
+
+    ASSERT_TRUE(repo->get()->importLayerDir(package::LayerDir{ oldDir.path() }).has_value());
+    ASSERT_TRUE(repo->get()->importLayerDir(package::LayerDir{ newDir.path() }).has_value());
+
+    auto oldRef = package::Reference::fromPackageInfo(oldInfo);
+    ASSERT_TRUE(oldRef.has_value()) << oldRef.error().message();
+    auto newRef = package::Reference::fromPackageInfo(newInfo);
+    ASSERT_TRUE(newRef.has_value()) << newRef.error().message();
+
+    EXPECT_FALSE(repo->get()->generateStaticDelta(*newRef, *newRef).has_value());
+
+    auto ret = repo->get()->generateStaticDelta(*oldRef, *newRef);
+    ASSERT_TRUE(ret.has_value()) << ret.error().message();
+    EXPECT_TRUE(fs::exists(repoRoot / "repo" / "deltas"));
+    EXPECT_FALSE(fs::is_empty(repoRoot / "repo" / "deltas"));
+    EXPECT_TRUE(fs::exists(repoRoot / "repo" / "summary"));
+}
+
 TEST_F(RepoTest, createPrefersRepoLocalConfigOverFallbackConfig)
 {
     TempDir tempDir;
@@ -432,6 +554,7 @@ TEST_F(RepoTest, exportDir)
 namespace {
 
 using ::testing::_;
+using ::testing::Field;
 using ::testing::Return;
 
 struct AppData
@@ -548,6 +671,40 @@ TEST(OSTreeRepoTest, searchRemote_Search)
     EXPECT_EQ((*result)[0].version, "1.0.0");
 }
 
+TEST(OSTreeRepoTest, searchRemote_UseCache)
+{
+    TempDir tempDir;
+    OSTreeRepoMock mockRepo(tempDir.path());
+    repo::OSTreeRepo &repo = mockRepo;
+
+    auto fuzzyRef = package::FuzzyReference::parse("com.example.app");
+    auto repoConfig = api::types::v1::Repo{ .name = "test", .url = "http://localhost:8080" };
+    auto client = apiClient_create_with_base_path(repoConfig.url.c_str(), nullptr, nullptr);
+    auto clientAPI = new MockClientAPIWrapper(client);
+
+    std::vector<AppData> test_data = { { .app_id = "com.example.app", .version = "1.0.0" } };
+    auto resp = create_response_from_data(test_data);
+
+    // the second search is answered by the cache
+    EXPECT_CALL(*clientAPI, fuzzySearch(_))
+      .WillOnce(Return(std::unique_ptr<fuzzy_search_app_200_response_t,
+                                       decltype(&fuzzy_search_app_200_response_free)>(
+        resp,
+        &fuzzy_search_app_200_response_free)));
+    EXPECT_CALL(mockRepo, createClientV2(repoConfig.url))
+      .WillOnce(Return(std::unique_ptr<ClientAPIWrapper>(clientAPI)));
+
+    auto result = repo.searchRemote(*fuzzyRef, repoConfig, true);
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(result->size(), 1);
+
+    result = repo.searchRemote(*fuzzyRef, repoConfig, true);
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(result->size(), 1);
+    EXPECT_EQ((*result)[0].id, "com.example.app");
+    EXPECT_EQ((*result)[0].version, "1.0.0");
+}
+
 TEST(OSTreeRepoTest, BuildPullRefCandidatesFallbackToRuntimeForBinary)
 {
     auto ref = package::Reference::parse("stable:org.deepin.demo/1.0.0/x86_64");
@@ -778,11 +935,14 @@ TEST(OSTreeRepoTest, matchRemoteByPriority_FallbackToLowerPriority)
           api::types::v1::Repo{ .name = "repo3", .priority = 1, .url = "http://localhost:8082" } },
       }));
 
-    EXPECT_CALL(mockRepo, searchRemote(_, _, true))
-      .WillOnce(Return(std::vector<api::types::v1::PackageInfoV2>{}))
+    // repos with the same priority are searched concurrently
+    EXPECT_CALL(mockRepo, searchRemote(_, Field(&api::types::v1::Repo::name, "repo1"), true))
+      .WillOnce(Return(std::vector<api::types::v1::PackageInfoV2>{}));
+    EXPECT_CALL(mockRepo, searchRemote(_, Field(&api::types::v1::Repo::name, "repo2"), true))
       .WillOnce(Return(std::vector<api::types::v1::PackageInfoV2>{
         api::types::v1::PackageInfoV2{ .id = "com.example.app", .version = "1.0.0" },
-      }))
+      }));
+    EXPECT_CALL(mockRepo, searchRemote(_, Field(&api::types::v1::Repo::name, "repo3"), true))
       .WillOnce(Return(std::vector<api::types::v1::PackageInfoV2>{}));
 
     auto result = repo.matchRemoteByPriority(*fuzzyRef);
@@ -891,11 +1051,13 @@ TEST(OSTreeRepoTest, matchRemoteByPriority_UseHighestPriority)
         },
       }));
 
-    EXPECT_CALL(mockRepo, searchRemote(_, _, true))
-      .WillOnce(Return(std::vector<api::types::v1::PackageInfoV2>{}))
+    EXPECT_CALL(mockRepo, searchRemote(_, Field(&api::types::v1::Repo::name, "repo1"), true))
+      .WillOnce(Return(std::vector<api::types::v1::PackageInfoV2>{}));
+    EXPECT_CALL(mockRepo, searchRemote(_, Field(&api::types::v1::Repo::name, "repo2"), true))
       .WillOnce(Return(std::vector<api::types::v1::PackageInfoV2>{
         api::types::v1::PackageInfoV2{ .id = "com.example.app", .version = "2.0.0" },
-      }))
+      }));
+    EXPECT_CALL(mockRepo, searchRemote(_, Field(&api::types::v1::Repo::name, "repo3"), true))
       .WillOnce(Return(std::vector<api::types::v1::PackageInfoV2>{
         api::types::v1::PackageInfoV2{ .id = "com.example.app", .version = "3.0.0" },
       }));
@@ -915,6 +1077,252 @@ TEST(OSTreeRepoTest, matchRemoteByPriority_UseHighestPriority)
     EXPECT_EQ(repoPackages.back().second[0].version, "3.0.0");
 }
 
+TEST(OSTreeRepoTest, batchMatchRemoteByPriority_KeepOrder)
+{
+    TempDir tempDir;
+    OSTreeRepoMock mockRepo(tempDir.path());
+    repo::OSTreeRepo &repo = mockRepo;
+
+    std::vector<package::FuzzyReference> fuzzyRefs;
+    for (const auto *id : { "com.example.app1", "com.example.app2", "com.example.app3" }) {
+        fuzzyRefs.emplace_back(*package::FuzzyReference::parse(id));
+    }
+
+    EXPECT_CALL(mockRepo, getPriorityGroupedRepos())
+      .Times(3)
+      .WillRepeatedly(Return(std::vector<std::vector<api::types::v1::Repo>>{
+        std::vector<api::types::v1::Repo>{
+          api::types::v1::Repo{ .name = "repo1", .priority = 1, .url = "http://localhost:8081" },
+        },
+      }));
+
+    EXPECT_CALL(mockRepo, searchRemote(_, _, true))
+      .Times(3)
+      .WillRepeatedly([](const package::FuzzyReference &fuzzyRef,
+                         const api::types::v1::Repo &,
+                         bool) -> utils::error::Result<std::vector<api::types::v1::PackageInfoV2>> {
+          LINGLONG_TRACE("search remote");
+          if (fuzzyRef.id == "com.example.app2") {
+              return LINGLONG_ERR("network error");
+          }
+          return std::vector<api::types::v1::PackageInfoV2>{
+            api::types::v1::PackageInfoV2{ .id = fuzzyRef.id, .version = "1.0.0" },
+          };
+      });
+
+    auto results = repo.batchMatchRemoteByPriority(fuzzyRefs, 2);
+
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_TRUE(results[0].has_value());
+    EXPECT_EQ(results[0]->getRepoPackages().front().second[0].id, "com.example.app1");
+    EXPECT_FALSE(results[1].has_value());
+    ASSERT_TRUE(results[2].has_value());
+    EXPECT_EQ(results[2]->getRepoPackages().front().second[0].id, "com.example.app3");
+}
+
+// A local ClientAPI server answering fuzzy searches over HTTP. Every app is found in version
+// 1.0.0 except the ones with an id ending with ".missing". Every connection is served by its own
+// thread like a real server, so the number of requests in flight is what the client sends.
+class MockClientAPIServer
+{
+public:
+    MockClientAPIServer()
+    {
+        listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        EXPECT_NE(listenFd, -1);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        EXPECT_EQ(::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), len), 0);
+        EXPECT_EQ(::listen(listenFd, 64), 0);
+        EXPECT_EQ(::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &len), 0);
+        port = ntohs(addr.sin_port);
+        acceptor = std::thread([this]() {
+            serve();
+        });
+    }
+
+    MockClientAPIServer(const MockClientAPIServer &) = delete;
+    MockClientAPIServer &operator=(const MockClientAPIServer &) = delete;
+    MockClientAPIServer(MockClientAPIServer &&) = delete;
+    MockClientAPIServer &operator=(MockClientAPIServer &&) = delete;
+
+    ~MockClientAPIServer()
+    {
+        // wakes up accept()
+        ::shutdown(listenFd, SHUT_RDWR);
+        acceptor.join();
+        for (auto &handler : handlers) {
+            handler.join();
+        }
+        ::close(listenFd);
+    }
+
+    [[nodiscard]] std::string url() const { return "http://127.0.0.1:" + std::to_string(port); }
+
+    [[nodiscard]] std::size_t requests() const noexcept { return requestCount.load(); }
+
+    [[nodiscard]] std::size_t maxInFlight() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return maxConcurrent;
+    }
+
+private:
+    void serve()
+    {
+        while (true) {
+            auto connection = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            handlers.emplace_back([this, connection]() {
+                handle(connection);
+                ::close(connection);
+            });
+        }
+    }
+
+    void handle(int connection)
+    {
+        std::string request;
+        std::array<char, 4096> buf{};
+        auto receive = [&]() {
+            auto n = ::recv(connection, buf.data(), buf.size(), 0);
+            if (n <= 0) {
+                return false;
+            }
+            request.append(buf.data(), static_cast<std::size_t>(n));
+            return true;
+        };
+
+        std::size_t headerEnd = std::string::npos;
+        while ((headerEnd = request.find("\r\n\r\n")) == std::string::npos) {
+            if (!receive()) {
+                return;
+            }
+        }
+
+        auto headers = request.substr(0, headerEnd);
+        std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+        std::size_t length = 0;
+        if (auto pos = headers.find("content-length:"); pos != std::string::npos) {
+            length = std::stoul(headers.substr(pos + std::string_view{ "content-length:" }.size()));
+        }
+        auto bodyBegin = headerEnd + 4;
+        while (request.size() < bodyBegin + length) {
+            if (!receive()) {
+                return;
+            }
+        }
+
+        auto body = nlohmann::json::parse(request.substr(bodyBegin, length), nullptr, false);
+        ASSERT_FALSE(body.is_discarded()) << request;
+        auto appId = body.value("appId", "");
+        ++requestCount;
+
+        {
+            // hold the first requests until another one arrives, a client which doesn't overlap
+            // its requests shows up as one request in flight
+            std::unique_lock<std::mutex> lock(mutex);
+            maxConcurrent = std::max(maxConcurrent, ++inFlight);
+            cond.notify_all();
+            cond.wait_for(lock, std::chrono::seconds(5), [this]() {
+                return maxConcurrent > 1;
+            });
+            --inFlight;
+        }
+
+        auto data = nlohmann::json::array();
+        if (appId.size() < 8 || appId.compare(appId.size() - 8, 8, ".missing") != 0) {
+            data.push_back({
+              { "appId", appId },
+              { "arch", body.value("arch", "x86_64") },
+              { "base", "base" },
+              { "channel", "main" },
+              { "description", "" },
+              { "id", appId },
+              { "kind", "app" },
+              { "module", "binary" },
+              { "name", appId },
+              { "repoName", body.value("repoName", "") },
+              { "runtime", "runtime" },
+              { "size", 0 },
+              { "uabUrl", "" },
+              { "version", "1.0.0" },
+            });
+        }
+        auto content = nlohmann::json{ { "code", 200 }, { "data", data } }.dump();
+        auto response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+          + std::to_string(content.size()) + "\r\nConnection: close\r\n\r\n" + content;
+        std::string_view remaining = response;
+        while (!remaining.empty()) {
+            auto n = ::send(connection, remaining.data(), remaining.size(), MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            remaining.remove_prefix(static_cast<std::size_t>(n));
+        }
+    }
+
+    int listenFd{ -1 };
+    uint16_t port{ 0 };
+    std::thread acceptor;
+    // only touched by the acceptor until it's joined
+    std::vector<std::thread> handlers;
+    std::atomic_size_t requestCount{ 0 };
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    std::size_t inFlight{ 0 };
+    std::size_t maxConcurrent{ 0 };
+};
+
+TEST(OSTreeRepoTest, batchMatchRemoteByPriority_MockServer)
+{
+    constexpr std::size_t MaxInFlight = 4;
+
+    MockClientAPIServer server;
+    TempDir tempDir;
+    MockOstreeRepo repo(
+      tempDir.path(),
+      api::types::v1::RepoConfigV2{
+        .defaultRepo = "mock",
+        .repos = { api::types::v1::Repo{ .name = "mock", .priority = 0, .url = server.url() } },
+        .version = 2,
+      });
+
+    std::vector<package::FuzzyReference> fuzzyRefs;
+    for (std::size_t i = 0; i < 12; ++i) {
+        auto id = "com.example.app" + std::to_string(i) + (i == 5 ? ".missing" : "");
+        fuzzyRefs.emplace_back(*package::FuzzyReference::parse(id));
+    }
+
+    auto results = repo.batchMatchRemoteByPriority(fuzzyRefs, MaxInFlight);
+
+    ASSERT_EQ(results.size(), fuzzyRefs.size());
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        ASSERT_TRUE(results[i].has_value()) << results[i].error().message();
+        if (i == 5) {
+            EXPECT_TRUE(results[i]->empty());
+            continue;
+        }
+        ASSERT_FALSE(results[i]->empty());
+        const auto &packages = results[i]->getRepoPackages().front();
+        EXPECT_EQ(packages.first.name, "mock");
+        ASSERT_EQ(packages.second.size(), 1);
+        EXPECT_EQ(packages.second[0].id, fuzzyRefs[i].id);
+        EXPECT_EQ(packages.second[0].version, "1.0.0");
+    }
+
+    EXPECT_EQ(server.requests(), fuzzyRefs.size());
+    EXPECT_GT(server.maxInFlight(), 1);
+    EXPECT_LE(server.maxInFlight(), MaxInFlight);
+}
+
 } // namespace
 
 } // namespace
@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "../../common/tempdir.h"
+#include "linglong/api/types/v1/Generators.hpp"
+#include "linglong/repo/remote_search_cache.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace linglong::repo::test {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+RemoteSearchCache::Key createKey()
+{
+    return RemoteSearchCache::Key{
+        .repoName = "stable",
+        .repoUrl = "https://repo.example.com",
+        .id = "org.deepin.demo",
+        .channel = "main",
+        .version = "1.0",
+        .arch = "x86_64",
+    };
+}
+
+std::vector<api::types::v1::PackageInfoV2> createPackages()
+{
+    return { api::types::v1::PackageInfoV2{
+      .arch = { "x86_64" },
+      .channel = "main",
+      .id = "org.deepin.demo",
+      .kind = "app",
+      .packageInfoV2Module = "binary",
+      .name = "demo",
+      .version = "1.0.0.1",
+    } };
+}
+
+// move the fetch time of the only entry in dir to the past
+void ageEntry(const fs::path &dir, std::chrono::seconds age)
+{
+    for (const auto &entry : fs::directory_iterator(dir)) {
+        nlohmann::json json;
+        {
+            std::ifstream in(entry.path());
+            json = nlohmann::json::parse(in);
+        }
+        json["fetchedAt"] = json["fetchedAt"].get<int64_t>() - age.count();
+        std::ofstream out(entry.path());
+        out << json.dump();
+    }
+}
+
+TEST(RemoteSearchCacheTest, lookupReturnsStoredPackages)
+{
+    TempDir tempDir;
+    RemoteSearchCache cache(tempDir.path() / "search-cache", std::chrono::seconds(300));
+
+    EXPECT_FALSE(cache.lookup(createKey()).has_value());
+
+    cache.store(createKey(), createPackages());
+    auto entry = cache.lookup(createKey());
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_FALSE(entry->stale);
+    ASSERT_EQ(entry->packages.size(), 1);
+    EXPECT_EQ(entry->packages[0].id, "org.deepin.demo");
+    EXPECT_EQ(entry->packages[0].version, "1.0.0.1");
+
+    auto other = createKey();
+    other.version = "1.1";
+    EXPECT_FALSE(cache.lookup(other).has_value());
+}
+
+TEST(RemoteSearchCacheTest, entriesBecomeStaleThenExpire)
+{
+    TempDir tempDir;
+    auto dir = tempDir.path() / "search-cache";
+    RemoteSearchCache cache(dir, std::chrono::seconds(300));
+
+    cache.store(createKey(), createPackages());
+    ageEntry(dir, std::chrono::seconds(400));
+    auto entry = cache.lookup(createKey());
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_TRUE(entry->stale);
+
+    ageEntry(dir, std::chrono::seconds(400));
+    EXPECT_FALSE(cache.lookup(createKey()).has_value());
+}
+
+TEST(RemoteSearchCacheTest, clearAndDisable)
+{
+    TempDir tempDir;
+    auto dir = tempDir.path() / "search-cache";
+    RemoteSearchCache cache(dir, std::chrono::seconds(300));
+
+    cache.store(createKey(), createPackages());
+    cache.clear();
+    EXPECT_FALSE(cache.lookup(createKey()).has_value());
+    EXPECT_FALSE(fs::exists(dir));
+
+    RemoteSearchCache disabled(dir, std::chrono::seconds(0));
+    disabled.store(createKey(), createPackages());
+    EXPECT_FALSE(disabled.lookup(createKey()).has_value());
+    EXPECT_FALSE(fs::exists(dir));
+}
+
+TEST(RemoteSearchCacheTest, revalidateOnlyOnce)
+{
+    TempDir tempDir;
+    RemoteSearchCache cache(tempDir.path() / "search-cache", std::chrono::seconds(300));
+
+    EXPECT_TRUE(cache.beginRevalidate(createKey()));
+    EXPECT_FALSE(cache.beginRevalidate(createKey()));
+    cache.endRevalidate(createKey());
+    EXPECT_TRUE(cache.beginRevalidate(createKey()));
+}
+
+} // namespace
+
+} // namespace linglong::repo::test
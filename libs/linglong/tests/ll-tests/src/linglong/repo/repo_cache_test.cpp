@@ -6,6 +6,7 @@
 
 #include <gtest/gtest.h>
 
+#include "../../common/benchmark.h"
 #include "../../common/tempdir.h"
 #include "linglong/api/types/v1/Generators.hpp"
 #include "linglong/api/types/v1/PackageInfoV2.hpp"
@@ -14,8 +15,10 @@
 #include "linglong/api/types/v1/RepositoryCache.hpp"
 #include "linglong/repo/repo_cache.h"
 
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <string>
 
 namespace linglong::repo::test {
 
@@ -149,6 +152,422 @@ TEST_F(RepoCacheTest, addAndDeleteLayerItemPersistAcrossReload)
     EXPECT_TRUE(afterDelete.queryLayerItem(repoCacheQuery{ .id = "app.test" }).empty());
 }
 
+TEST_F(RepoCacheTest, queryLayerItemSortsByVersionDescending)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    writeCacheFile(cacheFile,
+                   api::types::v1::RepositoryCache{
+                     .config = createRepoConfig(),
+                     .layers = { createLayerItem("commit-1", "app.test", "1.0.0.0"),
+                                 createLayerItem("commit-3", "app.test", "3.0.0.0"),
+                                 createLayerItem("commit-other", "app.other", "9.0.0.0"),
+                                 createLayerItem("commit-2", "app.test", "2.0.0.0") },
+                     .llVersion = "test",
+                     .merged = std::nullopt,
+                     .version = "2",
+                   });
+
+    RepoCache cache(cacheFile);
+    ASSERT_TRUE(cache.load().has_value());
+
+    auto items = cache.queryLayerItem(repoCacheQuery{ .id = "app.test" });
+    ASSERT_EQ(items.size(), 3);
+    EXPECT_EQ(items[0].commit, "commit-3");
+    EXPECT_EQ(items[1].commit, "commit-2");
+    EXPECT_EQ(items[2].commit, "commit-1");
+
+    auto all = cache.queryLayerItem(repoCacheQuery{});
+    ASSERT_EQ(all.size(), 4);
+    EXPECT_EQ(all.front().commit, "commit-other");
+}
+
+TEST_F(RepoCacheTest, queryLayerItemStaysConsistentAfterMutations)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    RepoCache cache(cacheFile);
+    auto first = createLayerItem("commit-1", "app.test", "1.0.0.0");
+    auto second = createLayerItem("commit-2", "app.test", "2.0.0.0");
+    auto other = createLayerItem("commit-other", "app.other", "1.0.0.0");
+
+    ASSERT_TRUE(cache.addLayerItem(first).has_value());
+    ASSERT_TRUE(cache.addLayerItem(other).has_value());
+    ASSERT_TRUE(cache.addLayerItem(second).has_value());
+
+    ASSERT_TRUE(cache.deleteLayerItem(first).has_value());
+
+    auto items = cache.queryLayerItem(repoCacheQuery{ .id = "app.test" });
+    ASSERT_EQ(items.size(), 1);
+    EXPECT_EQ(items.front().commit, "commit-2");
+
+    auto found = cache.findMatchingItem(other);
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ((*found)->commit, "commit-other");
+
+    auto otherItems =
+      cache.queryLayerItem(repoCacheQuery{ .id = "app.other", .version = "1.0.0.0" });
+    ASSERT_EQ(otherItems.size(), 1);
+    EXPECT_EQ(otherItems.front().commit, "commit-other");
+}
+
+TEST_F(RepoCacheTest, mutationsAreJournaledAndReplayedOnLoad)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    auto journalFile = tempDir.path() / "states.json.journal";
+    RepoCache cache(cacheFile);
+    auto first = createLayerItem("commit-1", "app.first", "1.0.0");
+    auto second = createLayerItem("commit-2", "app.second", "1.0.0");
+
+    // the first mutation creates the snapshot, the following ones only append to the journal
+    ASSERT_TRUE(cache.addLayerItem(first).has_value());
+    EXPECT_FALSE(fs::exists(journalFile));
+    ASSERT_TRUE(cache.addLayerItem(second).has_value());
+    ASSERT_TRUE(cache.markLayerItemDeleted(first, true).has_value());
+    EXPECT_TRUE(fs::exists(journalFile));
+
+    RepoCache reloaded(cacheFile);
+    ASSERT_TRUE(reloaded.load().has_value());
+    auto items = reloaded.queryExistingLayerItem();
+    ASSERT_EQ(items.size(), 1);
+    EXPECT_EQ(items.front().commit, "commit-2");
+
+    ASSERT_TRUE(reloaded.writeToDisk().has_value());
+    EXPECT_FALSE(fs::exists(journalFile));
+
+    RepoCache compacted(cacheFile);
+    ASSERT_TRUE(compacted.load().has_value());
+    EXPECT_EQ(compacted.queryExistingLayerItem().size(), 1);
+}
+
+TEST_F(RepoCacheTest, loadDropsTornJournalRecord)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    auto journalFile = tempDir.path() / "states.json.journal";
+    RepoCache cache(cacheFile);
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-1", "app.first", "1.0.0")).has_value());
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-2", "app.second", "1.0.0")).has_value());
+
+    std::ofstream(journalFile, std::ios::app) << R"({"op":"add","item":{"commit":)";
+
+    RepoCache reloaded(cacheFile);
+    ASSERT_TRUE(reloaded.load().has_value());
+    EXPECT_EQ(reloaded.queryExistingLayerItem().size(), 2);
+
+    // appending after a torn record compacts the journal first
+    ASSERT_TRUE(
+      reloaded.addLayerItem(createLayerItem("commit-3", "app.third", "1.0.0")).has_value());
+    EXPECT_FALSE(fs::exists(journalFile));
+
+    RepoCache afterCompact(cacheFile);
+    ASSERT_TRUE(afterCompact.load().has_value());
+    EXPECT_EQ(afterCompact.queryExistingLayerItem().size(), 3);
+}
+
+TEST_F(RepoCacheTest, loadFailsOnCorruptedJournal)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    auto journalFile = tempDir.path() / "states.json.journal";
+    RepoCache cache(cacheFile);
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-1", "app.first", "1.0.0")).has_value());
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-2", "app.second", "1.0.0")).has_value());
+
+    // a complete but broken record followed by a valid one, nothing after it may be dropped
+    std::string valid;
+    {
+        std::ifstream ifs(journalFile);
+        std::getline(ifs, valid);
+    }
+    std::ofstream(journalFile, std::ios::app) << "{\"op\":\n" << valid << '\n';
+    fs::remove(tempDir.path() / "states.bin");
+
+    RepoCache reloaded(cacheFile);
+    EXPECT_FALSE(reloaded.load().has_value());
+}
+
+TEST_F(RepoCacheTest, failedMutationLeavesCacheUnchanged)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    RepoCache cache(cacheFile);
+    auto first = createLayerItem("commit-1", "app.first", "1.0.0");
+    ASSERT_TRUE(cache.addLayerItem(first).has_value());
+    auto generation = cache.generation();
+
+    // neither the journal nor the snapshot can be written
+    fs::create_directory(tempDir.path() / "states.json.journal");
+    fs::create_directory(tempDir.path() / "temp-states.json");
+
+    EXPECT_FALSE(
+      cache.addLayerItem(createLayerItem("commit-2", "app.second", "1.0.0")).has_value());
+    EXPECT_FALSE(cache.deleteLayerItem(first).has_value());
+    EXPECT_FALSE(cache.markLayerItemDeleted(first, true).has_value());
+
+    EXPECT_EQ(cache.generation(), generation);
+    auto items = cache.queryExistingLayerItem();
+    ASSERT_EQ(items.size(), 1);
+    EXPECT_EQ(items.front().commit, "commit-1");
+    EXPECT_TRUE(cache.queryLayerItem(repoCacheQuery{ .id = "app.second" }).empty());
+}
+
+TEST_F(RepoCacheTest, loadFromImageMatchesJson)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    RepoCache cache(cacheFile);
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-1", "app.test", "1.0.0.0")).has_value());
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-3", "app.test", "3.0.0.0")).has_value());
+    ASSERT_TRUE(
+      cache.addLayerItem(createLayerItem("commit-other", "app.other", "2.0.0.0")).has_value());
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-2", "app.test", "2.0.0.0")).has_value());
+    // the image is written by compaction
+    ASSERT_TRUE(cache.writeToDisk().has_value());
+    EXPECT_TRUE(fs::exists(tempDir.path() / "states.bin"));
+
+    RepoCache reloaded(cacheFile);
+    ASSERT_TRUE(reloaded.load().has_value());
+
+    auto items = reloaded.queryLayerItem(repoCacheQuery{ .id = "app.test" });
+    ASSERT_EQ(items.size(), 3);
+    EXPECT_EQ(items[0].commit, "commit-3");
+    EXPECT_EQ(items[1].commit, "commit-2");
+    EXPECT_EQ(items[2].commit, "commit-1");
+
+    auto all = reloaded.queryLayerItem(repoCacheQuery{});
+    ASSERT_EQ(all.size(), 4);
+    EXPECT_EQ(all[0].commit, "commit-3");
+    EXPECT_EQ(all[1].commit, "commit-other");
+
+    auto existing = reloaded.queryExistingLayerItem();
+    ASSERT_EQ(existing.size(), 4);
+    EXPECT_EQ(existing.front().commit, "commit-1");
+
+    // mutations on a cache loaded from image
+    ASSERT_TRUE(reloaded.deleteLayerItem(items[0]).has_value());
+    RepoCache afterDelete(cacheFile);
+    ASSERT_TRUE(afterDelete.load().has_value());
+    EXPECT_EQ(afterDelete.queryLayerItem(repoCacheQuery{ .id = "app.test" }).size(), 2);
+}
+
+TEST_F(RepoCacheTest, journaledMutationsKeepImage)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    auto imageFile = tempDir.path() / "states.bin";
+    RepoCache cache(cacheFile);
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-1", "app.test", "1.0.0")).has_value());
+    ASSERT_TRUE(fs::exists(imageFile));
+    auto imageTime = fs::last_write_time(imageFile);
+
+    // appending to the journal doesn't rewrite the image, it's outdated until the next compaction
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-2", "app.test", "2.0.0")).has_value());
+    EXPECT_EQ(fs::last_write_time(imageFile), imageTime);
+
+    RepoCache reloaded(cacheFile);
+    ASSERT_TRUE(reloaded.load().has_value());
+    auto items = reloaded.queryLayerItem(repoCacheQuery{ .id = "app.test" });
+    ASSERT_EQ(items.size(), 2);
+    EXPECT_EQ(items.front().commit, "commit-2");
+}
+
+TEST_F(RepoCacheTest, loadIgnoresOutdatedImage)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    RepoCache cache(cacheFile);
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-1", "app.test", "1.0.0")).has_value());
+    ASSERT_TRUE(fs::exists(tempDir.path() / "states.bin"));
+
+    // states.json is the source of truth
+    writeCacheFile(cacheFile,
+                   api::types::v1::RepositoryCache{
+                     .config = createRepoConfig(),
+                     .layers = { createLayerItem("commit-2", "app.other", "1.0.0") },
+                     .llVersion = "test",
+                     .merged = std::nullopt,
+                     .version = "2",
+                   });
+
+    RepoCache reloaded(cacheFile);
+    ASSERT_TRUE(reloaded.load().has_value());
+    EXPECT_TRUE(reloaded.queryLayerItem(repoCacheQuery{ .id = "app.test" }).empty());
+    EXPECT_EQ(reloaded.queryLayerItem(repoCacheQuery{ .id = "app.other" }).size(), 1);
+}
+
+TEST_F(RepoCacheTest, generationIsBumpedByMutationsAndPersisted)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    RepoCache cache(cacheFile);
+    EXPECT_EQ(cache.generation(), 0);
+
+    auto item = createLayerItem("commit-1", "app.test", "1.0.0");
+    ASSERT_TRUE(cache.addLayerItem(item).has_value());
+    ASSERT_TRUE(cache.markLayerItemDeleted(item, true).has_value());
+    ASSERT_TRUE(cache.updateMergedItems({}).has_value());
+    EXPECT_EQ(cache.generation(), 3);
+
+    // from the image
+    RepoCache reloaded(cacheFile);
+    ASSERT_TRUE(reloaded.load().has_value());
+    EXPECT_EQ(reloaded.generation(), 3);
+
+    // from states.json and its journal
+    fs::remove(tempDir.path() / "states.bin");
+    RepoCache replayed(cacheFile);
+    ASSERT_TRUE(replayed.load().has_value());
+    EXPECT_EQ(replayed.generation(), 3);
+
+    // compaction doesn't change the content
+    ASSERT_TRUE(replayed.writeToDisk().has_value());
+    RepoCache compacted(cacheFile);
+    ASSERT_TRUE(compacted.load().has_value());
+    EXPECT_EQ(compacted.generation(), 3);
+
+    ASSERT_TRUE(compacted.deleteLayerItem(item).has_value());
+    EXPECT_EQ(compacted.generation(), 4);
+}
+
+TEST_F(RepoCacheTest, brokenImageKeepsLayers)
+{
+    ASSERT_TRUE(tempDir.isValid());
+
+    auto cacheFile = tempDir.path() / "states.json";
+    auto imageFile = tempDir.path() / "states.bin";
+    RepoCache cache(cacheFile);
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-1", "app.test", "1.0.0")).has_value());
+    ASSERT_TRUE(cache.addLayerItem(createLayerItem("commit-2", "app.other", "1.0.0")).has_value());
+    ASSERT_TRUE(cache.writeToDisk().has_value());
+
+    // break the package info of one layer, the stamp of the image still matches
+    std::string content;
+    {
+        std::ifstream in(imageFile, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto pos = content.find("\"kind\":\"");
+    ASSERT_NE(pos, std::string::npos);
+    content[pos + 6] = '!';
+    {
+        std::ofstream out(imageFile, std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+
+    RepoCache reloaded(cacheFile);
+    ASSERT_TRUE(reloaded.load().has_value());
+    EXPECT_EQ(reloaded.queryLayerItem(repoCacheQuery{}).size(), 2);
+    EXPECT_EQ(reloaded.queryExistingLayerItem().size(), 2);
+
+    // the compaction writes every layer back to states.json
+    ASSERT_TRUE(
+      reloaded.addLayerItem(createLayerItem("commit-3", "app.third", "1.0.0")).has_value());
+    ASSERT_TRUE(reloaded.writeToDisk().has_value());
+    fs::remove(imageFile);
+    RepoCache compacted(cacheFile);
+    ASSERT_TRUE(compacted.load().has_value());
+    EXPECT_EQ(compacted.queryLayerItem(repoCacheQuery{}).size(), 3);
+}
+
+// the latency of the queries `ll-cli run` and the package manager do, by the number of layers
+TEST_F(RepoCacheTest, queryLayerItemBenchmark)
+{
+    SKIP_UNLESS_BENCHMARK();
+    ASSERT_TRUE(tempDir.isValid());
+
+    constexpr std::size_t Rounds = 1000;
+    using Clock = std::chrono::steady_clock;
+
+    for (std::size_t layerCount : { 100, 1000, 10000 }) {
+        // ten versions of every app
+        api::types::v1::RepositoryCache data{
+            .config = createRepoConfig(),
+            .llVersion = "test",
+            .merged = std::nullopt,
+            .version = "2",
+        };
+        for (std::size_t i = 0; i < layerCount; ++i) {
+            data.layers.emplace_back(createLayerItem("commit-" + std::to_string(i),
+                                                     "app.test" + std::to_string(i / 10),
+                                                     "1.0." + std::to_string(i % 10)));
+        }
+
+        auto cacheFile = tempDir.path() / ("states-" + std::to_string(layerCount) + ".json");
+        writeCacheFile(cacheFile, data);
+        RepoCache cache(cacheFile);
+        ASSERT_TRUE(cache.load().has_value());
+
+        auto begin = Clock::now();
+        for (std::size_t i = 0; i < Rounds; ++i) {
+            auto id = "app.test" + std::to_string(i % (layerCount / 10));
+            auto items = cache.queryLayerItem(repoCacheQuery{ .id = id, .module = "binary" });
+            ASSERT_EQ(items.size(), 10);
+            ASSERT_EQ(items.front().info.version, "1.0.9");
+        }
+        std::chrono::duration<double, std::micro> latency = (Clock::now() - begin) / Rounds;
+
+        RecordProperty("queryUs" + std::to_string(layerCount), std::to_string(latency.count()));
+    }
+}
+
+// the time `ll-cli list` and `run` spend loading the cache and resolving a layer, from states.json
+// and from the image
+TEST_F(RepoCacheTest, loadBenchmark)
+{
+    SKIP_UNLESS_BENCHMARK();
+    ASSERT_TRUE(tempDir.isValid());
+
+    constexpr std::size_t LayerCount = 10000;
+    using Clock = std::chrono::steady_clock;
+
+    api::types::v1::RepositoryCache data{
+        .config = createRepoConfig(),
+        .llVersion = "test",
+        .merged = std::nullopt,
+        .version = "2",
+    };
+    for (std::size_t i = 0; i < LayerCount; ++i) {
+        data.layers.emplace_back(createLayerItem("commit-" + std::to_string(i),
+                                                 "app.test" + std::to_string(i / 10),
+                                                 "1.0." + std::to_string(i % 10)));
+    }
+    auto cacheFile = tempDir.path() / "states.json";
+    writeCacheFile(cacheFile, data);
+
+    auto resolve = [&cacheFile]() {
+        auto begin = Clock::now();
+        RepoCache cache(cacheFile);
+        EXPECT_TRUE(cache.load().has_value());
+        auto items = cache.queryLayerItem(repoCacheQuery{ .id = "app.test42" });
+        EXPECT_EQ(items.size(), 10);
+        return std::chrono::duration<double, std::milli>(Clock::now() - begin);
+    };
+
+    auto json = resolve();
+    {
+        RepoCache cache(cacheFile);
+        ASSERT_TRUE(cache.load().has_value());
+        ASSERT_TRUE(cache.writeToDisk().has_value());
+    }
+    ASSERT_TRUE(fs::exists(tempDir.path() / "states.bin"));
+    auto image = resolve();
+
+    RecordProperty("jsonMs", std::to_string(json.count()));
+    RecordProperty("imageMs", std::to_string(image.count()));
+}
+
 } // namespace
 
 } // namespace linglong::repo::test
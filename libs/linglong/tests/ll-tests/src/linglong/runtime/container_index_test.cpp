@@ -0,0 +1,143 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "../../common/tempdir.h"
+#include "linglong/api/types/v1/Generators.hpp" // IWYU pragma: keep
+#include "linglong/runtime/container_index.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace linglong;
+
+namespace {
+
+api::types::v1::ContainerProcessStateInfo stateInfo(const std::string &containerID)
+{
+    return api::types::v1::ContainerProcessStateInfo{
+        .app = "main:org.deepin.demo/1.0.0/x86_64",
+        .base = "main:org.deepin.base/23.1.0/x86_64",
+        .containerID = containerID,
+        .extensions = std::nullopt,
+        .runtime = "main:org.deepin.runtime.dtk/23.1.0/x86_64",
+    };
+}
+
+TEST(ContainerIndexTest, AddAndRemove)
+{
+    TempDir dir;
+    runtime::ContainerIndex index(dir.path());
+
+    auto entries = index.list();
+    ASSERT_TRUE(entries) << entries.error().message();
+    EXPECT_TRUE(entries->empty());
+
+    auto ret = index.add(stateInfo("container"));
+    ASSERT_TRUE(ret) << ret.error().message();
+
+    entries = index.list();
+    ASSERT_TRUE(entries) << entries.error().message();
+    ASSERT_EQ(entries->size(), 1);
+    EXPECT_EQ(entries->front().pid, ::getpid());
+    EXPECT_EQ(entries->front().info.containerID, "container");
+    EXPECT_EQ(entries->front().info.app, "main:org.deepin.demo/1.0.0/x86_64");
+
+    ret = index.remove();
+    ASSERT_TRUE(ret) << ret.error().message();
+
+    entries = index.list();
+    ASSERT_TRUE(entries) << entries.error().message();
+    EXPECT_TRUE(entries->empty());
+}
+
+TEST(ContainerIndexTest, SkipExitedProcesses)
+{
+    TempDir dir;
+    runtime::ContainerIndex index(dir.path());
+
+    // the ll-cli is killed before removing its container
+    auto child = ::fork();
+    ASSERT_NE(child, -1);
+    if (child == 0) {
+        _exit(index.add(stateInfo("killed")) ? 0 : 1);
+    }
+
+    int status = 0;
+    ASSERT_EQ(::waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    auto ret = index.add(stateInfo("running"));
+    ASSERT_TRUE(ret) << ret.error().message();
+
+    auto entries = index.list();
+    ASSERT_TRUE(entries) << entries.error().message();
+    ASSERT_EQ(entries->size(), 1);
+    EXPECT_EQ(entries->front().info.containerID, "running");
+}
+
+TEST(ContainerIndexTest, RebuildFromPidFiles)
+{
+    TempDir dir;
+    std::ofstream{ dir.path() / std::to_string(::getpid()) }
+      << nlohmann::json(stateInfo("container"));
+    // the process has exited
+    std::ofstream{ dir.path() / "999999999" } << nlohmann::json(stateInfo("exited"));
+    std::ofstream{ dir.path() / ".cli.container.lock" };
+
+    runtime::ContainerIndex index(dir.path());
+    auto entries = index.list();
+    ASSERT_TRUE(entries) << entries.error().message();
+    ASSERT_EQ(entries->size(), 1);
+    EXPECT_EQ(entries->front().pid, ::getpid());
+    EXPECT_EQ(entries->front().info.containerID, "container");
+
+    // the entry of the pid file isn't duplicated
+    auto ret = index.add(stateInfo("container"));
+    ASSERT_TRUE(ret) << ret.error().message();
+    entries = index.list();
+    ASSERT_TRUE(entries) << entries.error().message();
+    EXPECT_EQ(entries->size(), 1);
+}
+
+TEST(ContainerIndexTest, ListAllUsers)
+{
+    TempDir root;
+    for (const auto *user : { "1000", "1001" }) {
+        std::filesystem::create_directories(root.path() / user);
+        auto ret = runtime::ContainerIndex(root.path() / user).add(stateInfo(user));
+        ASSERT_TRUE(ret) << ret.error().message();
+    }
+
+    auto entries = runtime::ContainerIndex::listAll(root.path());
+    ASSERT_TRUE(entries) << entries.error().message();
+    EXPECT_EQ(entries->size(), 2);
+
+    // the broken index of a user is skipped, the containers of its pid files are still listed
+    auto broken = root.path() / "1002";
+    std::filesystem::create_directories(broken);
+    std::ofstream{ broken / "containers.json" } << "[{";
+    std::ofstream{ broken / std::to_string(::getpid()) } << nlohmann::json(stateInfo("1002"));
+
+    entries = runtime::ContainerIndex::listAll(root.path());
+    ASSERT_TRUE(entries) << entries.error().message();
+    EXPECT_EQ(entries->size(), 3);
+}
+
+TEST(ContainerIndexTest, ContainerPid)
+{
+    TempDir bundle;
+    EXPECT_FALSE(runtime::containerPid(bundle.path()).has_value());
+
+    std::ofstream{ bundle.path() / runtime::ContainerPidFile } << "1234";
+    EXPECT_EQ(runtime::containerPid(bundle.path()), 1234);
+}
+
+} // namespace
@@ -0,0 +1,237 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "../../common/benchmark.h"
+#include "../../common/tempdir.h"
+#include "linglong/common/socket.h"
+#include "linglong/runtime/init_exec.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace linglong;
+
+namespace {
+
+using Handler =
+  std::function<void(int connection, std::vector<int> &stdio, const std::string &payload)>;
+
+std::vector<std::string> splitFields(const std::string &payload)
+{
+    std::vector<std::string> fields;
+    std::size_t begin = 0;
+    while (begin < payload.size()) {
+        auto end = payload.find('\0', begin);
+        fields.emplace_back(payload, begin, end - begin);
+        begin = end + 1;
+    }
+    return fields;
+}
+
+// runs the command of a request like ll-init
+void runCommand(int connection, std::vector<int> &stdio, const std::string &payload)
+{
+    auto fields = splitFields(payload);
+    ASSERT_GE(fields.size(), 3);
+    auto argc = std::stoul(fields[0]);
+    auto envc = std::stoul(fields[1]);
+    ASSERT_EQ(fields.size(), 3 + argc + envc);
+
+    std::vector<char *> args;
+    for (std::size_t i = 3; i < 3 + argc; ++i) {
+        args.push_back(fields[i].data());
+    }
+    args.push_back(nullptr);
+    std::vector<char *> env;
+    for (std::size_t i = 3 + argc; i < fields.size(); ++i) {
+        env.push_back(fields[i].data());
+    }
+    env.push_back(nullptr);
+
+    auto pid = ::fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0) {
+        for (int i = 0; i < 3; ++i) {
+            ::dup2(stdio[i], i);
+        }
+        if (!fields[2].empty() && ::chdir(fields[2].c_str()) == -1) {
+            ::_exit(EXIT_FAILURE);
+        }
+        if (envc == 0) {
+            ::execvp(args[0], args.data());
+        } else {
+            ::execvpe(args[0], args.data(), env.data());
+        }
+        ::_exit(EXIT_FAILURE);
+    }
+
+    int status = 0;
+    ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+    auto reply = "exit " + std::to_string(WEXITSTATUS(status));
+    ::send(connection, reply.data(), reply.size(), MSG_NOSIGNAL);
+}
+
+// Serves count requests on socketPath in a thread, the protocol of ll-init is not exercised here.
+class FakeInit
+{
+public:
+    FakeInit(const std::filesystem::path &socketPath, std::size_t count, Handler handler)
+    {
+        auto fd = common::socket::createUnixSocket(socketPath.string());
+        EXPECT_TRUE(fd) << fd.error();
+        listenFd = *fd;
+        thread = std::thread([this, count, handler = std::move(handler)]() {
+            for (std::size_t i = 0; i < count; ++i) {
+                auto connection = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (connection == -1) {
+                    return;
+                }
+                auto data = common::socket::recvFdsWithPayload(connection, 3, 256 * 1024);
+                if (data) {
+                    handler(connection, data->fds, data->payload);
+                    for (auto stdioFd : data->fds) {
+                        ::close(stdioFd);
+                    }
+                }
+                ::close(connection);
+            }
+        });
+    }
+
+    FakeInit(const FakeInit &) = delete;
+    FakeInit &operator=(const FakeInit &) = delete;
+    FakeInit(FakeInit &&) = delete;
+    FakeInit &operator=(FakeInit &&) = delete;
+
+    ~FakeInit()
+    {
+        thread.join();
+        ::close(listenFd);
+    }
+
+private:
+    int listenFd{ -1 };
+    std::thread thread;
+};
+
+TEST(InitExecTest, RunCommand)
+{
+    TempDir dir;
+    auto socketPath = runtime::initExecSocketPath(dir.path());
+    std::filesystem::create_directories(socketPath.parent_path());
+    FakeInit init(socketPath, 1, runCommand);
+
+    auto output = dir.path() / "output";
+    auto fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    ASSERT_NE(fd, -1);
+
+    auto ret = runtime::sendInitExecRequest(
+      socketPath,
+      runtime::InitExecRequest{
+        .args = { "sh", "-c", "echo \"$GREETING\" $(pwd); exit 3" },
+        .env = { "GREETING=hello", "PATH=/usr/bin:/bin" },
+        .cwd = "/",
+        .stdio = { STDIN_FILENO, fd, STDERR_FILENO },
+      });
+    ::close(fd);
+    ASSERT_TRUE(ret) << ret.error().message();
+    ASSERT_TRUE(ret->has_value());
+    EXPECT_EQ(**ret, 3);
+
+    std::ifstream stream(output);
+    std::string line;
+    std::getline(stream, line);
+    EXPECT_EQ(line, "hello /");
+}
+
+TEST(InitExecTest, NoServer)
+{
+    TempDir dir;
+    auto ret = runtime::sendInitExecRequest(runtime::initExecSocketPath(dir.path()),
+                                            runtime::InitExecRequest{ .args = { "true" } });
+    ASSERT_TRUE(ret) << ret.error().message();
+    EXPECT_FALSE(ret->has_value());
+}
+
+TEST(InitExecTest, Refused)
+{
+    TempDir dir;
+    auto socketPath = dir.path() / "exec.sock";
+    FakeInit init(socketPath, 1, [](int connection, std::vector<int> &, const std::string &) {
+        std::string reply = "error invalid request";
+        ::send(connection, reply.data(), reply.size(), MSG_NOSIGNAL);
+    });
+
+    auto ret =
+      runtime::sendInitExecRequest(socketPath, runtime::InitExecRequest{ .args = { "true" } });
+    ASSERT_TRUE(ret) << ret.error().message();
+    EXPECT_FALSE(ret->has_value());
+}
+
+TEST(InitExecTest, ConnectionLost)
+{
+    TempDir dir;
+    auto socketPath = dir.path() / "exec.sock";
+    FakeInit init(socketPath, 1, [](int, std::vector<int> &, const std::string &) { });
+
+    // the command may have been started, it must not be run again by the OCI runtime
+    auto ret =
+      runtime::sendInitExecRequest(socketPath, runtime::InitExecRequest{ .args = { "true" } });
+    EXPECT_FALSE(ret);
+}
+
+// The latency of a reuse through the exec socket. A reuse through `ociCLI.exec` starts the OCI
+// runtime, which enters the namespaces of the container and starts ll-init to fork the command,
+// it can't be measured without a running container. The spawn of the command itself is reported
+// as the lower bound of both.
+TEST(InitExecTest, SpawnLatencyBenchmark)
+{
+    SKIP_UNLESS_BENCHMARK();
+
+    constexpr std::size_t Rounds = 50;
+    using Clock = std::chrono::steady_clock;
+
+    TempDir dir;
+    auto socketPath = dir.path() / "exec.sock";
+    FakeInit init(socketPath, Rounds, runCommand);
+
+    auto begin = Clock::now();
+    for (std::size_t i = 0; i < Rounds; ++i) {
+        auto ret =
+          runtime::sendInitExecRequest(socketPath, runtime::InitExecRequest{ .args = { "true" } });
+        ASSERT_TRUE(ret) << ret.error().message();
+        ASSERT_EQ(ret->value_or(-1), 0);
+    }
+    std::chrono::duration<double, std::micro> socketLatency = (Clock::now() - begin) / Rounds;
+
+    begin = Clock::now();
+    for (std::size_t i = 0; i < Rounds; ++i) {
+        auto pid = ::fork();
+        ASSERT_NE(pid, -1);
+        if (pid == 0) {
+            ::execlp("true", "true", nullptr);
+            ::_exit(EXIT_FAILURE);
+        }
+        int status = 0;
+        ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+    }
+    std::chrono::duration<double, std::micro> spawnLatency = (Clock::now() - begin) / Rounds;
+
+    RecordProperty("socketUs", std::to_string(socketLatency.count()));
+    RecordProperty("spawnUs", std::to_string(spawnLatency.count()));
+}
+
+} // namespace
@@ -0,0 +1,174 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "common/tempdir.h"
+#include "linglong/runtime/ld_cache_generator.h"
+
+#include <fmt/format.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+using linglong::package::Architecture;
+using linglong::runtime::LdCacheGenerator;
+
+namespace {
+
+void writeFile(const fs::path &path, const std::string &content)
+{
+    fs::create_directories(path.parent_path());
+    std::ofstream(path) << content;
+}
+
+std::string readFile(const fs::path &path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    std::stringstream content;
+    content << stream.rdbuf();
+    return content.str();
+}
+
+std::optional<fs::path> findLdconfig()
+{
+    for (const auto *path : { "/sbin/ldconfig", "/usr/sbin/ldconfig" }) {
+        if (::access(path, X_OK) == 0) {
+            return path;
+        }
+    }
+
+    return std::nullopt;
+}
+
+// some shared libraries of the host, which are copied into the test layers
+std::vector<fs::path> hostLibraries(const Architecture &arch, std::size_t count)
+{
+    std::vector<fs::path> libraries;
+    std::error_code ec;
+    for (const auto &entry : fs::directory_iterator("/usr/lib/" + arch.getTriplet(), ec)) {
+        auto name = entry.path().filename().string();
+        if (entry.is_symlink() || !entry.is_regular_file() || name.rfind("lib", 0) != 0
+            || name.find(".so.") == std::string::npos) {
+            continue;
+        }
+        libraries.push_back(entry.path());
+    }
+
+    std::sort(libraries.begin(), libraries.end());
+    if (libraries.size() > count) {
+        libraries.resize(count);
+    }
+    return libraries;
+}
+
+// the generator string in the extension of a cache written by ldconfig
+std::string cacheGenerator(const std::string &cache)
+{
+    uint32_t extensionOffset = 0;
+    std::memcpy(&extensionOffset, cache.data() + 32, sizeof(extensionOffset));
+
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    std::memcpy(&offset, cache.data() + extensionOffset + 16, sizeof(offset));
+    std::memcpy(&size, cache.data() + extensionOffset + 20, sizeof(size));
+    return cache.substr(offset, size);
+}
+
+TEST(LdCacheGeneratorTest, MatchesLdconfig)
+{
+    const auto &arch = Architecture::currentCPUArchitecture();
+    auto ldconfig = findLdconfig();
+    auto libraries = hostLibraries(arch, 4);
+    if (!ldconfig || libraries.size() < 4) {
+        GTEST_SKIP() << "ldconfig or host libraries not found";
+    }
+
+    TempDir tempDir;
+    auto base = tempDir.path() / "base";
+    auto runtime = tempDir.path() / "runtime";
+    auto app = tempDir.path() / "app";
+    auto triplet = arch.getTriplet();
+
+    writeFile(base / "etc/ld.so.conf", "include /etc/ld.so.conf.d/*.conf\n");
+    writeFile(base / "etc/ld.so.conf.d/base.conf", "# base libraries\n\n  /usr/lib/extra/\n");
+    fs::create_directories(base / "usr/lib" / triplet);
+    fs::create_directories(base / "usr/lib/extra");
+    fs::create_symlink("usr/lib", base / "lib");
+    fs::copy_file(libraries[0], base / "usr/lib" / triplet / libraries[0].filename());
+    fs::copy_file(libraries[1], base / "usr/lib/extra" / libraries[1].filename());
+
+    auto runtimeLib = runtime / "lib" / triplet;
+    fs::create_directories(runtimeLib);
+    fs::copy_file(libraries[2], runtimeLib / libraries[2].filename());
+    fs::create_symlink(libraries[2].filename(), runtimeLib / "libtest-dev.so");
+    fs::create_symlink("/runtime/lib/" + triplet + "/" + libraries[2].filename().string(),
+                       runtime / "lib/libabsolute.so.1");
+    fs::create_symlink("missing.so.1", runtimeLib / "libbroken.so.1");
+    writeFile(runtimeLib / "libscript.so", "GROUP ( libscript.so.1 )\n");
+    writeFile(runtimeLib / "libempty.so.1", "");
+    writeFile(runtimeLib / "README", "not a library\n");
+
+    fs::create_directories(app / "lib");
+    fs::copy_file(libraries[3], app / "lib" / libraries[3].filename());
+    fs::copy_file(libraries[2], app / "lib" / libraries[2].filename());
+
+    std::string ldConf;
+    for (const std::string prefix : { "/runtime", "/opt/apps/org.test/files" }) {
+        ldConf +=
+          fmt::format("{0}/lib\n{0}/lib/{1}\ninclude {0}/etc/ld.so.conf\n", prefix, triplet);
+    }
+    const fs::path ldConfPath = "/etc/ld.so.conf.d/zz_deepin-linglong-app.conf";
+
+    // the same filesystem as the container for ldconfig
+    auto root = tempDir.path() / "root";
+    fs::copy(base, root, fs::copy_options::recursive | fs::copy_options::copy_symlinks);
+    fs::copy(runtime,
+             root / "runtime",
+             fs::copy_options::recursive | fs::copy_options::copy_symlinks);
+    fs::create_directories(root / "opt/apps/org.test");
+    fs::copy(app,
+             root / "opt/apps/org.test/files",
+             fs::copy_options::recursive | fs::copy_options::copy_symlinks);
+    writeFile(root / ldConfPath.relative_path(), ldConf);
+
+    auto command =
+      fmt::format("{} -X -r {} -C /etc/ld.so.cache 2>/dev/null", ldconfig->string(), root.string());
+    ASSERT_EQ(std::system(command.c_str()), 0);
+    auto expected = readFile(root / "etc/ld.so.cache");
+    ASSERT_FALSE(expected.empty());
+
+    LdCacheGenerator generator({ { "/", base },
+                                 { "/runtime", runtime },
+                                 { "/opt/apps/org.test/files", app } },
+                               arch);
+    generator.addFile(ldConfPath, ldConf);
+    ASSERT_TRUE(generator.addConfFile("/etc/ld.so.conf"));
+    generator.addSystemDirs();
+
+    auto cache = generator.generate(cacheGenerator(expected));
+    ASSERT_TRUE(cache) << cache.error().message();
+    EXPECT_EQ(cache->size(), expected.size());
+    EXPECT_TRUE(*cache == expected);
+
+    auto output = tempDir.path() / "output/ld.so.cache";
+    ASSERT_TRUE(generator.write(output, cacheGenerator(expected)));
+    EXPECT_EQ(readFile(output), *cache);
+}
+
+TEST(LdCacheGeneratorTest, RejectsHwcapsSubdirectories)
+{
+    TempDir tempDir;
+    fs::create_directories(tempDir.path() / "usr/lib/glibc-hwcaps/x86-64-v3");
+
+    LdCacheGenerator generator({ { "/", tempDir.path() } },
+                               Architecture::currentCPUArchitecture());
+    generator.addDir("/usr/lib");
+    EXPECT_FALSE(generator.generate("test"));
+}
+
+} // namespace
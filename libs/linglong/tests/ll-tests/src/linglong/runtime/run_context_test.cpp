@@ -6,11 +6,13 @@
 #include <gtest/gtest.h>
 
 #include "../../common/tempdir.h"
+#include "linglong/api/types/v1/Generators.hpp"
 #include "linglong/cli/cli.h"
 #include "linglong/oci-cfg-generators/container_cfg_builder.h"
 #include "linglong/package/fuzzy_reference.h"
 #include "linglong/repo/ostree_repo.h"
 #include "linglong/runtime/run_context.h"
+#include "linglong/runtime/run_context_cache.h"
 
 #include <QCryptographicHash>
 #include <QFile>
@@ -970,6 +972,88 @@ TEST_F(RunContextTest, resolveFromConfigVersionMismatch)
     EXPECT_THAT(result.error().message(), ::testing::HasSubstr("version mismatch"));
 }
 
+TEST_F(RunContextTest, resolveWithCache)
+{
+    auto runnableRef = package::Reference::parse("stable:org.example.runnable/1.0.0/x86_64");
+    ASSERT_TRUE(runnableRef.has_value()) << runnableRef.error().message();
+    auto runtimeRef = package::Reference::parse("stable:org.deepin.runtime/23.0.0/x86_64");
+    ASSERT_TRUE(runtimeRef.has_value()) << runtimeRef.error().message();
+    auto baseRef = package::Reference::parse("stable:org.deepin.base/23.0.0/x86_64");
+    ASSERT_TRUE(baseRef.has_value()) << baseRef.error().message();
+
+    api::types::v1::RepositoryCacheLayersItem appItem;
+    appItem.info.id = "org.example.runnable";
+    appItem.info.version = "1.0.0";
+    appItem.info.kind = "app";
+    appItem.info.channel = "stable";
+    appItem.info.arch = { std::string{ "x86_64" } };
+    appItem.info.base = "org.deepin.base/23.0.0";
+    appItem.info.runtime = "org.deepin.runtime/23.0.0";
+
+    api::types::v1::RepositoryCacheLayersItem runtimeItem;
+    runtimeItem.info.id = "org.deepin.runtime";
+    runtimeItem.info.version = "23.0.0";
+    runtimeItem.info.kind = "runtime";
+    runtimeItem.info.channel = "stable";
+    runtimeItem.info.arch = { std::string{ "x86_64" } };
+
+    api::types::v1::RepositoryCacheLayersItem baseItem;
+    baseItem.info.id = "org.deepin.base";
+    baseItem.info.version = "23.0.0";
+    baseItem.info.kind = "base";
+    baseItem.info.channel = "stable";
+    baseItem.info.arch = { std::string{ "x86_64" } };
+
+    EXPECT_CALL(*repo, getLayerItem(*runnableRef, testing::_, testing::_))
+      .WillRepeatedly(Return(appItem));
+    EXPECT_CALL(*repo, getLayerItem(*runtimeRef, testing::_, testing::_))
+      .WillRepeatedly(Return(runtimeItem));
+    EXPECT_CALL(*repo, getLayerItem(*baseRef, testing::_, testing::_))
+      .WillRepeatedly(Return(baseItem));
+    // references are only cleared by the first resolution
+    EXPECT_CALL(*repo, clearReferenceLocal(testing::_, testing::_))
+      .WillOnce(Return(*runtimeRef))
+      .WillOnce(Return(*baseRef));
+
+    package::LayerDir mockLayerDir(tempDir->path() / "merged");
+    EXPECT_CALL(*repo, getMergedModuleDir(testing::_, testing::_, testing::_))
+      .WillRepeatedly(Return(utils::error::Result<package::LayerDir>(mockLayerDir)));
+
+    ResolveOptions opts;
+    opts.instance = "test";
+    runtime::RunContextCache cache(tempDir->path() / "run-context");
+
+    RunContext context(*this->repo);
+    auto result = context.resolve(*runnableRef, opts, cache);
+    ASSERT_TRUE(result.has_value()) << result.error().message();
+
+    RunContext cached(*this->repo);
+    result = cached.resolve(*runnableRef, opts, cache);
+    ASSERT_TRUE(result.has_value()) << result.error().message();
+
+    EXPECT_EQ(nlohmann::json(cached.getConfig()), nlohmann::json(context.getConfig()));
+    EXPECT_EQ(cached.getContainerId(), context.getContainerId());
+    EXPECT_EQ(cached.getTargetID(), "org.example.runnable");
+    EXPECT_TRUE(cached.getAppLayer().has_value());
+    EXPECT_TRUE(cached.getRuntimeLayer().has_value());
+    EXPECT_TRUE(cached.getBaseLayer().has_value());
+
+    // per run options and the host state are not cached
+    runtime::RunContextCache::Key key{ .repoDir = repo->getRepoDir(),
+                                       .ref = runnableRef->toString(),
+                                       .options = opts };
+    auto entry = cache.lookup(key, repo->cacheGeneration());
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_FALSE(entry->instance.has_value());
+    EXPECT_FALSE(entry->timezone.has_value());
+    EXPECT_EQ(entry->runtime, runtimeRef->toString());
+
+    // any change of the repo invalidates the entry
+    EXPECT_FALSE(cache.lookup(key, repo->cacheGeneration() + 1).has_value());
+    key.options.depsExcludeDev = true;
+    EXPECT_FALSE(cache.lookup(key, repo->cacheGeneration()).has_value());
+}
+
 TEST(ResolveOptionsTest, ApplyRuntimeConfigSetsExtDefs)
 {
     ResolveOptions opts;
@@ -4,8 +4,17 @@
 
 #include <gtest/gtest.h>
 
+#include "../../common/benchmark.h"
+#include "../../common/tempdir.h"
 #include "linglong/utils/cmd.h"
 
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
 namespace {
 
 TEST(command, Exec)
@@ -76,4 +85,93 @@ TEST(command, toStdin)
       << "wc -c should report 1049600 bytes, got: " << *ret4;
 }
 
+TEST(command, streamOutput)
+{
+    std::vector<std::string> chunks;
+    std::string errors;
+    auto ret = linglong::utils::Cmd("sh")
+                 .onStdout([&chunks](std::string_view chunk) {
+                     chunks.emplace_back(chunk);
+                 })
+                 .onStderr([&errors](std::string_view chunk) {
+                     errors.append(chunk);
+                 })
+                 .exec({ "-c", "echo first; sleep 0.1; echo second; echo oops >&2" });
+    ASSERT_TRUE(ret.has_value()) << ret.error().message();
+    // the output is passed to the handler instead of being returned
+    EXPECT_TRUE(ret->empty());
+    ASSERT_EQ(chunks.size(), 2);
+    EXPECT_EQ(chunks[0], "first\n");
+    EXPECT_EQ(chunks[1], "second\n");
+    EXPECT_EQ(errors, "oops\n");
+}
+
+TEST(command, startConcurrently)
+{
+    // every process waits until all of them are started, they only finish if start doesn't wait
+    // for the previous ones
+    constexpr auto script = R"sh(touch "$1/$2"; n=0
+while [ "$(ls "$1" | wc -l)" -lt 4 ] && [ $n -lt 300 ]; do sleep 0.1; n=$((n + 1)); done
+if [ "$(ls "$1" | wc -l)" -ge 4 ]; then echo done; else echo alone; fi)sh";
+
+    TempDir dir;
+    std::vector<linglong::utils::Cmd::Process> processes;
+    for (int i = 0; i < 4; ++i) {
+        auto process = linglong::utils::Cmd("sh").start(
+          { "-c", script, "sh", dir.path().string(), std::to_string(i) });
+        ASSERT_TRUE(process.has_value()) << process.error().message();
+        processes.push_back(std::move(process).value());
+    }
+
+    for (auto &process : processes) {
+        auto ret = process.wait();
+        ASSERT_TRUE(ret.has_value()) << ret.error().message();
+        EXPECT_EQ(*ret, "done\n");
+    }
+
+    // the exec errors are reported by start
+    auto missing = linglong::utils::Cmd("/proc/self/fdinfo").start();
+    EXPECT_FALSE(missing.has_value());
+}
+
+// Spawn rate of a process with a large heap like ll-package-manager, fork copies the page tables
+// of the whole heap before exec while posix_spawn doesn't.
+TEST(command, spawnRateBenchmark)
+{
+    SKIP_UNLESS_BENCHMARK();
+
+    constexpr int Rounds = 200;
+    constexpr std::size_t HeapSize = 256 * 1024 * 1024;
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<char> heap(HeapSize);
+    std::memset(heap.data(), 1, heap.size());
+
+    auto begin = Clock::now();
+    for (int i = 0; i < Rounds; ++i) {
+        auto ret = linglong::utils::Cmd("true").exec();
+        ASSERT_TRUE(ret.has_value()) << ret.error().message();
+    }
+    std::chrono::duration<double> spawnElapsed = Clock::now() - begin;
+
+    begin = Clock::now();
+    for (int i = 0; i < Rounds; ++i) {
+        auto pid = fork();
+        ASSERT_NE(pid, -1);
+        if (pid == 0) {
+            execlp("true", "true", nullptr);
+            _exit(EXIT_FAILURE);
+        }
+        int status = 0;
+        ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    }
+    std::chrono::duration<double> forkElapsed = Clock::now() - begin;
+
+    auto spawnRate = Rounds / spawnElapsed.count();
+    auto forkRate = Rounds / forkElapsed.count();
+    RecordProperty("spawnPerSecond", std::to_string(spawnRate));
+    RecordProperty("forkPerSecond", std::to_string(forkRate));
+    EXPECT_GT(heap[HeapSize / 2], 0);
+}
+
 } // namespace
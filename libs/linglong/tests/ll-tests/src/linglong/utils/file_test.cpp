@@ -11,7 +11,10 @@
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <unistd.h>
 
@@ -235,6 +238,26 @@ TEST_F(FileTest, MoveFiles_MatcherFileInUnmatchedDir)
     EXPECT_TRUE(fs::is_directory(src_dir / "subdir1" / "subdir2"));
 }
 
+TEST_F(FileTest, MoveFiles_MatcherThrows)
+{
+    auto matcher = [](const fs::path &path) -> bool {
+        if (path == "subdir1") {
+            throw std::runtime_error("matcher failed");
+        }
+        return true;
+    };
+
+    // the exception is thrown on a worker, it's returned as an error
+    auto result = linglong::utils::moveFiles(src_dir, dest_dir, matcher);
+    ASSERT_FALSE(result.has_value());
+    EXPECT_NE(result.error().message().find("matcher failed"), std::string::npos)
+      << result.error().message();
+
+    // other subtrees are still moved
+    EXPECT_TRUE(fs::exists(dest_dir / "file1.txt"));
+    EXPECT_TRUE(fs::exists(src_dir / "subdir1" / "file2.txt"));
+}
+
 TEST_F(FileTest, GetFiles)
 {
     auto result = linglong::utils::getFiles(src_dir);
@@ -420,6 +443,46 @@ TEST_F(FileTest, WriteFile)
     EXPECT_FALSE(result.has_value()); // Should fail because parent directory doesn't exist
 }
 
+TEST_F(FileTest, ReplaceFile)
+{
+    fs::path test_file = dest_dir / "test_replace.json";
+
+    auto result = linglong::utils::replaceFile(test_file, "old");
+    ASSERT_TRUE(result.has_value()) << result.error().message();
+    auto content = linglong::utils::readFile(test_file.string());
+    ASSERT_TRUE(content.has_value()) << content.error().message();
+    EXPECT_EQ(*content, "old");
+
+    // several threads replace the same file, the result is one of their contents
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 4; ++i) {
+        writers.emplace_back([&test_file, i]() {
+            for (int j = 0; j < 16; ++j) {
+                EXPECT_TRUE(linglong::utils::replaceFile(test_file, std::string(1024, 'a' + i)));
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    content = linglong::utils::readFile(test_file.string());
+    ASSERT_TRUE(content.has_value()) << content.error().message();
+    ASSERT_EQ(content->size(), 1024U);
+    EXPECT_EQ(std::count(content->begin(), content->end(), content->front()), 1024);
+
+    // no temporary file is left behind
+    std::size_t files = 0;
+    for ([[maybe_unused]] const auto &entry : fs::directory_iterator(dest_dir)) {
+        ++files;
+    }
+    EXPECT_EQ(files, 1U);
+
+    // the parent directory isn't created
+    result = linglong::utils::replaceFile(dest_dir / "subdir" / "subfile.json", "content");
+    EXPECT_FALSE(result.has_value());
+    EXPECT_FALSE(fs::exists(dest_dir / "subdir"));
+}
+
 TEST_F(FileTest, ReadFile)
 {
     // Test reading an existing file
@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "../../../common/benchmark.h"
+#include "../../../common/tempdir.h"
+#include "linglong/utils/io/event_loop.h"
+#include "linglong/utils/io/forwarder.h"
+#include "linglong/utils/io/pipe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace linglong::utils::io;
+
+namespace {
+
+// many times the capacity of a pipe, and not a multiple of the pattern
+constexpr std::size_t TotalSize = 4 * 1024 * 1024 + 123;
+
+// the size forwarded by the throughput benchmark
+constexpr std::size_t BenchmarkSize = 128 * 1024 * 1024;
+
+constexpr std::size_t PatternSize = 64 * 1024;
+
+// the stream repeats this block
+const std::vector<char> &pattern()
+{
+    static const auto block = []() {
+        std::vector<char> block(PatternSize);
+        for (std::size_t i = 0; i < block.size(); ++i) {
+            block[i] = static_cast<char>(i % 251);
+        }
+        return block;
+    }();
+    return block;
+}
+
+// Forward totalSize bytes from a pipe to another one like the output of `ll-cli exec cat`, every
+// byte must arrive in order. Returns the time it took.
+std::chrono::duration<double> forwardStream(bool splice, std::size_t totalSize = TotalSize)
+{
+    auto src = Pipe::create(O_CLOEXEC);
+    auto dst = Pipe::create(O_CLOEXEC);
+    EXPECT_TRUE(src && dst);
+    ::fcntl(src->readEnd(), F_SETFL, O_NONBLOCK);
+    ::fcntl(dst->writeEnd(), F_SETFL, O_NONBLOCK);
+
+    std::thread writer([fd = src->releaseWriteEnd(), totalSize]() {
+        for (std::size_t offset = 0; offset < totalSize;) {
+            auto pos = offset % PatternSize;
+            auto n = ::write(fd,
+                             pattern().data() + pos,
+                             std::min(PatternSize - pos, totalSize - offset));
+            if (n <= 0) {
+                break;
+            }
+            offset += static_cast<std::size_t>(n);
+        }
+        ::close(fd);
+    });
+
+    std::size_t received = 0;
+    bool matched = true;
+    std::thread reader([fd = dst->releaseReadEnd(), &received, &matched]() {
+        std::vector<char> chunk(PatternSize);
+        while (true) {
+            auto pos = received % PatternSize;
+            auto n = ::read(fd, chunk.data(), PatternSize - pos);
+            if (n <= 0) {
+                break;
+            }
+            matched = matched
+              && std::equal(chunk.data(), chunk.data() + n, pattern().data() + pos);
+            received += static_cast<std::size_t>(n);
+        }
+        ::close(fd);
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    {
+        auto epoll = EventLoop::create();
+        EXPECT_TRUE(epoll);
+        IOForwarder forwarder(*epoll);
+        forwarder.setSrc(src->readEnd());
+        forwarder.setDst(dst->writeEnd());
+        if (splice) {
+            EXPECT_TRUE(forwarder.enableSplice());
+        }
+        EXPECT_TRUE(epoll->add(src->readEnd(), EPOLLIN));
+
+        while (!forwarder.isFinished()) {
+            auto events = epoll->wait(1000);
+            EXPECT_TRUE(events);
+            for (int i = 0; i < events->count; ++i) {
+                const auto &ev = events->events[i];
+                // the end of the stream is found by reading the rest after EPOLLHUP
+                if (ev.data.fd == forwarder.srcFd()) {
+                    forwarder.drive();
+                }
+                if (ev.data.fd == forwarder.dstFd() && forwarder.needsWriteWatch()) {
+                    forwarder.onDstWritable();
+                }
+            }
+        }
+
+        EXPECT_EQ(forwarder.splicing(), splice);
+        dst->closeWriteEnd();
+    }
+
+    writer.join();
+    reader.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    EXPECT_EQ(received, totalSize);
+    EXPECT_TRUE(matched);
+    return elapsed;
+}
+
+TEST(IOForwarderTest, ForwardByCopy)
+{
+    forwardStream(false);
+}
+
+TEST(IOForwarderTest, ForwardBySplice)
+{
+    forwardStream(true);
+}
+
+// pipe to pipe throughput of the ring buffer and of splice(2)
+TEST(IOForwarderTest, ThroughputBenchmark)
+{
+    SKIP_UNLESS_BENCHMARK();
+
+    auto copy = forwardStream(false, BenchmarkSize);
+    auto splice = forwardStream(true, BenchmarkSize);
+    RecordProperty("copyGBps", std::to_string(BenchmarkSize / copy.count() / 1e9));
+    RecordProperty("spliceGBps", std::to_string(BenchmarkSize / splice.count() / 1e9));
+}
+
+TEST(IOForwarderTest, NoSpliceForTerminal)
+{
+    auto master = ::posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    ASSERT_NE(master, -1);
+    auto pipe = Pipe::create(O_CLOEXEC);
+    ASSERT_TRUE(pipe);
+
+    auto epoll = EventLoop::create();
+    ASSERT_TRUE(epoll);
+    IOForwarder forwarder(*epoll);
+    forwarder.setSrc(pipe->readEnd());
+    forwarder.setDst(master);
+    EXPECT_FALSE(forwarder.enableSplice());
+    EXPECT_FALSE(forwarder.splicing());
+    ::close(master);
+}
+
+TEST(IOForwarderTest, FallbackToCopy)
+{
+    TempDir dir;
+    auto file = dir.path() / "output";
+    // splice refuses files opened for appending
+    auto output = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    ASSERT_NE(output, -1);
+    auto pipe = Pipe::create(O_CLOEXEC | O_NONBLOCK);
+    ASSERT_TRUE(pipe);
+    ASSERT_EQ(::write(pipe->writeEnd(), "hello", 5), 5);
+    pipe->closeWriteEnd();
+
+    auto epoll = EventLoop::create();
+    ASSERT_TRUE(epoll);
+    IOForwarder forwarder(*epoll);
+    forwarder.setSrc(pipe->readEnd());
+    forwarder.setDst(output);
+    EXPECT_TRUE(forwarder.enableSplice());
+    while (!forwarder.isFinished()) {
+        forwarder.drive();
+    }
+    EXPECT_FALSE(forwarder.splicing());
+    ::close(output);
+
+    std::ifstream stream(file);
+    std::string content;
+    stream >> content;
+    EXPECT_EQ(content, "hello");
+}
+
+} // namespace
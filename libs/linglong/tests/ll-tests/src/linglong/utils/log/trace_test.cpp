@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "../../../common/tempdir.h"
+#include "linglong/utils/log/trace.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace linglong::utils::log;
+
+namespace {
+
+nlohmann::json readTrace(const std::filesystem::path &file)
+{
+    std::ifstream stream(file);
+    std::stringstream content;
+    content << stream.rdbuf();
+
+    // the array of events is left open, close it like the trace viewers do
+    auto str = content.str();
+    auto last = str.find_last_of(',');
+    if (last != std::string::npos) {
+        str.erase(last);
+    }
+    return nlohmann::json::parse(str + "]");
+}
+
+TEST(TraceTest, WriteNestedSpans)
+{
+    TempDir tempDir;
+    auto traceFile = tempDir.path() / "trace.json";
+    g_tracer.setTraceFile(traceFile);
+    EXPECT_STREQ(::getenv(TraceFileEnv), traceFile.c_str());
+
+    {
+        LogSpan("outer");
+        {
+            LogSpan("inner");
+        }
+    }
+
+    g_tracer.setTraceFile({});
+    EXPECT_EQ(::getenv(TraceFileEnv), nullptr);
+    {
+        LogSpan("untraced");
+    }
+
+    auto events = readTrace(traceFile);
+    ASSERT_EQ(events.size(), 3);
+    EXPECT_EQ(events[0]["ph"], "M");
+    EXPECT_EQ(events[0]["pid"], ::getpid());
+
+    // spans are written when they end
+    const auto &inner = events[1];
+    const auto &outer = events[2];
+    EXPECT_EQ(inner["name"], "inner");
+    EXPECT_EQ(outer["name"], "outer");
+    EXPECT_EQ(inner["ph"], "X");
+    EXPECT_EQ(inner["tid"], outer["tid"]);
+    EXPECT_GE(inner["ts"].get<double>(), outer["ts"].get<double>());
+    EXPECT_LE(inner["ts"].get<double>() + inner["dur"].get<double>(),
+              outer["ts"].get<double>() + outer["dur"].get<double>());
+}
+
+} // namespace
@@ -40,3 +40,11 @@ TEST(sha256, same_as_openssl)
     ASSERT_NE(ret, 0);
     EXPECT_EQ(digest1, digest2);
 }
+
+TEST(sha256, hex)
+{
+    EXPECT_EQ(digest::sha256Hex(""),
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    EXPECT_EQ(digest::sha256Hex("abc"),
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
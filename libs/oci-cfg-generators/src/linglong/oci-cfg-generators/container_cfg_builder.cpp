@@ -17,6 +17,7 @@
 #include "linglong/utils/cmd.h"
 #include "linglong/utils/file.h"
 #include "linglong/utils/log/log.h"
+#include "linglong/utils/log/trace.h"
 #include "linglong/utils/overlayfs.h"
 #include "linglong/utils/sha256.h"
 #include "ocppi/runtime/config/types/Generators.hpp"
@@ -25,11 +26,15 @@
 #include <sys/mount.h>
 
 #include <algorithm>
+#include <array>
+#include <cctype>
 #include <climits>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <sstream>
+#include <string_view>
 #include <vector>
 
 #include <grp.h>
@@ -46,6 +51,7 @@ using string_list = std::vector<std::string>;
 
 #define BUILD_STEP(step)      \
     do {                      \
+        LogSpan(#step);       \
         auto result = step(); \
         if (!result) {        \
             return result;    \
@@ -135,6 +141,87 @@ std::vector<DBusAddress> parseDBusAddressForMount(std::string_view address) noex
     return ret;
 }
 
+// annotations which change on every launch, they are replaced by placeholders in config templates
+constexpr std::array<std::string_view, 2> volatileAnnotations{
+    "cn.org.linyaps.runtime.ns_last_pid",
+    "cn.org.linyaps.runtime.ws.path",
+};
+
+// Replace the volatile annotations of config, and the mount sources with the same values, by
+// placeholders. placeholders maps a placeholder to its value.
+nlohmann::json normalizeVolatile(nlohmann::json config,
+                                 std::map<std::string, std::string> &placeholders)
+{
+    std::map<std::string, std::string> values;
+    if (auto annotations = config.find("annotations"); annotations != config.end()) {
+        for (auto key : volatileAnnotations) {
+            auto value = annotations->find(key);
+            if (value == annotations->end()) {
+                continue;
+            }
+
+            auto placeholder = fmt::format("@{}@", key);
+            values[value->get<std::string>()] = placeholder;
+            placeholders[placeholder] = value->get<std::string>();
+            *value = placeholder;
+        }
+    }
+
+    if (auto mounts = config.find("mounts"); mounts != config.end() && !values.empty()) {
+        for (auto &mount : *mounts) {
+            auto source = mount.find("source");
+            if (source == mount.end()) {
+                continue;
+            }
+
+            if (auto value = values.find(source->get<std::string>()); value != values.end()) {
+                *source = value->second;
+            }
+        }
+    }
+
+    return config;
+}
+
+// whether value is in str and not a part of a longer word or number, so pid 100 is not found in
+// /run/user/1000
+bool containsWord(std::string_view str, std::string_view value) noexcept
+{
+    auto isWordChar = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) != 0;
+    };
+    for (auto pos = str.find(value); pos != std::string_view::npos;
+         pos = str.find(value, pos + 1)) {
+        auto end = pos + value.size();
+        if ((pos == 0 || !isWordChar(str[pos - 1]))
+            && (end == str.size() || !isWordChar(str[end]))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// call fn on every string of json
+template <typename Fn>
+void forEachString(nlohmann::json &json, Fn &&fn)
+{
+    if (json.is_string()) {
+        fn(json);
+        return;
+    }
+
+    if (json.is_structured()) {
+        for (auto &item : json) {
+            forEachString(item, fn);
+        }
+    }
+}
+
+uint64_t mountpointKey(int parent, uint32_t nameId) noexcept
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(parent)) << 32U) | nameId;
+}
+
 } // namespace
 
 ContainerCfgBuilder &ContainerCfgBuilder::setAnnotation(ANNOTATION key, std::string value) noexcept
@@ -813,6 +900,29 @@ std::string ContainerCfgBuilder::ldConf(const std::string &triplet) const
     return ldRawConf;
 }
 
+std::vector<std::pair<std::filesystem::path, std::filesystem::path>>
+ContainerCfgBuilder::ldConfMounts() const
+{
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> mounts;
+    if (runtimePath) {
+        mounts.emplace_back(runtimeMountPoint, *runtimePath);
+    }
+
+    if (appPath) {
+        mounts.emplace_back(appMountPoint(appId), *appPath);
+    }
+
+    if (extensionMount) {
+        for (const auto &extension : *extensionMount) {
+            if (extension.source) {
+                mounts.emplace_back(extension.destination, *extension.source);
+            }
+        }
+    }
+
+    return mounts;
+}
+
 utils::error::Result<void> ContainerCfgBuilder::checkValid() noexcept
 {
     LINGLONG_TRACE("check validation");
@@ -1635,20 +1745,24 @@ Network={}
     return LINGLONG_OK;
 }
 
-utils::error::Result<void> ContainerCfgBuilder::applyPatch() noexcept
+utils::error::Result<std::vector<std::filesystem::path>>
+ContainerCfgBuilder::collectPatchFiles() const noexcept
 {
-    LINGLONG_TRACE("apply patches");
+    LINGLONG_TRACE("collect patches");
 
     if (!applyPatchEnabled) {
-        return LINGLONG_OK;
+        return {};
+    }
+
+    auto containerConfigPath = patchDir;
+    if (containerConfigPath.empty()) {
+        containerConfigPath = LINGLONG_INSTALL_PREFIX "/lib/linglong/container/config.d";
     }
 
-    std::filesystem::path containerConfigPath{ LINGLONG_INSTALL_PREFIX
-                                               "/lib/linglong/container/config.d" };
     std::error_code ec;
     if (!std::filesystem::exists(containerConfigPath, ec)) {
         // if no-exists or failed to check exists, ignore it
-        return LINGLONG_OK;
+        return {};
     }
 
     std::vector<std::filesystem::path> globalPatchFiles;
@@ -1687,23 +1801,233 @@ utils::error::Result<void> ContainerCfgBuilder::applyPatch() noexcept
     std::sort(globalPatchFiles.begin(), globalPatchFiles.end());
     std::sort(appPatchFiles.begin(), appPatchFiles.end());
 
-    auto doPatch = [this](const std::vector<std::filesystem::path> &patchFiles) {
-        for (const auto &patchFile : patchFiles) {
-            // skip if failed to apply
-            auto result = applyPatchFile(patchFile);
-            if (!result) {
-                std::cerr << "skip applying failed patch " << patchFile << ": "
-                          << result.error().message() << std::endl;
-            }
+    // global patches are applied before application-specific patches
+    auto patchFiles = std::move(globalPatchFiles);
+    patchFiles.insert(patchFiles.end(), appPatchFiles.begin(), appPatchFiles.end());
+    return patchFiles;
+}
+
+utils::error::Result<void> ContainerCfgBuilder::applyPatch() noexcept
+{
+    LINGLONG_TRACE("apply patches");
+
+    auto patchFiles = collectPatchFiles();
+    if (!patchFiles) {
+        return LINGLONG_ERR(patchFiles);
+    }
+
+    for (const auto &patchFile : *patchFiles) {
+        // skip if failed to apply
+        auto result = applyPatchFile(patchFile);
+        if (!result) {
+            std::cerr << "skip applying failed patch " << patchFile << ": "
+                      << result.error().message() << std::endl;
         }
+    }
+
+    return LINGLONG_OK;
+}
+
+utils::error::Result<void> ContainerCfgBuilder::patchAndAdjustMount() noexcept
+{
+    LINGLONG_TRACE("patch and adjust mounts");
+
+    auto patchAndAdjust = [this]() -> utils::error::Result<void> {
+        BUILD_STEP(applyPatch);
+        BUILD_STEP(selfAdjustingMount);
+        return LINGLONG_OK;
     };
 
-    doPatch(globalPatchFiles);
-    doPatch(appPatchFiles);
+    if (!templateCacheDir) {
+        return patchAndAdjust();
+    }
+
+    auto patchFiles = collectPatchFiles();
+    if (!patchFiles) {
+        return LINGLONG_ERR(patchFiles);
+    }
+
+    std::map<std::string, std::string> placeholders;
+    auto key = templateKey(*patchFiles, placeholders);
+    if (!key) {
+        LogD("skip config template: {}", key.error());
+        return patchAndAdjust();
+    }
+
+    if (loadTemplate(*key, placeholders)) {
+        return LINGLONG_OK;
+    }
+
+    auto result = patchAndAdjust();
+    if (!result) {
+        return result;
+    }
 
+    storeTemplate(*key, placeholders);
     return LINGLONG_OK;
 }
 
+std::filesystem::path ContainerCfgBuilder::templateFile() const noexcept
+{
+    // one template per container, the bundle of a container is named by its id
+    return *templateCacheDir / (digest::sha256Hex(appId + '\0' + bundlePath.string()) + ".json");
+}
+
+utils::error::Result<std::string>
+ContainerCfgBuilder::templateKey(const std::vector<std::filesystem::path> &patchFiles,
+                                 std::map<std::string, std::string> &placeholders) const noexcept
+{
+    LINGLONG_TRACE("generate key of config template");
+
+    std::string content;
+    try {
+        content = normalizeVolatile(nlohmann::json(config), placeholders).dump();
+    } catch (const std::exception &e) {
+        return LINGLONG_ERR("failed to serialize config", e);
+    }
+
+    content += '\0';
+    content += LINGLONG_VERSION;
+    // selfAdjustingMount looks into the layers, they are identified by their paths, which
+    // contain the commit of the layer
+    content += fmt::format("\0{}\0{}\0{}\0{}",
+                           selfAdjustingMountEnabled,
+                           basePath.string(),
+                           runtimePath.value_or("").string(),
+                           appPath.value_or("").string());
+    // patches are identified by their stat, modify or touch a patch to invalidate the templates
+    for (const auto &patchFile : patchFiles) {
+        struct stat st{};
+        if (::stat(patchFile.c_str(), &st) == -1) {
+            return LINGLONG_ERR(fmt::format("failed to stat {}", patchFile), errno);
+        }
+
+        content += fmt::format("\0{}\0{}:{}:{}:{}.{}",
+                               patchFile.string(),
+                               st.st_ino,
+                               st.st_mode,
+                               st.st_size,
+                               st.st_mtim.tv_sec,
+                               st.st_mtim.tv_nsec);
+    }
+
+    return digest::sha256Hex(content);
+}
+
+bool ContainerCfgBuilder::loadTemplate(
+  const std::string &key, const std::map<std::string, std::string> &placeholders) noexcept
+{
+    auto file = templateFile();
+    std::ifstream stream(file);
+    if (!stream.is_open()) {
+        return false;
+    }
+
+    try {
+        auto json = nlohmann::json::parse(stream);
+        if (json.at("key").get<std::string>() != key) {
+            return false;
+        }
+
+        auto &patched = json.at("config");
+        forEachString(patched, [&placeholders](nlohmann::json &value) {
+            if (auto it = placeholders.find(value.get_ref<const std::string &>());
+                it != placeholders.end()) {
+                value = it->second;
+            }
+        });
+        config = patched.get<Config>();
+    } catch (const std::exception &e) {
+        LogD("ignore invalid config template {}: {}", file, e.what());
+        return false;
+    }
+
+    // the modification time orders the templates by their last use for pruneTemplates
+    std::error_code ec;
+    std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), ec);
+    LogD("reuse config template {}", file);
+    return true;
+}
+
+void ContainerCfgBuilder::storeTemplate(
+  const std::string &key, const std::map<std::string, std::string> &placeholders) noexcept
+{
+    std::error_code ec;
+    std::filesystem::create_directories(*templateCacheDir, ec);
+    if (ec) {
+        LogD("failed to create config template directory {}: {}", *templateCacheDir, ec.message());
+        return;
+    }
+
+    auto file = templateFile();
+    std::string content;
+    try {
+        std::map<std::string, std::string> patchedPlaceholders;
+        auto patched = normalizeVolatile(nlohmann::json(config), patchedPlaceholders);
+
+        // a patch copied a volatile value to somewhere else, the result can't be reused
+        bool copied = false;
+        forEachString(patched, [&placeholders, &copied](nlohmann::json &value) {
+            const auto &str = value.get_ref<const std::string &>();
+            for (const auto &[placeholder, volatileValue] : placeholders) {
+                if (str != placeholder && containsWord(str, volatileValue)) {
+                    copied = true;
+                }
+            }
+        });
+        if (copied || patchedPlaceholders != placeholders) {
+            LogD("config patched with volatile values, don't store it as a template");
+            std::filesystem::remove(file, ec);
+            return;
+        }
+
+        content = nlohmann::json{ { "key", key }, { "config", std::move(patched) } }.dump();
+    } catch (const std::exception &e) {
+        LogD("failed to serialize config template {}: {}", file, e.what());
+        return;
+    }
+
+    auto ret = utils::replaceFile(file, content);
+    if (!ret) {
+        LogD("failed to write config template: {}", ret.error());
+        return;
+    }
+
+    pruneTemplates();
+}
+
+void ContainerCfgBuilder::pruneTemplates() const noexcept
+{
+    // every container has its own template, the templates of containers which are not run
+    // anymore, and temporary files left by crashed writers, are never looked up again
+    std::error_code ec;
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+    for (const auto &entry : std::filesystem::directory_iterator(*templateCacheDir, ec)) {
+        auto time = entry.last_write_time(ec);
+        if (ec) {
+            continue;
+        }
+        entries.emplace_back(time, entry.path());
+    }
+    if (ec) {
+        LogD("failed to list config templates in {}: {}", *templateCacheDir, ec.message());
+        return;
+    }
+    if (entries.size() <= maxTemplates) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.first > rhs.first;
+    });
+    for (auto it = entries.begin() + maxTemplates; it != entries.end(); ++it) {
+        std::filesystem::remove(it->second, ec);
+        if (ec) {
+            LogD("failed to remove config template {}: {}", it->second, ec.message());
+        }
+    }
+}
+
 utils::error::Result<void>
 ContainerCfgBuilder::applyPatchFile(const std::filesystem::path &patchFile) noexcept
 {
@@ -1970,24 +2294,63 @@ utils::error::Result<void> ContainerCfgBuilder::mergeMount() noexcept
 
 int ContainerCfgBuilder::findChild(int parent, const std::string &name) noexcept
 {
-    for (auto idx : mountpoints[parent].childs_idx) {
-        if (mountpoints[idx].name == name) {
-            return idx;
-        }
+    auto nameId = mountpointNames.find(name);
+    if (nameId == mountpointNames.end()) {
+        return -1;
     }
 
-    return -1;
+    auto child = mountpointChildren.find(mountpointKey(parent, nameId->second));
+    if (child == mountpointChildren.end()) {
+        return -1;
+    }
+
+    return child->second;
 }
 
 int ContainerCfgBuilder::insertChild(int parent, MountNode node) noexcept
 {
+    auto nameId =
+      mountpointNames.try_emplace(node.name, static_cast<uint32_t>(mountpointNames.size()))
+        .first->second;
     node.parent_idx = parent;
     mountpoints.emplace_back(std::move(node));
     int child = mountpoints.size() - 1;
-    mountpoints[parent].childs_idx.push_back(child);
+    mountpointChildren.insert_or_assign(mountpointKey(parent, nameId), child);
     return child;
 }
 
+std::vector<int> ContainerCfgBuilder::breadthFirstOrder() const noexcept
+{
+    // Group the nodes by their parent. A child is always inserted after its parent and the
+    // children of a node keep the order they are inserted, which is the order of their mounts.
+    std::vector<std::size_t> offsets(mountpoints.size() + 1, 0);
+    for (std::size_t i = 1; i < mountpoints.size(); ++i) {
+        ++offsets[mountpoints[i].parent_idx + 1];
+    }
+    for (std::size_t i = 1; i < offsets.size(); ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+    std::vector<int> children(mountpoints.size() > 0 ? mountpoints.size() - 1 : 0);
+    auto next = offsets;
+    for (std::size_t i = 1; i < mountpoints.size(); ++i) {
+        children[next[mountpoints[i].parent_idx]++] = static_cast<int>(i);
+    }
+
+    // all nodes except the root
+    std::vector<int> order;
+    order.reserve(children.size());
+    auto visit = [&](int node) {
+        order.insert(order.end(),
+                     children.begin() + static_cast<std::ptrdiff_t>(offsets[node]),
+                     children.begin() + static_cast<std::ptrdiff_t>(offsets[node + 1]));
+    };
+    visit(0);
+    for (std::size_t idx = 0; idx < order.size(); ++idx) {
+        visit(order[idx]);
+    }
+    return order;
+}
+
 int ContainerCfgBuilder::insertChildRecursively(const std::filesystem::path &path,
                                                 bool &inserted) noexcept
 {
@@ -2211,19 +2574,8 @@ utils::error::Result<void> ContainerCfgBuilder::constructMountpointsTree() noexc
 
 void ContainerCfgBuilder::tryFixMountpointsTree() noexcept
 {
-    // Perform a pre-order tree traversal to collect the nodes to be processed
-    std::vector<int> nodesToProcess;
-    size_t idx = 0;
-    int node = 0;
-    do {
-        for (auto i : mountpoints[node].childs_idx) {
-            nodesToProcess.push_back(i);
-        }
-
-        if (idx >= nodesToProcess.size())
-            break;
-        node = nodesToProcess[idx++];
-    } while (true);
+    // Perform a breadth-first traversal to collect the nodes to be processed
+    auto nodesToProcess = breadthFirstOrder();
 
     // Traverse the nodes to be processed in reverse order to ensure child nodes are handled
     // before their parent nodes.
@@ -2250,18 +2602,10 @@ void ContainerCfgBuilder::generateMounts() noexcept
 {
     // use BFS to travel mountpoints tree to generate the mounts
     std::vector<Mount> generated;
-    std::vector<int> queue = { 0 };
-    size_t idx = 0;
-    int node = 0;
-
-    while (queue.size() > idx) {
-        node = queue[idx++];
-        for (auto i : mountpoints[node].childs_idx) {
-            queue.push_back(i);
-            const auto &child = mountpoints[i];
-            if (child.mount_idx >= 0) {
-                generated.emplace_back(mounts[child.mount_idx]);
-            }
+    for (auto i : breadthFirstOrder()) {
+        const auto &child = mountpoints[i];
+        if (child.mount_idx >= 0) {
+            generated.emplace_back(mounts[child.mount_idx]);
         }
     }
 
@@ -2311,6 +2655,7 @@ utils::error::Result<void> ContainerCfgBuilder::finalize() noexcept
 utils::error::Result<void> ContainerCfgBuilder::build() noexcept
 {
     LINGLONG_TRACE("build container configuration");
+    LogSpan("build container configuration");
 
     BUILD_STEP(checkValid);
     BUILD_STEP(prepare);
@@ -2333,8 +2678,7 @@ utils::error::Result<void> ContainerCfgBuilder::build() noexcept
     BUILD_STEP(buildUserGroup);
     BUILD_STEP(mergeMount);
     BUILD_STEP(finalize);
-    BUILD_STEP(applyPatch);
-    BUILD_STEP(selfAdjustingMount);
+    BUILD_STEP(patchAndAdjustMount);
 
     return LINGLONG_OK;
 }
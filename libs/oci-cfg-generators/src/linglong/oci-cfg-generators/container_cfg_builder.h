@@ -12,9 +12,15 @@
 #include "ocppi/runtime/config/types/IdMapping.hpp"
 #include "ocppi/runtime/config/types/Mount.hpp"
 
+#include <cstdint>
 #include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace linglong::generator {
 
@@ -48,12 +54,14 @@ public:
         std::string name;
         bool ro;
         int mount_idx;
-        std::vector<int> childs_idx;
         int parent_idx;
     };
 
     inline static const std::filesystem::path runtimeMountPoint{ "/runtime" };
     inline static const std::filesystem::path zoneinfoMountPoint{ "/usr/share/zoneinfo" };
+    // the number of templates kept in the template cache dir, the least recently used ones are
+    // removed when a new one is stored
+    static constexpr std::size_t maxTemplates = 64;
 
     ContainerCfgBuilder &setAppId(const std::string &id) noexcept
     {
@@ -201,6 +209,23 @@ public:
         return *this;
     }
 
+    ContainerCfgBuilder &setPatchDir(std::filesystem::path dir) noexcept
+    {
+        patchDir = std::move(dir);
+        return *this;
+    }
+
+    // Keep the config patched by config.d and adjusted by selfAdjustingMount in dir as a template
+    // of the container. Both are only done again if the config generated before them, the patch
+    // files or the layers are changed, the volatile annotations like the last pid are filled into
+    // the template on every build. The generating steps still run on every build, they create
+    // files in the bundle and probe the host. At most maxTemplates templates are kept in dir.
+    ContainerCfgBuilder &setTemplateCacheDir(std::filesystem::path dir) noexcept
+    {
+        templateCacheDir = std::move(dir);
+        return *this;
+    }
+
     ContainerCfgBuilder &setCapabilities(std::vector<std::string> caps) noexcept
     {
         capabilities = std::move(caps);
@@ -211,6 +236,8 @@ public:
     applyCDIPatch(const linglong::cdi::types::ContainerEdits &edits) noexcept;
 
     std::string ldConf(const std::string &triplet) const;
+    // the layers whose directories are listed by ldConf, pairs of mount point and source
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> ldConfMounts() const;
 
     static std::filesystem::path appMountPoint(const std::string &id) noexcept;
     static std::filesystem::path extensionMountPoint(const std::string &id) noexcept;
@@ -240,11 +267,22 @@ private:
     utils::error::Result<void> buildEnv() noexcept;
     utils::error::Result<void> buildContainerInfo() noexcept;
     utils::error::Result<void> buildHooks() noexcept;
+    [[nodiscard]] utils::error::Result<std::vector<std::filesystem::path>>
+    collectPatchFiles() const noexcept;
     utils::error::Result<void> applyPatch() noexcept;
     utils::error::Result<void> applyPatchFile(const std::filesystem::path &patchFile) noexcept;
     utils::error::Result<void> applyJsonPatchFile(const std::filesystem::path &patchFile) noexcept;
     utils::error::Result<void>
     applyExecutablePatch(const std::filesystem::path &patchFile) noexcept;
+    [[nodiscard]] std::filesystem::path templateFile() const noexcept;
+    [[nodiscard]] utils::error::Result<std::string>
+    templateKey(const std::vector<std::filesystem::path> &patchFiles,
+                std::map<std::string, std::string> &placeholders) const noexcept;
+    bool loadTemplate(const std::string &key,
+                      const std::map<std::string, std::string> &placeholders) noexcept;
+    void storeTemplate(const std::string &key,
+                       const std::map<std::string, std::string> &placeholders) noexcept;
+    void pruneTemplates() const noexcept;
     utils::error::Result<void> mergeMount() noexcept;
     utils::error::Result<void> finalize() noexcept;
 
@@ -255,6 +293,8 @@ private:
     // adjust mount
     int findChild(int parent, const std::string &name) noexcept;
     int insertChild(int parent, MountNode node) noexcept;
+    // all nodes but the root, children in the order they are inserted
+    [[nodiscard]] std::vector<int> breadthFirstOrder() const noexcept;
     int insertChildRecursively(const std::filesystem::path &path, bool &inserted) noexcept;
     int findNearestMountNode(int child) noexcept;
     bool shouldFix(int node, std::filesystem::path &fixPath) noexcept;
@@ -266,6 +306,8 @@ private:
     void tryFixMountpointsTree() noexcept;
     void generateMounts() noexcept;
     utils::error::Result<void> selfAdjustingMount() noexcept;
+    // applyPatch and selfAdjustingMount, or their result kept in the template of the container
+    utils::error::Result<void> patchAndAdjustMount() noexcept;
 
     // path settings
     std::string appId;
@@ -347,6 +389,11 @@ private:
     // .mount_idx > 0 represents the path is a mount point, and it's the subscript of the array
     // mounts
     std::vector<MountNode> mountpoints;
+    // the children of all mountpoints indexed by the parent and the interned name, a directory
+    // like the root may have thousands of children. It's the only record of the children, the
+    // traversals derive them from parent_idx.
+    std::unordered_map<std::string, uint32_t> mountpointNames;
+    std::unordered_map<uint64_t, int> mountpointChildren;
     // this 'mounts' is used internally, distinct from config.mounts
     std::vector<ocppi::runtime::config::types::Mount> mounts;
     std::optional<PipewireMountOption> pipewireMountOption;
@@ -358,6 +405,9 @@ private:
     bool disableUserNamespaceEnabled = false;
     std::optional<XdpOption> xdpOption;
     bool applyPatchEnabled = true;
+    // empty for the config.d of the installation
+    std::filesystem::path patchDir;
+    std::optional<std::filesystem::path> templateCacheDir;
     bool isolateTmp{ false };
     bool devPassthru{ false };
 
@@ -15,13 +15,13 @@
 #include <fmt/ranges.h>
 #include <sys/epoll.h>
 
-#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <filesystem>
-#include <iostream>
+#include <utility>
 
 #include <fcntl.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -69,138 +69,206 @@ std::filesystem::path Cmd::getCommandPath()
     return {};
 }
 
+namespace {
+
+bool setNonBlock(int fd) noexcept
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags != -1) {
+        return fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+    }
+    return false;
+}
+
+// read all available output of fd, returns false once it's closed
+bool readOutput(int fd, std::string &output, const Cmd::OutputHandler &handler) noexcept
+{
+    std::array<char, 4096> buffer{};
+    while (true) {
+        ssize_t n = read(fd, buffer.data(), buffer.size());
+        if (n > 0) {
+            if (handler) {
+                handler(std::string_view{ buffer.data(), static_cast<size_t>(n) });
+            } else {
+                output.append(buffer.data(), static_cast<size_t>(n));
+            }
+            continue;
+        }
+
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+
+        // error or EOF, stop monitoring this FD
+        return n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+} // namespace
+
+Cmd::Process::Process(Process &&other) noexcept
+    : m_pid(std::exchange(other.m_pid, -1))
+    , m_stdin(std::move(other.m_stdin))
+    , m_stdout(std::move(other.m_stdout))
+    , m_stderr(std::move(other.m_stderr))
+    , m_stdinContent(std::move(other.m_stdinContent))
+    , m_stdoutHandler(std::move(other.m_stdoutHandler))
+    , m_stderrHandler(std::move(other.m_stderrHandler))
+{
+}
+
+Cmd::Process &Cmd::Process::operator=(Process &&other) noexcept
+{
+    if (this != &other) {
+        // the current process is reaped by the destructor of discarded
+        Process discarded(std::move(*this));
+        m_pid = std::exchange(other.m_pid, -1);
+        m_stdin = std::move(other.m_stdin);
+        m_stdout = std::move(other.m_stdout);
+        m_stderr = std::move(other.m_stderr);
+        m_stdinContent = std::move(other.m_stdinContent);
+        m_stdoutHandler = std::move(other.m_stdoutHandler);
+        m_stderrHandler = std::move(other.m_stderrHandler);
+    }
+    return *this;
+}
+
+Cmd::Process::~Process()
+{
+    if (m_pid <= 0) {
+        return;
+    }
+
+    // the process is not waited, don't leave a zombie
+    m_stdin.reset();
+    m_stdout.reset();
+    m_stderr.reset();
+    while (waitpid(m_pid, nullptr, 0) == -1 && errno == EINTR) { }
+}
+
 utils::error::Result<std::string> Cmd::exec(const std::vector<std::string> &args) noexcept
 {
     LINGLONG_TRACE(fmt::format("exec cmd: {} args: {}", m_command, fmt::join(args, " ")));
 
+    auto process = start(args);
+    if (!process) {
+        return LINGLONG_ERR(process);
+    }
+
+    return process->wait();
+}
+
+utils::error::Result<Cmd::Process> Cmd::start(const std::vector<std::string> &args) noexcept
+{
+    LINGLONG_TRACE(fmt::format("start cmd: {}", m_command));
+
     auto commandPath = getCommandPath();
     if (commandPath.empty()) {
         return LINGLONG_ERR(fmt::format("command not found: {}", m_command));
     }
 
-    std::array<int, 2> stdoutPipe{ -1, -1 };
-    if (pipe2(stdoutPipe.data(), O_CLOEXEC) == -1) {
-        return LINGLONG_ERR(fmt::format("pipe error: {}", common::error::errorString(errno)));
-    }
-    auto stdoutPipeCloser = utils::finally::finally([&stdoutPipe]() {
-        for (auto fd : stdoutPipe) {
-            if (fd >= 0) {
-                close(fd);
-            }
+    // the parent ends are kept by Process, the child ends are closed once it's spawned
+    auto makePipe = [](fd::UniqueFd &readEnd, fd::UniqueFd &writeEnd) {
+        std::array<int, 2> fds{ -1, -1 };
+        if (pipe2(fds.data(), O_CLOEXEC) == -1) {
+            return false;
         }
-    });
+        readEnd.reset(fds[0]);
+        writeEnd.reset(fds[1]);
+        return true;
+    };
 
-    std::array<int, 2> stdinPipe{ -1, -1 };
-    if (pipe2(stdinPipe.data(), O_CLOEXEC) == -1) {
+    Process process;
+    fd::UniqueFd childStdin;
+    fd::UniqueFd childStdout;
+    fd::UniqueFd childStderr;
+    if (!makePipe(childStdin, process.m_stdin) || !makePipe(process.m_stdout, childStdout)
+        || (m_stderrHandler && !makePipe(process.m_stderr, childStderr))) {
         return LINGLONG_ERR(fmt::format("pipe error: {}", common::error::errorString(errno)));
     }
-    auto stdinPipeCloser = utils::finally::finally([&stdinPipe]() {
-        for (auto fd : stdinPipe) {
-            if (fd >= 0) {
-                close(fd);
-            }
-        }
-    });
 
-    // Pre-allocate environment variables before fork to avoid memory allocation issues
-    std::vector<std::string> envStrings;
+    // The environment is environ without the overridden variables, followed by the overrides
+    // which are not empty (empty value means unset). Only the overrides are copied. It's built on
+    // every start, environ may be changed in between.
+    std::vector<std::string> overrides;
     std::vector<char *> envp;
-
-    // Copy current environment
     for (char *const *env = environ; *env != nullptr; ++env) {
-        envStrings.emplace_back(*env);
+        std::string_view entry{ *env };
+        if (m_envs.find(entry.substr(0, entry.find('='))) == m_envs.end()) {
+            envp.push_back(*env);
+        }
     }
-
-    // Add or override environment variables
-    for (auto it = m_envs.cbegin(); it != m_envs.cend(); ++it) {
-        const auto &name = it->first;
-        const auto &value = it->second;
-        if (value.empty()) {
-            // Remove the environment variable if value is empty
-            envStrings.erase(std::remove_if(envStrings.begin(),
-                                            envStrings.end(),
-                                            [&name](const std::string &env) {
-                                                return env.size() > name.size()
-                                                  && env.compare(0, name.size(), name) == 0
-                                                  && env[name.size()] == '=';
-                                            }),
-                             envStrings.end());
-        } else {
-            // Add or update environment variable
-            const auto envVar = (name + "=").append(value);
-            bool found = false;
-            for (auto &env : envStrings) {
-                if (env.size() > name.size() && env.compare(0, name.size(), name) == 0
-                    && env[name.size()] == '=') {
-                    env = envVar;
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                envStrings.push_back(envVar);
-            }
+    for (const auto &[name, value] : m_envs) {
+        if (!value.empty()) {
+            overrides.push_back((name + "=").append(value));
         }
     }
-
-    // Build envp array for execvpe
-    envp.reserve(envStrings.size() + 1);
-    for (auto &env : envStrings) {
-        envp.push_back(const_cast<char *>(env.c_str()));
+    for (auto &env : overrides) {
+        envp.push_back(env.data());
     }
     envp.push_back(nullptr);
 
-    LogD("execute {} with args [{}]", commandPath, fmt::join(args, ", "));
-
-    const pid_t pid = fork();
-    if (pid == -1) {
-        return LINGLONG_ERR(fmt::format("fork error: {}", common::error::errorString(errno)));
+    auto filename = commandPath.filename().string();
+    std::vector<char *> argv;
+    argv.push_back(filename.data());
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
     }
+    argv.push_back(nullptr);
 
-    // child process
-    if (pid == 0) {
-        // Redirect stdout and stdin
-        close(stdoutPipe[0]);
-        close(stdinPipe[1]);
-        if (dup2(stdoutPipe[1], STDOUT_FILENO) == -1 || dup2(stdinPipe[0], STDIN_FILENO) == -1) {
-            _exit(EXIT_FAILURE);
-        }
-        close(stdoutPipe[1]);
-        close(stdinPipe[0]);
-
-        std::vector<char *> argv;
-        auto filename = commandPath.filename();
-        argv.push_back(const_cast<char *>(filename.c_str()));
-        for (const auto &arg : args) {
-            argv.push_back(const_cast<char *>(arg.c_str()));
-        }
-        argv.push_back(nullptr);
+    posix_spawn_file_actions_t actions;
+    if (auto ret = posix_spawn_file_actions_init(&actions); ret != 0) {
+        return LINGLONG_ERR(fmt::format("posix_spawn_file_actions_init error: {}",
+                                        common::error::errorString(ret)));
+    }
+    auto actionsDestroyer = utils::finally::finally([&actions]() {
+        posix_spawn_file_actions_destroy(&actions);
+    });
 
-        execvpe(commandPath.c_str(), argv.data(), envp.data());
+    // all pipe ends are close-on-exec, only the duplicated ones are left to the child
+    auto ret = posix_spawn_file_actions_adddup2(&actions, childStdin.get(), STDIN_FILENO);
+    if (ret == 0) {
+        ret = posix_spawn_file_actions_adddup2(&actions, childStdout.get(), STDOUT_FILENO);
+    }
+    if (ret == 0 && childStderr) {
+        ret = posix_spawn_file_actions_adddup2(&actions, childStderr.get(), STDERR_FILENO);
+    }
+    if (ret != 0) {
+        return LINGLONG_ERR(fmt::format("posix_spawn_file_actions_adddup2 error: {}",
+                                        common::error::errorString(ret)));
+    }
 
-        std::cout << "execvpe failed: " << common::error::errorString(errno) << std::endl;
+    LogD("execute {} with args [{}]", commandPath, fmt::join(args, ", "));
 
-        _exit(EXIT_FAILURE);
+    // posix_spawn doesn't copy the page tables like fork, the exec errors are reported here
+    ret = posix_spawn(&process.m_pid, commandPath.c_str(), &actions, nullptr, argv.data(),
+                      envp.data());
+    if (ret != 0) {
+        process.m_pid = -1;
+        return LINGLONG_ERR(
+          fmt::format("failed to execute {}: {}", commandPath, common::error::errorString(ret)));
     }
 
-    // parent process
-    close(stdoutPipe[1]);
-    stdoutPipe[1] = -1;
-    close(stdinPipe[0]);
-    stdinPipe[0] = -1;
-
-    auto setNonBlock = [](int fd) {
-        int flags = fcntl(fd, F_GETFL, 0);
-        if (flags != -1) {
-            return fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
-        }
-        return false;
-    };
-    if (!setNonBlock(stdoutPipe[0]) || !setNonBlock(stdinPipe[1])) {
+    if (!setNonBlock(process.m_stdout.get()) || !setNonBlock(process.m_stdin.get())
+        || (process.m_stderr && !setNonBlock(process.m_stderr.get()))) {
         return LINGLONG_ERR(
           fmt::format("set non block error: {}", common::error::errorString(errno)));
     }
 
+    process.m_stdinContent = m_stdinContent;
+    process.m_stdoutHandler = m_stdoutHandler;
+    process.m_stderrHandler = m_stderrHandler;
+    return process;
+}
+
+utils::error::Result<std::string> Cmd::Process::wait() noexcept
+{
+    LINGLONG_TRACE(fmt::format("wait for process {}", m_pid));
+
+    if (m_pid <= 0) {
+        return LINGLONG_ERR("process is not running");
+    }
+
     int epfd = epoll_create1(O_CLOEXEC);
     if (epfd == -1) {
         return LINGLONG_ERR(
@@ -213,32 +281,38 @@ utils::error::Result<std::string> Cmd::exec(const std::vector<std::string> &args
     struct epoll_event ev;
     int activeFds = 0;
 
-    ev.events = EPOLLIN;
-    ev.data.fd = stdoutPipe[0];
-    if (epoll_ctl(epfd, EPOLL_CTL_ADD, stdoutPipe[0], &ev) == -1) {
-        return LINGLONG_ERR(
-          fmt::format("epoll_ctl stdout error: {}", common::error::errorString(errno)));
+    for (const auto *pipe : { &m_stdout, &m_stderr }) {
+        if (!*pipe) {
+            continue;
+        }
+
+        ev.events = EPOLLIN;
+        ev.data.fd = pipe->get();
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, pipe->get(), &ev) == -1) {
+            return LINGLONG_ERR(
+              fmt::format("epoll_ctl output error: {}", common::error::errorString(errno)));
+        }
+        activeFds++;
     }
-    activeFds++;
 
     size_t writtenBytes = 0;
     if (!m_stdinContent.empty()) {
         ev.events = EPOLLOUT;
-        ev.data.fd = stdinPipe[1];
-        if (epoll_ctl(epfd, EPOLL_CTL_ADD, stdinPipe[1], &ev) == -1) {
+        ev.data.fd = m_stdin.get();
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, m_stdin.get(), &ev) == -1) {
             return LINGLONG_ERR(
               fmt::format("epoll_ctl stdin error: {}", common::error::errorString(errno)));
         }
         activeFds++;
     } else {
         // If no input, close write end immediately to send EOF to child
-        close(stdinPipe[1]);
-        stdinPipe[1] = -1;
+        m_stdin.reset();
     }
 
     std::string output;
-    std::vector<char> buffer(4096);
-    const int MAX_EVENTS = 2;
+    // stderr is only piped to its handler, nothing is appended
+    std::string errorOutput;
+    const int MAX_EVENTS = 3;
     struct epoll_event events[MAX_EVENTS];
 
     while (activeFds > 0) {
@@ -252,26 +326,15 @@ utils::error::Result<std::string> Cmd::exec(const std::vector<std::string> &args
 
         for (int i = 0; i < nfds; ++i) {
             int fd = events[i].data.fd;
-            if (fd == stdoutPipe[0]) {
-                while (true) {
-                    ssize_t n = read(fd, buffer.data(), buffer.size());
-                    if (n > 0) {
-                        output.append(buffer.data(), static_cast<size_t>(n));
-                        continue;
-                    }
-
-                    if (n == -1 && errno == EINTR) {
-                        continue;
-                    }
-
-                    if ((n == -1 && errno != EAGAIN && errno != EWOULDBLOCK) || n == 0) {
-                        // error or EOF, stop monitoring this FD
-                        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
-                        activeFds--;
-                    }
-                    break;
+            if (fd == m_stdout.get() || fd == m_stderr.get()) {
+                auto isStdout = fd == m_stdout.get();
+                if (!readOutput(fd,
+                                isStdout ? output : errorOutput,
+                                isStdout ? m_stdoutHandler : m_stderrHandler)) {
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+                    activeFds--;
                 }
-            } else if (fd == stdinPipe[1]) {
+            } else if (fd == m_stdin.get()) {
                 if (writtenBytes < m_stdinContent.size()) {
                     ssize_t n = write(fd,
                                       m_stdinContent.data() + writtenBytes,
@@ -292,7 +355,7 @@ utils::error::Result<std::string> Cmd::exec(const std::vector<std::string> &args
 
                 if (writtenBytes >= m_stdinContent.size()) {
                     epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
-                    close(fd);
+                    m_stdin.reset();
                     activeFds--;
                 }
             }
@@ -300,11 +363,12 @@ utils::error::Result<std::string> Cmd::exec(const std::vector<std::string> &args
     }
 
     int status;
-    while (waitpid(pid, &status, 0) == -1) {
+    while (waitpid(m_pid, &status, 0) == -1) {
         if (errno == EINTR)
             continue;
         return LINGLONG_ERR(fmt::format("waitpid error: {}", common::error::errorString(errno)));
     }
+    m_pid = -1;
 
     if (WIFEXITED(status)) {
         int exitCode = WEXITSTATUS(status);
@@ -336,4 +400,16 @@ Cmd &Cmd::toStdin(std::string content) noexcept
     return *this;
 }
 
+Cmd &Cmd::onStdout(OutputHandler handler) noexcept
+{
+    m_stdoutHandler = std::move(handler);
+    return *this;
+}
+
+Cmd &Cmd::onStderr(OutputHandler handler) noexcept
+{
+    m_stderrHandler = std::move(handler);
+    return *this;
+}
+
 } // namespace linglong::utils
@@ -7,12 +7,17 @@
 #pragma once
 
 #include "linglong/utils/error/error.h"
+#include "linglong/utils/unique_fd.h"
 
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include <sys/types.h>
+
 namespace linglong::utils {
 
 // Executes a command from the standard system PATH
@@ -20,6 +25,40 @@ namespace linglong::utils {
 class Cmd
 {
 public:
+    // called with every chunk of the output as soon as it's read
+    using OutputHandler = std::function<void(std::string_view)>;
+
+    // A command started by Cmd::start. Processes run concurrently until they are waited, so
+    // independent commands can be started together and waited one by one.
+    class Process
+    {
+    public:
+        Process(Process &&other) noexcept;
+        Process &operator=(Process &&other) noexcept;
+        Process(const Process &) = delete;
+        Process &operator=(const Process &) = delete;
+        ~Process();
+
+        // Feed stdin and read the output until the process exits, the stdout is returned unless
+        // it's streamed to a handler.
+        utils::error::Result<std::string> wait() noexcept;
+
+        [[nodiscard]] pid_t pid() const noexcept { return m_pid; }
+
+    private:
+        friend class Cmd;
+
+        Process() noexcept = default;
+
+        pid_t m_pid{ -1 };
+        fd::UniqueFd m_stdin;
+        fd::UniqueFd m_stdout;
+        fd::UniqueFd m_stderr;
+        std::string m_stdinContent;
+        OutputHandler m_stdoutHandler;
+        OutputHandler m_stderrHandler;
+    };
+
     explicit Cmd(std::string command) noexcept;
     virtual ~Cmd();
 
@@ -29,12 +68,23 @@ public:
     virtual Cmd &setEnv(const std::string &name, const std::string &value) noexcept;
     virtual Cmd &toStdin(std::string content) noexcept;
 
+    // Stream stdout to handler instead of returning it from exec.
+    Cmd &onStdout(OutputHandler handler) noexcept;
+    // Stream stderr to handler, it's inherited from the current process by default.
+    Cmd &onStderr(OutputHandler handler) noexcept;
+
+    // Start the command without waiting for it, see Process.
+    utils::error::Result<Process> start(const std::vector<std::string> &args = {}) noexcept;
+
 private:
     std::filesystem::path getCommandPath();
 
     std::string m_command;
-    std::map<std::string, std::string> m_envs;
+    // transparent, the names in environ are looked up without copies
+    std::map<std::string, std::string, std::less<>> m_envs;
     std::string m_stdinContent;
+    OutputHandler m_stdoutHandler;
+    OutputHandler m_stderrHandler;
 };
 
 } // namespace linglong::utils
@@ -7,12 +7,17 @@
 #include "linglong/common/error.h"
 #include "linglong/utils/error/error.h"
 #include "linglong/utils/log/log.h"
+#include "linglong/utils/parallel.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <sys/stat.h>
 #include <unistd.h>
@@ -21,6 +26,9 @@ namespace linglong::utils {
 
 namespace {
 
+// renaming is cheap, more workers only contend on the locks of the file system
+constexpr std::size_t MoveMaxWorkers = 8;
+
 linglong::utils::error::Result<void>
 ensureOwnerPermissionsIfNeeded(const std::filesystem::path &path,
                                std::filesystem::perms currentPerms,
@@ -86,6 +94,34 @@ linglong::utils::error::Result<void> writeFile(const std::filesystem::path &file
     return LINGLONG_OK;
 }
 
+linglong::utils::error::Result<void> replaceFile(const std::filesystem::path &filepath,
+                                                 std::string_view content) noexcept
+{
+    LINGLONG_TRACE(fmt::format("replace file {}", filepath));
+
+    auto tmpFile = filepath;
+    tmpFile += fmt::format(".{}.{}.tmp",
+                           ::getpid(),
+                           std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    std::error_code ec;
+    std::ofstream out{ tmpFile, std::ios::binary | std::ios::trunc };
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    out.close();
+    if (!out) {
+        std::filesystem::remove(tmpFile, ec);
+        return LINGLONG_ERR(fmt::format("failed to write {}", tmpFile));
+    }
+
+    std::filesystem::rename(tmpFile, filepath, ec);
+    if (ec) {
+        std::error_code removeEc;
+        std::filesystem::remove(tmpFile, removeEc);
+        return LINGLONG_ERR(fmt::format("failed to rename {}", tmpFile), ec);
+    }
+
+    return LINGLONG_OK;
+}
+
 linglong::utils::error::Result<void> concatFile(const std::filesystem::path &source,
                                                 const std::filesystem::path &target)
 {
@@ -218,35 +254,83 @@ moveFiles(const std::filesystem::path &src,
         return LINGLONG_ERR("failed to get files", files);
     }
 
-    for (const auto &relPath : *files) {
-        if (matcher && !matcher(relPath)) {
-            continue;
+    // Files in different top level entries never share a parent below dest, so every subtree is
+    // moved by a worker on its own. Files of a subtree keep the order of the iteration, parents
+    // are always visited before their children.
+    std::vector<std::vector<std::filesystem::path>> subtrees;
+    std::unordered_map<std::string, std::size_t> subtreeIndex;
+    for (auto &relPath : *files) {
+        auto [it, inserted] = subtreeIndex.try_emplace(relPath.begin()->string(), subtrees.size());
+        if (inserted) {
+            subtrees.emplace_back();
         }
+        subtrees[it->second].emplace_back(std::move(relPath));
+    }
 
-        const auto fromPath = src / relPath;
-        const auto toPath = dest / relPath;
-        LogD("{} -> {}", fromPath, toPath);
-
-        std::error_code ec;
-        auto status = std::filesystem::symlink_status(fromPath, ec);
-        if (ec) {
-            LogD("failed to get symlink status of {}: {}", fromPath, ec.message());
-            continue;
-        }
-        if (!std::filesystem::exists(status)) {
-            LogD("{} does not exist, skip it", fromPath);
-            continue;
+    // the matcher and the filesystem may throw, which must not escape a worker
+    auto moveSubtree = [&src, &dest, &matcher](const std::vector<std::filesystem::path> &subtree)
+      noexcept -> utils::error::Result<void> {
+        LINGLONG_TRACE("move subtree");
+
+        try {
+            // children of a moved directory are moved with it
+            std::string movedPrefix;
+            for (const auto &relPath : subtree) {
+                if (!movedPrefix.empty() && relPath.native().rfind(movedPrefix, 0) == 0) {
+                    continue;
+                }
+
+                if (matcher && !matcher(relPath)) {
+                    continue;
+                }
+
+                const auto fromPath = src / relPath;
+                const auto toPath = dest / relPath;
+                LogD("{} -> {}", fromPath, toPath);
+
+                std::error_code ec;
+                auto status = std::filesystem::symlink_status(fromPath, ec);
+                if (ec) {
+                    LogD("failed to get symlink status of {}: {}", fromPath, ec.message());
+                    continue;
+                }
+                if (!std::filesystem::exists(status)) {
+                    LogD("{} does not exist, skip it", fromPath);
+                    continue;
+                }
+
+                std::filesystem::create_directories(toPath.parent_path(), ec);
+                if (ec) {
+                    LogW("failed to create directory {}: {}", toPath, ec.message());
+                    continue;
+                }
+                std::filesystem::rename(fromPath, toPath, ec);
+                if (ec) {
+                    LogW("failed to copy {} to {}: {}", fromPath, toPath, ec.message());
+                    continue;
+                }
+
+                if (std::filesystem::is_directory(status)) {
+                    movedPrefix = relPath.native() + '/';
+                }
+            }
+        } catch (const std::exception &e) {
+            return LINGLONG_ERR("failed to move files", e);
         }
 
-        std::filesystem::create_directories(toPath.parent_path(), ec);
-        if (ec) {
-            LogW("failed to create directory {}: {}", toPath, ec.message());
-            continue;
-        }
-        std::filesystem::rename(fromPath, toPath, ec);
-        if (ec) {
-            LogW("failed to copy {} to {}: {}", fromPath, toPath, ec.message());
-            continue;
+        return LINGLONG_OK;
+    };
+
+    std::vector<utils::error::Result<void>> results(subtrees.size());
+    utils::parallelFor(subtrees.size(),
+                       std::min<std::size_t>(std::thread::hardware_concurrency(), MoveMaxWorkers),
+                       [&subtrees, &results, &moveSubtree](std::size_t i) noexcept {
+                           results[i] = moveSubtree(subtrees[i]);
+                       });
+
+    for (auto &result : results) {
+        if (!result) {
+            return LINGLONG_ERR(result);
         }
     }
 
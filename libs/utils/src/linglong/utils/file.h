@@ -7,6 +7,7 @@
 
 #include <filesystem>
 #include <string>
+#include <string_view>
 
 namespace linglong::utils {
 
@@ -15,6 +16,11 @@ linglong::utils::error::Result<std::string> readFile(const std::filesystem::path
 linglong::utils::error::Result<void> writeFile(const std::filesystem::path &filepath,
                                                const std::string &content);
 
+// Write content to a temporary file next to filepath and rename it over filepath, so readers see
+// either the old or the new content. Several threads or processes may replace the same file.
+linglong::utils::error::Result<void> replaceFile(const std::filesystem::path &filepath,
+                                                 std::string_view content) noexcept;
+
 linglong::utils::error::Result<void> concatFile(const std::filesystem::path &source,
                                                 const std::filesystem::path &target);
 
@@ -28,6 +34,9 @@ void copyDirectory(
   std::filesystem::copy_options options = std::filesystem::copy_options::copy_symlinks
     | std::filesystem::copy_options::skip_existing);
 
+// Move the files in src which are accepted by matcher to dest, a matched directory is moved with
+// all its children. The top level entries of src are moved concurrently, matcher must be safe to
+// be called from several threads.
 linglong::utils::error::Result<void>
 moveFiles(const std::filesystem::path &src,
           const std::filesystem::path &dest,
@@ -7,8 +7,31 @@
 #include "linglong/utils/io/event_loop.h"
 #include "linglong/utils/log/log.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+
 namespace linglong::utils::io {
 
+namespace {
+
+// the most data moved by one splice, bounded by the size of the pipe anyway
+constexpr std::size_t SpliceChunkSize = 1024 * 1024;
+
+bool isPipe(int fd) noexcept
+{
+    struct stat st{};
+    return ::fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+bool isWritable(int fd) noexcept
+{
+    struct pollfd pfd{ .fd = fd, .events = POLLOUT, .revents = 0 };
+    return ::poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT) != 0;
+}
+
+} // namespace
+
 IOForwarder::IOForwarder(EventLoop &epoll, std::size_t bufferSize) noexcept
     : buffer_(RingBuffer::create(bufferSize))
     , epoll_(&epoll)
@@ -32,6 +55,75 @@ void IOForwarder::setDst(int fd) noexcept
     dstFd_ = fd;
 }
 
+bool IOForwarder::enableSplice() noexcept
+{
+    if (srcFd_ < 0 || dstFd_ < 0 || !bufferEmpty()) {
+        return false;
+    }
+
+    // the line discipline of terminals doesn't support splice
+    if (::isatty(srcFd_) != 0 || ::isatty(dstFd_) != 0) {
+        return false;
+    }
+
+    splice_ = isPipe(srcFd_) || isPipe(dstFd_);
+    return splice_;
+}
+
+void IOForwarder::transfer() noexcept
+{
+    while (!srcEof_ && !dstFailed_) {
+        auto n = ::splice(srcFd_,
+                          nullptr,
+                          dstFd_,
+                          nullptr,
+                          SpliceChunkSize,
+                          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            continue;
+        }
+
+        if (n == 0) {
+            srcEof_ = true;
+            break;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // either src has no data or dst has no room, the data stays in src for the latter
+            if (!isWritable(dstFd_)) {
+                registerDstWrite();
+                return;
+            }
+            break;
+        }
+
+        if (errno == EINVAL || errno == ENOSYS) {
+            LogD("splice from {} to {} is not supported, copy the data instead", srcFd_, dstFd_);
+            splice_ = false;
+            pull();
+            push();
+            return;
+        }
+
+        if (errno == EPIPE) {
+            dstFailed_ = true;
+            return;
+        }
+
+        // EIO
+        srcEof_ = true;
+        return;
+    }
+
+    if (writeWatched_) {
+        unregisterDstWrite();
+    }
+}
+
 void IOForwarder::pull() noexcept
 {
     if (srcEof_ || !buffer_ || buffer_->full() || srcFd_ < 0) {
@@ -107,12 +199,22 @@ void IOForwarder::push() noexcept
 
 void IOForwarder::drive() noexcept
 {
+    if (splice_) {
+        transfer();
+        return;
+    }
+
     pull();
     push();
 }
 
 void IOForwarder::onDstWritable() noexcept
 {
+    if (splice_) {
+        transfer();
+        return;
+    }
+
     push();
 }
 
@@ -33,6 +33,13 @@ public:
     void setSrc(int fd) noexcept;
     void setDst(int fd) noexcept;
 
+    // Move the data by splice(2) in the kernel instead of copying it through the buffer. Only
+    // possible if one of src and dst is a pipe and none is a terminal, returns whether it's used.
+    // The forwarder falls back to the buffer if the kernel refuses to splice the fds.
+    bool enableSplice() noexcept;
+
+    [[nodiscard]] bool splicing() const noexcept { return splice_; }
+
     [[nodiscard]] int srcFd() const noexcept { return srcFd_; }
 
     [[nodiscard]] int dstFd() const noexcept { return dstFd_; }
@@ -57,6 +64,7 @@ public:
     void onDstWritable() noexcept;
 
 private:
+    void transfer() noexcept;
     void registerDstWrite() noexcept;
     void unregisterDstWrite() noexcept;
 
@@ -66,6 +74,7 @@ private:
     bool srcEof_{ false };
     bool dstFailed_{ false };
     bool writeWatched_{ false };
+    bool splice_{ false };
     EventLoop *epoll_;
 };
 
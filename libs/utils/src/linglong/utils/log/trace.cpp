@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "trace.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace linglong::utils::log {
+
+namespace {
+
+thread_local std::size_t spanDepth = 0;
+
+bool writeAll(int fd, std::string_view content) noexcept
+{
+    while (!content.empty()) {
+        auto ret = ::write(fd, content.data(), content.size());
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        content.remove_prefix(static_cast<std::size_t>(ret));
+    }
+
+    return true;
+}
+
+} // namespace
+
+Tracer::Tracer() noexcept
+{
+    if (auto *file = ::getenv(TraceFileEnv); file != nullptr && file[0] != '\0') {
+        openTraceFile(file);
+    }
+}
+
+Tracer::~Tracer()
+{
+    if (traceFd != -1) {
+        ::close(traceFd);
+    }
+}
+
+void Tracer::setTraceFile(const std::filesystem::path &file) noexcept
+{
+    std::lock_guard lock(mutex);
+    if (traceFd != -1) {
+        ::close(traceFd);
+        traceFd = -1;
+    }
+
+    if (file.empty()) {
+        ::unsetenv(TraceFileEnv);
+        return;
+    }
+
+    std::error_code ec;
+    auto path = std::filesystem::absolute(file, ec);
+    if (ec) {
+        path = file;
+    }
+
+    ::setenv(TraceFileEnv, path.c_str(), 1);
+    openTraceFile(path.c_str());
+}
+
+void Tracer::openTraceFile(const char *file) noexcept
+{
+    // every event is appended by a single write, so the events of several processes never
+    // interleave
+    traceFd = ::open(file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (traceFd == -1) {
+        return;
+    }
+
+    // the trailing ']' of the JSON array format is optional, so the file is valid at any time
+    if (::flock(traceFd, LOCK_EX) == 0) {
+        struct stat st{};
+        if (::fstat(traceFd, &st) == 0 && st.st_size == 0) {
+            writeAll(traceFd, "[\n");
+        }
+        ::flock(traceFd, LOCK_UN);
+    }
+}
+
+uint64_t Tracer::now() noexcept
+{
+    struct timespec ts{};
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000U + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void Tracer::record(const Logger::LoggerContext &context,
+                    std::string_view name,
+                    uint64_t begin,
+                    uint64_t end) noexcept
+{
+    std::lock_guard lock(mutex);
+    if (traceFd == -1) {
+        return;
+    }
+
+    std::string content;
+    try {
+        auto pid = ::getpid();
+        // name the process once, forked processes have their own pid
+        if (pid != namedPid) {
+            namedPid = pid;
+            content = nlohmann::json{
+                { "name", "process_name" },
+                { "ph", "M" },
+                { "pid", pid },
+                { "args", { { "name", program_invocation_short_name } } },
+            }.dump();
+            content += ",\n";
+        }
+
+        content += nlohmann::json{
+            { "name", name },
+            { "cat", "linglong" },
+            { "ph", "X" },
+            { "ts", static_cast<double>(begin) / 1000 },
+            { "dur", static_cast<double>(end - begin) / 1000 },
+            { "pid", pid },
+            { "tid", ::syscall(SYS_gettid) },
+            { "args", { { "function", context.function } } },
+        }.dump();
+        content += ",\n";
+    } catch (const std::exception &) {
+        return;
+    }
+
+    writeAll(traceFd, content);
+}
+
+TraceSpan::TraceSpan(const Logger::LoggerContext &context, std::string name) noexcept
+    : context(context)
+    , name(std::move(name))
+    , begin(Tracer::now())
+{
+    ++spanDepth;
+}
+
+TraceSpan::~TraceSpan()
+{
+    auto end = Tracer::now();
+    --spanDepth;
+
+    g_logger.log(context,
+                 LogLevel::Debug,
+                 "{:{}}span {} took {:.3f}ms",
+                 "",
+                 spanDepth * 2,
+                 name,
+                 static_cast<double>(end - begin) / 1000000);
+    g_tracer.record(context, name, begin, end);
+}
+
+} // namespace linglong::utils::log
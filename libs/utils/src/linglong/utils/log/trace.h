@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "linglong/utils/log/log.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include <sys/types.h>
+
+/*
+spans are logged at debug level, and appended as chrome trace events to the file named by
+LINYAPS_TRACE_FILE, which can be opened by https://ui.perfetto.dev or chrome://tracing:
+LINYAPS_TRACE_FILE=/tmp/trace.json ll-cli run org.deepin.demo
+ll-cli --trace /tmp/trace.json run org.deepin.demo
+*/
+
+#define LOG_CONCAT_IMPL(a, b) a##b
+#define LOG_CONCAT(a, b) LOG_CONCAT_IMPL(a, b)
+
+// measure the time from here to the end of the current scope
+#define LogSpan(name) LOGNS::TraceSpan LOG_CONCAT(logSpan, __LINE__)(LOGCTX, name)
+
+namespace linglong::utils::log {
+
+constexpr auto TraceFileEnv = "LINYAPS_TRACE_FILE";
+
+class Tracer
+{
+public:
+    Tracer() noexcept;
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+    Tracer(Tracer &&) = delete;
+    Tracer &operator=(Tracer &&) = delete;
+    ~Tracer();
+
+    // Append the events of this process to file, or stop tracing if file is empty. The file is
+    // exported by TraceFileEnv, so the processes started later write to it as well.
+    void setTraceFile(const std::filesystem::path &file) noexcept;
+
+    // CLOCK_MONOTONIC in nanoseconds, the timestamps of all processes are comparable
+    static uint64_t now() noexcept;
+
+    void record(const Logger::LoggerContext &context,
+                std::string_view name,
+                uint64_t begin,
+                uint64_t end) noexcept;
+
+private:
+    void openTraceFile(const char *file) noexcept;
+
+    std::mutex mutex;
+    int traceFd{ -1 };
+    pid_t namedPid{ -1 };
+};
+
+inline Tracer g_tracer;
+
+class TraceSpan
+{
+public:
+    TraceSpan(const Logger::LoggerContext &context, std::string name) noexcept;
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+    TraceSpan(TraceSpan &&) = delete;
+    TraceSpan &operator=(TraceSpan &&) = delete;
+    ~TraceSpan();
+
+private:
+    Logger::LoggerContext context;
+    std::string name;
+    uint64_t begin;
+};
+
+} // namespace linglong::utils::log
@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2026 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include "linglong/utils/log/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace linglong::utils {
+
+// Call fn(i) for every i in [0, count) on at most maxWorkers threads, the calling thread is one
+// of the workers. fn must be noexcept and safe to be called concurrently for different indexes.
+// Results should be written to a slot per index to keep them in order.
+// Returns the number of workers actually used.
+template <typename Fn>
+std::size_t parallelFor(std::size_t count, std::size_t maxWorkers, Fn &&fn) noexcept
+{
+    std::atomic_size_t next{ 0 };
+    auto worker = [&next, count, &fn]() noexcept {
+        for (auto i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            fn(i);
+        }
+    };
+
+    auto workerCount = std::min(std::max<std::size_t>(maxWorkers, 1), count);
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < workerCount; ++i) {
+        try {
+            workers.emplace_back(worker);
+        } catch (const std::system_error &e) {
+            // the remaining work is shared by the started workers
+            LogW("failed to start worker thread: {}", e.what());
+            break;
+        }
+    }
+
+    worker();
+    for (auto &thread : workers) {
+        thread.join();
+    }
+
+    return workers.size() + 1;
+}
+
+} // namespace linglong::utils
@@ -10,6 +10,8 @@
 #include <array>
 #include <cstdint>
 #include <cstring>
+#include <string>
+#include <string_view>
 
 namespace digest {
 
@@ -217,4 +219,22 @@ private:
     std::array<std::byte, 64> m{};
 };
 
+// the SHA-256 digest of data in lowercase hex, e.g. to name the file of a cache entry by its key
+inline std::string sha256Hex(std::string_view data) noexcept
+{
+    SHA256 sha256;
+    sha256.update(reinterpret_cast<const std::byte *>(data.data()), data.size());
+    std::array<std::byte, 32> digest{};
+    sha256.final(digest.data());
+
+    constexpr std::string_view digits = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for (auto byte : digest) {
+        hex += digits[std::to_integer<unsigned>(byte) >> 4U];
+        hex += digits[std::to_integer<unsigned>(byte) & 0xfU];
+    }
+    return hex;
+}
+
 } // namespace digest